@@ -0,0 +1,191 @@
+/* $Id$
+ * --------------------------------------------------------------------------
+ *
+ *           //=====   //===== ===//=== //===//  //       //   //===//
+ *          //        //         //    //    // //       //   //    //
+ *         //====//  //         //    //===//  //       //   //===<<
+ *              //  //         //    //       //       //   //    //
+ *       ======//  //=====    //    //       //=====  //   //===//
+ *
+ * -------------- An SCTP implementation according to RFC 4960 --------------
+ *
+ * Copyright (C) 2000 by Siemens AG, Munich, Germany.
+ * Copyright (C) 2001-2004 Andreas Jungmaier
+ * Copyright (C) 2004-2017 Thomas Dreibholz
+ *
+ * Acknowledgements:
+ * Realized in co-operation between Siemens AG and the University of
+ * Duisburg-Essen, Institute for Experimental Mathematics, Computer
+ * Networking Technology group.
+ * This work was partially funded by the Bundesministerium fuer Bildung und
+ * Forschung (BMBF) of the Federal Republic of Germany
+ * (Förderkennzeichen 01AK045).
+ * The authors alone are responsible for the contents.
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact: sctp-discussion@sctp.de
+ *          dreibh@iem.uni-due.de
+ *          tuexen@fh-muenster.de
+ *          andreas.jungmaier@web.de
+ */
+
+/*
+Measures the overhead of an sctp_send() call, depending on the number of
+associations. The associations are started towards ports on which nobody
+listens, and the event loop is never run, so they all stay in COOKIE-WAIT.
+The sctp_send() calls address a path that does not exist, so each call only
+looks up the association and returns.
+
+Example:
+sudo ./assocbench -s 10 -s 1000 -s 50000
+*/
+
+#include "sctp_wrapper.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>         /* for atoi() under Linux */
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define DEFAULT_PORT                       5001
+#define FIRST_REMOTE_PORT                 10000
+#define MAXIMUM_NUMBER_OF_ASSOCIATIONS    55000
+#define MAXIMUM_NUMBER_OF_STEPS              10
+#define DEFAULT_NUMBER_OF_CALLS         1000000
+
+static unsigned int  assocIDs[MAXIMUM_NUMBER_OF_ASSOCIATIONS];
+static unsigned int  numberOfAssociations = 0;
+static unsigned int  steps[MAXIMUM_NUMBER_OF_STEPS];
+static unsigned int  numberOfSteps = 0;
+static unsigned int  numberOfCalls = DEFAULT_NUMBER_OF_CALLS;
+static unsigned char destinationAddress[SCTP_MAX_IP_LEN] = "127.0.0.1";
+static unsigned char localAddressList[1][SCTP_MAX_IP_LEN] = { "0.0.0.0" };
+
+void printUsage(void)
+{
+   printf("usage:   assocbench [options]\n");
+   printf("options:\n");
+   printf("-s number        number of associations for one measurement (may be repeated,\n");
+   printf("                 default: 10, 1000 and 50000)\n");
+   printf("-c number        number of sctp_send() calls per measurement\n");
+   printf("-d address       destination address of the associations\n");
+}
+
+void getArgs(int argc, char **argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++) {
+       if ((argv[i][0] != '-') || (i + 1 >= argc)) {
+          printUsage();
+          exit(0);
+       }
+       switch (argv[i][1]) {
+          case 's':
+             if (numberOfSteps < MAXIMUM_NUMBER_OF_STEPS) {
+                steps[numberOfSteps] = atoi(argv[++i]);
+                if (steps[numberOfSteps] > MAXIMUM_NUMBER_OF_ASSOCIATIONS)
+                   steps[numberOfSteps] = MAXIMUM_NUMBER_OF_ASSOCIATIONS;
+                numberOfSteps++;
+             } else {
+                i++;
+             }
+           break;
+          case 'c':
+             numberOfCalls = atoi(argv[++i]);
+           break;
+          case 'd':
+             if (strlen(argv[i+1]) < SCTP_MAX_IP_LEN) {
+                strcpy((char *)destinationAddress, argv[i+1]);
+             }
+             i++;
+           break;
+          default:
+             printUsage();
+             exit(0);
+       }
+    }
+    if (numberOfSteps == 0) {
+       steps[0] = 10;
+       steps[1] = 1000;
+       steps[2] = 50000;
+       numberOfSteps = 3;
+    }
+}
+
+static double nanoseconds(struct timespec *start, struct timespec *stop)
+{
+    return (stop->tv_sec - start->tv_sec) * 1e9 + (stop->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char **argv)
+{
+    SCTP_ulpCallbacks benchUlp;
+    SCTP_LibraryParameters params;
+    struct timespec start, stop;
+    unsigned char data[16];
+    unsigned int step, i, id;
+    int sctpInstance, result;
+
+    getArgs(argc, argv);
+    memset(&benchUlp, 0, sizeof(benchUlp));
+    memset(data, 0, sizeof(data));
+
+    SCTP_initLibrary();
+    SCTP_getLibraryParameters(&params);
+    /* the INITs arrive at this process, they must not be answered */
+    params.sendOotbAborts = 0;
+    SCTP_setLibraryParameters(&params);
+    sctpInstance = SCTP_registerInstance(DEFAULT_PORT, 1, 1, 1, localAddressList, benchUlp);
+    if (sctpInstance <= 0) {
+        fprintf(stderr, "could not register the SCTP instance\n");
+        exit(1);
+    }
+    srand(1);
+
+    for (step = 0; step < numberOfSteps; step++) {
+        while (numberOfAssociations < steps[step]) {
+            id = sctp_associate((unsigned short)sctpInstance, 1, destinationAddress,
+                                (unsigned short)(FIRST_REMOTE_PORT + numberOfAssociations), NULL);
+            if (id == 0) {
+                fprintf(stderr, "could not create association %u\n", numberOfAssociations + 1);
+                exit(1);
+            }
+            assocIDs[numberOfAssociations++] = id;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < numberOfCalls; i++) {
+            /* path 1 does not exist: the call returns right after finding the association */
+            result = sctp_send(assocIDs[rand() % numberOfAssociations], 0, data, sizeof(data),
+                               SCTP_GENERIC_PAYLOAD_PROTOCOL_ID, 1, SCTP_NO_CONTEXT,
+                               SCTP_INFINITE_LIFETIME, SCTP_ORDERED_DELIVERY, SCTP_BUNDLING_ENABLED);
+            if (result != SCTP_PARAMETER_PROBLEM) {
+                fprintf(stderr, "unexpected result %d of sctp_send()\n", result);
+                exit(1);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        printf("%6u associations: %.1f ns per sctp_send() call\n",
+               numberOfAssociations, nanoseconds(&start, &stop) / numberOfCalls);
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+/* $Id$
+ * --------------------------------------------------------------------------
+ *
+ *           //=====   //===== ===//=== //===//  //       //   //===//
+ *          //        //         //    //    // //       //   //    //
+ *         //====//  //         //    //===//  //       //   //===<<
+ *              //  //         //    //       //       //   //    //
+ *       ======//  //=====    //    //       //=====  //   //===//
+ *
+ * -------------- An SCTP implementation according to RFC 4960 --------------
+ *
+ * Copyright (C) 2000 by Siemens AG, Munich, Germany.
+ * Copyright (C) 2001-2004 Andreas Jungmaier
+ * Copyright (C) 2004-2017 Thomas Dreibholz
+ *
+ * Acknowledgements:
+ * Realized in co-operation between Siemens AG and the University of
+ * Duisburg-Essen, Institute for Experimental Mathematics, Computer
+ * Networking Technology group.
+ * This work was partially funded by the Bundesministerium fuer Bildung und
+ * Forschung (BMBF) of the Federal Republic of Germany
+ * (Förderkennzeichen 01AK045).
+ * The authors alone are responsible for the contents.
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact: sctp-discussion@sctp.de
+ *          dreibh@iem.uni-due.de
+ *          tuexen@fh-muenster.de
+ *          andreas.jungmaier@web.de
+ */
+
+/*
+Compares the per packet cost of the two ways the library has used to send a
+datagram with a given TOS byte:
+ - old: getsockopt(IP_TOS), setsockopt(IP_TOS), sendto(), setsockopt(IP_TOS),
+        and the destination address formatted as a string for each packet
+ - new: one sendmsg() carrying the TOS as ancillary data
+The datagrams are sent over UDP to a socket on the loopback interface, so no
+special privileges are needed.
+
+Example:
+./txbench -n 1000000 -l 1000
+*/
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>         /* for atoi() under Linux */
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <arpa/inet.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define DEFAULT_LENGTH                     1000
+#define DEFAULT_NUMBER_OF_MESSAGES       200000
+#define MAXIMUM_PAYLOAD_LENGTH             9000
+
+static unsigned int   numberOfMessages = DEFAULT_NUMBER_OF_MESSAGES;
+static unsigned int   messageLength    = DEFAULT_LENGTH;
+static int            tosByte          = 0x10;  /* IPTOS_LOWDELAY */
+static unsigned char  buffer[MAXIMUM_PAYLOAD_LENGTH];
+static unsigned long  numberOfSyscalls;
+static unsigned long  numberOfErrors;
+
+void printUsage(void)
+{
+   printf("usage:   txbench [options]\n");
+   printf("options:\n");
+   printf("-l length        size of the datagrams\n");
+   printf("-n number        number of datagrams sent by each method\n");
+   printf("-t tos           TOS byte of the datagrams\n");
+}
+
+void getArgs(int argc, char **argv)
+{
+    int i;
+
+    for (i = 1; i < argc; i++) {
+       if ((argv[i][0] != '-') || (i + 1 >= argc)) {
+          printUsage();
+          exit(0);
+       }
+       switch (argv[i][1]) {
+          case 'l':
+             messageLength = atoi(argv[++i]);
+             if (messageLength > MAXIMUM_PAYLOAD_LENGTH) messageLength = MAXIMUM_PAYLOAD_LENGTH;
+           break;
+          case 'n':
+             numberOfMessages = atoi(argv[++i]);
+           break;
+          case 't':
+             tosByte = atoi(argv[++i]);
+           break;
+          default:
+             printUsage();
+             exit(0);
+       }
+    }
+}
+
+static double nanoseconds(struct timespec *start, struct timespec *stop)
+{
+    return (stop->tv_sec - start->tv_sec) * 1e9 + (stop->tv_nsec - start->tv_nsec);
+}
+
+/* the transmit path before: the TOS is set and reset around each sendto() */
+static void sendOld(int sfd, struct sockaddr_in *dest)
+{
+    unsigned char oldTos, tos = (unsigned char)tosByte;
+    socklen_t optLen = sizeof(oldTos);
+    char hostname[INET6_ADDRSTRLEN];
+
+    getsockopt(sfd, IPPROTO_IP, IP_TOS, &oldTos, &optLen);
+    setsockopt(sfd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    inet_ntop(AF_INET, &dest->sin_addr, hostname, sizeof(hostname));
+    if (sendto(sfd, buffer, messageLength, 0, (struct sockaddr *)dest, sizeof(*dest)) < 0) {
+        numberOfErrors++;
+    }
+    setsockopt(sfd, IPPROTO_IP, IP_TOS, &oldTos, sizeof(oldTos));
+    numberOfSyscalls += 4;
+}
+
+/* the transmit path now: the TOS travels with the datagram */
+static void sendNew(int sfd, struct sockaddr_in *dest)
+{
+    struct msghdr msg;
+    struct iovec vec;
+    struct cmsghdr *cmsg;
+    unsigned char cmsgbuf[CMSG_SPACE(sizeof(int))];
+
+    vec.iov_base = buffer;
+    vec.iov_len  = messageLength;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name       = dest;
+    msg.msg_namelen    = sizeof(*dest);
+    msg.msg_iov        = &vec;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cmsgbuf;
+    msg.msg_controllen = sizeof(cmsgbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type  = IP_TOS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &tosByte, sizeof(int));
+    if (sendmsg(sfd, &msg, 0) < 0) {
+        numberOfErrors++;
+    }
+    numberOfSyscalls += 1;
+}
+
+static void runMethod(const char *name, void (*method)(int, struct sockaddr_in *),
+                      int sfd, struct sockaddr_in *dest)
+{
+    struct timespec start, stop;
+    unsigned int i;
+    double ns;
+
+    numberOfSyscalls = 0;
+    numberOfErrors   = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < numberOfMessages; i++) {
+        (*method)(sfd, dest);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    ns = nanoseconds(&start, &stop);
+
+    printf("%-4s: %u datagrams of %u bytes, %.2f syscalls/packet, %.1f ns/packet, %lu errors\n",
+           name, numberOfMessages, messageLength,
+           (double)numberOfSyscalls / numberOfMessages, ns / numberOfMessages, numberOfErrors);
+}
+
+int main(int argc, char **argv)
+{
+    int sfd, rfd;
+    struct sockaddr_in dest;
+    socklen_t destLen = sizeof(dest);
+
+    getArgs(argc, argv);
+    if (numberOfMessages == 0) {
+        printUsage();
+        exit(0);
+    }
+    memset(buffer, 0x55, sizeof(buffer));
+
+    /* the receiver is never read: datagrams are dropped once its buffer is full */
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family      = AF_INET;
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    dest.sin_port        = 0;
+    if (((rfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) ||
+        (bind(rfd, (struct sockaddr *)&dest, sizeof(dest)) < 0) ||
+        (getsockname(rfd, (struct sockaddr *)&dest, &destLen) < 0)) {
+        perror("receiver socket");
+        exit(1);
+    }
+    if ((sfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        perror("sender socket");
+        exit(1);
+    }
+
+    runMethod("old", sendOld, sfd, &dest);
+    runMethod("new", sendNew, sfd, &dest);
+
+    close(sfd);
+    close(rfd);
+    return 0;
+}
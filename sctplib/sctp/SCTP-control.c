@@ -121,7 +121,7 @@ typedef struct SCTP_CONTROLDATA
 /*
 pointer to the current controller structure. Only set when association exists.
 */
-static SCTP_controlData *localData;
+static ENGINE_LOCAL SCTP_controlData *localData;
 
 
 /* ------------------ Function Implementations ---------------------------------------------------*/
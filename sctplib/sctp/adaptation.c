@@ -43,6 +43,7 @@
 
 #include "adaptation.h"
 #include "timer_list.h"
+#include "chunkpool.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -51,6 +52,7 @@
 
 #ifndef WIN32
    #include <sys/time.h>
+   #include <time.h>           /* for clock_gettime() */
    #include <netinet/in_systm.h>
    #include <netinet/ip.h>
    #include <netdb.h>
@@ -140,6 +142,12 @@
     #define POLLERR    0x008
 #endif
 
+/* on Linux, the event loop uses epoll() unless USE_SELECT is defined */
+#if defined (LINUX) && defined (HAVE_SYS_EPOLL_H) && !defined (USE_SELECT)
+    #define USE_EPOLL
+    #include <sys/epoll.h>
+#endif
+
 #ifdef LIBRARY_DEBUG
  #define ENTER_TIMER_DISPATCHER printf("Entering timer dispatcher.\n"); fflush(stdout);
  #define LEAVE_TIMER_DISPATCHER printf("Leaving  timer dispatcher.\n"); fflush(stdout);
@@ -156,10 +164,72 @@
 #define POLL_FD_UNUSED     -1
 #define NUM_FDS     20
 
+#ifdef USE_EPOLL
+/* maximum number of events fetched by one epoll_wait() call */
+#define EPOLL_MAX_EVENTS        256
+/* maximum number of reads (single datagrams or batches) from one library socket per readiness event */
+#define EPOLL_DRAIN_BUDGET      64
+/* initial size of the table of registered file descriptors */
+#define EPOLL_TABLE_SIZE        64
+/* the library's own sockets are drained, so they must never block in recv() */
+#define ADL_RECV_FLAGS          MSG_DONTWAIT
+#else
+#define ADL_RECV_FLAGS          0
+#endif
+
+/* on Linux, the TOS (or IPv6 traffic class) of each datagram is passed to sendmsg()
+   as ancillary data, so the socket options need not be changed for every datagram */
+#if defined (LINUX)
+#define USE_TOS_CMSG
+#define TOS_CMSG_SPACE          CMSG_SPACE(sizeof(int))
+#endif
+
+/* on Linux, datagrams may be queued and sent in batches with sendmmsg(), if available */
+#if defined (LINUX) && defined (HAVE_SENDMMSG)
+#define USE_SENDMMSG
+/* maximum number of datagrams in the transmit queue */
+#define SEND_QUEUE_MAX_DEPTH    64
+#endif
+
+/* on Linux, the SCTP sockets are read in batches with recvmmsg(), if available */
+#if defined (LINUX) && defined (HAVE_RECVMMSG)
+#define USE_RECVMMSG
+/* maximum number of datagrams read by one recvmmsg() call */
+#define RECV_BATCH_SIZE         16
+#endif
+
+/* maximum number of unused receive buffers kept for reuse */
+#define RECV_POOL_SIZE          64
+/* room for a datagram in a receive buffer, until a datagram larger than the common
+   MTU has been received, see adl_dispatchReceiveBuffer() */
+#define RECV_BUFFER_SIZE        (DEFAULT_MTU_SIZE + 20)
+
+/* other threads wake up the event loop through an eventfd (or a pipe) */
+#if !defined (WIN32)
+#define USE_WAKEUP
+#if defined (LINUX)
+    #include <sys/eventfd.h>
+#else
+    #include <fcntl.h>
+#endif
+#endif
+
+/* with an engine per thread, engines may run as shards that are fed by a receive dispatcher */
+#if defined (SCTP_ENGINE_PER_THREAD) && defined (USE_WAKEUP)
+#define USE_SHARDS
+#include <pthread.h>
+/* number of datagrams (and of given back receive buffers) a shard ring holds, a power of 2 */
+#define SHARD_RING_SIZE         1024
+#endif
+
+/* default number of expired timers handled by one dispatch_timer() call */
+#define TIMER_BUDGET            64
+
 #define    EVENTCB_TYPE_SCTP       1
 #define    EVENTCB_TYPE_UDP        2
 #define    EVENTCB_TYPE_USER       3
 #define    EVENTCB_TYPE_ROUTING    4
+#define    EVENTCB_TYPE_SHARD      5
 
 
 #ifdef SCTP_OVER_UDP
@@ -268,7 +338,7 @@ adl_random(void)
  *      fails.
  */
 
-static long revision = 0;
+static ENGINE_LOCAL long revision = 0;
 
 struct extendedpollfd {
    int       fd;
@@ -397,26 +467,593 @@ int extendedPoll(struct extendedpollfd* fdlist,
 
 
 /* a static counter - for stats we should have more counters !  */
-static unsigned int number_of_sendevents = 0;
-/* a static receive buffer  */
-static unsigned char rbuf[MAX_MTU_SIZE + 20];
+static ENGINE_LOCAL unsigned int number_of_sendevents = 0;
+/*
+ * a receive buffer for one datagram. The DATA chunks of the datagram that are queued
+ * in the stream engine refer to their payload in the buffer, and each holds a
+ * reference to it, so the buffer is only reused once they have been read.
+ */
+typedef struct receive_buffer_struct
+{
+    unsigned int refcount;
+    /* number of bytes that can be read into the buffer */
+    unsigned int size;
+    /* next buffer in the pool of unused buffers */
+    struct receive_buffer_struct* next;
+    unsigned char data[1];
+} receive_buffer;
+
+/* the receive buffer for single datagrams */
+static ENGINE_LOCAL receive_buffer* rx_buffer = NULL;
+/* the buffer of the datagram that is being handed on to mdi_receiveMessage() */
+static ENGINE_LOCAL receive_buffer* rx_current = NULL;
+/* unused receive buffers */
+static ENGINE_LOCAL receive_buffer* rx_pool = NULL;
+static ENGINE_LOCAL unsigned int    rx_pool_size = 0;
+/* size of the buffers that datagrams from the SCTP sockets are read into */
+static ENGINE_LOCAL unsigned int    rx_size = RECV_BUFFER_SIZE;
 /* a static value that keeps currently treated timer id */
-static unsigned int current_tid = 0;
+static ENGINE_LOCAL unsigned int current_tid = 0;
+/* maximum number of expired timers handled by one dispatch_timer() call */
+static ENGINE_LOCAL unsigned int timer_budget = TIMER_BUDGET;
+
+#ifdef USE_WAKEUP
+/**
+ * opens the file descriptors through which other threads wake up an event loop:
+ * an eventfd, for which both are the same, or a pipe
+ * @param  wakeup_fd    the descriptor to read from, and the one to write to
+ * @return 0 for success, -1 for error
+ */
+int adl_openWakeup(int wakeup_fd[2])
+{
+#if defined (LINUX)
+    wakeup_fd[0] = wakeup_fd[1] = eventfd(0, EFD_NONBLOCK);
+    if (wakeup_fd[0] >= 0) return 0;
+#else
+    if (pipe(wakeup_fd) == 0) {
+        fcntl(wakeup_fd[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakeup_fd[1], F_SETFL, O_NONBLOCK);
+        return 0;
+    }
+#endif
+    error_logi(ERROR_MAJOR, "adl_openWakeup: could not create wakeup fd, errno = %d", errno);
+    return -1;
+}
+
+
+void adl_closeWakeup(int wakeup_fd[2])
+{
+    close(wakeup_fd[0]);
+    if (wakeup_fd[1] != wakeup_fd[0]) close(wakeup_fd[1]);
+}
+
+
+/**
+ * wakes up the event loop that reads the wakeup descriptors. May be called by any thread.
+ */
+void adl_signalWakeup(int wakeup_fd[2])
+{
+#if defined (LINUX)
+    guint64 one = 1;
+
+    if (write(wakeup_fd[1], &one, sizeof(one)) < 0)
+#else
+    char one = 1;
+
+    /* a full pipe wakes up the event loop anyway */
+    if (write(wakeup_fd[1], &one, sizeof(one)) < 0 && errno != EAGAIN)
+#endif
+        error_logi(ERROR_MINOR, "adl_signalWakeup: write() failed, errno = %d", errno);
+}
+
+
+/**
+ * reads the wakeups, before the event loop looks for the work it has been woken up for
+ */
+void adl_clearWakeup(int wakeup_fd[2])
+{
+#if defined (LINUX)
+    guint64 wakeups;
+
+    if (read(wakeup_fd[0], &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN)
+        error_logi(ERROR_MINOR, "adl_clearWakeup: read() failed, errno = %d", errno);
+#else
+    char wakeups[64];
+
+    while (read(wakeup_fd[0], wakeups, sizeof(wakeups)) > 0);
+#endif
+}
+#endif
+
+#ifdef USE_SHARDS
+/*
+ * In sharded mode, one engine is the receive dispatcher: it reads the SCTP sockets
+ * and steers each datagram to the shard that owns its association. Every shard is an
+ * engine of its own, that sends on the sockets of the dispatcher, but gets the datagrams
+ * for its associations through a ring with a single producer (the dispatcher) and a single
+ * consumer (the shard). The receive buffers go back to the dispatcher through a second ring.
+ * The indices written by the dispatcher and those written by the shard are kept apart,
+ * so they do not share a cache line.
+ */
+typedef struct shard_packet_struct
+{
+    receive_buffer* buffer;
+    int sfd;
+    int offset;
+    int length;
+    union sockunion from;
+    union sockunion to;
+} shard_packet;
+
+typedef struct shard_struct
+{
+    /* written by the dispatcher */
+    unsigned int    packet_head;
+    unsigned int    buffer_tail;
+    gboolean        wakeup_pending;
+    shard_packet    packets[SHARD_RING_SIZE];
+    /* written by the shard */
+    unsigned int    packet_tail;
+    unsigned int    buffer_head;
+    receive_buffer* buffers[SHARD_RING_SIZE];
+    /* eventfd (or pipe) that wakes up the event loop of the shard */
+    int             wakeup_fd[2];
+    int             joined;
+    /* the command queue of the shard, for commands submitted by other threads */
+    void*           command_queue;
+} shard_state;
+
+#define SHARD_RING_MASK             (SHARD_RING_SIZE - 1)
+#define SHARD_LOAD(index)           __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define SHARD_STORE(index, value)   __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+/* set up by the dispatcher before the shards are started, and shared by all engines */
+static shard_state*  shards = NULL;
+static unsigned int  shard_count = 0;
+static int           shard_sfd = -1;
+static int           shard_sfdv6 = -1;
+static int           shard_rwnd = 8192;
+static gboolean      shard_df = FALSE;
+static gboolean      shard_dfv6 = FALSE;
+/* the shards share the sockets, so no probe may be sent while one of them has cleared the DF bit */
+static pthread_mutex_t shard_df_lock = PTHREAD_MUTEX_INITIALIZER;
+/* ADL_NO_SHARD, ADL_SHARD_DISPATCHER, or the index of the shard run by this engine */
+static ENGINE_LOCAL int engine_shard = ADL_NO_SHARD;
+
+
+/**
+ * called at the end of a dispatch pass of the dispatcher: wakes up the shards that it
+ * has steered datagrams to, once per pass
+ */
+static void adl_wakeShards(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < shard_count; i++) {
+        if (shards[i].wakeup_pending) {
+            shards[i].wakeup_pending = FALSE;
+            adl_signalWakeup(shards[i].wakeup_fd);
+        }
+    }
+}
+
+
+/**
+ * computes the shard of the associations with a peer. Associations that the peer starts
+ * are set up by this shard, as the INIT chunk carries no tag to steer by.
+ * @param  address  the address of the peer
+ * @param  port     the SCTP port of the peer
+ * @return index of the shard
+ */
+static unsigned int adl_shardOfPeer(union sockunion* address, unsigned short port)
+{
+    guint32 hash = port;
+#ifdef HAVE_IPV6
+    guint32 word;
+    int i;
+#endif
+
+    switch (sockunion_family(address)) {
+    case AF_INET:
+        hash ^= ntohl(sock2ip(address));
+        break;
+#ifdef HAVE_IPV6
+    case AF_INET6:
+        for (i = 0; i < 16; i += 4) {
+            memcpy(&word, &sock2ip6(address)[i], sizeof(word));
+            hash ^= ntohl(word);
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+    hash *= 2654435761U;
+    return (hash >> 16) % shard_count;
+}
+
+
+/**
+ * finds the shard that owns the association of a datagram: the shard that has chosen
+ * its own tag, which the peer puts into the common header. INIT chunks carry no tag yet,
+ * so these are steered by the address and port of the peer. A COOKIE ECHO chunk carries
+ * the tag of the INIT ACK, which the shard that received the INIT has chosen, and goes
+ * there. ABORT and SHUTDOWN COMPLETE chunks with the T bit carry the tag of the peer,
+ * and may come from any of its addresses, so they go to all shards: those that do not
+ * have the association discard them as out of the blue.
+ * @param  packet   the SCTP packet, starting with the common header
+ * @param  length   length of the SCTP packet
+ * @param  from     source address of the datagram
+ * @return index of the shard, or shard_count for all shards
+ */
+static unsigned int adl_shardOfPacket(guchar* packet, int length, union sockunion* from)
+{
+    SCTP_common_header* header = (SCTP_common_header*)packet;
+    SCTP_chunk_header* chunk;
+    guint32 tag;
+
+    /* malformed packets are discarded by any shard */
+    if (length < (int)(sizeof(SCTP_common_header) + sizeof(SCTP_chunk_header))) return 0;
+
+    chunk = (SCTP_chunk_header*)&packet[sizeof(SCTP_common_header)];
+    if (((chunk->chunk_id == CHUNK_ABORT) || (chunk->chunk_id == CHUNK_SHUTDOWN_COMPLETE)) &&
+        (chunk->chunk_flags & FLAG_NO_TCB)) {
+        return shard_count;
+    }
+    tag = ntohl(header->verification_tag);
+    if (tag == 0) return adl_shardOfPeer(from, ntohs(header->src_port));
+    return tag % shard_count;
+}
+
+
+/**
+ * queues a receive buffer on the ring of a shard, which takes over the reference of
+ * the slot. If the shard does not keep up and its ring is full, the datagram is dropped,
+ * as if the socket buffer had been full.
+ */
+static void adl_queueShardPacket(shard_state* shard, receive_buffer** slot, int sfd, int offset,
+                                 int length, union sockunion* from, union sockunion* to)
+{
+    shard_packet* packet;
+    unsigned int head = shard->packet_head;
+
+    if (head - SHARD_LOAD(shard->packet_tail) == SHARD_RING_SIZE) {
+        event_logi(VERBOSE, "adl_queueShardPacket: ring of shard %u is full, dropping datagram",
+                   (unsigned int)(shard - shards));
+        return;
+    }
+    packet = &shard->packets[head & SHARD_RING_MASK];
+    packet->buffer = *slot;
+    packet->sfd    = sfd;
+    packet->offset = offset;
+    packet->length = length;
+    packet->from   = *from;
+    packet->to     = *to;
+    *slot = NULL;
+    SHARD_STORE(shard->packet_head, head + 1);
+    shard->wakeup_pending = TRUE;
+}
+
+
+static receive_buffer* adl_prepareReceiveBuffer(receive_buffer** slot, unsigned int size);
+
+/**
+ * called by the dispatcher instead of handing on a datagram to mdi_receiveMessage():
+ * queues the receive buffer on the ring of the owning shard. A datagram for all shards
+ * is copied for each of them but the last, as the shards do not share receive buffers.
+ */
+static void adl_steerReceiveBuffer(receive_buffer** slot, int sfd, int offset, int length,
+                                   union sockunion* from, union sockunion* to)
+{
+    unsigned int i, shard = adl_shardOfPacket(&(*slot)->data[offset], length, from);
+    receive_buffer* copy;
+
+    if (shard < shard_count) {
+        adl_queueShardPacket(&shards[shard], slot, sfd, offset, length, from, to);
+        return;
+    }
+    for (i = 0; i + 1 < shard_count; i++) {
+        copy = NULL;
+        if (adl_prepareReceiveBuffer(&copy, (unsigned int)(offset + length)) == NULL) break;
+        memcpy(copy->data, (*slot)->data, offset + length);
+        adl_queueShardPacket(&shards[i], &copy, sfd, offset, length, from, to);
+        adl_releaseReceiveBuffer(copy);
+    }
+    adl_queueShardPacket(&shards[shard_count - 1], slot, sfd, offset, length, from, to);
+}
+
+
+/**
+ * called by a shard for a receive buffer that is no longer used: gives it back to the
+ * dispatcher, which reads the next datagrams into it
+ * @return TRUE if the buffer has been given back, FALSE if the ring is full
+ */
+static gboolean adl_returnShardBuffer(receive_buffer* rb)
+{
+    shard_state* shard = &shards[engine_shard];
+    unsigned int head = shard->buffer_head;
+
+    if (head - SHARD_LOAD(shard->buffer_tail) == SHARD_RING_SIZE) return FALSE;
+    shard->buffers[head & SHARD_RING_MASK] = rb;
+    SHARD_STORE(shard->buffer_head, head + 1);
+    return TRUE;
+}
+
+
+/**
+ * called by the dispatcher when it has no unused receive buffers left: takes the buffers
+ * that the shards have given back into its pool
+ */
+static void adl_reclaimShardBuffers(void)
+{
+    shard_state* shard;
+    receive_buffer* rb;
+    unsigned int i, tail, head;
+
+    for (i = 0; i < shard_count; i++) {
+        shard = &shards[i];
+        tail = shard->buffer_tail;
+        head = SHARD_LOAD(shard->buffer_head);
+        while (tail != head) {
+            rb = shard->buffers[tail & SHARD_RING_MASK];
+            rb->next = rx_pool;
+            rx_pool = rb;
+            rx_pool_size++;
+            tail++;
+        }
+        SHARD_STORE(shard->buffer_tail, tail);
+    }
+}
+#endif
 
 
-static struct extendedpollfd poll_fds[NUM_FDS];
-static int num_of_fds = 0;
+#ifndef USE_EPOLL
+static ENGINE_LOCAL struct extendedpollfd poll_fds[NUM_FDS];
+#endif
+static ENGINE_LOCAL int num_of_fds = 0;
 
-static int sctp_sfd = -1;       /* socket fd for standard SCTP port....      */
+static ENGINE_LOCAL int sctp_sfd = -1;       /* socket fd for standard SCTP port....      */
 
 #ifdef HAVE_IPV6
-static int sctpv6_sfd = -1;
+static ENGINE_LOCAL int sctpv6_sfd = -1;
+#endif
+/* the packets sent on these sockets have the DF bit set, see adl_setDontFragment() */
+static ENGINE_LOCAL gboolean sctp_df = FALSE;
+#ifdef HAVE_IPV6
+static ENGINE_LOCAL gboolean sctpv6_df = FALSE;
 #endif
 
 /* will be added back later....
    static int icmp_sfd = -1;  */      /* socket fd for ICMP messages */
 
-static struct event_cb *event_callbacks[NUM_FDS];
+#ifndef USE_EPOLL
+static ENGINE_LOCAL struct event_cb *event_callbacks[NUM_FDS];
+#else
+/*
+ * The epoll() based event loop keeps the registered file descriptors in a table
+ * indexed by the descriptor itself, so registering, removing and looking up a
+ * descriptor does not depend on the number of registered descriptors, and
+ * dispatch_event() only visits the descriptors reported by epoll_wait().
+ * The library's own SCTP and UDP sockets are registered edge-triggered and are
+ * read until they are drained (or the drain budget is used up), user file
+ * descriptors keep the level-triggered semantics of the select() loop.
+ * The revision numbers of extendedPoll() are kept (see above).
+ */
+struct epoll_entry {
+   struct extendedpollfd pfd;
+   struct event_cb*      cb;
+   /* event mask currently set in the epoll set, 0 if not in the set */
+   short int             registered_events;
+   gboolean              edge_triggered;
+   /* TRUE, if the fd is reported by the next poll without waiting for epoll */
+   gboolean              pending;
+   /* TRUE for fds epoll cannot watch (e.g. regular files): always ready */
+   gboolean              always_ready;
+};
+
+static ENGINE_LOCAL int                  epoll_sfd = -1;
+static ENGINE_LOCAL struct epoll_entry** epoll_table = NULL;
+static ENGINE_LOCAL int                  epoll_table_size = 0;
+static ENGINE_LOCAL struct epoll_event   epoll_events[EPOLL_MAX_EVENTS];
+/* fds reported by the last epollPoll() call, handled by dispatch_event() */
+static ENGINE_LOCAL int*                 ready_fds = NULL;
+static ENGINE_LOCAL int                  num_of_ready_fds = 0;
+/* fds to be reported by the next epollPoll() call without waiting */
+static ENGINE_LOCAL int*                 pending_fds = NULL;
+static ENGINE_LOCAL int                  num_of_pending_fds = 0;
+
+
+static struct epoll_entry* epoll_lookup(int sfd)
+{
+   if ((sfd < 0) || (sfd >= epoll_table_size)) return NULL;
+   return epoll_table[sfd];
+}
+
+
+/**
+ * grows the table of registered fds (and the ready and pending lists), so that
+ * it can hold the descriptor sfd
+ * @return 0 for success, -1 if memory could not be allocated
+ */
+static int epoll_grow_table(int sfd)
+{
+   struct epoll_entry** table;
+   int*                 fdlist;
+   int                  new_size, i;
+
+   new_size = (epoll_table_size > 0) ? epoll_table_size : EPOLL_TABLE_SIZE;
+   while (new_size <= sfd) new_size *= 2;
+   if (new_size == epoll_table_size) return 0;
+
+   table = (struct epoll_entry**)realloc(epoll_table, new_size * sizeof(struct epoll_entry*));
+   if (table == NULL) return -1;
+   epoll_table = table;
+   fdlist = (int*)realloc(ready_fds, new_size * sizeof(int));
+   if (fdlist == NULL) return -1;
+   ready_fds = fdlist;
+   fdlist = (int*)realloc(pending_fds, new_size * sizeof(int));
+   if (fdlist == NULL) return -1;
+   pending_fds = fdlist;
+
+   for (i = epoll_table_size; i < new_size; i++) epoll_table[i] = NULL;
+   epoll_table_size = new_size;
+   return 0;
+}
+
+
+static void epoll_set_pending(struct epoll_entry* entry)
+{
+   if (entry->pending == FALSE) {
+      entry->pending = TRUE;
+      pending_fds[num_of_pending_fds++] = entry->pfd.fd;
+   }
+}
+
+
+static void epoll_clear_pending(struct epoll_entry* entry)
+{
+   int i;
+
+   if (entry->pending == TRUE) {
+      entry->pending = FALSE;
+      for (i = 0; i < num_of_pending_fds; i++) {
+         if (pending_fds[i] == entry->pfd.fd) {
+            pending_fds[i] = pending_fds[--num_of_pending_fds];
+            break;
+         }
+      }
+   }
+}
+
+
+static void epoll_set_ready(struct epoll_entry* entry, short int revents)
+{
+   if (revents == 0) return;
+   /* revents != 0 means the fd is already in the ready list */
+   if (entry->pfd.revents == 0) {
+      ready_fds[num_of_ready_fds++] = entry->pfd.fd;
+   }
+   entry->pfd.revents |= revents;
+}
+
+
+/**
+ * brings the epoll set in line with the event mask of an entry. The epoll events
+ * correspond to the fd sets used by extendedPoll(): POLLIN|POLLPRI selects for
+ * reading, POLLOUT for writing and both select exceptional conditions.
+ * @return 0 for success, -1 if epoll_ctl() failed (errno is set)
+ */
+static int epoll_update(struct epoll_entry* entry)
+{
+   struct epoll_event ev;
+   int                op;
+
+   if (entry->always_ready) {
+      if (entry->pfd.events != 0) epoll_set_pending(entry);
+      else epoll_clear_pending(entry);
+      return 0;
+   }
+   if (entry->pfd.events == entry->registered_events) return 0;
+
+   memset(&ev, 0, sizeof(ev));
+   if (entry->pfd.events & (POLLIN|POLLPRI)) ev.events |= EPOLLIN;
+   if (entry->pfd.events & POLLOUT)          ev.events |= EPOLLOUT;
+   if (entry->pfd.events & (POLLIN|POLLOUT)) ev.events |= EPOLLPRI;
+   if (entry->edge_triggered)                ev.events |= EPOLLET;
+   ev.data.fd = entry->pfd.fd;
+
+   /* fds without events are taken out of the set, so that a hangup does not wake us up */
+   if (entry->pfd.events == 0)             op = EPOLL_CTL_DEL;
+   else if (entry->registered_events == 0) op = EPOLL_CTL_ADD;
+   else                                    op = EPOLL_CTL_MOD;
+
+   if (epoll_ctl(epoll_sfd, op, entry->pfd.fd, &ev) < 0) return -1;
+   entry->registered_events = entry->pfd.events;
+   return 0;
+}
+
+
+/**
+ * epoll() counterpart of extendedPoll(): waits for events on the registered fds
+ * and collects the ready fds (with their revents set) in the ready list.
+ * @return number of ready fds, -1 on error
+ */
+static int epollPoll(int  time,
+                     void (*lock)(void* data),
+                     void (*unlock)(void* data),
+                     void* data)
+{
+   struct epoll_entry* entry;
+   unsigned int        events;
+   short int           revents;
+   int                 i, n;
+
+   for (i = 0; i < num_of_ready_fds; i++) {
+      if ((entry = epoll_lookup(ready_fds[i])) != NULL) entry->pfd.revents = 0;
+   }
+   num_of_ready_fds = 0;
+
+   /* fds that may still have data (or cannot be watched) are reported without waiting */
+   if (num_of_pending_fds > 0) time = 0;
+
+   /* see extendedPoll() */
+   revision++;
+
+   if (unlock) {
+      unlock(data);
+   }
+   n = epoll_wait(epoll_sfd, epoll_events, EPOLL_MAX_EVENTS, time);
+   if (lock) {
+      lock(data);
+   }
+
+   if (n < 0) {
+      if (errno != EINTR) error_logi(ERROR_MINOR, "epoll_wait() failed : errno = %d", errno);
+      if (num_of_pending_fds == 0) return -1;
+      n = 0;
+   }
+
+   for (i = 0; i < n; i++) {
+      entry = epoll_lookup(epoll_events[i].data.fd);
+      if (entry == NULL) continue;
+      if (entry->pfd.revision >= revision) {
+         /* registered during epoll_wait(): do not lose the edge, report it next time */
+         if (entry->edge_triggered) epoll_set_pending(entry);
+         continue;
+      }
+      events  = epoll_events[i].events;
+      revents = 0;
+      if ((entry->pfd.events & POLLIN) && (events & (EPOLLIN|EPOLLHUP|EPOLLERR))) {
+         revents |= POLLIN;
+      }
+      if ((entry->pfd.events & POLLOUT) && (events & (EPOLLOUT|EPOLLERR))) {
+         revents |= POLLOUT;
+      }
+      if ((entry->pfd.events & (POLLIN|POLLOUT)) && (events & EPOLLPRI)) {
+         revents |= POLLERR;
+      }
+      epoll_set_ready(entry, revents);
+   }
+
+   i = 0;
+   while (i < num_of_pending_fds) {
+      entry = epoll_lookup(pending_fds[i]);
+      if (entry->pfd.revision >= revision) {
+         i++;
+         continue;
+      }
+      epoll_set_ready(entry, entry->pfd.events & (POLLIN|POLLOUT));
+      if (entry->always_ready) {
+         i++;
+         continue;
+      }
+      entry->pending = FALSE;
+      pending_fds[i] = pending_fds[--num_of_pending_fds];
+   }
+
+   return num_of_ready_fds;
+}
+#endif
 
 /**
  *  converts address-string (hex for ipv6, dotted decimal for ipv4
@@ -569,6 +1206,67 @@ int adl_setReceiveBufferSize(int sfd,int new_size)
 }
 
 
+/**
+ * sets or clears the DF bit of the packets sent on a raw socket. With the DF bit set,
+ * the kernel does not fragment these packets either, so that path MTU probes, which
+ * are too large for the path, get lost instead of reaching the peer in fragments.
+ * @param  sfd           the socket
+ * @param  af            its address family
+ * @param  dontFragment  TRUE to set the DF bit, FALSE to let packets be fragmented
+ * @return 0 for success, -1 if the DF bit cannot be controlled on this socket
+ */
+static int adl_setDontFragment(int sfd, int af, gboolean dontFragment)
+{
+    int ch;
+
+    switch (af) {
+        case AF_INET:
+#if defined (LINUX)
+            ch = (dontFragment) ? IP_PMTUDISC_DO : IP_PMTUDISC_DONT;
+            if (setsockopt(sfd, IPPROTO_IP, IP_MTU_DISCOVER, (char *) &ch, sizeof(ch)) == 0) return 0;
+            error_log(ERROR_MAJOR, "setsockopt: IP_MTU_DISCOVER failed !");
+#elif defined (IP_DONTFRAG)
+            ch = (dontFragment) ? 1 : 0;
+            if (setsockopt(sfd, IPPROTO_IP, IP_DONTFRAG, (char *) &ch, sizeof(ch)) == 0) return 0;
+            error_log(ERROR_MAJOR, "setsockopt: IP_DONTFRAG failed !");
+#endif
+            break;
+#ifdef HAVE_IPV6
+        case AF_INET6:
+            /* the sender fragments IPv6 packets, as routers do not */
+#if defined (IPV6_DONTFRAG)
+            ch = (dontFragment) ? 1 : 0;
+            if (setsockopt(sfd, IPPROTO_IPV6, IPV6_DONTFRAG, (char *) &ch, sizeof(ch)) == 0) return 0;
+            error_log(ERROR_MAJOR, "setsockopt: IPV6_DONTFRAG failed !");
+#elif defined (IPV6_MTU_DISCOVER)
+            ch = (dontFragment) ? IPV6_PMTUDISC_DO : IPV6_PMTUDISC_DONT;
+            if (setsockopt(sfd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, (char *) &ch, sizeof(ch)) == 0) return 0;
+            error_log(ERROR_MAJOR, "setsockopt: IPV6_MTU_DISCOVER failed !");
+#endif
+            break;
+#endif
+        default:
+            break;
+    }
+    return -1;
+}
+
+
+/**
+ * @param  af   the address family of a path
+ * @return TRUE, if the packets to that path have the DF bit set, which is needed for
+ *         the path MTU discovery
+ */
+gboolean adl_dontFragment(int af)
+{
+    if (af == AF_INET) return sctp_df;
+#ifdef HAVE_IPV6
+    if (af == AF_INET6) return sctpv6_df;
+#endif
+    return FALSE;
+}
+
+
 gint adl_open_sctp_socket(int af, int* myRwnd)
 {
     int sfd, ch;
@@ -609,10 +1307,6 @@ gint adl_open_sctp_socket(int af, int* myRwnd)
 #if defined (LINUX)
             adl_setReceiveBufferSize(sfd, 10*0xFFFF);
 
-            ch = IP_PMTUDISC_DO;
-            if (setsockopt(sfd, IPPROTO_IP, IP_MTU_DISCOVER, (char *) &ch, sizeof(ch)) < 0) {
-                error_log(ERROR_FATAL, "setsockopt: IP_PMTU_DISCOVER failed !");
-            }
             opt_size=sizeof(*myRwnd);
             if (getsockopt (sfd, SOL_SOCKET, SO_RCVBUF, (void*)myRwnd, &opt_size) < 0) {
                 error_log(ERROR_FATAL, "getsockopt: SO_RCVBUF failed !");
@@ -784,109 +1478,518 @@ int adl_sendUdpData(int sfd, unsigned char* buf, int length,
 
 
 
+#ifdef USE_TOS_CMSG
 /**
- * function to be called when library sends a message on an SCTP socket
- * @param  sfd the socket file descriptor where data will be sent
- * @param  buf pointer to a buffer, where data to be sent is stored
- * @param  len number of bytes to be sent
- * @param  destination address, where data is to be sent
- * @param    dest_len size of the address
- * @return returns number of bytes actually sent, or error
+ * fills in a message header for sending a datagram with sendmsg(). The TOS of IPv4
+ * datagrams, or the traffic class of IPv6 datagrams, is passed as ancillary data.
+ * @param  msg      the message header
+ * @param  vec      the buffers holding the datagram
+ * @param  vlen     number of buffers in vec
+ * @param  dest     the destination address
+ * @param  tos      the TOS or traffic class
+ * @param  cmsgbuf  buffer of TOS_CMSG_SPACE bytes for the ancillary data
  */
-int adl_send_message(int sfd, void *buf, int len, union sockunion *dest, unsigned char tos)
+static void adl_prepare_send_msghdr(struct msghdr* msg, struct iovec* vec, int vlen,
+                                    union sockunion* dest, int tos, unsigned char* cmsgbuf)
 {
-    int txmt_len = 0;
-    unsigned char old_tos;
-    socklen_t opt_len;
-    int tmp;
-#ifdef SCTP_OVER_UDP
-    guchar      outBuffer[65536];
-    udp_header* udp;
+    struct cmsghdr* cmsg;
+
+    memset(msg, 0, sizeof(struct msghdr));
+    msg->msg_iov        = vec;
+    msg->msg_iovlen     = vlen;
+    msg->msg_name       = dest;
+    msg->msg_control    = cmsgbuf;
+    msg->msg_controllen = TOS_CMSG_SPACE;
+    cmsg = CMSG_FIRSTHDR(msg);
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+#ifdef HAVE_IPV6
+    if (sockunion_family(dest) == AF_INET6) {
+        msg->msg_namelen = sizeof(struct sockaddr_in6);
+        cmsg->cmsg_level = IPPROTO_IPV6;
+        cmsg->cmsg_type  = IPV6_TCLASS;
+    } else
+#endif
+    {
+        msg->msg_namelen = sizeof(struct sockaddr_in);
+        cmsg->cmsg_level = IPPROTO_IP;
+        cmsg->cmsg_type  = IP_TOS;
+    }
+    memcpy(CMSG_DATA(cmsg), &tos, sizeof(int));
+}
+#else
+/* the socket and the TOS that was last set with setsockopt() */
+static ENGINE_LOCAL int ipv4_tos_sfd = -1;
+static ENGINE_LOCAL int ipv4_tos = -1;
 #endif
 
-#ifdef HAVE_IPV6
-    guchar hostname[MAX_MTU_SIZE];
+
+/* the time sampled when the current dispatch pass started, see adl_now() */
+static ENGINE_LOCAL adl_time               dispatch_time = 0;
+/* number of dispatch passes currently running */
+static ENGINE_LOCAL int                    dispatch_depth = 0;
+
+/**
+ * reads the monotonic clock
+ * @return the time in nanoseconds
+ */
+static adl_time adl_read_clock(void)
+{
+#if defined(WIN32)
+    return (adl_time)GetTickCount64() * ADL_NSECS_PER_MSEC;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (adl_time)ts.tv_sec * ADL_NSECS_PER_SEC + (adl_time)ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, (struct timezone *) NULL);
+    return (adl_time)tv.tv_sec * ADL_NSECS_PER_SEC + (adl_time)tv.tv_usec * ADL_NSECS_PER_USEC;
 #endif
+}
 
-    switch (sockunion_family(dest)) {
 
-    case AF_INET:
-        number_of_sendevents++;
-        opt_len = sizeof(old_tos);
-        tmp = getsockopt(sfd, IPPROTO_IP, IP_TOS, &old_tos, &opt_len);
-        tmp = setsockopt(sfd, IPPROTO_IP, IP_TOS, &tos, sizeof(unsigned char));
-        event_logii(VVERBOSE, "adl_send_message: set IP_TOS %u, result=%d", tos,tmp);
+adl_time adl_now(void)
+{
+    if (dispatch_depth > 0) return dispatch_time;
+    return adl_read_clock();
+}
 
-        event_logiiii(VERBOSE,
-                     "AF_INET : adl_send_message : sfd : %d, len %d, destination : %s, send_events %u",
-                     sfd, len, inet_ntoa(dest->sin.sin_addr), number_of_sendevents);
 
+#ifdef USE_SENDMMSG
 #ifdef SCTP_OVER_UDP
-        if(len + sizeof(udp_header) > sizeof(outBuffer)) {
-           error_log(ERROR_FATAL, "Data block too large ! bye !\n");
+#define SEND_QUEUE_HEADROOM     sizeof(udp_header)
+#else
+#define SEND_QUEUE_HEADROOM     0
+#endif
+
+/**
+ * a datagram waiting in the transmit queue
+ */
+struct queued_datagram {
+    int             sfd;
+    union sockunion dest;
+    int             tos;
+    int             len;
+    unsigned char   buf[SEND_QUEUE_HEADROOM + MAX_MTU_SIZE];
+};
+
+/*
+ * While a receive or timer dispatch pass runs, the datagrams sent by the library are
+ * queued, and the queue is flushed with one sendmmsg() call per socket when the pass
+ * ends, when the queue is full, or when the oldest datagram has waited too long.
+ */
+static ENGINE_LOCAL struct queued_datagram* send_queue = NULL;
+static ENGINE_LOCAL unsigned int           send_queue_len = 0;
+/* configured queue depth, 0 means that datagrams are sent at once */
+static ENGINE_LOCAL unsigned int           send_queue_depth = 0;
+/* configured maximum delay of a queued datagram in usecs, 0 means no limit */
+static ENGINE_LOCAL unsigned int           send_queue_max_delay = 0;
+/* the time the oldest datagram in the queue was queued */
+static ENGINE_LOCAL adl_time               send_queue_first;
+/* number of dispatch passes currently running */
+static ENGINE_LOCAL int                    send_batch_active = 0;
+static ENGINE_LOCAL struct mmsghdr         tx_msgs[SEND_QUEUE_MAX_DEPTH];
+static ENGINE_LOCAL struct iovec           tx_vec[SEND_QUEUE_MAX_DEPTH];
+static ENGINE_LOCAL unsigned char          tx_cmsg[SEND_QUEUE_MAX_DEPTH][TOS_CMSG_SPACE];
+/* counters for the sendmmsg() batches */
+static ENGINE_LOCAL unsigned int           number_of_send_batches = 0;
+static ENGINE_LOCAL unsigned int           number_of_batched_datagrams = 0;
+static ENGINE_LOCAL unsigned int           largest_send_batch = 0;
+
+
+/**
+ * fills in the message header for sending a queued datagram
+ */
+static void adl_prepare_queued_datagram(struct mmsghdr* msg, struct iovec* vec,
+                                        unsigned char* cmsgbuf, struct queued_datagram* dg)
+{
+    vec->iov_base = dg->buf;
+    vec->iov_len  = dg->len;
+    adl_prepare_send_msghdr(&msg->msg_hdr, vec, 1, &dg->dest, dg->tos, cmsgbuf);
+    msg->msg_len = 0;
+}
+
+
+/**
+ * sends all datagrams of the transmit queue, with one sendmmsg() call per socket
+ * (or more, if the kernel accepts only a part of the batch)
+ */
+static void adl_flush_send_queue(void)
+{
+    unsigned int first, i, count, sent;
+    int sfd, result;
+
+    for (first = 0; first < send_queue_len; first++) {
+        sfd = send_queue[first].sfd;
+        if (sfd < 0) continue;
+
+        /* collect the datagrams for this socket, keeping their order */
+        count = 0;
+        for (i = first; i < send_queue_len; i++) {
+            if (send_queue[i].sfd != sfd) continue;
+            adl_prepare_queued_datagram(&tx_msgs[count], &tx_vec[count], tx_cmsg[count], &send_queue[i]);
+            send_queue[i].sfd = -1;
+            count++;
         }
-        memcpy(&outBuffer[sizeof(udp_header)], buf, len);
-
-        udp = (udp_header*)&outBuffer;
-        udp->src_port = htons(SCTP_OVER_UDP_UDPPORT);
-        udp->dest_port = htons(SCTP_OVER_UDP_UDPPORT);
-        udp->length = htons(sizeof(udp_header) + len);
-        udp->checksum = 0x0000;
-
-        txmt_len = sendto(sfd, (char*)&outBuffer, sizeof(udp_header) + len,
-                          0, (struct sockaddr *) &(dest->sin), sizeof(struct sockaddr_in));
-        if(txmt_len >= (int)sizeof(udp_header)) {
-           txmt_len -= (int)sizeof(udp_header);
+
+        sent = 0;
+        while (sent < count) {
+            result = sendmmsg(sfd, &tx_msgs[sent], count - sent, 0);
+            if (result <= 0) {
+                /* the first datagram could not be sent: drop it, as sendto() failures do */
+                error_logii(ERROR_MAJOR, "sendmmsg()=%d, errno=%d !", result, errno);
+                sent++;
+                continue;
+            }
+            number_of_send_batches++;
+            number_of_batched_datagrams += result;
+            if ((unsigned int)result > largest_send_batch) largest_send_batch = result;
+            event_logii(VVERBOSE, "sendmmsg() sent %d datagrams on socket %d", result, sfd);
+            sent += result;
         }
+    }
+    send_queue_len = 0;
+}
+
+
+/**
+ * puts a datagram into the transmit queue, flushing the queue first, if it is full
+ * or if its oldest datagram has been waiting longer than the configured delay
+ * @return len, i.e. the datagram counts as sent
+ */
+static int adl_queue_message(int sfd, const SCTP_iovec* iov, int iovcnt, int len,
+                             union sockunion *dest, unsigned char tos)
+{
+    struct queued_datagram* dg;
+    unsigned char* pos;
+    int i;
+#ifdef SCTP_OVER_UDP
+    udp_header* udp;
+#endif
+
+    if (send_queue_len >= send_queue_depth) adl_flush_send_queue();
+    /* the time of the dispatch pass does not advance, so the clock is read here */
+    if ((send_queue_len > 0) && (send_queue_max_delay > 0)) {
+        if (adl_read_clock() - send_queue_first >= send_queue_max_delay * ADL_NSECS_PER_USEC)
+            adl_flush_send_queue();
+    }
+    if ((send_queue_len == 0) && (send_queue_max_delay > 0)) send_queue_first = adl_read_clock();
+
+    number_of_sendevents++;
+    dg = &send_queue[send_queue_len++];
+    dg->sfd = sfd;
+    dg->tos = tos;
+    memcpy(&dg->dest, dest, sizeof(union sockunion));
+    pos = &dg->buf[SEND_QUEUE_HEADROOM];
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    dg->len = len + SEND_QUEUE_HEADROOM;
+#ifdef SCTP_OVER_UDP
+    udp = (udp_header*)dg->buf;
+    udp->src_port = htons(SCTP_OVER_UDP_UDPPORT);
+    udp->dest_port = htons(SCTP_OVER_UDP_UDPPORT);
+    udp->length = htons(sizeof(udp_header) + len);
+    udp->checksum = 0x0000;
+#endif
+    event_logiii(VVERBOSE, "adl_queue_message : sfd : %d, len %d, queue length %u",
+                 sfd, len, send_queue_len);
+    return len;
+}
+#endif
+
+
+/**
+ * called when a receive or timer dispatch pass starts: datagrams sent by the library
+ * are queued from now on, if a transmit queue has been configured
+ */
+static void adl_begin_send_batch(void)
+{
+#ifdef USE_SENDMMSG
+    send_batch_active++;
+#endif
+}
+
+
+/**
+ * called when a receive or timer dispatch pass ends: flushes the transmit queue
+ */
+static void adl_end_send_batch(void)
+{
+#ifdef USE_SENDMMSG
+    if (--send_batch_active == 0 && send_queue_len > 0) adl_flush_send_queue();
+#endif
+}
+
+
+/**
+ * called when a receive or timer dispatch pass starts: samples the clock for adl_now(),
+ * and starts a transmit batch
+ */
+static void adl_begin_dispatch(void)
+{
+    if (dispatch_depth++ == 0) dispatch_time = adl_read_clock();
+    adl_begin_send_batch();
+}
+
+
+/**
+ * called when a receive or timer dispatch pass ends. Completed borrowed-buffer sends
+ * are reported before the transmit batch is flushed, so data the ULP sends in response
+ * goes out with it.
+ */
+static void adl_end_dispatch(void)
+{
+    if (dispatch_depth == 1) {
+        cp_notifyPayloads();
+#ifdef USE_SHARDS
+        if (engine_shard == ADL_SHARD_DISPATCHER) adl_wakeShards();
+#endif
+    }
+    adl_end_send_batch();
+    dispatch_depth--;
+}
+
+
+/**
+ * reports completed borrowed-buffer sends when called outside a dispatch pass, e.g. at
+ * the end of an API function that released queued chunks. Inside a pass, this is left
+ * to adl_end_dispatch(), so that no callback runs while the library is in a callback.
+ */
+void adl_notifyPayloads(void)
+{
+    if (dispatch_depth == 0) cp_notifyPayloads();
+}
+
+
+/**
+ * configures the transmit queue
+ * @param  depth      maximum number of queued datagrams, 0 sends datagrams at once
+ * @param  maxDelay   maximum time in usecs a datagram is kept in the queue, 0 for no limit
+ * @return 0 for success, -1 if the depth is not supported
+ */
+int adl_setSendBatching(unsigned int depth, unsigned int maxDelay)
+{
+#ifdef USE_SENDMMSG
+    if (depth > SEND_QUEUE_MAX_DEPTH) return -1;
+    if (send_queue_len > 0) adl_flush_send_queue();
+    if (depth > 0 && send_queue == NULL) {
+        /* allocated by the engine that uses it, instead of taking room in every thread */
+        send_queue = (struct queued_datagram*)malloc(SEND_QUEUE_MAX_DEPTH * sizeof(struct queued_datagram));
+        if (send_queue == NULL) return -1;
+    }
+    send_queue_depth = depth;
+    send_queue_max_delay = maxDelay;
+    return 0;
+#else
+    return (depth > 0) ? -1 : 0;
+#endif
+}
+
+
+/**
+ * reads the configuration and the counters of the transmit queue
+ * @param  depth      maximum number of queued datagrams
+ * @param  maxDelay   maximum time in usecs a datagram is kept in the queue
+ * @param  batches    number of sendmmsg() calls made so far
+ * @param  datagrams  number of datagrams sent by these calls
+ * @param  largest    largest number of datagrams sent by one call
+ */
+void adl_getSendBatching(unsigned int* depth, unsigned int* maxDelay,
+                         unsigned int* batches, unsigned int* datagrams, unsigned int* largest)
+{
+#ifdef USE_SENDMMSG
+    *depth     = send_queue_depth;
+    *maxDelay  = send_queue_max_delay;
+    *batches   = number_of_send_batches;
+    *datagrams = number_of_batched_datagrams;
+    *largest   = largest_send_batch;
+#else
+    *depth = *maxDelay = *batches = *datagrams = *largest = 0;
+#endif
+}
+
+
+/**
+ * function to be called when library sends a message on an SCTP socket
+ * @param  sfd the socket file descriptor where data will be sent
+ * @param  buf pointer to a buffer, where data to be sent is stored
+ * @param  len number of bytes to be sent
+ * @param  destination address, where data is to be sent
+ * @param    dest_len size of the address
+ * @return returns number of bytes actually sent, or error
+ */
+int adl_send_message(int sfd, void *buf, int len, union sockunion *dest, unsigned char tos)
+{
+    SCTP_iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len  = len;
+    return adl_send_vector(sfd, &iov, 1, dest, tos, 0);
+}
+
+
+/**
+ * function to be called when library sends a message that is gathered from several
+ * buffers, see adl_send_message()
+ */
+int adl_send_vector(int sfd, const SCTP_iovec* iov, int iovcnt, union sockunion *dest,
+                    unsigned char tos, int flags)
+{
+    int txmt_len, len, i;
+    guchar hostname[SCTP_MAX_IP_LEN];
+#ifdef USE_TOS_CMSG
+    struct msghdr msg;
+    struct iovec vec[ADL_MAX_IOVECS + 1];
+    unsigned char cmsgbuf[TOS_CMSG_SPACE];
+    int vlen = 0;
 #else
-        txmt_len = sendto(sfd, buf, len, 0, (struct sockaddr *) &(dest->sin), sizeof(struct sockaddr_in));
+    socklen_t destlen = sizeof(struct sockaddr_in);
+    guchar      outBuffer[65536];
+    guchar*     pos;
 #endif
+#ifdef SCTP_OVER_UDP
+    udp_header  udp;
+#endif
+
+    if (iovcnt > ADL_MAX_IOVECS) {
+        error_logi(ERROR_MAJOR, "adl_send_vector : too many buffers (%d)", iovcnt);
+        return -1;
+    }
+    for (len = 0, i = 0; i < iovcnt; i++) len += iov[i].iov_len;
 
-        if (txmt_len < 0) {
-            error_logi(ERROR_MAJOR, "AF_INET : sendto()=%d !", txmt_len);
+#ifdef USE_SENDMMSG
+    if ((send_batch_active > 0) && (send_queue_depth > 0) && (len <= MAX_MTU_SIZE) && (flags == 0)) {
+        if (sockunion_family(dest) == AF_INET
+#ifdef HAVE_IPV6
+            || sockunion_family(dest) == AF_INET6
+#endif
+           ) {
+            return adl_queue_message(sfd, iov, iovcnt, len, dest, tos);
         }
-        tmp = setsockopt(sfd, IPPROTO_IP, IP_TOS, &old_tos, sizeof(unsigned char));
-    break;
+    }
+    /* keep the order of datagrams */
+    if (send_queue_len > 0) adl_flush_send_queue();
+#endif
+
+    switch (sockunion_family(dest)) {
+    case AF_INET:
+        break;
 #ifdef HAVE_IPV6
     case AF_INET6:
-        number_of_sendevents++;
-        inet_ntop(AF_INET6, sock2ip6(dest), (char *)hostname, MAX_MTU_SIZE);
+#ifndef USE_TOS_CMSG
+        destlen = sizeof(struct sockaddr_in6);
+#endif
+        break;
+#endif
+    default:
+        error_logi(ERROR_MAJOR,
+                   "adl_send_message : Adress Family %d not supported here",
+                   sockunion_family(dest));
+        return -1;
+    }
+    number_of_sendevents++;
 
+    if (Current_event_log_ >= VVERBOSE) {
+        adl_sockunion2str(dest, hostname, SCTP_MAX_IP_LEN);
         event_logiiii(VVERBOSE,
-                     "AF_INET6: adl_send_message : sfd : %d, len %d, destination : %s, send_events: %u",
-                        sfd, len, hostname, number_of_sendevents);
+                     "adl_send_message : sfd : %d, len %d, destination : %s, send_events %u",
+                     sfd, len, hostname, number_of_sendevents);
+    }
+
+    /* without the DF bit, packets are fragmented anyway */
+    if (!adl_dontFragment(sockunion_family(dest))) flags = 0;
+#ifdef USE_SHARDS
+    if ((flags != 0) && (engine_shard != ADL_NO_SHARD)) pthread_mutex_lock(&shard_df_lock);
+#endif
+    if (flags & ADL_SEND_FRAGMENT) {
+        event_logi(VERBOSE, "adl_send_message : datagram of %d bytes sent without DF bit", len);
+        adl_setDontFragment(sfd, sockunion_family(dest), FALSE);
+    }
 
 #ifdef SCTP_OVER_UDP
-        if(len + sizeof(udp_header) > sizeof(outBuffer)) {
+    udp.src_port = htons(SCTP_OVER_UDP_UDPPORT);
+    udp.dest_port = htons(SCTP_OVER_UDP_UDPPORT);
+    udp.length = htons(sizeof(udp_header) + len);
+    udp.checksum = 0x0000;
+#endif
+
+#ifdef USE_TOS_CMSG
+#ifdef SCTP_OVER_UDP
+    vec[vlen].iov_base = &udp;
+    vec[vlen++].iov_len = sizeof(udp_header);
+#endif
+    for (i = 0; i < iovcnt; i++) {
+        vec[vlen].iov_base = iov[i].iov_base;
+        vec[vlen++].iov_len = iov[i].iov_len;
+    }
+    adl_prepare_send_msghdr(&msg, vec, vlen, dest, tos, cmsgbuf);
+    txmt_len = sendmsg(sfd, &msg, 0);
+#else
+    if ((sockunion_family(dest) == AF_INET) && ((sfd != ipv4_tos_sfd) || (tos != ipv4_tos))) {
+        /* only change the socket option, when the TOS changes */
+        if (setsockopt(sfd, IPPROTO_IP, IP_TOS, &tos, sizeof(unsigned char)) == 0) {
+            ipv4_tos_sfd = sfd;
+            ipv4_tos = tos;
+        }
+        event_logi(VVERBOSE, "adl_send_message: set IP_TOS %u", tos);
+    }
+#ifdef SCTP_OVER_UDP
+    if(len + sizeof(udp_header) > sizeof(outBuffer)) {
+       error_log(ERROR_FATAL, "Data block too large ! bye !\n");
+    }
+    memcpy(outBuffer, &udp, sizeof(udp_header));
+    pos = &outBuffer[sizeof(udp_header)];
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    txmt_len = sendto(sfd, (char*)&outBuffer, sizeof(udp_header) + len,
+                      0, (struct sockaddr *)dest, destlen);
+#else
+    if (iovcnt == 1) {
+        txmt_len = sendto(sfd, (char*)iov[0].iov_base, len, 0, (struct sockaddr *)dest, destlen);
+    } else {
+        /* without sendmsg(), the datagram is gathered into one buffer */
+        if(len > (int)sizeof(outBuffer)) {
            error_log(ERROR_FATAL, "Data block too large ! bye !\n");
         }
-        memcpy(&outBuffer[sizeof(udp_header)], buf, len);
-
-        udp = (udp_header*)&outBuffer;
-        udp->src_port = htons(SCTP_OVER_UDP_UDPPORT);
-        udp->dest_port = htons(SCTP_OVER_UDP_UDPPORT);
-        udp->length = htons(sizeof(udp_header) + len);
-        udp->checksum = 0x0000;
-
-        txmt_len = sendto(sfd, (char*)&outBuffer, sizeof(udp_header) + len,
-                          0, (struct sockaddr *) &(dest->sin6), sizeof(struct sockaddr_in6));
-        if(txmt_len >= (int)sizeof(udp_header)) {
-           txmt_len -= (int)sizeof(udp_header);
+        pos = outBuffer;
+        for (i = 0; i < iovcnt; i++) {
+            memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+            pos += iov[i].iov_len;
         }
-#else
-        txmt_len = sendto(sfd, buf, len, 0, (struct sockaddr *)&(dest->sin6), sizeof(struct sockaddr_in6));
+        txmt_len = sendto(sfd, (char*)&outBuffer, len, 0, (struct sockaddr *)dest, destlen);
+    }
 #endif
-        break;
 #endif
-    default:
-        error_logi(ERROR_MAJOR,
-                   "adl_send_message : Adress Family %d not supported here",
-                   sockunion_family(dest));
-        txmt_len = -1;
+
+    if (flags & ADL_SEND_FRAGMENT) adl_setDontFragment(sfd, sockunion_family(dest), TRUE);
+#ifdef USE_SHARDS
+    if ((flags != 0) && (engine_shard != ADL_NO_SHARD)) pthread_mutex_unlock(&shard_df_lock);
+#endif
+
+#ifdef SCTP_OVER_UDP
+    if(txmt_len >= (int)sizeof(udp_header)) {
+       txmt_len -= (int)sizeof(udp_header);
+    }
+#endif
+    if (txmt_len < 0) {
+        if (errno == EMSGSIZE) {
+            /* e.g. a path MTU probe larger than the MTU of the interface */
+            event_logi(VERBOSE, "adl_send_message : datagram of %d bytes too large", len);
+        } else {
+            error_logii(ERROR_MAJOR, "adl_send_message : sending to family %d failed, result=%d !",
+                        sockunion_family(dest), txmt_len);
+        }
     }
     return txmt_len;
 }
 
+#ifndef USE_EPOLL
 /**
  * function to assign an event mask to a certain poll
  */
@@ -906,6 +2009,7 @@ void assign_poll_fd(int fd_index, int sfd, int event_mask)
     poll_fds[fd_index].revision = revision;
     poll_fds[fd_index].revents  = 0;
 }
+#endif
 
 
 /**
@@ -914,6 +2018,23 @@ void assign_poll_fd(int fd_index, int sfd, int event_mask)
  */
 int adl_remove_poll_fd(gint sfd)
 {
+#ifdef USE_EPOLL
+    struct epoll_event ev;
+    struct epoll_entry* entry = epoll_lookup(sfd);
+
+    if (entry == NULL) return 0;
+    if (entry->registered_events != 0) {
+        /* fails harmlessly, if the fd has already been closed */
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epoll_sfd, EPOLL_CTL_DEL, sfd, &ev);
+    }
+    epoll_clear_pending(entry);
+    epoll_table[sfd] = NULL;
+    free(entry->cb);
+    free(entry);
+    num_of_fds -= 1;
+    return 1;
+#else
     int i, tmp, counter = 0;
     for (i = 0, tmp = 0; i < NUM_FDS; i++, tmp++) {
         if (tmp < NUM_FDS) {
@@ -962,6 +2083,7 @@ int adl_remove_poll_fd(gint sfd)
 #endif
     }
     return (counter);
+#endif
 }
 
 /**
@@ -999,6 +2121,54 @@ if (sfd!=0)
 }
 #endif
 
+#ifdef USE_EPOLL
+    struct epoll_entry* entry;
+
+    if (sfd < 0 || (sfd >= epoll_table_size && epoll_grow_table(sfd) < 0))
+        return (-1);
+    /* registering an fd again replaces its callback */
+    if (epoll_table[sfd] != NULL)
+        adl_remove_poll_fd(sfd);
+
+    entry = (struct epoll_entry*)malloc(sizeof(struct epoll_entry));
+    if (!entry)
+        error_log(ERROR_FATAL, "Could not allocate memory in  register_fd_cb \n");
+    entry->cb = (struct event_cb*)malloc(sizeof(struct event_cb));
+    if (!entry->cb)
+        error_log(ERROR_FATAL, "Could not allocate memory in  register_fd_cb \n");
+    entry->cb->sfd = sfd;
+    entry->cb->eventcb_type = eventcb_type;
+    entry->cb->action = (void (*) (void))action;
+    entry->cb->userData = userData;
+
+    entry->pfd.fd = sfd;
+    entry->pfd.events = event_mask;
+    entry->pfd.revents = 0;
+    /* see assign_poll_fd() */
+    entry->pfd.revision = revision;
+    entry->registered_events = 0;
+    /* library sockets are drained by dispatch_event(), user fds stay level-triggered */
+    entry->edge_triggered = (eventcb_type != EVENTCB_TYPE_USER);
+    entry->pending = FALSE;
+    entry->always_ready = FALSE;
+    epoll_table[sfd] = entry;
+
+    if (epoll_update(entry) < 0) {
+        if (errno == EPERM) {
+            /* fd does not support epoll (e.g. a regular file), select() reports it as ready */
+            entry->always_ready = TRUE;
+            epoll_update(entry);
+        } else {
+            error_logii(ERROR_MAJOR, "epoll_ctl() failed for fd %d : errno = %d", sfd, errno);
+            epoll_table[sfd] = NULL;
+            free(entry->cb);
+            free(entry);
+            return (-1);
+        }
+    }
+    num_of_fds++;
+    return num_of_fds;
+#else
     if (num_of_fds < NUM_FDS && sfd >= 0) {
         assign_poll_fd(num_of_fds, sfd, event_mask);
         event_callbacks[num_of_fds] = (struct event_cb*)malloc(sizeof(struct event_cb));
@@ -1013,6 +2183,7 @@ if (sfd!=0)
         return num_of_fds;
     } else
         return (-1);
+#endif
 }
 
 #ifndef CMSG_ALIGN
@@ -1031,21 +2202,15 @@ if (sfd!=0)
 #define CMSG_LEN(len) (CMSG_ALIGN(sizeof(struct cmsghdr)) + (len))
 #endif
 
+#ifdef SCTP_OVER_UDP
 /**
- * function to be called when we get an sctp message. This function gives also
- * the source and destination addresses.
- *
- * @param  sfd      the socket file descriptor where data can be read...
- * @param  dest     pointer to a buffer, where we can store the received data
- * @param  maxlen   maximum number of bytes that can be received with call
- * @param  from     address, where we got the data from
- * @param  to       destination address of that message
- * @return returns number of bytes received with this call
+ * removes the UDP header from an SCTP over UDP datagram
+ * @param  udp_start    pointer to the UDP header
+ * @param  len          number of bytes from the UDP header to the end of the datagram
+ * @return length of the remaining SCTP packet, -1 if it was not sent to our UDP port
  */
-int adl_receive_message(int sfd, void *dest, int maxlen, union sockunion *from, union sockunion *to)
+static int adl_strip_udp_header(unsigned char* udp_start, int len)
 {
-    int len;
-#ifdef SCTP_OVER_UDP
 #ifdef LINUX
     udp_header*    udp;
 #else
@@ -1053,28 +2218,69 @@ int adl_receive_message(int sfd, void *dest, int maxlen, union sockunion *from,
 #endif
     unsigned char* ptr;
     int            i;
+
+#ifdef LINUX
+    if(len < (int)sizeof(udp_header)) {
+#else
+    if(len < (int)sizeof(struct udphdr)) {
 #endif
-#ifdef HAVE_IPV6
-    struct msghdr rmsghdr;
-    struct cmsghdr *rcmsgp;
-    struct iovec  data_vec;
+        return -1;
+    }
+#ifdef LINUX
+    udp = (udp_header*)udp_start;
+    if(ntohs(udp->dest_port) != SCTP_OVER_UDP_UDPPORT) {
+#else
+    udp = (struct udphdr *)udp_start;
+    if(ntohs(udp->uh_dport) != SCTP_OVER_UDP_UDPPORT) {
+#endif
+        return -1;
+    }
+    ptr = (unsigned char*)udp;
+#ifdef LINUX
+    for(i = 0;i < len - (int)sizeof(udp_header);i++) {
+       *ptr = ptr[sizeof(udp_header)];
+#else
+    for(i = 0;i < len - (int)sizeof(struct udphdr);i++) {
+       *ptr = ptr[sizeof(struct udphdr)];
 #endif
+       ptr++;
+    }
+#ifdef LINUX
+    return len - sizeof(udp_header);
+#else
+    return len - sizeof(struct udphdr);
+#endif
+}
+#endif
+
+
+/**
+ * sets the addresses of a datagram that has been read from one of the SCTP sockets,
+ * and removes the UDP header, if we run SCTP over UDP.
+ * IPv4 datagrams keep their IP header, for IPv6 the source address has already been
+ * filled in by recvmsg(), and the destination address is taken from the packet info.
+ *
+ * @param  sfd      the socket file descriptor the datagram was read from
+ * @param  dest     pointer to the datagram
+ * @param  len      number of bytes read, or -1 if reading failed
+ * @param  cmsg     control message buffer of an IPv6 datagram
+ * @param  from     address, where we got the data from
+ * @param  to       destination address of that message
+ * @return length of the datagram, -1 if it must be discarded
+ */
+static int adl_decode_message(int sfd, void *dest, int len, void *cmsg,
+                              union sockunion *from, union sockunion *to)
+{
 #ifdef LINUX
     struct iphdr *iph;
 #else
     struct ip *iph;
 #endif
-
 #ifdef HAVE_IPV6
-    unsigned char m6buf[(CMSG_SPACE(sizeof (struct in6_pktinfo)))];
     struct in6_pktinfo *pkt6info;
 #endif
 
-    len = -1;
-    if ((dest == NULL) || (from == NULL) || (to == NULL)) return -1;
-
     if (sfd == sctp_sfd) {
-        len = recv (sfd, dest, maxlen, 0);
 #ifdef LINUX
         iph = (struct iphdr *)dest;
 #else
@@ -1097,64 +2303,27 @@ int adl_receive_message(int sfd, void *dest, int maxlen, union sockunion *from,
 
 #ifdef SCTP_OVER_UDP
 #ifdef LINUX
-        if(len < (int)sizeof(struct iphdr) + (int)sizeof(udp_header)) {
-#else
-        if(len < (int)sizeof(struct ip) + (int)sizeof(struct udphdr)) {
-#endif
+        if(len < (int)sizeof(struct iphdr)) {
             return -1;
         }
-#ifdef LINUX
-        udp = (udp_header*)((long)dest + (long)sizeof(struct iphdr));
+        len = adl_strip_udp_header((unsigned char*)dest + sizeof(struct iphdr),
+                                   len - (int)sizeof(struct iphdr));
+        if (len < 0) return -1;
+        len += sizeof(struct iphdr);
 #else
-        udp = (struct udphdr *)((long)dest + (long)sizeof(struct ip));
-#endif
-#ifdef LINUX
-        if(ntohs(udp->dest_port) != SCTP_OVER_UDP_UDPPORT) {
-#else
-       if(ntohs(udp->uh_dport) != SCTP_OVER_UDP_UDPPORT) {
-#endif
+        if(len < (int)sizeof(struct ip)) {
             return -1;
         }
-        ptr = (unsigned char*)udp;
-#ifdef LINUX
-        for(i = 0;i < len - (int)(sizeof(struct iphdr) + sizeof(udp_header));i++) {
-           *ptr = ptr[sizeof(udp_header)];
-#else
-        for(i = 0;i < len - (int)(sizeof(struct ip) + sizeof(struct udphdr));i++) {
-           *ptr = ptr[sizeof(struct udphdr)];
-#endif
-           ptr++;
-        }
-#ifdef LINUX
-        len -= sizeof(udp_header);
-#else
-        len -= sizeof(struct udphdr);
+        len = adl_strip_udp_header((unsigned char*)dest + sizeof(struct ip),
+                                   len - (int)sizeof(struct ip));
+        if (len < 0) return -1;
+        len += sizeof(struct ip);
 #endif
 #endif
     }
 #ifdef HAVE_IPV6
-    data_vec.iov_base = dest;
-    data_vec.iov_len  = maxlen;
     if (sfd == sctpv6_sfd) {
-        rcmsgp = (struct cmsghdr *)m6buf;
-        pkt6info = (struct in6_pktinfo *)(CMSG_DATA(rcmsgp));
-
-        /* receive control msg */
-        rcmsgp->cmsg_level = IPPROTO_IPV6;
-        rcmsgp->cmsg_type = IPV6_PKTINFO;
-        rcmsgp->cmsg_len = CMSG_LEN (sizeof (struct in6_pktinfo));
-
-        rmsghdr.msg_flags = 0;
-        rmsghdr.msg_iov = &data_vec;
-        rmsghdr.msg_iovlen = 1;
-        rmsghdr.msg_name =      (caddr_t) &(from->sin6);
-        rmsghdr.msg_namelen =   sizeof (struct sockaddr_in6);
-        rmsghdr.msg_control = (caddr_t) m6buf;
-        rmsghdr.msg_controllen = sizeof (m6buf);
-        memset (from, 0, sizeof (struct sockaddr_in6));
-        memset (to,   0, sizeof (struct sockaddr_in6));
-
-        len = recvmsg (sfd, &rmsghdr, 0);
+        pkt6info = (struct in6_pktinfo *)(CMSG_DATA((struct cmsghdr *)cmsg));
 
         /* Linux sets this, so we reset it, as we don't want to run into trouble if
            we have a port set on sending...then we would get INVALID ARGUMENT  */
@@ -1165,49 +2334,279 @@ int adl_receive_message(int sfd, void *dest, int maxlen, union sockunion *from,
         to->sin6.sin6_flowinfo = htonl(0);
         memcpy(&(to->sin6.sin6_addr), &(pkt6info->ipi6_addr), sizeof(struct in6_addr));
 
-#ifdef SCTP_OVER_UDP
-#ifdef LINUX
-        if(len < (int)sizeof(udp_header)) {
-#else
-        if(len < (int)sizeof(struct udphdr)) {
+#ifdef SCTP_OVER_UDP
+        len = adl_strip_udp_header((unsigned char*)dest, len);
+#endif
+    }
+#endif
+    return len;
+}
+
+
+#ifdef HAVE_IPV6
+/**
+ * prepares a message header for reading a datagram and its packet info from
+ * the IPv6 SCTP socket
+ */
+static void adl_prepare_msghdr(struct msghdr* rmsghdr, struct iovec* data_vec,
+                               void *cmsg, size_t cmsglen, union sockunion *from, union sockunion *to)
+{
+    struct cmsghdr *rcmsgp = (struct cmsghdr *)cmsg;
+
+    /* receive control msg */
+    rcmsgp->cmsg_level = IPPROTO_IPV6;
+    rcmsgp->cmsg_type = IPV6_PKTINFO;
+    rcmsgp->cmsg_len = CMSG_LEN (sizeof (struct in6_pktinfo));
+
+    rmsghdr->msg_flags = 0;
+    rmsghdr->msg_iov = data_vec;
+    rmsghdr->msg_iovlen = 1;
+    rmsghdr->msg_name =      (caddr_t) &(from->sin6);
+    rmsghdr->msg_namelen =   sizeof (struct sockaddr_in6);
+    rmsghdr->msg_control = (caddr_t) cmsg;
+    rmsghdr->msg_controllen = cmsglen;
+    memset (from, 0, sizeof (struct sockaddr_in6));
+    memset (to,   0, sizeof (struct sockaddr_in6));
+}
+#endif
+
+
+/**
+ * function to be called when we get an sctp message. This function gives also
+ * the source and destination addresses.
+ *
+ * @param  sfd      the socket file descriptor where data can be read...
+ * @param  dest     pointer to a buffer, where we can store the received data
+ * @param  maxlen   maximum number of bytes that can be received with call
+ * @param  from     address, where we got the data from
+ * @param  to       destination address of that message
+ * @return returns number of bytes received with this call
+ */
+int adl_receive_message(int sfd, void *dest, int maxlen, union sockunion *from, union sockunion *to)
+{
+    int len;
+#ifdef HAVE_IPV6
+    struct msghdr rmsghdr;
+    struct iovec  data_vec;
+    unsigned char m6buf[(CMSG_SPACE(sizeof (struct in6_pktinfo)))];
+#endif
+
+    len = -1;
+    if ((dest == NULL) || (from == NULL) || (to == NULL)) return -1;
+
+    if (sfd == sctp_sfd) {
+        len = recv (sfd, dest, maxlen, ADL_RECV_FLAGS);
+        if (len >= 0) len = adl_decode_message(sfd, dest, len, NULL, from, to);
+    }
+#ifdef HAVE_IPV6
+    if (sfd == sctpv6_sfd) {
+        data_vec.iov_base = dest;
+        data_vec.iov_len  = maxlen;
+        adl_prepare_msghdr(&rmsghdr, &data_vec, m6buf, sizeof(m6buf), from, to);
+
+        len = recvmsg (sfd, &rmsghdr, ADL_RECV_FLAGS);
+        if (len >= 0) len = adl_decode_message(sfd, dest, len, m6buf, from, to);
+    }
+#endif
+
+    if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        error_log(ERROR_MAJOR, "recvmsg()  failed in adl_receive_message() !");
+
+    return len;
+}
+
+
+/**
+ * makes sure that a receive buffer slot holds a buffer that is not referenced by
+ * queued DATA chunks, so that the next datagram can be read into it
+ * @param  slot     NULL, or a buffer of which the slot holds one reference
+ * @param  size     number of bytes that must fit into the buffer
+ * @return the buffer in the slot, or NULL if no memory is left
+ */
+static receive_buffer* adl_prepareReceiveBuffer(receive_buffer** slot, unsigned int size)
+{
+    receive_buffer* rb = *slot;
+
+    if ((rb != NULL) && (rb->refcount == 1) && (rb->size >= size)) return rb;
+    /* the datagram in the buffer may still be in use, leave the buffer to its users */
+    adl_releaseReceiveBuffer(rb);
+
+#ifdef USE_SHARDS
+    if ((rx_pool == NULL) && (engine_shard == ADL_SHARD_DISPATCHER)) adl_reclaimShardBuffers();
+#endif
+    while ((rb = rx_pool) != NULL) {
+        rx_pool = rb->next;
+        rx_pool_size--;
+        if (rb->size >= size) break;
+        /* left over from before the buffers grew */
+        free(rb);
+    }
+    if (rb == NULL) {
+        rb = (receive_buffer*)malloc(sizeof(receive_buffer) + size + 20);
+        if (rb == NULL) {
+            error_log(ERROR_MAJOR, "adl_prepareReceiveBuffer: out of memory");
+            *slot = NULL;
+            return NULL;
+        }
+        rb->size = size;
+    }
+    rb->refcount = 1;
+    *slot = rb;
+    return rb;
+}
+
+
+/**
+ * hands on a datagram in a receive buffer to mdi_receiveMessage(). While it runs, the
+ * buffer can be referenced with adl_holdReceiveBuffer(). The receive dispatcher of
+ * sharded engines steers the datagram to its shard instead.
+ * @param  slot     the slot that holds the receive buffer
+ */
+static void adl_dispatchReceiveBuffer(receive_buffer** slot, int sfd, int offset, int length,
+                                      union sockunion* from, union sockunion* to)
+{
+    receive_buffer* rb = *slot;
+    receive_buffer* previous = rx_current;
+
+    if ((offset + length > DEFAULT_MTU_SIZE) && (rx_size < MAX_MTU_SIZE)) {
+        /* the peer sends jumbo frames, this one may have been cut off, and will be
+           dropped for its checksum. The next ones are read into larger buffers. */
+        event_logi(INTERNAL_EVENT_0, "datagram of %d bytes received, using buffers for jumbo frames",
+                   offset + length);
+        rx_size = MAX_MTU_SIZE;
+    }
+
+#ifdef USE_SHARDS
+    if (engine_shard == ADL_SHARD_DISPATCHER) {
+        adl_steerReceiveBuffer(slot, sfd, offset, length, from, to);
+        return;
+    }
+#endif
+
+    /* a nested event loop must not read into this buffer */
+    rb->refcount++;
+    rx_current = rb;
+    mdi_receiveMessage(sfd, &rb->data[offset], length, from, to);
+    rx_current = previous;
+    adl_releaseReceiveBuffer(rb);
+}
+
+
+void* adl_holdReceiveBuffer(void)
+{
+    if (rx_current == NULL) return NULL;
+    rx_current->refcount++;
+    return rx_current;
+}
+
+
+unsigned int adl_getReceiveBufferSize(void)
+{
+    return (rx_current != NULL) ? rx_current->size : 0;
+}
+
+
+void adl_releaseReceiveBuffer(void* buffer)
+{
+    receive_buffer* rb = (receive_buffer*)buffer;
+
+    if ((rb == NULL) || (--rb->refcount > 0)) return;
+#ifdef USE_SHARDS
+    if ((engine_shard >= 0) && adl_returnShardBuffer(rb)) return;
 #endif
-            return -1;
-        }
-#ifdef LINUX
-        udp = (udp_header*)dest;
+    if (rx_pool_size < RECV_POOL_SIZE) {
+        rb->next = rx_pool;
+        rx_pool = rb;
+        rx_pool_size++;
+    } else {
+        free(rb);
+    }
+}
+
+
+#ifdef USE_RECVMMSG
+#ifdef HAVE_IPV6
+#define RECV_CMSG_SIZE          CMSG_SPACE(sizeof (struct in6_pktinfo))
 #else
-        udp = (struct udphdr *)dest;
+#define RECV_CMSG_SIZE          CMSG_SPACE(sizeof (int))
 #endif
-#ifdef LINUX
-	if(ntohs(udp->dest_port) != SCTP_OVER_UDP_UDPPORT) {
-#else
-	if(ntohs(udp->uh_dport) != SCTP_OVER_UDP_UDPPORT) {
+
+/* receive ring for recvmmsg(), one receive buffer per datagram */
+static ENGINE_LOCAL receive_buffer* rx_ring[RECV_BATCH_SIZE];
+static ENGINE_LOCAL unsigned char   rx_cmsg[RECV_BATCH_SIZE][RECV_CMSG_SIZE];
+static ENGINE_LOCAL struct mmsghdr  rx_msgs[RECV_BATCH_SIZE];
+static ENGINE_LOCAL struct iovec    rx_vec[RECV_BATCH_SIZE];
+static ENGINE_LOCAL union sockunion rx_from[RECV_BATCH_SIZE];
+static ENGINE_LOCAL union sockunion rx_to[RECV_BATCH_SIZE];
+/* cleared, if the kernel does not support recvmmsg() */
+static ENGINE_LOCAL gboolean        use_recvmmsg = TRUE;
+
+/**
+ * reads up to RECV_BATCH_SIZE datagrams from one of the SCTP sockets with a single
+ * recvmmsg() call, and hands them on to mdi_receiveMessage().
+ * @param  sfd      the socket file descriptor where data can be read
+ * @param  full     set to TRUE if the datagrams filled all receive buffers that could be
+ *                  prepared, so that more may be waiting in the socket
+ * @return number of datagrams read, -1 if nothing could be read (errno is set)
+ */
+static int adl_receive_batch(int sfd, gboolean* full)
+{
+    int i, n, len, hlen, slots;
+#ifdef HAVE_IPV6
+    struct msghdr* rmsghdr;
 #endif
-            return -1;
+
+    for (slots = 0; slots < RECV_BATCH_SIZE; slots++) {
+        if (adl_prepareReceiveBuffer(&rx_ring[slots], rx_size) == NULL) break;
+    }
+    if (slots == 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < slots; i++) {
+        rx_vec[i].iov_base = rx_ring[i]->data;
+        rx_vec[i].iov_len  = rx_ring[i]->size;
+        memset(&rx_msgs[i], 0, sizeof(struct mmsghdr));
+#ifdef HAVE_IPV6
+        if (sfd == sctpv6_sfd) {
+            rmsghdr = &rx_msgs[i].msg_hdr;
+            adl_prepare_msghdr(rmsghdr, &rx_vec[i], rx_cmsg[i], sizeof(rx_cmsg[i]), &rx_from[i], &rx_to[i]);
+            continue;
         }
-        ptr = (unsigned char*)udp;
-#ifdef LINUX
-        for(i = 0;i < len - (int)sizeof(udp_header);i++) {
-           *ptr = ptr[sizeof(udp_header)];
-#else
-        for(i = 0;i < len - (int)sizeof(struct udphdr);i++) {
-           *ptr = ptr[sizeof(struct udphdr)];
 #endif
-           ptr++;
-        }
-#ifdef LINUX
-        len -= sizeof(udp_header);
+        rx_msgs[i].msg_hdr.msg_iov    = &rx_vec[i];
+        rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    n = recvmmsg(sfd, rx_msgs, slots, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+        if (errno == ENOSYS) use_recvmmsg = FALSE;
+        return -1;
+    }
+    event_logii(VERBOSE, "recvmmsg() read %d datagrams from socket %d", n, sfd);
+    *full = (n == slots);
+
+    for (i = 0; i < n; i++) {
+        len = adl_decode_message(sfd, rx_ring[i]->data, (int)rx_msgs[i].msg_len, rx_cmsg[i], &rx_from[i], &rx_to[i]);
+        if (len < 0) continue;
+        hlen = 0;
+        if (sfd == sctp_sfd) {
+#if defined (LINUX)
+            hlen = ((struct iphdr *)rx_ring[i]->data)->ihl << 2;
 #else
-        len -= sizeof(struct udphdr);
-#endif
+            hlen = ((struct ip *)rx_ring[i]->data)->ip_hl << 2;
 #endif
+            if (len < hlen) {
+                error_logi(ERROR_MINOR, "adl_receive_batch : packet too short (%d bytes)", len);
+                continue;
+            }
+        }
+        adl_dispatchReceiveBuffer(&rx_ring[i], sfd, hlen, len - hlen, &rx_from[i], &rx_to[i]);
     }
-#endif
-
-    if (len < 0) error_log(ERROR_MAJOR, "recvmsg()  failed in adl_receive_message() !");
-
-    return len;
+    return n;
 }
+#endif
 
 
 /**
@@ -1223,22 +2622,57 @@ int adl_get_message(int sfd, void *dest, int maxlen, union sockunion *from, sock
 {
     int len;
 
-    len = recvfrom(sfd, dest, maxlen, 0, (struct sockaddr *) from, from_len);
-    if (len < 0)
+    len = recvfrom(sfd, dest, maxlen, ADL_RECV_FLAGS, (struct sockaddr *) from, from_len);
+    /* a drained socket has nothing more to read */
+    if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
         error_log(ERROR_FATAL, "recvfrom  failed in get_message(), aborting !");
 
     return len;
 }
 
+#ifdef USE_SHARDS
 /**
- * this function is responsible for calling the callback functions belonging
- * to all of the file descriptors that have indicated an event !
- * TODO : check handling of POLLERR situation
- * @param num_of_events  number of events indicated by poll()
+ * called by a shard when it is woken up: hands on the datagrams that the dispatcher
+ * has steered to it. If more than a ring of datagrams is waiting, the shard wakes itself
+ * up again, so the other events of its event loop are not held up.
+ * @param  shard    the shard state of this engine
+ * @return FALSE, as the wakeup has been read
  */
-void dispatch_event(int num_of_events)
+static gboolean adl_receive_shard(shard_state* shard)
+{
+    shard_packet packet;
+    unsigned int count, tail;
+
+    /* clear the wakeup first, so that datagrams steered from now on wake up the shard again */
+    adl_clearWakeup(shard->wakeup_fd);
+
+    for (count = 0; count < SHARD_RING_SIZE; count++) {
+        tail = shard->packet_tail;
+        if (tail == SHARD_LOAD(shard->packet_head)) return FALSE;
+        /* a nested event loop may read the next datagrams, so the slot is freed first */
+        packet = shard->packets[tail & SHARD_RING_MASK];
+        SHARD_STORE(shard->packet_tail, tail + 1);
+        adl_dispatchReceiveBuffer(&packet.buffer, packet.sfd, packet.offset, packet.length,
+                                  &packet.from, &packet.to);
+        /* give back the reference that came with the ring */
+        adl_releaseReceiveBuffer(packet.buffer);
+    }
+    adl_signalWakeup(shard->wakeup_fd);
+    return FALSE;
+}
+#endif
+
+
+/**
+ * calls the callback function belonging to one file descriptor that has indicated
+ * an event. For the library's sockets, one message is read and handed on.
+ * @param pfd       poll entry of the file descriptor
+ * @param cb        callback registered for the file descriptor
+ * @param revents   events indicated for the file descriptor
+ * @return TRUE if the library socket may have more messages to read, else FALSE
+ */
+static gboolean dispatch_fd_event(struct extendedpollfd* pfd, struct event_cb* cb, short int revents)
 {
-    int i = 0;
     int length=0;
     socklen_t src_len;
     union sockunion src, dest;
@@ -1252,155 +2686,249 @@ void dispatch_event(int num_of_events)
     struct iphdr *iph;
 #endif
     int hlen=0;
-    ENTER_EVENT_DISPATCHER;
-    for (i = 0; i < num_of_fds; i++) {
-
-    if (!poll_fds[i].revents)
-        continue;
+#ifdef USE_RECVMMSG
+    gboolean full;
+#endif
 
-        if (poll_fds[i].revents & POLLERR) {
-            /* We must have specified this callback funtion for treating/logging the error */
-            if (event_callbacks[i]->eventcb_type == EVENTCB_TYPE_USER) {
-                event_logi(VERBOSE, "Poll Error Condition on user fd %d", poll_fds[i].fd);
-                ((sctp_userCallback)*(event_callbacks[i]->action)) (poll_fds[i].fd, poll_fds[i].revents, &poll_fds[i].events, event_callbacks[i]->userData);
-            } else {
-                error_logi(ERROR_MINOR, "Poll Error Condition on fd %d", poll_fds[i].fd);
-                ((sctp_socketCallback)*(event_callbacks[i]->action)) (poll_fds[i].fd, NULL, 0, NULL, 0);
-            }
+    if (revents & POLLERR) {
+        /* We must have specified this callback funtion for treating/logging the error */
+        if (cb->eventcb_type == EVENTCB_TYPE_USER) {
+            event_logi(VERBOSE, "Poll Error Condition on user fd %d", pfd->fd);
+            ((sctp_userCallback)*(cb->action)) (pfd->fd, revents, &pfd->events, cb->userData);
+        } else {
+            error_logi(ERROR_MINOR, "Poll Error Condition on fd %d", pfd->fd);
+            ((sctp_socketCallback)*(cb->action)) (pfd->fd, NULL, 0, NULL, 0);
         }
+    }
 
-        if ((poll_fds[i].revents & POLLPRI) || (poll_fds[i].revents & POLLIN) || (poll_fds[i].revents & POLLOUT)) {
-            if (event_callbacks[i]->eventcb_type == EVENTCB_TYPE_USER) {
-                    event_logi(VERBOSE, "Activity on user fd %d - Activating USER callback", poll_fds[i].fd);
-                    ((sctp_userCallback)*(event_callbacks[i]->action)) (poll_fds[i].fd, poll_fds[i].revents, &poll_fds[i].events, event_callbacks[i]->userData);
+    if ((revents & POLLPRI) || (revents & POLLIN) || (revents & POLLOUT)) {
+        if (cb->eventcb_type == EVENTCB_TYPE_USER) {
+                event_logi(VERBOSE, "Activity on user fd %d - Activating USER callback", pfd->fd);
+                ((sctp_userCallback)*(cb->action)) (pfd->fd, revents, &pfd->events, cb->userData);
 
-            } else if (event_callbacks[i]->eventcb_type == EVENTCB_TYPE_UDP) {
-                src_len = sizeof(src);
-                length = adl_get_message(poll_fds[i].fd, rbuf, MAX_MTU_SIZE, &src, &src_len);
-                event_logi(VERBOSE, "Message %d bytes - Activating UDP callback", length);
-                adl_sockunion2str(&src, src_address, SCTP_MAX_IP_LEN);
+        } else if (cb->eventcb_type == EVENTCB_TYPE_UDP) {
+            if (adl_prepareReceiveBuffer(&rx_buffer, MAX_MTU_SIZE) == NULL) return FALSE;
+            src_len = sizeof(src);
+            errno = 0;
+            length = adl_get_message(pfd->fd, rx_buffer->data, rx_buffer->size, &src, &src_len);
+
+            /* discarded messages do not stop draining the socket, only EAGAIN does */
+            if(length < 0) return (errno != EAGAIN && errno != EWOULDBLOCK);
 
-                switch (sockunion_family(&src)) {
-                    case AF_INET :
-                        portnum = ntohs(src.sin.sin_port);
-                        break;
+            event_logi(VERBOSE, "Message %d bytes - Activating UDP callback", length);
+            adl_sockunion2str(&src, src_address, SCTP_MAX_IP_LEN);
+
+            switch (sockunion_family(&src)) {
+                case AF_INET :
+                    portnum = ntohs(src.sin.sin_port);
+                    break;
 #ifdef HAVE_IPV6
-                    case AF_INET6:
-                        portnum = ntohs(src.sin6.sin6_port);
-                        break;
+                case AF_INET6:
+                    portnum = ntohs(src.sin6.sin6_port);
+                    break;
 #endif
-                    default:
-                        portnum = 0;
-                        break;
-                }
-                ((sctp_socketCallback)*(event_callbacks[i]->action)) (poll_fds[i].fd, rbuf, length, src_address, portnum);
+                default:
+                    portnum = 0;
+                    break;
+            }
+            ((sctp_socketCallback)*(cb->action)) (pfd->fd, rx_buffer->data, length, src_address, portnum);
 
-            } else if (event_callbacks[i]->eventcb_type == EVENTCB_TYPE_SCTP) {
-                length = adl_receive_message(poll_fds[i].fd, rbuf, MAX_MTU_SIZE, &src, &dest);
+#ifdef USE_SHARDS
+        } else if (cb->eventcb_type == EVENTCB_TYPE_SHARD) {
+            return adl_receive_shard((shard_state*)cb->userData);
+#endif
+        } else if (cb->eventcb_type == EVENTCB_TYPE_SCTP) {
+#ifdef USE_RECVMMSG
+            if (use_recvmmsg) {
+                length = adl_receive_batch(pfd->fd, &full);
+                /* a batch that has not filled its buffers has drained the socket */
+                if (length >= 0) return full;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return FALSE;
+                /* otherwise read a single datagram, which also reports the error */
+            }
+#endif
+            if (adl_prepareReceiveBuffer(&rx_buffer, rx_size) == NULL) return FALSE;
+            errno = 0;
+            length = adl_receive_message(pfd->fd, rx_buffer->data, rx_buffer->size, &src, &dest);
 
-                if(length < 0) break;
+            /* discarded messages do not stop draining the socket, only EAGAIN does */
+            if(length < 0) return (errno != EAGAIN && errno != EWOULDBLOCK);
 
-                event_logiiii(VERBOSE, "SCTP-Message on socket %u , len=%d, portnum=%d, sockunion family %u",
-                     poll_fds[i].fd, length, portnum, sockunion_family(&src));
+            event_logiiii(VERBOSE, "SCTP-Message on socket %u , len=%d, portnum=%d, sockunion family %u",
+                 pfd->fd, length, portnum, sockunion_family(&src));
 
-                switch (sockunion_family(&src)) {
-                case AF_INET:
-                    src_in = (struct sockaddr_in *) &src;
-                    event_logi(VERBOSE, "IPv4/SCTP-Message from %s -> activating callback",
-                               inet_ntoa(src_in->sin_addr));
+            switch (sockunion_family(&src)) {
+            case AF_INET:
+                src_in = (struct sockaddr_in *) &src;
+                event_logi(VERBOSE, "IPv4/SCTP-Message from %s -> activating callback",
+                           inet_ntoa(src_in->sin_addr));
 #if defined (LINUX)
-                    iph = (struct iphdr *) rbuf;
-                    hlen = iph->ihl << 2;
+                iph = (struct iphdr *) rx_buffer->data;
+                hlen = iph->ihl << 2;
 #elif defined (WIN32)
-                    iph = (struct ip *) rbuf;
-                    hlen = (iph->ip_verlen & 0x0F) << 2;
+                iph = (struct ip *) rx_buffer->data;
+                hlen = (iph->ip_verlen & 0x0F) << 2;
 #else
-                    iph = (struct ip *) rbuf;
-                    hlen = iph->ip_hl << 2;
+                iph = (struct ip *) rx_buffer->data;
+                hlen = iph->ip_hl << 2;
 #endif
-                    if (length < hlen) {
-                        error_logii(ERROR_MINOR,
-                                    "dispatch_event : packet too short (%d bytes) from %s",
-                                    length, inet_ntoa(src_in->sin_addr));
-                    } else {
-                        length -= hlen;
-                        mdi_receiveMessage(poll_fds[i].fd, &rbuf[hlen], length, &src, &dest);
-                    }
-                    break;
+                if (length < hlen) {
+                    error_logii(ERROR_MINOR,
+                                "dispatch_event : packet too short (%d bytes) from %s",
+                                length, inet_ntoa(src_in->sin_addr));
+                } else {
+                    length -= hlen;
+                    adl_dispatchReceiveBuffer(&rx_buffer, pfd->fd, hlen, length, &src, &dest);
+                }
+                break;
 #ifdef HAVE_IPV6
-                case AF_INET6:
-                    adl_sockunion2str(&src, src_address, SCTP_MAX_IP_LEN);
-                    /* if we have additional options, we must parse them, and deduct the sizes :-( */
-                    event_logii(VERBOSE, "IPv6/SCTP-Message from %s (%d bytes) -> activating callback",
-                                   src_address, length);
+            case AF_INET6:
+                adl_sockunion2str(&src, src_address, SCTP_MAX_IP_LEN);
+                /* if we have additional options, we must parse them, and deduct the sizes :-( */
+                event_logii(VERBOSE, "IPv6/SCTP-Message from %s (%d bytes) -> activating callback",
+                               src_address, length);
 
-                    mdi_receiveMessage(poll_fds[i].fd, &rbuf[hlen], length, &src, &dest);
-                    break;
+                adl_dispatchReceiveBuffer(&rx_buffer, pfd->fd, hlen, length, &src, &dest);
+                break;
 
 #endif                          /* HAVE_IPV6 */
-                default:
-                    error_logi(ERROR_MAJOR, "Unsupported Address Family Type %u ", sockunion_family(&src));
-                    break;
+            default:
+                error_logi(ERROR_MAJOR, "Unsupported Address Family Type %u ", sockunion_family(&src));
+                break;
 
-                }
             }
         }
+    }
+    return (cb->eventcb_type != EVENTCB_TYPE_USER &&
+            ((revents & POLLPRI) || (revents & POLLIN) || (revents & POLLOUT)));
+}
+
+
+/**
+ * this function is responsible for calling the callback functions belonging
+ * to all of the file descriptors that have indicated an event !
+ * TODO : check handling of POLLERR situation
+ * @param num_of_events  number of events indicated by poll()
+ */
+void dispatch_event(int num_of_events)
+{
+    int i = 0;
+    short int revents;
+#ifdef USE_EPOLL
+    struct epoll_entry* entry;
+    gboolean more;
+    int fd, count;
+#endif
+
+    ENTER_EVENT_DISPATCHER;
+    adl_begin_dispatch();
+#ifdef USE_EPOLL
+    for (i = 0; i < num_of_ready_fds; i++) {
+        fd = ready_fds[i];
+        entry = epoll_lookup(fd);
+        if ((entry == NULL) || (entry->pfd.revents == 0))
+            continue;
+        revents = entry->pfd.revents;
+        entry->pfd.revents = 0;
+
+        /* edge-triggered sockets are read until drained, callbacks may remove the fd */
+        count = 0;
+        do {
+            more = dispatch_fd_event(&entry->pfd, entry->cb, revents);
+            count++;
+        } while (more && entry->edge_triggered && count < EPOLL_DRAIN_BUDGET &&
+                 epoll_lookup(fd) == entry && entry->pfd.revision < revision);
+
+        if ((epoll_lookup(fd) != entry) || (entry->pfd.revision >= revision))
+            continue;
+        if (more && entry->edge_triggered) {
+            /* drain budget used up, so there may be more to read */
+            epoll_set_pending(entry);
+        }
+        /* a user callback may have changed the event mask */
+        if (epoll_update(entry) < 0)
+            error_logii(ERROR_MINOR, "epoll_ctl() failed for fd %d : errno = %d", fd, errno);
+    }
+    num_of_ready_fds = 0;
+#else
+    for (i = 0; i < num_of_fds; i++) {
+
+        if (!poll_fds[i].revents)
+            continue;
+
+        revents = poll_fds[i].revents;
         poll_fds[i].revents = 0;
+        dispatch_fd_event(&poll_fds[i], event_callbacks[i], revents);
     }                       /*   for(i = 0; i < num_of_fds; i++) */
+#endif
+    adl_end_dispatch();
     LEAVE_EVENT_DISPATCHER;
 }
 
 
 /**
- * function calls the respective callback funtion, that is to be executed as a timer
- * event, passing it two arguments
+ * function calls the respective callback funtions of all timers that have expired,
+ * passing each two arguments. At most timer_budget timers are handled in one call,
+ * the others are left for the next pass of the event loop.
  */
 void dispatch_timer(void)
 {
     int tid, result;
+    unsigned int handled = 0;
     AlarmTimer* event;
+    adl_time deadline;
 
     ENTER_TIMER_DISPATCHER;
     if (timer_list_empty()) {
         LEAVE_TIMER_DISPATCHER;
         return;
     }
-    result = get_msecs_to_nexttimer();
-
-    if (result == 0) {  /* i.e. a timer expired */
-        result = get_next_event(&event);
+    adl_begin_dispatch();
+    /* like get_msecs_to_nexttimer(), treat timers due within the next msec as expired */
+    deadline = adl_now() + ADL_NSECS_PER_MSEC;
 
+    while ((handled < timer_budget) && (get_next_event(&event) == 0) &&
+           (event->action_time < deadline)) {
         tid = event->timer_id;
         current_tid = tid;
 
         (*(event->action)) (tid, event->arg1, event->arg2);
         current_tid = 0;
+        handled++;
 
         result = remove_timer(event);
         if (result) /* this can happen for a timeout that occurs on a deleted assoc ? */
             error_logi(ERROR_MAJOR, "remove_item returned %d", result);
     }
+    adl_end_dispatch();
+    event_logi(VVERBOSE, "dispatch_timer: handled %u timers", handled);
     LEAVE_TIMER_DISPATCHER;
     return;
 }
 
 
-void adl_add_msecs_totime(struct timeval *t, unsigned int msecs)
+/**
+ * sets the maximum number of expired timers handled by one dispatch_timer() call
+ * @param  budget     number of timers, 0 keeps the current budget
+ * @return 0 for success
+ */
+int adl_setTimerBudget(unsigned int budget)
 {
-    long seconds = 0, microseconds = 0;
-    struct timeval tmp, res;
-    seconds = msecs / 1000;
-    microseconds = (msecs % 1000) * 1000;
-    tmp.tv_sec = seconds;
-    tmp.tv_usec = microseconds;
+    if (budget != 0) timer_budget = budget;
+    return 0;
+}
 
-    timeradd(t, &tmp, &res);
-    memcpy(t, &res, sizeof(res));
-    return;
+
+unsigned int adl_getTimerBudget(void)
+{
+    return timer_budget;
 }
 
+
 /**
  * helper function for the sake of a cleaner interface :-)
+ * Reads the wall clock, which is used for log timestamps only: protocol timing uses
+ * adl_now().
  */
 int adl_gettime(struct timeval *tv)
 {
@@ -1415,23 +2943,6 @@ int adl_gettime(struct timeval *tv)
 #endif
 }
 
-/**
- * function is to return difference in msecs between time a and b (i.e. a-b)
- * @param a later time (e.g. current time)
- * @param b earlier time
- * @return -1 if a is earlier than b, else msecs that passed from b to a
- */
-int adl_timediff_to_msecs(struct timeval *a, struct timeval *b)
-{
-    struct timeval result;
-    int retval;
-    /* result = a-b */
-    timersub(a, b, &result);
-    retval = result.tv_sec * 1000 + result.tv_usec / 1000;
-    event_logi(VVERBOSE, "Computed Time Difference : %d msecs", retval);
-    return ((retval < 0) ? -1 : retval);
-}
-
 /**
  * function initializes the array of fds we want to use for listening to events
  * USE    POLL_FD_UNUSED to differentiate between used/unused fds !
@@ -1439,6 +2950,21 @@ int adl_timediff_to_msecs(struct timeval *a, struct timeval *b)
 int init_poll_fds(void)
 {
     int i;
+#ifdef USE_EPOLL
+    if (epoll_sfd < 0) {
+        epoll_sfd = epoll_create(EPOLL_MAX_EVENTS);
+        if (epoll_sfd < 0)
+            error_log(ERROR_FATAL, "epoll_create() failed, aborting !");
+    }
+    if (epoll_grow_table(EPOLL_TABLE_SIZE - 1) < 0)
+        error_log(ERROR_FATAL, "Could not allocate memory in init_poll_fds()");
+    for (i = 0; i < epoll_table_size; i++) {
+        if (epoll_table[i] != NULL) adl_remove_poll_fd(i);
+    }
+    num_of_ready_fds = 0;
+    num_of_pending_fds = 0;
+    num_of_fds = 0;
+#else
     for (i = 0; i < NUM_FDS; i++) {
         assign_poll_fd(i, POLL_FD_UNUSED, 0);
       #ifdef WIN32
@@ -1448,6 +2974,7 @@ int init_poll_fds(void)
     num_of_fds = 0;
 #ifdef WIN32
    fdnum=0;
+#endif
 #endif
     return (0);
 }
@@ -1489,7 +3016,11 @@ int adl_extendedEventLoop(void (*lock)(void* data), void (*unlock)(void* data),
     }
 
     /*  print_debug_list(INTERNAL_EVENT_0); */
+#ifdef USE_EPOLL
+    result = epollPoll(msecs, lock, unlock, data);
+#else
     result = extendedPoll(poll_fds, &num_of_fds, msecs, lock, unlock, data);
+#endif
     switch (result) {
     case -1:
         result = 0;
@@ -1575,7 +3106,8 @@ int adl_eventLoop()
                for (j=0; j<NUM_FDS; j++)
                   if (event_callbacks[i]->sfd==fds[i])
                   {
-                  length = adl_receive_message(fds[i], rbuf, MAX_MTU_SIZE, &src, &dest);
+                  if (adl_prepareReceiveBuffer(&rx_buffer, rx_size) == NULL) break;
+                  length = adl_receive_message(fds[i], rx_buffer->data, rx_buffer->size, &src, &dest);
                   portnum = ntohs(src.sin.sin_port);
                   if(length < 0) break;
                   event_logiiii(VERBOSE, "SCTP-Message on socket %u , len=%d, portnum=%d, sockunion family %u",
@@ -1584,7 +3116,7 @@ int adl_eventLoop()
                     src_in = (struct sockaddr_in *) &src;
                     event_logi(VERBOSE, "IPv4/SCTP-Message from %s -> activating callback",
                                inet_ntoa(src_in->sin_addr));
-                  iph = (struct ip *) rbuf;
+                  iph = (struct ip *) rx_buffer->data;
                     hlen = (iph->ip_verlen & 0x0F) << 2;
                if (length < hlen)
                {
@@ -1594,7 +3126,7 @@ int adl_eventLoop()
                     } else
                {
                         length -= hlen;
-                        mdi_receiveMessage(fds[i], &rbuf[hlen], length, &src, &dest);
+                        adl_dispatchReceiveBuffer(&rx_buffer, fds[i], hlen, length, &src, &dest);
                     }
                     break;
                   }
@@ -1618,7 +3150,11 @@ int adl_extendedGetEvents(void (*lock)(void* data), void (*unlock)(void* data),
    if(lock != NULL) {
      lock(data);
    }
+#ifdef USE_EPOLL
+   result = epollPoll(0, lock, unlock, data);
+#else
    result = extendedPoll(poll_fds, &num_of_fds, 0, lock, unlock, data);
+#endif
    if(unlock != NULL) {
      unlock(data);
    }
@@ -1730,9 +3266,28 @@ int open_dummy_socket(int family)
 #endif
 
 
-int adl_init_adaptation_layer(int * myRwnd)
+/**
+ * seeds the random number generator, which is shared by all engines of the process
+ */
+void adl_init_random(void)
 {
     struct timeval curTime;
+
+    adl_gettime(&curTime);
+#ifdef HAVE_RANDOM
+    rstate[0] = curTime.tv_sec;
+    rstate[1] = curTime.tv_usec;
+    initstate(curTime.tv_sec, (char *) rstate, 8);
+    setstate((char *) rstate);
+#else
+    /* FIXME: this may be too weak (better than nothing however) */
+    srand(curTime.tv_usec);
+#endif
+}
+
+
+int adl_init_adaptation_layer(int * myRwnd)
+{
 #ifdef WIN32
     WSADATA        wsaData;
     int            Ret;
@@ -1765,26 +3320,32 @@ int adl_init_adaptation_layer(int * myRwnd)
    handles[1]=stdinevent;
 #endif
 
-    /* initialize random number generator */
-    adl_gettime(&curTime);
-#ifdef HAVE_RANDOM
-    rstate[0] = curTime.tv_sec;
-    rstate[1] = curTime.tv_usec;
-    initstate(curTime.tv_sec, (char *) rstate, 8);
-    setstate((char *) rstate);
-#else
-    /* FIXME: this may be too weak (better than nothing however) */
-    srand(curTime.tv_usec);
-#endif
-
     init_poll_fds();
     init_timer_list();
+#ifdef USE_SHARDS
+    if (engine_shard >= 0) {
+        /* a shard sends on the sockets of the dispatcher, which reads them for it */
+        sctp_sfd = shard_sfd;
+        sctp_df = shard_df;
+#ifdef HAVE_IPV6
+        sctpv6_sfd = shard_sfdv6;
+        sctpv6_df = shard_dfv6;
+#endif
+        *myRwnd = shard_rwnd;
+        if (adl_register_fd_cb(shards[engine_shard].wakeup_fd[0], EVENTCB_TYPE_SHARD, POLLIN | POLLPRI,
+                               NULL, &shards[engine_shard]) < 0)
+            return -1;
+        return 0;
+    }
+#endif
     /*  print_debug_list(INTERNAL_EVENT_0); */
     sctp_sfd = adl_open_sctp_socket(AF_INET, myRwnd);
     /* set a safe default */
     if (*myRwnd == -1) *myRwnd = 8192;
 
     if (sctp_sfd < 0) return sctp_sfd;
+    sctp_df = (adl_setDontFragment(sctp_sfd, AF_INET, TRUE) == 0);
+    if (!sctp_df) error_log(ERROR_MAJOR, "DF bit not supported - no path MTU discovery on IPv4 !");
 
 #ifdef SCTP_OVER_UDP
     dummy_sctp_udp = open_dummy_socket(AF_INET);
@@ -1805,6 +3366,8 @@ int adl_init_adaptation_layer(int * myRwnd)
         sctpv6_sfd = -1;
     }
     else {
+       sctpv6_df = (adl_setDontFragment(sctpv6_sfd, AF_INET6, TRUE) == 0);
+       if (!sctpv6_df) error_log(ERROR_MAJOR, "DF bit not supported - no path MTU discovery on IPv6 !");
 #ifdef SCTP_OVER_UDP
        dummy_sctpv6_udp = open_dummy_socket(AF_INET6);
        if(dummy_sctpv6_udp < 0) {
@@ -1820,6 +3383,18 @@ int adl_init_adaptation_layer(int * myRwnd)
     if (myRwnd6 == -1) *myRwnd = 8192;
 #endif
 
+#ifdef USE_SHARDS
+    if (engine_shard == ADL_SHARD_DISPATCHER) {
+        shard_sfd = sctp_sfd;
+        shard_df = sctp_df;
+#ifdef HAVE_IPV6
+        shard_sfdv6 = sctpv6_sfd;
+        shard_dfv6 = sctpv6_df;
+#endif
+        shard_rwnd = *myRwnd;
+    }
+#endif
+
     /* icmp_sfd = int adl_open_icmp_socket(); */
     /* adl_register_socket_cb(icmp_sfd, adl_icmp_cb); */
 
@@ -1831,6 +3406,129 @@ int adl_init_adaptation_layer(int * myRwnd)
 }
 
 
+/**
+ * makes the engine of the calling thread the receive dispatcher of a number of shards.
+ * It must be called before adl_init_adaptation_layer(), and before the shards are started.
+ * @param  numberOfShards   number of shards, at least 1
+ * @return 0 for success, -1 if shards are not supported, have already been set up, or
+ *         their wakeup file descriptors could not be created
+ */
+int adl_initDispatcher(unsigned int numberOfShards)
+{
+#ifdef USE_SHARDS
+    unsigned int i;
+
+    if ((shards != NULL) || (numberOfShards == 0)) return -1;
+    shards = (shard_state*)calloc(numberOfShards, sizeof(shard_state));
+    if (shards == NULL) return -1;
+
+    for (i = 0; i < numberOfShards; i++) {
+        if (adl_openWakeup(shards[i].wakeup_fd) == 0) continue;
+        while (i-- > 0) adl_closeWakeup(shards[i].wakeup_fd);
+        free(shards);
+        shards = NULL;
+        return -1;
+    }
+    shard_count = numberOfShards;
+    engine_shard = ADL_SHARD_DISPATCHER;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+
+/**
+ * undoes adl_initDispatcher() when the engine of the dispatcher could not be set up.
+ * It must be called before any shard is started.
+ */
+void adl_exitDispatcher(void)
+{
+#ifdef USE_SHARDS
+    unsigned int i;
+
+    if (engine_shard != ADL_SHARD_DISPATCHER) return;
+    for (i = 0; i < shard_count; i++) adl_closeWakeup(shards[i].wakeup_fd);
+    free(shards);
+    shards = NULL;
+    shard_count = 0;
+    shard_sfd = -1;
+    shard_sfdv6 = -1;
+    engine_shard = ADL_NO_SHARD;
+#endif
+}
+
+
+/**
+ * makes the engine of the calling thread one of the shards set up by adl_initDispatcher().
+ * It must be called before adl_init_adaptation_layer().
+ * @param  shard    index of the shard
+ * @return 0 for success, -1 if there is no such shard, or it is already run by an engine
+ */
+int adl_initShard(unsigned int shard)
+{
+#ifdef USE_SHARDS
+    if (shard >= shard_count) return -1;
+    if (__atomic_exchange_n(&shards[shard].joined, 1, __ATOMIC_ACQ_REL) != 0) return -1;
+    engine_shard = (int)shard;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+
+int adl_getShard(void)
+{
+#ifdef USE_SHARDS
+    return engine_shard;
+#else
+    return ADL_NO_SHARD;
+#endif
+}
+
+
+unsigned int adl_getShardCount(void)
+{
+#ifdef USE_SHARDS
+    return shard_count;
+#else
+    return 0;
+#endif
+}
+
+
+int adl_getShardOfPeer(union sockunion* address, unsigned short port)
+{
+#ifdef USE_SHARDS
+    if (shard_count == 0) return -1;
+    return (int)adl_shardOfPeer(address, port);
+#else
+    return -1;
+#endif
+}
+
+
+void adl_setShardCommandQueue(void* queue)
+{
+#ifdef USE_SHARDS
+    if (engine_shard >= 0)
+        __atomic_store_n(&shards[engine_shard].command_queue, queue, __ATOMIC_RELEASE);
+#endif
+}
+
+
+void* adl_getShardCommandQueue(unsigned int shard)
+{
+#ifdef USE_SHARDS
+    if (shard >= shard_count) return NULL;
+    return __atomic_load_n(&shards[shard].command_queue, __ATOMIC_ACQUIRE);
+#else
+    return NULL;
+#endif
+}
+
+
 /**
  * this function is supposed to open and bind a UDP socket listening on a port
  * to incoming udp pakets on a local interface (a local union sockunion address)
@@ -1920,6 +3618,18 @@ int adl_registerUserCallback(int fd, sctp_userCallback sdf, void* userData, shor
 }
 
 #ifndef WIN32
+/**
+ * registers a callback for wakeup descriptors opened with adl_openWakeup(), which
+ * the event loop calls when another thread has woken it up
+ * @return number of registered file descriptors, or -1 if error ocurred
+ */
+int adl_registerWakeupCallback(int wakeup_fd[2], sctp_userCallback sdf, void* userData)
+{
+    return adl_register_fd_cb(wakeup_fd[0], EVENTCB_TYPE_USER, POLLIN | POLLPRI,
+                              (void (*) (void *,void *))sdf, userData);
+}
+
+
 void readCallback(int fd, short int revents, short int* events, void* userData)
 {
    int n;
@@ -1985,6 +3695,10 @@ int adl_unregisterUserCallback(int fd)
 int
 adl_register_socket_cb(gint sfd, sctp_socketCallback scf)
 {
+#ifdef USE_SHARDS
+    /* the SCTP sockets of a shard are read by the dispatcher */
+    if ((engine_shard >= 0) && (sfd == shard_sfd || sfd == shard_sfdv6)) return num_of_fds;
+#endif
     return (adl_register_fd_cb(sfd, EVENTCB_TYPE_SCTP, POLLIN | POLLPRI, (void(*)(void *,void *))scf, NULL));
 }
 
@@ -2002,20 +3716,13 @@ unsigned int adl_startMicroTimer(unsigned int seconds, unsigned int microseconds
 {
     unsigned int result = 0;
     AlarmTimer* item;
-    struct timeval talarm, delta, now;
-
-    delta.tv_sec = seconds;
-    /* make sure, user cannot confuse us :-) */
-    delta.tv_sec += (microseconds / 1000000);  /* usually 0 */
-    delta.tv_usec = (microseconds % 1000000);
 
-    adl_gettime(&now);
     item = (AlarmTimer*)malloc(sizeof(AlarmTimer));
     if (item == NULL) return 0;
 
-    timeradd(&now, &delta, &talarm);
     item->timer_type = ttype;
-    item->action_time = talarm;
+    item->action_time = adl_now() + (adl_time)seconds * ADL_NSECS_PER_SEC +
+                        (adl_time)microseconds * ADL_NSECS_PER_USEC;
     item->action = timer_cb;
     item->arg1 = param1;
     item->arg2 = param2;
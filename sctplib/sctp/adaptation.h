@@ -86,6 +86,13 @@ gint adl_open_sctp_socket(int af, int* myRwnd);
 
 int adl_setReceiveBufferSize(int sfd, int new_size);
 
+/**
+ * @param  af   the address family of a path
+ * @return TRUE, if the packets to that path have the DF bit set, which is needed for
+ *         the path MTU discovery
+ */
+gboolean adl_dontFragment(int af);
+
 gint adl_get_sctpv4_socket(void);
 #ifdef HAVE_IPV6
 gint adl_get_sctpv6_socket(void);
@@ -103,6 +110,79 @@ gint adl_get_sctpv6_socket(void);
  */
 int adl_send_message(int sfd, void *buf, int len, union sockunion *dest, unsigned char tos);
 
+/** maximum number of buffers a datagram may be gathered from by adl_send_vector() */
+#define ADL_MAX_IOVECS      64
+
+/** flags for adl_send_vector(): a path MTU probe, that must not be fragmented */
+#define ADL_SEND_PROBE      1
+/** a packet larger than the path MTU, that the kernel may fragment (RFC 4960, 7.3) */
+#define ADL_SEND_FRAGMENT   2
+
+/**
+ * like adl_send_message(), for a datagram that is gathered from several buffers
+ * @param  sfd      the socket file descriptor where data will be sent
+ * @param  iov      the buffers of the datagram
+ * @param  iovcnt   number of buffers, at most ADL_MAX_IOVECS
+ * @param  dest     address, where data is to be sent
+ * @param  tos      the TOS (or IPv6 traffic class) of the datagram
+ * @param  flags    0, ADL_SEND_PROBE or ADL_SEND_FRAGMENT. These datagrams are sent at once.
+ * @return returns number of bytes actually sent, or error
+ */
+int adl_send_vector(int sfd, const SCTP_iovec* iov, int iovcnt, union sockunion *dest,
+                    unsigned char tos, int flags);
+
+/**
+ * takes a reference to the receive buffer of the datagram that is being handed on to
+ * mdi_receiveMessage(), so that pointers into the datagram stay valid until the
+ * reference is given back with adl_releaseReceiveBuffer()
+ * @return the buffer, or NULL if no datagram from a receive buffer is being handled
+ */
+void* adl_holdReceiveBuffer(void);
+
+/**
+ * @return the size of the receive buffer of the datagram that is being handed on to
+ *         mdi_receiveMessage(), or 0 if it is not in a receive buffer
+ */
+unsigned int adl_getReceiveBufferSize(void);
+
+/**
+ * gives back a reference taken with adl_holdReceiveBuffer()
+ * @param  buffer   the buffer, may be NULL
+ */
+void adl_releaseReceiveBuffer(void* buffer);
+
+/**
+ * configures the transmit queue, that collects the datagrams sent during a receive or
+ * timer dispatch pass and sends them with sendmmsg() at the end of the pass
+ * @param  depth      maximum number of queued datagrams, 0 sends datagrams at once
+ * @param  maxDelay   maximum time in usecs a datagram is kept in the queue, 0 for no limit
+ * @return 0 for success, -1 if the depth is not supported
+ */
+int adl_setSendBatching(unsigned int depth, unsigned int maxDelay);
+
+/**
+ * reads the configuration and the batch counters of the transmit queue
+ */
+void adl_getSendBatching(unsigned int* depth, unsigned int* maxDelay,
+                         unsigned int* batches, unsigned int* datagrams, unsigned int* largest);
+
+/**
+ * reports completed borrowed-buffer sends, unless a dispatch pass is running
+ */
+void adl_notifyPayloads(void);
+
+/**
+ * sets the maximum number of expired timers handled by one dispatch_timer() call
+ * @param  budget     number of timers, 0 keeps the current budget
+ * @return 0 for success
+ */
+int adl_setTimerBudget(unsigned int budget);
+
+/**
+ * @return the maximum number of expired timers handled by one dispatch_timer() call
+ */
+unsigned int adl_getTimerBudget(void);
+
 
 /**
  * this function initializes the data of this module. It opens raw sockets for
@@ -112,6 +192,90 @@ int adl_send_message(int sfd, void *buf, int len, union sockunion *dest, unsigne
 int adl_init_adaptation_layer(int * myRwnd);
 
 
+#ifndef WIN32
+/**
+ * opens the file descriptors through which other threads wake up an event loop
+ * @param  wakeup_fd    the descriptor to read from, and the one to write to
+ * @return 0 for success, -1 for error
+ */
+int adl_openWakeup(int wakeup_fd[2]);
+
+void adl_closeWakeup(int wakeup_fd[2]);
+
+/**
+ * wakes up the event loop that reads the wakeup descriptors, from any thread
+ */
+void adl_signalWakeup(int wakeup_fd[2]);
+
+/**
+ * reads the wakeups, before the event loop looks for the work it has been woken up for
+ */
+void adl_clearWakeup(int wakeup_fd[2]);
+
+/**
+ * registers a callback that is called by the event loop when it has been woken up
+ */
+int adl_registerWakeupCallback(int wakeup_fd[2], sctp_userCallback sdf, void* userData);
+#endif
+
+/* the role of an engine in sharded mode, as returned by adl_getShard() */
+#define ADL_NO_SHARD            -1
+#define ADL_SHARD_DISPATCHER    -2
+
+/**
+ * makes the engine of the calling thread the receive dispatcher of a number of shards:
+ * it reads the SCTP sockets and steers every datagram to the shard that owns its
+ * association. To be called before adl_init_adaptation_layer().
+ * @return 0 for success, -1 for error
+ */
+int adl_initDispatcher(unsigned int numberOfShards);
+
+/**
+ * undoes adl_initDispatcher(), if the engine of the dispatcher could not be set up
+ */
+void adl_exitDispatcher(void);
+
+/**
+ * makes the engine of the calling thread a shard, that gets its datagrams from the
+ * dispatcher. To be called before adl_init_adaptation_layer().
+ * @return 0 for success, -1 for error
+ */
+int adl_initShard(unsigned int shard);
+
+/**
+ * @return the index of the shard run by the engine of the calling thread,
+ *         ADL_SHARD_DISPATCHER, or ADL_NO_SHARD
+ */
+int adl_getShard(void);
+
+/**
+ * @return the number of shards, 0 if the engines are not sharded
+ */
+unsigned int adl_getShardCount(void);
+
+/**
+ * @return the index of the shard that sets up the associations with a peer, or -1
+ *         if the engines are not sharded
+ */
+int adl_getShardOfPeer(union sockunion* address, unsigned short port);
+
+/**
+ * publishes the command queue of the shard run by the engine of the calling thread
+ */
+void adl_setShardCommandQueue(void* queue);
+
+/**
+ * @return the command queue published by a shard, or NULL
+ */
+void* adl_getShardCommandQueue(unsigned int shard);
+
+
+/**
+ * seeds the random number generator, once for all engines of the process
+ */
+void adl_init_random(void);
+
+
 
 /**
  * function add a sfd to the list of sfds we want to wait for with the poll()
@@ -138,15 +302,12 @@ int adl_remove_poll_fd(gint sfd);
 
 
 /**
- * function is to return difference in msecs between time a and b (i.e. a-b)
- * @param a later time (e.g. current time)
- * @param b earlier time
- * @return -1 if a is earlier than b, else msecs that passed from b to a
+ * returns the time on the monotonic clock. While a receive or timer dispatch pass
+ * runs, the time sampled at the start of the pass is returned, so all timers and
+ * timestamps of one pass agree and the clock is read once per pass.
+ * @return the time in nanoseconds
  */
-int adl_timediff_to_msecs(struct timeval *a, struct timeval *b);
-
-
-void adl_add_msecs_totime(struct timeval *t, unsigned int msecs);
+adl_time adl_now(void);
 
 int adl_gettime(struct timeval *tv);
 
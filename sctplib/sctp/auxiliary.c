@@ -47,6 +47,23 @@
 #include "adaptation.h"
 
 #include <stdio.h>
+#include <stdint.h>
+
+/* the hardware CRC32C engines need GCC-style target attributes */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(HAVE_CPUID_H)
+#define CRC32C_SSE42
+#include <cpuid.h>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__aarch64__) && defined(HAVE_SYS_AUXV_H) && defined(HAVE_GETAUXVAL)
+#define CRC32C_ARMV8
+#include <sys/auxv.h>
+#include <arm_acle.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
 
 #define BASE 65521L             /* largest prime smaller than 65536 */
 #define NMAX 5552
@@ -54,6 +71,9 @@
 
 /* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
 
+/* the longest SCTP packet, which may be a jumbo frame */
+#define PMAX ((int)sizeof(SCTP_message))
+
 #define DO1(buf,i)  {s1 += buf[i]; s2 += s1;}
 #define DO2(buf,i)  DO1(buf,i); DO1(buf,i+1);
 #define DO4(buf,i)  DO2(buf,i); DO2(buf,i+2);
@@ -132,21 +152,370 @@ uint32_t crc_c[256] =
     0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351,
 };
 
+/* the CRC32C polynomial, bit reflected */
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+/* the lanes of the interleaved hardware CRC32C engines, in bytes (multiples of 8) */
+#define CRC32C_LONG  1024
+#define CRC32C_SHORT  128
+
+/*
+ * The CRC32C engines update a CRC without the initial and final inversion, so that the
+ * CRC of a concatenation can be computed from the CRCs of its parts. They are selected
+ * by set_checksum_algorithm(), the byte-wise engine works without any initialization.
+ */
+typedef uint32_t (*crc32c_engine)(uint32_t crc, const unsigned char *buffer, unsigned int length);
+
+static uint32_t crc32c_bytewise(uint32_t crc, const unsigned char *buffer, unsigned int length);
+static uint32_t crc32c_sliced(uint32_t crc, const unsigned char *buffer, unsigned int length);
+#ifdef CRC32C_SSE42
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *buffer, unsigned int length);
+#endif
+#ifdef CRC32C_ARMV8
+static uint32_t crc32c_armv8(uint32_t crc, const unsigned char *buffer, unsigned int length);
+#endif
+
+static crc32c_engine crc32c_update = crc32c_bytewise;
+
+static uint32_t crc32c_multiply_bitwise(uint32_t a, uint32_t b);
+#ifdef CRC32C_SSE42
+static uint32_t crc32c_multiply_pclmul(uint32_t a, uint32_t b);
+#endif
+
+/* multiplication modulo the CRC32C polynomial, used for combining CRC32Cs */
+static uint32_t (*crc32c_multiply)(uint32_t a, uint32_t b) = crc32c_multiply_bitwise;
+/* combining CRC32Cs is cheaper than computing a CRC32C again, see aux_crc32c_combining() */
+static int crc32c_combining_pays = 0;
+
+/* crc_c extended for slicing-by-8: crc32c_slices[k][n] is the CRC of byte n followed by k zero bytes */
+static uint32_t crc32c_slices[8][256];
+/* aux_crc32c_shift() operators for 0..255 bytes and for multiples of 256 bytes */
+static uint32_t crc32c_shift_bytes[256];
+static uint32_t crc32c_shift_blocks[256];
+#if defined(CRC32C_SSE42) || defined(CRC32C_ARMV8)
+/* operators appending CRC32C_LONG resp. CRC32C_SHORT zero bytes to a CRC, see crc32c_shift() */
+static uint32_t crc32c_long_zeros[4][256];
+static uint32_t crc32c_short_zeros[4][256];
+#endif
+
 static int insert_adler32(unsigned char *buffer, int length);
 static int insert_crc32(unsigned char *buffer, int length);
 static int validate_adler32(unsigned char *header_start, int length);
 static int validate_crc32(unsigned char *buffer, int length);
 
 
-static int (*insert_checksum) (unsigned char* buffer, int length) = insert_crc32;
-static int (*validate_checksum) (unsigned char* buffer, int length) = validate_crc32;
+static ENGINE_LOCAL int (*insert_checksum) (unsigned char* buffer, int length) = insert_crc32;
+static ENGINE_LOCAL int (*validate_checksum) (unsigned char* buffer, int length) = validate_crc32;
 
 
 static uint32_t sctp_adler32(uint32_t adler, const unsigned char *buf, unsigned int len);
 
 
+static uint32_t crc32c_bytewise(uint32_t crc, const unsigned char *buffer, unsigned int length)
+{
+    while (length-- > 0) {
+        CRC32C(crc, *buffer++);
+    }
+    return crc;
+}
+
+
+/**
+ * slicing-by-8: processes eight bytes with eight table lookups
+ */
+static uint32_t crc32c_sliced(uint32_t crc, const unsigned char *buffer, unsigned int length)
+{
+    uint32_t low, high;
+
+    /* the words are assembled byte by byte, so neither alignment nor byte order matter */
+    while (length >= 8) {
+        low  = crc ^ ((uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+                      ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24));
+        high = (uint32_t)buffer[4] | ((uint32_t)buffer[5] << 8) |
+               ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[7] << 24);
+        crc  = crc32c_slices[7][low & 0xFF] ^ crc32c_slices[6][(low >> 8) & 0xFF] ^
+               crc32c_slices[5][(low >> 16) & 0xFF] ^ crc32c_slices[4][low >> 24] ^
+               crc32c_slices[3][high & 0xFF] ^ crc32c_slices[2][(high >> 8) & 0xFF] ^
+               crc32c_slices[1][(high >> 16) & 0xFF] ^ crc32c_slices[0][high >> 24];
+        buffer += 8;
+        length -= 8;
+    }
+    return crc32c_bytewise(crc, buffer, length);
+}
+
+
+#if defined(CRC32C_SSE42) || defined(CRC32C_ARMV8)
+/**
+ * computes the table of the (linear) operator that appends a number of zero bytes to a CRC
+ * @param zeros     the table to fill in
+ * @param length    the number of zero bytes
+ */
+static void crc32c_zeros(uint32_t zeros[4][256], unsigned int length)
+{
+    uint32_t basis[32], crc;
+    unsigned int i, k, n;
+
+    for (i = 0; i < 32; i++) {
+        crc = (uint32_t)1 << i;
+        for (n = 0; n < length; n++) {
+            CRC32C(crc, 0);
+        }
+        basis[i] = crc;
+    }
+    for (k = 0; k < 4; k++) {
+        for (n = 0; n < 256; n++) {
+            crc = 0;
+            for (i = 0; i < 8; i++) {
+                if (n & (1 << i)) crc ^= basis[8 * k + i];
+            }
+            zeros[k][n] = crc;
+        }
+    }
+}
+
+
+/**
+ * appends the zero bytes of a table computed by crc32c_zeros() to a CRC
+ */
+static uint32_t crc32c_shift(uint32_t zeros[4][256], uint32_t crc)
+{
+    return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^
+           zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+#endif
+
+
+#ifdef CRC32C_SSE42
+/**
+ * SSE4.2 crc32 instruction. The instruction has a latency of three cycles but can be
+ * issued every cycle, so three lanes are computed interleaved and combined afterwards.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *buffer, unsigned int length)
+{
+    uint64_t crc0, crc1, crc2, word0, word1, word2;
+    const unsigned char *end;
+
+    while ((length > 0) && (((uintptr_t)buffer & 7) != 0)) {
+        crc = _mm_crc32_u8(crc, *buffer++);
+        length--;
+    }
+    crc0 = crc;
+    while (length >= 3 * CRC32C_LONG) {
+        crc1 = crc2 = 0;
+        end = buffer + CRC32C_LONG;
+        do {
+            memcpy(&word0, buffer, 8);
+            memcpy(&word1, buffer + CRC32C_LONG, 8);
+            memcpy(&word2, buffer + 2 * CRC32C_LONG, 8);
+            crc0 = _mm_crc32_u64(crc0, word0);
+            crc1 = _mm_crc32_u64(crc1, word1);
+            crc2 = _mm_crc32_u64(crc2, word2);
+            buffer += 8;
+        } while (buffer < end);
+        crc0 = crc32c_shift(crc32c_long_zeros, (uint32_t)crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_long_zeros, (uint32_t)crc0) ^ crc2;
+        buffer += 2 * CRC32C_LONG;
+        length -= 3 * CRC32C_LONG;
+    }
+    while (length >= 3 * CRC32C_SHORT) {
+        crc1 = crc2 = 0;
+        end = buffer + CRC32C_SHORT;
+        do {
+            memcpy(&word0, buffer, 8);
+            memcpy(&word1, buffer + CRC32C_SHORT, 8);
+            memcpy(&word2, buffer + 2 * CRC32C_SHORT, 8);
+            crc0 = _mm_crc32_u64(crc0, word0);
+            crc1 = _mm_crc32_u64(crc1, word1);
+            crc2 = _mm_crc32_u64(crc2, word2);
+            buffer += 8;
+        } while (buffer < end);
+        crc0 = crc32c_shift(crc32c_short_zeros, (uint32_t)crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_short_zeros, (uint32_t)crc0) ^ crc2;
+        buffer += 2 * CRC32C_SHORT;
+        length -= 3 * CRC32C_SHORT;
+    }
+    while (length >= 8) {
+        memcpy(&word0, buffer, 8);
+        crc0 = _mm_crc32_u64(crc0, word0);
+        buffer += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc0;
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *buffer++);
+    }
+    return crc;
+}
+#endif
+
+
+#ifdef CRC32C_ARMV8
+/**
+ * ARMv8 CRC32 extension, interleaved like crc32c_sse42()
+ */
+__attribute__((target("+crc")))
+static uint32_t crc32c_armv8(uint32_t crc, const unsigned char *buffer, unsigned int length)
+{
+    uint32_t crc0, crc1, crc2;
+    uint64_t word0, word1, word2;
+    const unsigned char *end;
+
+    while ((length > 0) && (((uintptr_t)buffer & 7) != 0)) {
+        crc = __crc32cb(crc, *buffer++);
+        length--;
+    }
+    crc0 = crc;
+    while (length >= 3 * CRC32C_LONG) {
+        crc1 = crc2 = 0;
+        end = buffer + CRC32C_LONG;
+        do {
+            memcpy(&word0, buffer, 8);
+            memcpy(&word1, buffer + CRC32C_LONG, 8);
+            memcpy(&word2, buffer + 2 * CRC32C_LONG, 8);
+            crc0 = __crc32cd(crc0, word0);
+            crc1 = __crc32cd(crc1, word1);
+            crc2 = __crc32cd(crc2, word2);
+            buffer += 8;
+        } while (buffer < end);
+        crc0 = crc32c_shift(crc32c_long_zeros, crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_long_zeros, crc0) ^ crc2;
+        buffer += 2 * CRC32C_LONG;
+        length -= 3 * CRC32C_LONG;
+    }
+    while (length >= 3 * CRC32C_SHORT) {
+        crc1 = crc2 = 0;
+        end = buffer + CRC32C_SHORT;
+        do {
+            memcpy(&word0, buffer, 8);
+            memcpy(&word1, buffer + CRC32C_SHORT, 8);
+            memcpy(&word2, buffer + 2 * CRC32C_SHORT, 8);
+            crc0 = __crc32cd(crc0, word0);
+            crc1 = __crc32cd(crc1, word1);
+            crc2 = __crc32cd(crc2, word2);
+            buffer += 8;
+        } while (buffer < end);
+        crc0 = crc32c_shift(crc32c_short_zeros, crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_short_zeros, crc0) ^ crc2;
+        buffer += 2 * CRC32C_SHORT;
+        length -= 3 * CRC32C_SHORT;
+    }
+    while (length >= 8) {
+        memcpy(&word0, buffer, 8);
+        crc0 = __crc32cd(crc0, word0);
+        buffer += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc0 = __crc32cb(crc0, *buffer++);
+    }
+    return crc0;
+}
+#endif
+
+
+/**
+ * multiplies two polynomials modulo the CRC32C polynomial, in the bit reflected
+ * representation of the CRC: the most significant bit is the coefficient of x^0.
+ */
+static uint32_t crc32c_multiply_bitwise(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    int i;
+
+    /* without branches, as the bits of a are unpredictable */
+    for (i = 31; i >= 0; i--) {
+        product ^= b & (0 - ((a >> i) & 1));
+        b = (b >> 1) ^ (CRC32C_POLYNOMIAL & (0 - (b & 1)));
+    }
+    return product;
+}
+
+
+#ifdef CRC32C_SSE42
+/**
+ * the same with a carry-less multiplication: the 63 bit product is reduced with the crc32
+ * instruction, which computes the product of its 32 bit operand with x^32 modulo the polynomial
+ */
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_multiply_pclmul(uint32_t a, uint32_t b)
+{
+    __m128i  product;
+    uint64_t reflected;
+
+    product = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)a), _mm_cvtsi32_si128((int)b), 0);
+    reflected = (uint64_t)_mm_cvtsi128_si64(product) << 1;
+    return _mm_crc32_u32(0, (uint32_t)reflected) ^ (uint32_t)(reflected >> 32);
+}
+#endif
+
+
+/**
+ * computes the tables of the CRC32C engines, and chooses the fastest engine the CPU supports
+ */
+static void crc32c_init(void)
+{
+    static boolean initialized = FALSE;
+    int k, n;
+
+    if (initialized) return;
+
+    for (n = 0; n < 256; n++) {
+        crc32c_slices[0][n] = crc_c[n];
+    }
+    for (k = 1; k < 8; k++) {
+        for (n = 0; n < 256; n++) {
+            crc32c_slices[k][n] = (crc32c_slices[k-1][n] >> 8) ^ crc_c[crc32c_slices[k-1][n] & 0xFF];
+        }
+    }
+    crc32c_update = crc32c_sliced;
+    crc32c_combining_pays = 1;
+
+#ifdef CRC32C_SSE42
+    {
+        unsigned int eax, ebx, ecx, edx;
+
+        if ((__get_cpuid(1, &eax, &ebx, &ecx, &edx)) && (ecx & bit_SSE4_2)) {
+            crc32c_update = crc32c_sse42;
+            /* the crc32 instruction is so fast, that only a fast multiplication can keep up */
+            if (ecx & bit_PCLMUL) {
+                crc32c_multiply = crc32c_multiply_pclmul;
+            } else {
+                crc32c_combining_pays = 0;
+            }
+        }
+    }
+#endif
+#ifdef CRC32C_ARMV8
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        crc32c_update = crc32c_armv8;
+        crc32c_combining_pays = 0;
+    }
+#endif
+
+    /* shifting by a byte multiplies with x^8, by 256 bytes with x^2048 */
+    crc32c_shift_bytes[0] = crc32c_shift_blocks[0] = (uint32_t)1 << 31;
+    for (n = 1; n < 256; n++) {
+        crc32c_shift_bytes[n] = (*crc32c_multiply)(crc32c_shift_bytes[n-1], (uint32_t)1 << 23);
+    }
+    for (n = 1; n < 256; n++) {
+        crc32c_shift_blocks[n] = (*crc32c_multiply)(crc32c_shift_blocks[n-1],
+                                                 (*crc32c_multiply)(crc32c_shift_bytes[255], (uint32_t)1 << 23));
+    }
+
+#if defined(CRC32C_SSE42) || defined(CRC32C_ARMV8)
+    if (crc32c_update != crc32c_sliced) {
+        crc32c_zeros(crc32c_long_zeros, CRC32C_LONG);
+        crc32c_zeros(crc32c_short_zeros, CRC32C_SHORT);
+    }
+#endif
+    initialized = TRUE;
+}
+
+
 int set_checksum_algorithm(int algorithm){
     if (algorithm == SCTP_CHECKSUM_ALGORITHM_CRC32C) {
+        crc32c_init();
         insert_checksum =  &insert_crc32;
         validate_checksum =  &validate_crc32;
         return SCTP_SUCCESS;
@@ -161,7 +530,7 @@ int set_checksum_algorithm(int algorithm){
 
 unsigned char* key_operation(int operation_code)
 {
-    static unsigned char *secret_key = NULL;
+    static ENGINE_LOCAL unsigned char *secret_key = NULL;
     uint32_t              count = 0, tmp;
 
     if (operation_code == KEY_READ) return secret_key;
@@ -190,12 +559,43 @@ int aux_insert_checksum(unsigned char *buffer, int length)
 }
 
 
+int aux_crc32c_in_use(void)
+{
+    return (insert_checksum == insert_crc32);
+}
+
+
+int aux_crc32c_combining(void)
+{
+    return ((insert_checksum == insert_crc32) && crc32c_combining_pays);
+}
+
+
+unsigned int aux_crc32c(unsigned int crc, const unsigned char *buffer, unsigned int length)
+{
+    return (*crc32c_update)(crc, buffer, length);
+}
+
+
+unsigned int aux_crc32c_shift(unsigned int length)
+{
+    if (length < 256) return crc32c_shift_bytes[length];
+    return (*crc32c_multiply)(crc32c_shift_blocks[(length >> 8) & 0xFF], crc32c_shift_bytes[length & 0xFF]);
+}
+
+
+unsigned int aux_crc32c_combine(unsigned int crcA, unsigned int crcB, unsigned int shiftB)
+{
+    return (*crc32c_multiply)(shiftB, crcA) ^ crcB;
+}
+
+
 static int insert_adler32(unsigned char *buffer, int length)
 {
     SCTP_message *message;
     uint32_t      a32;
     /* save crc value from PDU */
-    if (length > NMAX || length < NMIN)
+    if (length > PMAX || length < NMIN)
         return -1;
     message = (SCTP_message *) buffer;
     message->common_header.checksum = htonl(0L);
@@ -212,17 +612,14 @@ static int insert_adler32(unsigned char *buffer, int length)
     return 1;
 }
 
-static uint32_t generate_crc32c(unsigned char *buffer, int length)
+/**
+ * converts a CRC32C without pre- and post-inversion to the checksum in host byte order
+ */
+static uint32_t finish_crc32c(uint32_t crc32)
 {
     unsigned char byte0, byte1, byte2, byte3, swap;
-    uint32_t      crc32 = ~0L;
-    int           i;
 
-    for (i = 0; i < length; i++)
-    {
-      CRC32C(crc32, buffer[i]);
-    }
-    crc32 =~ crc32;
+    crc32 = ~crc32;
     /* do the swap */
     byte0 = (unsigned char) crc32 & 0xff;
     byte1 = (unsigned char) (crc32>>8) & 0xff;
@@ -236,13 +633,18 @@ static uint32_t generate_crc32c(unsigned char *buffer, int length)
 
 }
 
+static uint32_t generate_crc32c(unsigned char *buffer, int length)
+{
+    return finish_crc32c((*crc32c_update)(~0L, buffer, (unsigned int)length));
+}
+
 static int insert_crc32(unsigned char *buffer, int length)
 {
     SCTP_message *message;
     uint32_t      crc32c;
 
     /* check packet length */
-    if (length > NMAX  || length < NMIN)
+    if (length > PMAX  || length < NMIN)
       return -1;
 
     message = (SCTP_message *) buffer;
@@ -255,11 +657,34 @@ static int insert_crc32(unsigned char *buffer, int length)
 }
 
 
+int aux_insert_checksum_combined(unsigned char *buffer, int length, unsigned int chunksCrc)
+{
+    SCTP_message *message;
+    uint32_t      crc32c;
+
+    if (insert_checksum != insert_crc32)
+        return ((*insert_checksum)(buffer,length));
+
+    /* check packet length */
+    if (length > PMAX  || length < NMIN)
+      return -1;
+
+    message = (SCTP_message *) buffer;
+    message->common_header.checksum = 0L;
+    crc32c = (*crc32c_update)(~0L, buffer, sizeof(SCTP_common_header));
+    crc32c = (*crc32c_multiply)(aux_crc32c_shift(length - sizeof(SCTP_common_header)), crc32c) ^ chunksCrc;
+    /* and insert it into the message */
+    message->common_header.checksum = htonl(finish_crc32c(crc32c));
+
+   return 1;
+}
+
+
 int validate_size(unsigned char *header_start, int length)
 {
     if ((length % 4) != 0L)
         return 0;
-    if (length > NMAX  || length < NMIN)
+    if (length > PMAX  || length < NMIN)
         return 0;
     return 1;
 }
@@ -59,6 +59,53 @@ int validate_datagram(unsigned char *buffer, int length);
 
 int aux_insert_checksum(unsigned char *buffer, int length);
 
+/**
+ * Inserts the checksum into an SCTP packet, when the CRC32C of its chunks is already known.
+ * Falls back to aux_insert_checksum(), if CRC32C is not the checksum algorithm in use.
+ * @param buffer     pointer to the start of the packet
+ * @param length     length of the packet
+ * @param chunksCrc  aux_crc32c(0, ...) of the packet without the common header
+ * @return 1 on success, -1 if the length is not valid
+ */
+int aux_insert_checksum_combined(unsigned char *buffer, int length, unsigned int chunksCrc);
+
+/**
+ * @return 1 if the checksum algorithm in use is CRC32C, else 0
+ */
+int aux_crc32c_in_use(void);
+
+/**
+ * @return 1 if the checksum algorithm in use is CRC32C, and combining CRC32Cs with
+ *         aux_crc32c_combine() is cheaper than computing them again, else 0
+ */
+int aux_crc32c_combining(void);
+
+/**
+ * Updates a CRC32C with a buffer. Pre- and post-inversion of the checksum are left out,
+ * so that the CRC32C of concatenated buffers can be combined from the CRC32Cs of the
+ * parts with aux_crc32c_combine(). Start with 0 for this.
+ * @param crc        the CRC32C of the preceding data
+ * @param buffer     the data
+ * @param length     the length of the data
+ * @return the updated CRC32C
+ */
+unsigned int aux_crc32c(unsigned int crc, const unsigned char *buffer, unsigned int length);
+
+/**
+ * @param length     a length in bytes (less than 65536)
+ * @return the operator for aux_crc32c_combine(), that shifts a CRC32C by length bytes
+ */
+unsigned int aux_crc32c_shift(unsigned int length);
+
+/**
+ * Computes the CRC32C of the concatenation of two buffers A and B
+ * @param crcA       the CRC32C of A
+ * @param crcB       the CRC32C of B, computed starting with 0
+ * @param shiftB     aux_crc32c_shift() of the length of B
+ * @return the CRC32C of A and B
+ */
+unsigned int aux_crc32c_combine(unsigned int crcA, unsigned int crcB, unsigned int shiftB);
+
 int set_checksum_algorithm(int algorithm);
 
 #endif
@@ -51,7 +51,7 @@
 
 void bu_init_bundling(void);
 gint bu_put_Ctrl_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index);
-gint bu_put_Data_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index);
+gint bu_put_Data_Chunk(chunk_data * chunk,unsigned int * dest_index);
 
 
 /*
@@ -148,6 +148,15 @@ gint bu_put_SACK_Chunk(SCTP_sack_chunk * chunk, unsigned int* dest_index);
  */
 gint bu_sendAllChunks(guint * ad_idx);
 
+
+/*
+ * bu_sendPadded: sends a control chunk in a packet of its own, filled up with
+ * a PAD chunk to a length of the chunks of length bytes.
+ *
+ * Return value: 0 if the packet was sent, -1 else
+ */
+gint bu_sendPadded(SCTP_simple_chunk * chunk, guint length, guint ad_idx);
+
 void bu_request_sack(void);
 
 #endif
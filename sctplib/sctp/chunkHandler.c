@@ -70,11 +70,11 @@
 /* Other constants */
 
 
-static unsigned short      writeCursor[MAX_CHUNKS];
-static SCTP_simple_chunk*  chunks[MAX_CHUNKS];
-static boolean             chunkCompleted[MAX_CHUNKS];
+static ENGINE_LOCAL unsigned short      writeCursor[MAX_CHUNKS];
+static ENGINE_LOCAL SCTP_simple_chunk*  chunks[MAX_CHUNKS];
+static ENGINE_LOCAL boolean             chunkCompleted[MAX_CHUNKS];
 
-static ChunkID freeChunkID = 0;
+static ENGINE_LOCAL ChunkID freeChunkID = 0;
 
 void ch_addUnrecognizedParameter(unsigned char* pos, ChunkID cid,
                                  unsigned short length, unsigned char* data);
@@ -1904,8 +1904,9 @@ boolean ch_goodCookie(ChunkID chunkID)
 
 /**
  * ch_makeHeartbeat creates a heartbeatchunk.
+ * @param probeSize  size of the packet, if the heartbeat probes the path MTU, else 0
  */
-ChunkID ch_makeHeartbeat(unsigned int sendingTime, unsigned int pathID)
+ChunkID ch_makeHeartbeat(unsigned int sendingTime, unsigned int pathID, unsigned int probeSize)
 {
 
     SCTP_heartbeat *heartbeatChunk;
@@ -1927,6 +1928,7 @@ ChunkID ch_makeHeartbeat(unsigned int sendingTime, unsigned int pathID)
     heartbeatChunk->HB_Info.param_length = htons(sizeof(SCTP_heartbeat) - 4);
     heartbeatChunk->pathID = htonl((unsigned int) pathID);
     heartbeatChunk->sendingTime = htonl(sendingTime);
+    heartbeatChunk->probeSize = htonl(probeSize);
 
     key =  key_operation(KEY_READ);
     if (key == NULL) abort();
@@ -2050,6 +2052,26 @@ unsigned int ch_HBpathID(ChunkID chunkID)
 
 
 
+/* ch_HBprobeSize reads the packet size of a heartbeat that probed the path MTU.
+*/
+unsigned int ch_HBprobeSize(ChunkID chunkID)
+{
+    if (chunks[chunkID] == NULL) {
+        error_log(ERROR_MAJOR, "Invalid chunk ID");
+        return 0;
+    }
+
+    if (chunks[chunkID]->chunk_header.chunk_id == CHUNK_HBREQ ||
+        chunks[chunkID]->chunk_header.chunk_id == CHUNK_HBACK) {
+        return ntohl(((SCTP_heartbeat *) chunks[chunkID])->probeSize);
+    } else {
+        error_log(ERROR_MINOR, "ch_HBprobeSize: chunk type not heartbeat or heartbeatAck");
+        return 0;
+    }
+}
+
+
+
 /***** create simple chunk **********************************************************************/
 
 /* ch_makeSimpleChunk creates a simple chunk. It can be used for parameterless chunks like
@@ -224,9 +224,10 @@ boolean ch_goodCookie(ChunkID chunkID);
 
 /****** create and read from heartbeat chunk ******************************************************/
 
-/* ch_makeHeartbeat creates a heartbeatchunk.
+/* ch_makeHeartbeat creates a heartbeatchunk, probeSize is the size of the packet
+   for a path MTU probe, else 0.
 */
-ChunkID ch_makeHeartbeat(unsigned int sendingTime, unsigned int pathID);
+ChunkID ch_makeHeartbeat(unsigned int sendingTime, unsigned int pathID, unsigned int probeSize);
 
 /**
  * ch_verifyHeartbeat checks the signature of the received heartbeat.
@@ -247,6 +248,12 @@ unsigned int ch_HBpathID(ChunkID chunkID);
 
 
 
+/* ch_HBprobeSize reads the packet size of a heartbeat that probed the path MTU.
+*/
+unsigned int ch_HBprobeSize(ChunkID chunkID);
+
+
+
 /***** create simple chunk **********************************************************************/
 
 /* ch_makeSimpleChunk creates a simple chunk. It can be used for parameterless chunks like
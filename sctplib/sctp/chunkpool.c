@@ -0,0 +1,340 @@
+/* $Id$
+ * --------------------------------------------------------------------------
+ *
+ *           //=====   //===== ===//=== //===//  //       //   //===//
+ *          //        //         //    //    // //       //   //    //
+ *         //====//  //         //    //===//  //       //   //===<<
+ *              //  //         //    //       //       //   //    //
+ *       ======//  //=====    //    //       //=====  //   //===//
+ *
+ * -------------- An SCTP implementation according to RFC 4960 --------------
+ *
+ * Copyright (C) 2000 by Siemens AG, Munich, Germany.
+ * Copyright (C) 2001-2004 Andreas Jungmaier
+ * Copyright (C) 2004-2017 Thomas Dreibholz
+ *
+ * Acknowledgements:
+ * Realized in co-operation between Siemens AG and the University of
+ * Duisburg-Essen, Institute for Experimental Mathematics, Computer
+ * Networking Technology group.
+ * This work was partially funded by the Bundesministerium fuer Bildung und
+ * Forschung (BMBF) of the Federal Republic of Germany
+ * (Förderkennzeichen 01AK045).
+ * The authors alone are responsible for the contents.
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact: sctp-discussion@sctp.de
+ *          dreibh@iem.uni-due.de
+ *          tuexen@fh-muenster.de
+ *          andreas.jungmaier@web.de
+ */
+
+
+#include "chunkpool.h"
+#include "sctp.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Chunks are carved from slabs of about CHUNK_SLAB_SIZE bytes, one list of slabs per
+ * size class, so that a small message does not occupy a chunk_data sized for the
+ * largest DATA chunk. Each chunk is preceded by a header, that points to its slab
+ * while the chunk is in use, and links it into the free list of the slab otherwise.
+ * A slab whose chunks are all free is given back to the system, unless it is the
+ * only empty slab of its class.
+ */
+#define CHUNK_SLAB_SIZE          32768
+#define CHUNK_SLAB_MIN_CHUNKS    8
+#define CHUNK_SPARE_SLABS        1
+
+#define CHUNK_ALIGN(size)        (((size) + 7) & ~((size_t)7))
+
+typedef union chunk_header_union
+{
+    /* the slab, while the chunk is in use */
+    struct chunk_slab_struct* slab;
+    /* the next free chunk of the slab, while the chunk is free */
+    union chunk_header_union* next;
+    adl_time align;
+} ChunkHeader;
+
+typedef struct chunk_class_struct
+{
+    /* the longest DATA chunk, including its header, that fits into this class */
+    unsigned int max_length;
+    /* size of a chunk with its header */
+    size_t chunk_size;
+    /* slabs that have at least one free chunk */
+    struct chunk_slab_struct* partial;
+    /* number of slabs without chunks in use */
+    unsigned int empty_slabs;
+} ChunkClass;
+
+typedef struct chunk_slab_struct
+{
+    struct chunk_slab_struct* prev;
+    struct chunk_slab_struct* next;
+    ChunkClass* size_class;
+    ChunkHeader* free_chunks;
+    unsigned int in_use;
+} ChunkSlab;
+
+#define CHUNK_SIZE(payload) \
+    CHUNK_ALIGN(sizeof(ChunkHeader) + offsetof(chunk_data, data) + FIXED_DATA_CHUNK_SIZE + (payload))
+
+#define CHUNK_CLASS(payload) \
+    { FIXED_DATA_CHUNK_SIZE + (payload), CHUNK_SIZE(payload), NULL, 0 }
+
+/* size classes by payload length: the largest DATA chunk at the default path MTU,
+   and the last one takes the largest DATA chunk of a jumbo frame */
+static ENGINE_LOCAL ChunkClass chunk_classes[] = {
+    CHUNK_CLASS(128),
+    CHUNK_CLASS(512),
+    CHUNK_CLASS(DEFAULT_SCTP_PDU - FIXED_DATA_CHUNK_SIZE),
+    CHUNK_CLASS(MAX_SCTP_PDU - FIXED_DATA_CHUNK_SIZE)
+};
+
+#define NUMBER_OF_CHUNK_CLASSES  (sizeof(chunk_classes) / sizeof(chunk_classes[0]))
+
+/* borrowed-buffer messages whose last chunk has been freed, in the order of completion */
+static ENGINE_LOCAL ChunkPayload* completed_first = NULL;
+static ENGINE_LOCAL ChunkPayload* completed_last  = NULL;
+
+
+static void cp_linkSlab(ChunkClass* sc, ChunkSlab* slab)
+{
+    slab->prev = NULL;
+    slab->next = sc->partial;
+    if (sc->partial != NULL) sc->partial->prev = slab;
+    sc->partial = slab;
+}
+
+
+static void cp_unlinkSlab(ChunkClass* sc, ChunkSlab* slab)
+{
+    if (slab->prev != NULL) slab->prev->next = slab->next;
+    else sc->partial = slab->next;
+    if (slab->next != NULL) slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
+
+
+/**
+ * allocates a new slab for a size class, and puts all its chunks into its free list
+ * @return the slab, or NULL if no memory is left
+ */
+static ChunkSlab* cp_newSlab(ChunkClass* sc)
+{
+    ChunkSlab* slab;
+    ChunkHeader* chunk;
+    unsigned char* first;
+    unsigned int count, i;
+
+    count = (unsigned int)(CHUNK_SLAB_SIZE / sc->chunk_size);
+    if (count < CHUNK_SLAB_MIN_CHUNKS) count = CHUNK_SLAB_MIN_CHUNKS;
+
+    slab = (ChunkSlab*)malloc(CHUNK_ALIGN(sizeof(ChunkSlab)) + count * sc->chunk_size);
+    if (slab == NULL) {
+        error_log(ERROR_MAJOR, "cp_newSlab: out of memory");
+        return NULL;
+    }
+    slab->size_class  = sc;
+    slab->in_use      = 0;
+    slab->free_chunks = NULL;
+    first = (unsigned char*)slab + CHUNK_ALIGN(sizeof(ChunkSlab));
+    for (i = count; i > 0; i--) {
+        chunk = (ChunkHeader*)(first + (i - 1) * sc->chunk_size);
+        chunk->next = slab->free_chunks;
+        slab->free_chunks = chunk;
+    }
+    cp_linkSlab(sc, slab);
+    sc->empty_slabs++;
+    event_logii(VERBOSE, "cp_newSlab: %u chunks of %u bytes", count, (unsigned int)sc->chunk_size);
+    return slab;
+}
+
+
+chunk_data* cp_allocChunk(unsigned int length)
+{
+    ChunkClass* sc;
+    ChunkSlab* slab;
+    ChunkHeader* chunk;
+    unsigned int i;
+
+    for (i = 0; i < NUMBER_OF_CHUNK_CLASSES; i++) {
+        if (length <= chunk_classes[i].max_length) break;
+    }
+    if (i == NUMBER_OF_CHUNK_CLASSES) {
+        error_logi(ERROR_MAJOR, "cp_allocChunk: chunk length %u too large", length);
+        return NULL;
+    }
+    sc = &chunk_classes[i];
+
+    slab = sc->partial;
+    if (slab == NULL) {
+        if ((slab = cp_newSlab(sc)) == NULL) return NULL;
+    }
+    chunk = slab->free_chunks;
+    slab->free_chunks = chunk->next;
+    if (slab->in_use++ == 0) sc->empty_slabs--;
+    if (slab->free_chunks == NULL) cp_unlinkSlab(sc, slab);
+
+    chunk->slab = slab;
+    ((chunk_data*)(chunk + 1))->payload = NULL;
+    ((chunk_data*)(chunk + 1))->references = 1;
+    return (chunk_data*)(chunk + 1);
+}
+
+
+/**
+ * gives back a reference to a payload, and queues the notification of the ULP when
+ * the last one is gone
+ */
+static void cp_releasePayload(ChunkPayload* payload)
+{
+    if (--payload->refcount > 0) return;
+
+    payload->next = NULL;
+    if (completed_last != NULL) completed_last->next = payload;
+    else completed_first = payload;
+    completed_last = payload;
+}
+
+
+void cp_freeChunk(chunk_data* chunk)
+{
+    ChunkHeader* header;
+    ChunkSlab* slab;
+    ChunkClass* sc;
+
+    if (chunk == NULL) return;
+    if (--chunk->references > 0) return;
+    if (chunk->payload != NULL) cp_releasePayload(chunk->payload);
+
+    header = ((ChunkHeader*)chunk) - 1;
+    slab = header->slab;
+    sc = slab->size_class;
+
+    if (slab->free_chunks == NULL) cp_linkSlab(sc, slab);
+    header->next = slab->free_chunks;
+    slab->free_chunks = header;
+
+    if (--slab->in_use == 0) {
+        if (sc->empty_slabs >= CHUNK_SPARE_SLABS) {
+            cp_unlinkSlab(sc, slab);
+            free(slab);
+        } else {
+            sc->empty_slabs++;
+        }
+    }
+}
+
+
+void cp_holdChunk(chunk_data* chunk)
+{
+    chunk->references++;
+}
+
+
+void cp_freeChunks(chunk_data** chunks, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++) cp_freeChunk(chunks[i]);
+}
+
+
+
+ChunkPayload* cp_newPayload(const SCTP_iovec* iov, unsigned int iovcnt,
+                            void (*completeNotif) (unsigned int, void*, void*),
+                            unsigned int assocId, void* context, void* ulpData)
+{
+    ChunkPayload* payload;
+
+    payload = (ChunkPayload*)malloc(sizeof(ChunkPayload) + iovcnt * sizeof(SCTP_iovec));
+    if (payload == NULL) {
+        error_log(ERROR_MAJOR, "cp_newPayload: out of memory");
+        return NULL;
+    }
+    payload->refcount      = 1;
+    payload->iovcnt        = iovcnt;
+    payload->iov           = (SCTP_iovec*)(payload + 1);
+    memcpy(payload->iov, iov, iovcnt * sizeof(SCTP_iovec));
+    payload->completeNotif = completeNotif;
+    payload->assocId       = assocId;
+    payload->context       = context;
+    payload->ulpData       = ulpData;
+    payload->next          = NULL;
+    return payload;
+}
+
+
+void cp_attachPayload(chunk_data* chunk, ChunkPayload* payload, unsigned int iov, unsigned int offset)
+{
+    payload->refcount++;
+    chunk->payload        = payload;
+    chunk->payload_iov    = iov;
+    chunk->payload_offset = offset;
+}
+
+
+void cp_endPayload(ChunkPayload* payload, gboolean queued)
+{
+    if ((!queued) && (payload->refcount == 1)) {
+        free(payload);
+        return;
+    }
+    cp_releasePayload(payload);
+}
+
+
+void cp_copyPayload(chunk_data* chunk, unsigned char* buffer)
+{
+    unsigned int length = chunk->chunk_len - FIXED_DATA_CHUNK_SIZE;
+    unsigned int i, offset, count;
+    const SCTP_iovec* iov;
+
+    if (chunk->payload == NULL) {
+        memcpy(buffer, &chunk->data[FIXED_DATA_CHUNK_SIZE], length);
+        return;
+    }
+    offset = chunk->payload_offset;
+    for (i = chunk->payload_iov; length > 0; i++) {
+        iov = &chunk->payload->iov[i];
+        count = iov->iov_len - offset;
+        if (count > length) count = length;
+        memcpy(buffer, (const unsigned char*)iov->iov_base + offset, count);
+        buffer += count;
+        length -= count;
+        offset = 0;
+    }
+}
+
+
+void cp_notifyPayloads(void)
+{
+    ChunkPayload* payload;
+
+    while ((payload = completed_first) != NULL) {
+        completed_first = payload->next;
+        if (completed_first == NULL) completed_last = NULL;
+        if (payload->completeNotif != NULL) {
+            (*payload->completeNotif)(payload->assocId, payload->context, payload->ulpData);
+        }
+        free(payload);
+    }
+}
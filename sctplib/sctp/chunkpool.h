@@ -0,0 +1,148 @@
+/* $Id$
+ * --------------------------------------------------------------------------
+ *
+ *           //=====   //===== ===//=== //===//  //       //   //===//
+ *          //        //         //    //    // //       //   //    //
+ *         //====//  //         //    //===//  //       //   //===<<
+ *              //  //         //    //       //       //   //    //
+ *       ======//  //=====    //    //       //=====  //   //===//
+ *
+ * -------------- An SCTP implementation according to RFC 4960 --------------
+ *
+ * Copyright (C) 2000 by Siemens AG, Munich, Germany.
+ * Copyright (C) 2001-2004 Andreas Jungmaier
+ * Copyright (C) 2004-2017 Thomas Dreibholz
+ *
+ * Acknowledgements:
+ * Realized in co-operation between Siemens AG and the University of
+ * Duisburg-Essen, Institute for Experimental Mathematics, Computer
+ * Networking Technology group.
+ * This work was partially funded by the Bundesministerium fuer Bildung und
+ * Forschung (BMBF) of the Federal Republic of Germany
+ * (Förderkennzeichen 01AK045).
+ * The authors alone are responsible for the contents.
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact: sctp-discussion@sctp.de
+ *          dreibh@iem.uni-due.de
+ *          tuexen@fh-muenster.de
+ *          andreas.jungmaier@web.de
+ */
+
+
+#ifndef CHUNKPOOL_H
+#define CHUNKPOOL_H
+
+#include "globals.h"
+#include "sctp.h"
+
+/**
+ * The payload of a message sent with sctp_sendv() from borrowed buffers. Its chunks
+ * refer to the buffers of the ULP instead of carrying a copy, which is made only when
+ * a chunk is bundled or handed back to the ULP. The payload holds one reference for
+ * each such chunk, and one for the sender until the message has been queued.
+ */
+typedef struct chunk_payload_struct
+{
+    unsigned int refcount;
+    unsigned int iovcnt;
+    /* the vector of the ULP, kept with the payload (the buffers stay with the ULP) */
+    SCTP_iovec* iov;
+    /* called once the last chunk of the message has been acked or abandoned */
+    void (*completeNotif) (unsigned int, void*, void*);
+    unsigned int assocId;
+    void* context;
+    void* ulpData;
+    /* the next payload in the list of completed payloads */
+    struct chunk_payload_struct* next;
+} ChunkPayload;
+
+/**
+ * Allocates a chunk_data structure from the pool, with room for a DATA chunk of the
+ * given length. The chunk comes from the smallest size class that fits it, so its
+ * data field must not be written beyond that length.
+ * @param  length   length of the DATA chunk, including the chunk header
+ * @return the chunk, or NULL if the length is too large or no memory is left
+ */
+chunk_data* cp_allocChunk(unsigned int length);
+
+/**
+ * Returns a chunk allocated with cp_allocChunk() to the pool, once every holder of
+ * the chunk has freed it
+ * @param  chunk    the chunk, may be NULL
+ */
+void cp_freeChunk(chunk_data* chunk);
+
+/**
+ * Takes another reference to a chunk, so that it stays valid until the holder calls
+ * cp_freeChunk() as well. Bundling holds the DATA chunks of a packet this way, which
+ * are sent from where they are kept, while they may be acked or abandoned meanwhile.
+ * @param  chunk    the chunk
+ */
+void cp_holdChunk(chunk_data* chunk);
+
+/**
+ * Returns a number of chunks allocated with cp_allocChunk() to the pool at once
+ * @param  chunks   array of the chunks
+ * @param  count    number of chunks in the array
+ */
+void cp_freeChunks(chunk_data** chunks, unsigned int count);
+
+/**
+ * Creates the payload of a message that is sent from borrowed buffers. The caller
+ * holds the first reference, and gives it back with cp_endPayload().
+ * @param  iov            the buffers of the message
+ * @param  iovcnt         number of buffers
+ * @param  completeNotif  callback of the ULP, may be NULL
+ * @param  assocId        association, context and ulpData are passed to completeNotif
+ * @return the payload, or NULL if no memory is left
+ */
+ChunkPayload* cp_newPayload(const SCTP_iovec* iov, unsigned int iovcnt,
+                            void (*completeNotif) (unsigned int, void*, void*),
+                            unsigned int assocId, void* context, void* ulpData);
+
+/**
+ * Lets a chunk refer to the payload, instead of carrying a copy of it
+ * @param  chunk    the chunk
+ * @param  payload  the payload
+ * @param  iov      index of the buffer, where the payload of the chunk starts
+ * @param  offset   offset of the payload of the chunk in that buffer
+ */
+void cp_attachPayload(chunk_data* chunk, ChunkPayload* payload, unsigned int iov, unsigned int offset);
+
+/**
+ * Gives back the reference of the sender of a payload. If the message could not be
+ * queued and no chunk refers to the payload, the payload is freed without calling
+ * the ULP, otherwise the ULP is called once the last chunk is freed.
+ * @param  payload  the payload
+ * @param  queued   TRUE if the message has been queued
+ */
+void cp_endPayload(ChunkPayload* payload, gboolean queued);
+
+/**
+ * Copies the payload of a DATA chunk, wherever it is kept
+ * @param  chunk    the chunk
+ * @param  buffer   where chunk_len - FIXED_DATA_CHUNK_SIZE bytes are written
+ */
+void cp_copyPayload(chunk_data* chunk, unsigned char* buffer);
+
+/**
+ * Calls the ULP for all borrowed-buffer messages that have been completed since the
+ * last call. The callbacks are collected while chunks are freed, and called from here,
+ * when the library is not working on the queues of an association.
+ */
+void cp_notifyPayloads(void);
+
+#endif
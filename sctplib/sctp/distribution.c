@@ -58,6 +58,9 @@
 
 #include  <sys/types.h>
 #include  <errno.h>
+#ifdef SCTP_ENGINE_PER_THREAD
+#include  <pthread.h>
+#endif
 #ifdef WIN32
 #include <winsock2.h>
 #else
@@ -74,13 +77,13 @@
 
 
 /*------------------------ Default Definitions --------------------------------------------------*/
-static int      myRWND                      = 0x7FFF;
-static union    sockunion *myAddressList    = NULL;
-static unsigned int myNumberOfAddresses     = 0;
-static gboolean sendAbortForOOTB            = TRUE;
-static int      checksumAlgorithm           = SCTP_CHECKSUM_ALGORITHM_CRC32C;
-static gboolean librarySupportsPRSCTP         = TRUE;
-static gboolean supportADDIP                = FALSE;
+static ENGINE_LOCAL int      myRWND                      = 0x7FFF;
+static ENGINE_LOCAL union    sockunion *myAddressList    = NULL;
+static ENGINE_LOCAL unsigned int myNumberOfAddresses     = 0;
+static ENGINE_LOCAL gboolean sendAbortForOOTB            = TRUE;
+static ENGINE_LOCAL int      checksumAlgorithm           = SCTP_CHECKSUM_ALGORITHM_CRC32C;
+static ENGINE_LOCAL gboolean librarySupportsPRSCTP       = TRUE;
+static ENGINE_LOCAL gboolean supportADDIP                = FALSE;
 /*------------------------Structure Definitions --------------------------------------------------*/
 
 /**
@@ -193,34 +196,124 @@ typedef struct ASSOCIATION
     /* and these values for our peer */
     gboolean    peerSupportsPRSCTP;
     gboolean    peerSupportsADDIP;
+    /** the element of AssociationList holding this association */
+    GList*      assocListEntry;
     /*@}*/
 } Association;
 
 
+/**
+ * Key of the index of associations by transport address: one remote address together
+ * with the remote and the local port. IPv4 addresses are stored like IPv4-compatible
+ * IPv6 addresses, so that keys are equal whenever adl_equal_address() finds the
+ * addresses equal.
+ */
+typedef struct TRANSPORT_KEY
+{
+    unsigned char  address[16];
+    unsigned short remotePort;
+    unsigned short localPort;
+} TransportKey;
+
+
+/**
+ * Entry of the index of associations by transport address
+ */
+typedef struct TRANSPORT_ENTRY
+{
+    TransportKey key;
+    /** the associations with the remote address and ports of the key, normally just one */
+    GList*       assocs;
+} TransportEntry;
+
+
+#ifndef WIN32
+/**
+ * A command that another thread has submitted to the command queue of an engine.
+ */
+typedef struct MDI_COMMAND
+{
+    /** the command submitted before */
+    struct MDI_COMMAND* next;
+    int            command;
+    unsigned int   associationID;
+    sctp_commandCallback completion;
+    void*          context;
+    /** for SCTP_COMMAND_SEND and SCTP_COMMAND_SET_PRIMARY */
+    short          path_id;
+    /** for SCTP_COMMAND_SEND, which carries a copy of the message */
+    unsigned short streamID;
+    unsigned int   protocolId;
+    unsigned int   lifetime;
+    int            unorderedDelivery;
+    int            dontBundle;
+    unsigned int   length;
+    unsigned char  data[1];
+} mdi_command;
+
+/**
+ * The commands are pushed onto a lock-free stack by any number of threads. The event loop
+ * thread takes the whole stack at once, and executes the commands in the order in which
+ * they have been submitted.
+ */
+struct SCTP_COMMAND_QUEUE
+{
+    /** the command submitted last */
+    mdi_command* head;
+    /** wakes up the event loop when the first command is pushed onto the empty stack */
+    int          wakeup_fd[2];
+};
+#endif
+
+
 /******************** Declarations ****************************************************************/
-static gboolean sctpLibraryInitialized = FALSE;
+static ENGINE_LOCAL gboolean sctpLibraryInitialized = FALSE;
+#ifdef SCTP_ENGINE_PER_THREAD
+/* the first sctp_initLibrary() of the process runs mdi_initProcess() */
+static pthread_once_t processInitialized = PTHREAD_ONCE_INIT;
+#endif
 /*
     Keyed list of SCTP-instances with the instanceName as key
 */
 /**
- * Keyed list of associations with the association-ID as key
+ * List of all associations, newest first. It is used for iterating over the
+ * associations, lookups by association-ID use AssociationTable.
+ */
+static ENGINE_LOCAL GList* AssociationList = NULL;
+
+/**
+ * Index of all associations (including those marked "deleted"), with the
+ * association-ID as key
  */
-static GList* AssociationList = NULL;
+static ENGINE_LOCAL GHashTable* AssociationTable = NULL;
+
+/**
+ * Index of associations by transport address, used for demultiplexing received packets.
+ * Maps a TransportKey to a TransportEntry, and has an entry for each destination address
+ * of each association.
+ */
+static ENGINE_LOCAL GHashTable* TransportTable = NULL;
+
+/**
+ * Index of associations by local tag, i.e. by the verification tag of the packets
+ * they receive. Only the first association with a certain tag is entered.
+ */
+static ENGINE_LOCAL GHashTable* TagTable = NULL;
 
 /**
  * Whenever an external event (ULP-call, socket-event or timer-event) this variable must
  * contain the addressed sctp instance.
  * This pointer must be reset to null after the event  has been handled.
  */
-static SCTP_instance *sctpInstance;
+static ENGINE_LOCAL SCTP_instance *sctpInstance;
 
 /**
  * Keyed list of SCTP instances with the instance name as key
  */
-static GList* InstanceList = NULL;
-static unsigned int ipv4_users = 0;
+static ENGINE_LOCAL GList* InstanceList = NULL;
+static ENGINE_LOCAL unsigned int ipv4_users = 0;
 #ifdef HAVE_IPV6
-    static unsigned int ipv6_users = 0;
+    static ENGINE_LOCAL unsigned int ipv6_users = 0;
 #endif
 /**
  * Whenever an external event (ULP-call, socket-event or timer-event) this variable must
@@ -228,46 +321,60 @@ static unsigned int ipv4_users = 0;
  * Read functions for 'global data' read data from the association pointed to by this pointer.
  * This pointer must be reset to null after the event  has been handled.
  */
-static Association *currentAssociation;
-static Association tmpAssoc;
-static union sockunion tmpAddress;
+static ENGINE_LOCAL Association *currentAssociation;
 
 
 /* If firstSCTP_instance is true, a seed is generated by
    use of (current time). After the first SCTP-instance was created, firstSCTP_instance
    is set to false.
 */
-static unsigned short lastSCTP_instanceName = 1;
+static ENGINE_LOCAL unsigned short lastSCTP_instanceName = 1;
 /*
    AssociationIDs are counted up, and if a new one is needed, they are checked for wraps
  */
-static unsigned int nextAssocId = 1;
+static ENGINE_LOCAL unsigned int nextAssocId = 1;
 
 /**
    initAck is sent to this address
    In this case, SCTP-control reads this address on reception of the cookie echo
    (which consequently also does not contain an addresslist) to initialize the new association.
  */
-static union sockunion *lastFromAddress;
-static union sockunion *lastDestAddress;
+static ENGINE_LOCAL union sockunion *lastFromAddress;
+static ENGINE_LOCAL union sockunion *lastDestAddress;
 
-static short lastFromPath;
-static unsigned short lastFromPort;
-static unsigned short lastDestPort;
-static unsigned int lastInitiateTag;
+static ENGINE_LOCAL short lastFromPath;
+static ENGINE_LOCAL unsigned short lastFromPort;
+static ENGINE_LOCAL unsigned short lastDestPort;
+static ENGINE_LOCAL unsigned int lastInitiateTag;
 
 /**
   Descriptor of socket used by all associations and SCTP-instances.
  */
-static gint sctp_socket;
+static ENGINE_LOCAL gint sctp_socket;
 
 #ifdef HAVE_IPV6
-static gint ipv6_sctp_socket;
+static ENGINE_LOCAL gint ipv6_sctp_socket;
 #endif
 
 /* port management array */
-static unsigned char portsSeized[0x10000];
-static unsigned int numberOfSeizedPorts;
+static ENGINE_LOCAL unsigned char portsSeized[0x10000];
+static ENGINE_LOCAL unsigned int numberOfSeizedPorts;
+
+#ifdef SCTP_ENGINE_PER_THREAD
+/*
+ * the ports of all engines of the process: each raw socket receives the packets of all
+ * ports, so an engine must not use a port of another one. Only shards, that get their
+ * packets from the receive dispatcher, may register instances on the same port.
+ * Holds the number of shards using a port, or PORT_EXCLUSIVE.
+ */
+#define PORT_EXCLUSIVE          0xFF
+static unsigned char portUsers[0x10000];
+#endif
+
+#ifndef WIN32
+/* the command queue of this engine, created by sctp_getCommandQueue() */
+static ENGINE_LOCAL SCTP_CommandQueue* commandQueue = NULL;
+#endif
 
 
 /* ---------------------- Internal Function Prototypes ------------------------------------------- */
@@ -383,128 +490,147 @@ SCTP_instance* retrieveInstance(unsigned short instance_name)
 
 
 /**
- *  compareAssociationIDs compares the association ID's of two associations and returns 0
- *  if they are equal. This is a call back function called by List Functions whenever two
- *  association need to be compared.
- *  @param a  pointer to association struct 1
- *  @param b  pointer to association struct 2
- *  @return    0 if a->assocId equals b->assocId, 1 if bigger, -1 if smaller
+ *  fills in the index key for a remote address and the ports of an association
+ *  @param key          the key to fill in
+ *  @param address      the remote address
+ *  @param remotePort   the remote port
+ *  @param localPort    the local port
  */
-gint compareAssociationIDs(gconstpointer a, gconstpointer b)
+static void makeTransportKey(TransportKey* key, union sockunion* address,
+                             unsigned short remotePort, unsigned short localPort)
 {
-    /* two associations are equal if there local tags (in this implementation also used as
-       association ID) are equal. */
-    if (((Association*)a)->assocId == ((Association*)b)->assocId)
-        return 0;
-    else if (((Association*)a)->assocId < ((Association*)b)->assocId)
-        return -1;
-    else
-        return 1;
+    memset(key, 0, sizeof(TransportKey));
+    switch (sockunion_family(address)) {
+    case AF_INET:
+        memcpy(&key->address[12], &(address->sin.sin_addr.s_addr), 4);
+        break;
+#ifdef HAVE_IPV6
+    case AF_INET6:
+        memcpy(key->address, sock2ip6(address), 16);
+        break;
+#endif
+    default:
+        error_logi(ERROR_MAJOR, "makeTransportKey: Unsupported Address Type %d",
+                   sockunion_family(address));
+        break;
+    }
+    key->remotePort = remotePort;
+    key->localPort = localPort;
 }
 
 
+static guint hashTransportKey(gconstpointer a)
+{
+    const unsigned char* byte = (const unsigned char*)a;
+    guint hash = 2166136261U;
+    unsigned int i;
 
-/**
- *  equalAssociations compares two associations and returns 0 if they are equal. In contrast to
- *  function compareAssociationIDs, equal here means the two associations belong to the same
- *  SCTP-instance and have at least one destinationaddress in common.
- *  This is a call back function called by GList-functions whenever two association need to be compared.
- *  @param i1  association data 1
- *  @param i2  association data 2
- *  @return 0 if il1 and il2 are equal according to above definition, 1 else
- */
-gint equalAssociations(gconstpointer a, gconstpointer b)
+    /* FNV-1a */
+    for (i = 0; i < sizeof(TransportKey); i++) {
+        hash = (hash ^ byte[i]) * 16777619U;
+    }
+    return hash;
+}
+
+
+static gboolean equalTransportKeys(gconstpointer a, gconstpointer b)
 {
-    int i,j;
+    return (memcmp(a, b, sizeof(TransportKey)) == 0);
+}
 
-    event_logii(VVERBOSE, "equalAssociations: checking assoc A[id=%d] and assoc B[id=%d]",
-        ((Association*)a)->assocId,((Association*)b)->assocId);
 
-    /* two associations are equal if their remote and local ports are equal and at least
-       one of their remote addresses are equal. This is like in TCP, where a connection
-       is identified by the transport address, i.e. the IP-address and port of the peer. */
+/**
+ *  enters an association into the indices used for demultiplexing received packets,
+ *  i.e. with each of its destination addresses, and with its local tag
+ *  @param assoc    the association
+ */
+static void indexAssociation(Association* assoc)
+{
+    TransportKey key;
+    TransportEntry* entry;
+    int i;
+
+    for (i = 0; i < assoc->noOfNetworks; i++) {
+        makeTransportKey(&key, &(assoc->destinationAddresses[i]), assoc->remotePort, assoc->localPort);
+        entry = (TransportEntry*)g_hash_table_lookup(TransportTable, &key);
+        if (entry == NULL) {
+            entry = (TransportEntry*)malloc(sizeof(TransportEntry));
+            if (entry == NULL) error_log_sys(ERROR_FATAL, (short)errno);
+            memcpy(&entry->key, &key, sizeof(TransportKey));
+            entry->assocs = NULL;
+            g_hash_table_insert(TransportTable, &entry->key, entry);
+        }
+        if (g_list_find(entry->assocs, assoc) == NULL) {
+            entry->assocs = g_list_append(entry->assocs, assoc);
+        }
+    }
+    if (g_hash_table_lookup(TagTable, GUINT_TO_POINTER(assoc->tagLocal)) == NULL) {
+        g_hash_table_insert(TagTable, GUINT_TO_POINTER(assoc->tagLocal), assoc);
+    }
+}
 
-    if ( (((Association *)a)->remotePort == ((Association *)b)->remotePort) &&
-         (((Association *)a)->localPort == ((Association *)b)->localPort) ){
-        for (i = 0; i < ((Association *)a)->noOfNetworks; i++)
-            for (j = 0; j < ((Association *)b)->noOfNetworks; j++) {
-                event_logii(VVERBOSE, "equalAssociations: checking address A[%d] address B[%d]",i,j);
-                if (adl_equal_address
-                    (&(((Association *)a)->destinationAddresses[i]),
-                     &(((Association *)b)->destinationAddresses[j])) == TRUE) {
-                    if ( (((Association *)b)->deleted == FALSE) && (((Association *)a)->deleted == FALSE)) {
-                        event_log(VVERBOSE, "equalAssociations: found TWO equal assocs !");
-                        return 0;
-                    } else {
-                        event_log(VVERBOSE, "equalAssociations: found NO equal assocs !");
-                        return 1;
-                    }
-                }
-            }
-       event_log(VVERBOSE, "equalAssociations: found NO equal assocs !");
-       return 1;
+
+/**
+ *  removes an association from the indices used for demultiplexing received packets
+ *  @param assoc    the association
+ */
+static void unindexAssociation(Association* assoc)
+{
+    TransportKey key;
+    TransportEntry* entry;
+    int i;
+
+    for (i = 0; i < assoc->noOfNetworks; i++) {
+        makeTransportKey(&key, &(assoc->destinationAddresses[i]), assoc->remotePort, assoc->localPort);
+        entry = (TransportEntry*)g_hash_table_lookup(TransportTable, &key);
+        if (entry == NULL) continue;
+        entry->assocs = g_list_remove(entry->assocs, assoc);
+        if (entry->assocs == NULL) {
+            /* frees the entry */
+            g_hash_table_remove(TransportTable, &key);
+        }
+    }
+    if (g_hash_table_lookup(TagTable, GUINT_TO_POINTER(assoc->tagLocal)) == assoc) {
+        g_hash_table_remove(TagTable, GUINT_TO_POINTER(assoc->tagLocal));
     }
-    event_log(VVERBOSE, "equalAssociations: found NO equal assocs !");
-    return 1;
 }
 
 
 /**
- * retrieveAssociation retrieves a association from the list using the id as key.
- * Returns NULL also if the association is marked "deleted" !
+ * retrieveAssociationForced retrieves an association from the list using
+ * assoc id as key. Returns also associations marked "deleted" !
  * @param assocID  association ID
  * @return  pointer to the retrieved association, or NULL
  */
-Association *retrieveAssociation(unsigned int assocID)
+Association *retrieveAssociationForced(unsigned int assocID)
 {
-    Association *assoc;
-    Association *assocFindP;
-    GList* result = NULL;
+    Association *assoc = NULL;
 
-    event_logi(INTERNAL_EVENT_0, "retrieving association %08x from list", assocID);
-
-    tmpAssoc.assocId = assocID;
-    tmpAssoc.deleted = FALSE;
-    assocFindP = &tmpAssoc;
-    assoc = NULL;
-
-    result = g_list_find_custom(AssociationList, assocFindP, &compareAssociationIDs);
-    if (result != NULL) {
-
-        assoc = (Association *)result->data;
+    event_logi(INTERNAL_EVENT_0, "forced retrieval of association %08x from list", assocID);
 
-        if (assoc->deleted) {
-            assoc = NULL;
-        }
-    } else {
+    if (AssociationTable != NULL) {
+        assoc = (Association *)g_hash_table_lookup(AssociationTable, GUINT_TO_POINTER(assocID));
+    }
+    if (assoc == NULL) {
         event_logi(INTERNAL_EVENT_0, "association %08x not in list", assocID);
-        assoc = NULL;
     }
     return assoc;
 }
 
 /**
- * retrieveAssociationForced retrieves an association from the list using
- * assoc id as key. Returns also associations marked "deleted" !
+ * retrieveAssociation retrieves a association from the list using the id as key.
+ * Returns NULL also if the association is marked "deleted" !
  * @param assocID  association ID
  * @return  pointer to the retrieved association, or NULL
  */
-Association *retrieveAssociationForced(unsigned int assocID)
+Association *retrieveAssociation(unsigned int assocID)
 {
     Association *assoc;
-    Association *assocFindP;
-    GList* result = NULL;
 
-    event_logi(INTERNAL_EVENT_0, "forced retrieval of association %08x from list", assocID);
+    event_logi(INTERNAL_EVENT_0, "retrieving association %08x from list", assocID);
 
-    tmpAssoc.assocId = assocID;
-    assocFindP = &tmpAssoc;
-    assoc = NULL;
-    result = g_list_find_custom(AssociationList, assocFindP, &compareAssociationIDs);
-    if (result != NULL) {
-       assoc = (Association *)result->data;
-    } else {
-        event_logi(INTERNAL_EVENT_0, "association %08x not in list", assocID);
+    assoc = retrieveAssociationForced(assocID);
+    if ((assoc != NULL) && (assoc->deleted)) {
         assoc = NULL;
     }
     return assoc;
@@ -525,61 +651,61 @@ Association *retrieveAssociationByTransportAddress(union sockunion * fromAddress
                                                    unsigned short fromPort,
                                                    unsigned short toPort)
 {
-
+    TransportKey key;
+    TransportEntry* entry;
+    GList* assocs;
     Association *assocr;
-    Association *assocp;
-    GList* result = NULL;
 
-    tmpAssoc.noOfNetworks = 1;
-    tmpAssoc.destinationAddresses = &tmpAddress;
-
-    switch (sockunion_family(fromAddress)) {
-    case AF_INET:
-        event_logi(INTERNAL_EVENT_0,
-                   "Looking for IPv4 Address %x (in NBO)", sock2ip(fromAddress));
-        tmpAssoc.destinationAddresses[0].sa.sa_family = AF_INET;
-        tmpAssoc.destinationAddresses[0].sin.sin_addr.s_addr = sock2ip(fromAddress);
-        tmpAssoc.remotePort = fromPort;
-        tmpAssoc.localPort = toPort;
-        tmpAssoc.deleted = FALSE;
-        break;
-#ifdef HAVE_IPV6
-    case AF_INET6:
-        tmpAssoc.destinationAddresses[0].sa.sa_family = AF_INET6;
-        memcpy(&(tmpAssoc.destinationAddresses[0].sin6.sin6_addr.s6_addr),
-               (sock2ip6(fromAddress)), sizeof(struct in6_addr));
-        event_logi(INTERNAL_EVENT_0, "Looking for IPv6 Address %x, check NTOHX() ! ",
-                    tmpAssoc.destinationAddresses[0].sin6.sin6_addr.s6_addr);
-        tmpAssoc.remotePort = fromPort;
-        tmpAssoc.localPort = toPort;
-        tmpAssoc.deleted = FALSE;
-        break;
-#endif
-    default:
-        error_logi(ERROR_FATAL,
-                   "Unsupported Address Type %d in retrieveAssociationByTransportAddress()",
-                   sockunion_family(fromAddress));
-        break;
+    event_log(INTERNAL_EVENT_0, "retrieving association by transport address from list");
 
+    makeTransportKey(&key, fromAddress, fromPort, toPort);
+    entry = (TransportEntry*)g_hash_table_lookup(TransportTable, &key);
+    for (assocs = (entry != NULL) ? entry->assocs : NULL; assocs != NULL; assocs = g_list_next(assocs)) {
+        assocr = (Association *)assocs->data;
+        if (assocr->deleted) {
+            event_logi(VERBOSE, "Found assoc that should be deleted, with id %u",assocr->assocId);
+            continue;
+        }
+        event_logi(VERBOSE, "Found valid assoc assoc with id %u",assocr->assocId);
+        return assocr;
     }
+    event_log(INTERNAL_EVENT_0, "association indexed by transport address not in list");
+    return NULL;
+}
 
-    assocp = &tmpAssoc;
 
-    event_log(INTERNAL_EVENT_0, "retrieving association by transport address from list");
+/**
+ *   retrieveAssociationByTag retrieves an association using the verification tag of a received
+ *   packet, which is the local tag of the association, as key. The ports and the source address
+ *   of the packet must belong to the association as well. Returns NULL also if the association
+ *   is marked "deleted" !
+ *
+ *   @param  tag         verification tag of the packet
+ *   @param  fromAddress address from which data arrived
+ *   @param  fromPort    SCTP port from which data arrived
+ *   @param  toPort      SCTP port to which data was sent
+ *   @return pointer to the retrieved association, or NULL
+ */
+static Association *retrieveAssociationByTag(unsigned int tag,
+                                             union sockunion * fromAddress,
+                                             unsigned short fromPort,
+                                             unsigned short toPort)
+{
+    Association *assoc;
+    int i;
 
-    result = g_list_find_custom(AssociationList, assocp, equalAssociations);
+    if (tag == 0) return NULL;
 
-    if (result != NULL){
-        assocr = (Association *)result->data;
-        if (assocr->deleted) {
-            event_logi(VERBOSE, "Found assoc that should be deleted, with id %u",assocr->assocId);
-            assocr= NULL;
+    assoc = (Association *)g_hash_table_lookup(TagTable, GUINT_TO_POINTER(tag));
+    if ((assoc == NULL) || (assoc->deleted) ||
+        (assoc->remotePort != fromPort) || (assoc->localPort != toPort)) {
+        return NULL;
+    }
+    for (i = 0; i < assoc->noOfNetworks; i++) {
+        if (adl_equal_address(&(assoc->destinationAddresses[i]), fromAddress) == TRUE) {
+            event_logi(VERBOSE, "Found assoc with id %u by its tag", assoc->assocId);
+            return assoc;
         }
-        if (assocr != NULL)
-            event_logi(VERBOSE, "Found valid assoc assoc with id %u",assocr->assocId);
-        return assocr;
-    } else {
-        event_log(INTERNAL_EVENT_0, "association indexed by transport address not in list");
     }
     return NULL;
 }
@@ -587,35 +713,64 @@ Association *retrieveAssociationByTransportAddress(union sockunion * fromAddress
 
 
 /**
- *  checkForExistingAssociations checks wether a given association is already in the list using
- *  the equality condition given by function equalAssociations.
- *  TODO : this must still be implemented. Where is it used ??????????????
+ *  checkForExistingAssociations checks wether a given association is already in the list,
+ *  i.e. whether an association that is not marked "deleted" has the same ports and at least
+ *  one destination address in common with it.
  *
  *  @param assoc_new the association to be compared with the association in the list.
  *  @return      1 if was association found, else  0
  */
 static short checkForExistingAssociations(Association * assoc_new)
 {
-    GList* result = NULL;
-
-    if (AssociationList == NULL) {
-        event_logi(VERBOSE, "checkForExistingAssociations(new_assoc = %u) AssocList not set",
-            assoc_new->assocId);
+    int i;
 
-        return 0;
+    for (i = 0; i < assoc_new->noOfNetworks; i++) {
+        /* then one of addresses of assoc A was in set of addresses of B */
+        if (retrieveAssociationByTransportAddress(&(assoc_new->destinationAddresses[i]),
+                                                  assoc_new->remotePort, assoc_new->localPort) != NULL)
+            return 1;
     }
+    return 0;
+}
 
-    result = g_list_find_custom(AssociationList, assoc_new, equalAssociations);
 
-    if (result) /* then one of addresses of assoc A was in set of addresses of B */
-        return 1;
-    else
-        return 0;
+
+/*------------------- Internal port management Functions -----------------------------------------*/
+
+#ifdef SCTP_ENGINE_PER_THREAD
+/**
+ * takeProcessPort marks a port as used in the port table of the process.
+ * @param port      the port
+ * @param shared    TRUE if other shards may use the port, too
+ * @return TRUE if the port was taken, FALSE if another engine uses it
+ */
+static gboolean takeProcessPort(unsigned short port, gboolean shared)
+{
+    unsigned char users = __atomic_load_n(&portUsers[port], __ATOMIC_RELAXED);
+
+    do {
+        if (users >= PORT_EXCLUSIVE - 1 || (users != 0 && !shared)) return FALSE;
+    } while (!__atomic_compare_exchange_n(&portUsers[port], &users,
+                                          (unsigned char)(shared ? users + 1 : PORT_EXCLUSIVE),
+                                          TRUE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    return TRUE;
 }
 
 
+/**
+ * giveBackProcessPort drops the use of a port from the port table of the process.
+ * @param port      the port
+ */
+static void giveBackProcessPort(unsigned short port)
+{
+    unsigned char users = __atomic_load_n(&portUsers[port], __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(&portUsers[port], &users,
+                                        (unsigned char)((users == PORT_EXCLUSIVE) ? 0 : users - 1),
+                                        TRUE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+}
+#endif
 
-/*------------------- Internal port management Functions -----------------------------------------*/
 
 /**
  * allocatePort Allocate a given port.
@@ -624,6 +779,9 @@ static short checkForExistingAssociations(Association * assoc_new)
 static unsigned short allocatePort(unsigned short port)
 {
    if(portsSeized[port] == 0) {
+#ifdef SCTP_ENGINE_PER_THREAD
+      if (!takeProcessPort(port, (adl_getShard() >= 0))) return(0);
+#endif
       portsSeized[port] = 1;
       numberOfSeizedPorts++;
       return(port);
@@ -639,6 +797,9 @@ static unsigned short allocatePort(unsigned short port)
 static unsigned short seizePort(void)
 {
     unsigned short seizePort = 0;
+#ifdef SCTP_ENGINE_PER_THREAD
+    unsigned int tries = 0;
+#endif
 
     /* problem: no more available ports ?! */
     if (numberOfSeizedPorts >= 0xFBFF)
@@ -646,9 +807,17 @@ static unsigned short seizePort(void)
 
     seizePort = (unsigned short)(adl_random() % 0xFFFF);
 
+#ifdef SCTP_ENGINE_PER_THREAD
+    /* the ports of the other engines are not counted here, so give up at some point */
+    while (portsSeized[seizePort] || seizePort < 0x0400 || !takeProcessPort(seizePort, FALSE)) {
+        if (++tries == 0x10000) return 0x0000;
+        seizePort = (unsigned short)(adl_random() % 0xFFFF);
+    }
+#else
     while (portsSeized[seizePort] || seizePort < 0x0400) {
         seizePort = (unsigned short)(adl_random() % 0xFFFF);
     }
+#endif
 
     numberOfSeizedPorts++;
     portsSeized[seizePort] = 1;
@@ -670,6 +839,9 @@ static void releasePort(unsigned short portSeized)
 
     numberOfSeizedPorts--;
     portsSeized[portSeized] = 0;
+#ifdef SCTP_ENGINE_PER_THREAD
+    giveBackProcessPort(portSeized);
+#endif
 }
 
 
@@ -953,12 +1125,15 @@ mdi_receiveMessage(gint socket_fd,
         error_log(ERROR_FATAL, "mdi_receiveMessage: Unsupported AddressType Received !");
         discard = TRUE;
     }
-    adl_sockunion2str(source_addr, source_addr_string, SCTP_MAX_IP_LEN);
-    adl_sockunion2str(dest_addr, dest_addr_string, SCTP_MAX_IP_LEN);
+    /* the address strings are only needed for logging */
+    if (Current_event_log_ >= EXTERNAL_EVENT) {
+        adl_sockunion2str(source_addr, source_addr_string, SCTP_MAX_IP_LEN);
+        adl_sockunion2str(dest_addr, dest_addr_string, SCTP_MAX_IP_LEN);
 
-    event_logiiiii(EXTERNAL_EVENT,
-                  "mdi_receiveMessage : len %d, sourceaddress : %s, src_port %u,dest: %s, dest_port %u",
-                  bufferLength, source_addr_string, lastFromPort, dest_addr_string,lastDestPort);
+        event_logiiiii(EXTERNAL_EVENT,
+                      "mdi_receiveMessage : len %d, sourceaddress : %s, src_port %u,dest: %s, dest_port %u",
+                      bufferLength, source_addr_string, lastFromPort, dest_addr_string,lastDestPort);
+    }
 
     if (discard == TRUE) {
         lastFromAddress = NULL;
@@ -973,8 +1148,12 @@ mdi_receiveMessage(gint socket_fd,
     }
 
 
-    /* Retrieve association from list  */
-    currentAssociation = retrieveAssociationByTransportAddress(lastFromAddress, lastFromPort,lastDestPort);
+    /* Retrieve association from list, first by the verification tag, then by the transport address */
+    currentAssociation = retrieveAssociationByTag(ntohl(message->common_header.verification_tag),
+                                                  lastFromAddress, lastFromPort, lastDestPort);
+    if (currentAssociation == NULL) {
+        currentAssociation = retrieveAssociationByTransportAddress(lastFromAddress, lastFromPort, lastDestPort);
+    }
 
     if (currentAssociation != NULL) {
         /* meaning we MUST have an instance with no fixed port */
@@ -1445,6 +1624,18 @@ unsigned int sctp_getLibraryVersion(void)
     return (unsigned int)(SCTP_MAJOR_VERSION << 16 | SCTP_MINOR_VERSION);
 }
 
+/**
+ * sets up what all engines of the process share: the trace levels, the random number
+ * generator and the tables of the CRC32C engines
+ */
+static void mdi_initProcess(void)
+{
+    read_tracelevels();
+    adl_init_random();
+    set_checksum_algorithm(SCTP_CHECKSUM_ALGORITHM_CRC32C);
+}
+
+
 /**
  * Function that needs to be called in advance to all library calls.
  * It initializes all file descriptors etc. and sets up some variables
@@ -1460,7 +1651,11 @@ int sctp_initLibrary(void)
         LEAVE_LIBRARY("sctp_initLibrary");
         return SCTP_LIBRARY_ALREADY_INITIALIZED;
     }
-    read_tracelevels();
+#ifdef SCTP_ENGINE_PER_THREAD
+    pthread_once(&processInitialized, &mdi_initProcess);
+#else
+    mdi_initProcess();
+#endif
 
 #if defined(HAVE_GETEUID)
     /* check privileges. Must be root or setuid-root for now ! */
@@ -1480,7 +1675,10 @@ int sctp_initLibrary(void)
         return SCTP_SPECIFIC_FUNCTION_ERROR;
     }
 
-    /* Create list for associations - old, used to be here - now removed ! */
+    /* the association list itself needs no initialization, but its index does */
+    AssociationTable = g_hash_table_new(g_direct_hash, g_direct_equal);
+    TransportTable = g_hash_table_new_full(hashTransportKey, equalTransportKeys, NULL, free);
+    TagTable = g_hash_table_new(g_direct_hash, g_direct_equal);
 
     /* initialize ports seized -- see comments above !!! */
     for (i = 0; i < 0x10000; i++) portsSeized[i] = 0;
@@ -1492,6 +1690,7 @@ int sctp_initLibrary(void)
 
     /* this block is to be executed only once for the lifetime of sctp-software */
     key_operation(KEY_INIT);
+    set_checksum_algorithm(checksumAlgorithm);
 
     /* we might need to replace this socket !*/
     sfd = adl_get_sctpv4_socket();
@@ -1507,6 +1706,79 @@ int sctp_initLibrary(void)
 }
 
 
+/**
+ * Runs the engine of the calling thread as the receive dispatcher of sharded engines
+ */
+int sctp_initShards(unsigned int numberOfShards)
+{
+#ifdef SCTP_ENGINE_PER_THREAD
+    int result;
+    gint sfd;
+
+    if (sctpLibraryInitialized == TRUE) return SCTP_LIBRARY_ALREADY_INITIALIZED;
+    if (adl_initDispatcher(numberOfShards) < 0) return SCTP_PARAMETER_PROBLEM;
+
+    result = sctp_initLibrary();
+    if (result != SCTP_SUCCESS) {
+        adl_exitDispatcher();
+        return result;
+    }
+
+    ENTER_LIBRARY("sctp_initShards");
+    /* the dispatcher reads the SCTP sockets for all shards */
+    sfd = adl_get_sctpv4_socket();
+    if (!adl_register_socket_cb(sfd, &mdi_dummy_callback))
+        error_log(ERROR_FATAL, "registration of IPv4 socket call back function failed");
+#ifdef HAVE_IPV6
+    sfd = adl_get_sctpv6_socket();
+    if ((sfd >= 0) && !adl_register_socket_cb(sfd, &mdi_dummy_callback))
+        error_log(ERROR_FATAL, "register ipv6 socket call back function failed");
+#endif
+    LEAVE_LIBRARY("sctp_initShards");
+    return SCTP_SUCCESS;
+#else
+    return SCTP_NOT_SUPPORTED;
+#endif
+}
+
+
+/**
+ * Runs the engine of the calling thread as one of the shards
+ */
+int sctp_initShard(unsigned int shard)
+{
+#ifdef SCTP_ENGINE_PER_THREAD
+    if (sctpLibraryInitialized == TRUE) return SCTP_LIBRARY_ALREADY_INITIALIZED;
+    if (adl_getShardCount() == 0) return SCTP_LIBRARY_NOT_INITIALIZED;
+    if (adl_initShard(shard) < 0) return SCTP_PARAMETER_PROBLEM;
+
+    return sctp_initLibrary();
+#else
+    return SCTP_NOT_SUPPORTED;
+#endif
+}
+
+
+int sctp_getShardOfAssociation(unsigned int associationID)
+{
+    if (adl_getShardCount() == 0) return SCTP_LIBRARY_NOT_INITIALIZED;
+    if (associationID == 0) return SCTP_PARAMETER_PROBLEM;
+
+    return (int)(associationID % adl_getShardCount());
+}
+
+
+int sctp_getShardOfPeer(unsigned char address[SCTP_MAX_IP_LEN], unsigned short port)
+{
+    union sockunion su;
+
+    if (adl_getShardCount() == 0) return SCTP_LIBRARY_NOT_INITIALIZED;
+    if (adl_str2sockunion(address, &su) < 0) return SCTP_PARAMETER_PROBLEM;
+
+    return adl_getShardOfPeer(&su, port);
+}
+
+
 int mdi_updateMyAddressList(void)
 {
     int sfd;
@@ -2017,35 +2289,30 @@ int sctp_unregisterInstance(unsigned short instance_name)
  */
 int sctp_deleteAssociation(unsigned int associationID)
 {
-    Association *assocFindP;
-    GList* result = NULL;
-
     ENTER_LIBRARY("sctp_deleteAssociation");
 
     CHECK_LIBRARY;
 
     event_logi(INTERNAL_EVENT_0, "sctp_deleteAssociation: getting assoc %08x from list", associationID);
 
-    tmpAssoc.assocId = associationID;
-    tmpAssoc.deleted = FALSE;
-    assocFindP = &tmpAssoc;
-    currentAssociation = NULL;
-
-    result = g_list_find_custom(AssociationList, assocFindP, &compareAssociationIDs);
-    if (result != NULL) {
-        currentAssociation = (Association *)result->data;
+    currentAssociation = retrieveAssociationForced(associationID);
+    if (currentAssociation != NULL) {
         if (!currentAssociation->deleted) {
             currentAssociation = NULL;
             error_log(ERROR_MAJOR, "Deleted-Flag not set, returning from sctp_deleteAssociation !");
             LEAVE_LIBRARY("sctp_deleteAssociation");
             return SCTP_SPECIFIC_FUNCTION_ERROR;
         }
-        /* remove the association from the list */
-        AssociationList = g_list_remove(AssociationList, currentAssociation);
+        /* remove the association from the list and the index */
+        AssociationList = g_list_delete_link(AssociationList, currentAssociation->assocListEntry);
+        g_hash_table_remove(AssociationTable, GUINT_TO_POINTER(associationID));
+        unindexAssociation(currentAssociation);
         event_log(INTERNAL_EVENT_0, "sctp_deleteAssociation: Deleted Association from list");
         /* free all association data */
         mdi_removeAssociationData(currentAssociation);
         currentAssociation = NULL;
+        /* report the borrowed-buffer messages that were still queued */
+        adl_notifyPayloads();
         LEAVE_LIBRARY("sctp_deleteAssociation");
         return SCTP_SUCCESS;
     } else {
@@ -2119,6 +2386,24 @@ unsigned int sctp_associatex(unsigned int SCTP_InstanceName,
         }
     }
 
+    /* an INIT of the peer would be steered to the shard of its address, which must know the association */
+    if ((adl_getShard() >= 0) && (noOfDestinationAddresses > 0) &&
+        (adl_getShardOfPeer(&dest_su[0], destinationPort) != adl_getShard())) {
+        error_logii(ERROR_MAJOR, "sctp_associate: the peer belongs to shard %d, not to shard %d",
+                    adl_getShardOfPeer(&dest_su[0], destinationPort), adl_getShard());
+        sctpInstance = old_Instance;
+        currentAssociation = old_assoc;
+        LEAVE_LIBRARY("sctp_associate");
+        return 0;
+    }
+    /* INITs that the peer sends from its other addresses, on a restart or an INIT
+       collision, would reach other shards, which do not know the association */
+    for (count = 1; (adl_getShard() >= 0) && (count < noOfDestinationAddresses); count++) {
+        if (adl_getShardOfPeer(&dest_su[count], destinationPort) != adl_getShard())
+            error_logii(ERROR_MINOR, "sctp_associate: destination address %u belongs to shard %d",
+                        count, adl_getShardOfPeer(&dest_su[count], destinationPort));
+    }
+
     event_log(EXTERNAL_EVENT, "sctp_associatex called");
     event_logi(VERBOSE, "Looking for SCTP Instance %u in the list", SCTP_InstanceName);
 
@@ -2266,6 +2551,8 @@ int sctp_abort(unsigned int associationID)
 
     sctpInstance = old_Instance;
     currentAssociation = old_assoc;
+    /* the abort dropped all queued chunks */
+    adl_notifyPayloads();
     LEAVE_LIBRARY("sctp_abort");
     return SCTP_SUCCESS;
 
@@ -2335,6 +2622,100 @@ int sctp_send_private(unsigned int associationID, unsigned short streamID,
 
 
 
+/**
+ * sctp_sendv does the same thing as sctp_send(), but takes the message as a vector of
+ * buffers, so that the ULP does not need to put the parts of a message together first.
+ * With SCTP_COPY_BUFFERS, the buffers are copied before sctp_sendv() returns. With
+ * SCTP_BORROW_BUFFERS, the library only refers to the buffers, and copies from them
+ * when the message is bundled. The buffers must then be left untouched until the
+ * sendCompleteNotif callback reports, with the given context, that the message has
+ * been acked or abandoned. The callback follows every successful sctp_sendv() call;
+ * after an error it follows only if parts of the message had already been queued.
+ *
+ *  @param    associationID  the ID of the addressed association.
+ *  @param    streamID       identifies the stream on which the chunk is sent.
+ *  @param    iov            the buffers of the message.
+ *  @param    iovcnt         number of buffers.
+ *  @param    protocolId     the payload protocol identifier
+ *  @param    path_id        index of destination address, if different from primary pat, negative for primary
+ *  @param    context        ULP context, returned with the send failure and send complete callbacks.
+ *  @param    lifetime       maximum time of chunk in send queue in msecs, 0 for infinite
+ *  @param    unorderedDelivery chunk is delivered to peer without resequencing, if true (==1), else ordered (==0).
+ *  @param    dontBundle     chunk must not be bundled with other data chunks.
+ *                           boolean, 0==normal bundling, 1==do not bundle message
+ *  @param    borrowBuffers  boolean, 0==buffers are copied, 1==buffers are borrowed
+ *  @return   error code     -1 for send error, 1 for association error, 0 if successful
+ */
+int sctp_sendv(unsigned int associationID, unsigned short streamID,
+               const SCTP_iovec *iov, unsigned int iovcnt, unsigned int protocolId, short path_id,
+               void*  context, /* optional (=SCTP_NO_CONTEXT=NULL if none) */
+               unsigned int lifetime, /* optional (zero -> infinite) */
+               int unorderedDelivery, /* boolean, 0==ordered, 1==unordered */
+               int dontBundle,        /* boolean, 0==normal bundling, 1==do not bundle message */
+               int borrowBuffers)     /* boolean, 0==buffers are copied, 1==buffers are borrowed */
+{
+    int result = SCTP_SUCCESS;
+    unsigned int length = 0, i;
+    ChunkPayload* payload = NULL;
+    SCTP_instance *old_Instance = sctpInstance;
+    Association *old_assoc = currentAssociation;
+    ENTER_LIBRARY("sctp_sendv");
+
+    CHECK_LIBRARY;
+
+    if ((iov == NULL) && (iovcnt > 0)) {
+        LEAVE_LIBRARY("sctp_sendv");
+        return SCTP_PARAMETER_PROBLEM;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > 0xFFFFFFFF - length) {
+            error_log(ERROR_MAJOR, "sctp_sendv: message too long");
+            LEAVE_LIBRARY("sctp_sendv");
+            return SCTP_PARAMETER_PROBLEM;
+        }
+        length += iov[i].iov_len;
+    }
+
+    /* Retrieve association from list  */
+    currentAssociation = retrieveAssociation(associationID);
+
+    if (currentAssociation != NULL) {
+        sctpInstance = currentAssociation->sctpInstance;
+
+        if ((path_id < -1) || (path_id >= currentAssociation->noOfNetworks)) {
+            error_logi(ERROR_MAJOR, "sctp_sendv: invalid destination address %d", path_id);
+            result = SCTP_PARAMETER_PROBLEM;
+        } else if (borrowBuffers) {
+            if (sctpInstance->ULPcallbackFunctions.sendCompleteNotif == NULL) {
+                error_log(ERROR_MAJOR, "sctp_sendv: borrowed buffers need the sendCompleteNotif callback");
+                result = SCTP_PARAMETER_PROBLEM;
+            } else if ((payload = cp_newPayload(iov, iovcnt,
+                                                sctpInstance->ULPcallbackFunctions.sendCompleteNotif,
+                                                associationID, context,
+                                                currentAssociation->ulp_dataptr)) == NULL) {
+                result = SCTP_OUT_OF_RESOURCES;
+            }
+        }
+        if (result == SCTP_SUCCESS) {
+            event_log(INTERNAL_EVENT_1, "sctp_sendv: sending chunk");
+            /* Forward chunk to the addressed association */
+            result = se_ulpsendv(streamID, iov, iovcnt, length, protocolId, path_id,
+                                 context, lifetime, unorderedDelivery, dontBundle, payload);
+            if (payload != NULL) cp_endPayload(payload, (result == SCTP_SUCCESS));
+        }
+    } else {
+        error_log(ERROR_MAJOR, "sctp_sendv: addressed association does not exist");
+        result = SCTP_ASSOC_NOT_FOUND ;
+    }
+
+    sctpInstance = old_Instance;
+    currentAssociation = old_assoc;
+    LEAVE_LIBRARY("sctp_sendv");
+    return result;
+}                               /* end: sctp_sendv */
+
+
+
 /**
  * sctp_setPrimary changes the primary path of an association.
  * @param  associationID     ID of assocation.
@@ -2475,6 +2856,61 @@ int sctp_receivefrom(unsigned int associationID,
 
 
 
+/**
+ * sctp_receive_batch reads the messages waiting on all streams of an association in
+ * one call, instead of one sctp_receive() per message. The messages are copied one
+ * after the other into the arena, and described by the entries of messages.
+ * Reading stops when maxMessages messages have been read, or when the next message
+ * does not fit into the rest of the arena. Only if that is the first one, it is read
+ * partially, and its remaining field tells how much is left for the next call.
+ *  @param   associationID  ID of association.
+ *  @param   messages       array of maxMessages entries, filled with the messages read
+ *  @param   maxMessages    maximum number of messages to read
+ *  @param   arena          buffer the messages are copied to
+ *  @param   arenaLength    length of the arena in bytes
+ *  @param   numMessages    number of messages read
+ *  @return  SCTP_SUCCESS if okay, 1==SCTP_SPECIFIC_FUNCTION_ERROR if there was no data
+*/
+int sctp_receive_batch(unsigned int associationID,
+                       SCTP_ReceivedMessage *messages,
+                       unsigned int maxMessages,
+                       unsigned char *arena,
+                       unsigned int arenaLength,
+                       unsigned int *numMessages)
+{
+    SCTP_instance *old_Instance = sctpInstance;
+    Association *old_assoc = currentAssociation;
+
+    ENTER_LIBRARY("sctp_receive_batch");
+
+    CHECK_LIBRARY;
+
+    if (messages == NULL || arena == NULL || numMessages == NULL ||
+        maxMessages == 0 || arenaLength == 0) {
+        LEAVE_LIBRARY("sctp_receive_batch");
+        return SCTP_PARAMETER_PROBLEM;
+    }
+    /* Retrieve association from list, as long as the data is not actually gone ! */
+    currentAssociation = retrieveAssociationForced(associationID);
+
+    if (currentAssociation == NULL) {
+        error_log(ERROR_MAJOR, "sctp_receive_batch: addressed association does not exist");
+        currentAssociation = old_assoc;
+        LEAVE_LIBRARY("sctp_receive_batch");
+        return SCTP_ASSOC_NOT_FOUND;
+    }
+    sctpInstance = currentAssociation->sctpInstance;
+
+    *numMessages = se_ulpreceivebatch(messages, maxMessages, arena, arenaLength);
+
+    sctpInstance = old_Instance;
+    currentAssociation = old_assoc;
+    LEAVE_LIBRARY("sctp_receive_batch");
+    return (*numMessages > 0) ? SCTP_SUCCESS : SCTP_SPECIFIC_FUNCTION_ERROR;
+}                               /* end: sctp_receive_batch */
+
+
+
 /**
  * sctp_changeHeartBeat turns the hearbeat on a path of an association on or
  * off, or modifies the interval
@@ -2691,7 +3127,7 @@ int sctp_getPathStatus(unsigned int associationID, short path_id, SCTP_PathStatu
             status->partialBytesAcked = fc_readPBA(path_id);
             status->ssthresh = fc_readSsthresh(path_id);
             status->outstandingBytesPerAddress = rtx_get_obpa((unsigned int)path_id, &totalBytesInFlight);
-            status->mtu = fc_readMTU(path_id);
+            status->mtu = pm_readMTU(path_id);
             status->ipTos = currentAssociation->ipTos;
             result = SCTP_SUCCESS;
         }
@@ -3045,6 +3481,14 @@ int sctp_setLibraryParameters(SCTP_LibraryParameters *params)
         LEAVE_LIBRARY("sctp_setLibraryParameters");
         return SCTP_PARAMETER_PROBLEM;
     }
+    if (adl_setSendBatching(params->sendBatchSize, params->sendBatchMaxDelay) < 0) {
+        LEAVE_LIBRARY("sctp_setLibraryParameters");
+        return SCTP_PARAMETER_PROBLEM;
+    }
+    if (adl_setTimerBudget(params->timerBudget) < 0) {
+        LEAVE_LIBRARY("sctp_setLibraryParameters");
+        return SCTP_PARAMETER_PROBLEM;
+    }
 
     event_logi(INTERNAL_EVENT_0, "sctp_setLibraryParameters: Set Parameter sendAbortForOOTB to %s",
                                   (sendAbortForOOTB==TRUE)?"TRUE":"FALSE");
@@ -3054,6 +3498,10 @@ int sctp_setLibraryParameters(SCTP_LibraryParameters *params)
                                   (params->supportPRSCTP==TRUE)?"ENABLED":"DISABLED");
     event_logi(INTERNAL_EVENT_0, "sctp_setLibraryParameters: Support of ADDIP is now %s",
                                   (params->supportADDIP==TRUE)?"ENABLED":"DISABLED");
+    event_logii(INTERNAL_EVENT_0, "sctp_setLibraryParameters: Send batches of up to %u datagrams, max. delay %u usecs",
+                                  params->sendBatchSize, params->sendBatchMaxDelay);
+    event_logi(INTERNAL_EVENT_0, "sctp_setLibraryParameters: Handle up to %u timers per pass",
+                                  params->timerBudget);
 
     LEAVE_LIBRARY("sctp_setLibraryParameters");
     return SCTP_SUCCESS;
@@ -3077,6 +3525,10 @@ int sctp_getLibraryParameters(SCTP_LibraryParameters *params)
     params->checksumAlgorithm = checksumAlgorithm;
     params->supportPRSCTP = (librarySupportsPRSCTP == TRUE) ? 1 : 0;
     params->supportADDIP = (supportADDIP == TRUE) ? 1 : 0;
+    adl_getSendBatching(&params->sendBatchSize, &params->sendBatchMaxDelay,
+                        &params->sendBatchCalls, &params->sendBatchDatagrams, &params->sendBatchLargest);
+    params->timerBudget = adl_getTimerBudget();
+    se_getDeliveryCounters(&params->receivedChunks, &params->expressChunks);
     event_logi(INTERNAL_EVENT_0, "sctp_getLibraryParameters: Checksum Algorithm is currently %s",
                                   (checksumAlgorithm==SCTP_CHECKSUM_ALGORITHM_CRC32C)?"CRC32C":"ADLER32");
 
@@ -3130,6 +3582,7 @@ int sctp_receiveUnsent(unsigned int associationID, unsigned char *buffer, unsign
     }
     sctpInstance = old_Instance;
     currentAssociation = old_assoc;
+    adl_notifyPayloads();
     LEAVE_LIBRARY("sctp_receiveUnsent");
     return result;
 
@@ -3181,6 +3634,7 @@ int sctp_receiveUnacked(unsigned int associationID, unsigned char *buffer, unsig
     }
     sctpInstance = old_Instance;
     currentAssociation = old_assoc;
+    adl_notifyPayloads();
     LEAVE_LIBRARY("sctp_receiveUnacked");
     return result;
 
@@ -3411,6 +3865,209 @@ int sctp_extendedEventLoop(void (*lock)(void* data), void (*unlock)(void* data),
 }
 
 
+#ifndef WIN32
+/**
+ * called by the event loop when it has been woken up by a submitted command: executes
+ * the commands in the queue, and reports their results to their completion callbacks
+ */
+static void mdi_executeCommands(int fd, short int revents, short int* events, void* userData)
+{
+    SCTP_CommandQueue* queue = (SCTP_CommandQueue*)userData;
+    mdi_command *stack, *command = NULL, *next;
+    int result;
+
+    /* clear the wakeup first, so that commands submitted from now on wake up the loop again */
+    adl_clearWakeup(queue->wakeup_fd);
+    stack = __atomic_exchange_n(&queue->head, NULL, __ATOMIC_ACQUIRE);
+
+    /* the stack holds the command submitted last on top */
+    while (stack != NULL) {
+        next = stack->next;
+        stack->next = command;
+        command = stack;
+        stack = next;
+    }
+
+    while (command != NULL) {
+        switch (command->command) {
+        case SCTP_COMMAND_SEND:
+            result = sctp_send_private(command->associationID, command->streamID,
+                                       command->data, command->length, command->protocolId,
+                                       command->path_id, command->context, command->lifetime,
+                                       command->unorderedDelivery, command->dontBundle);
+            break;
+        case SCTP_COMMAND_SHUTDOWN:
+            result = sctp_shutdown(command->associationID);
+            break;
+        case SCTP_COMMAND_ABORT:
+            result = sctp_abort(command->associationID);
+            break;
+        case SCTP_COMMAND_SET_PRIMARY:
+            result = sctp_setPrimary(command->associationID, command->path_id);
+            break;
+        default:
+            result = SCTP_PARAMETER_PROBLEM;
+            break;
+        }
+        if (command->completion != NULL) {
+            ENTER_CALLBACK("commandCompletion");
+            (*command->completion)(command->associationID, command->command, result, command->context);
+            LEAVE_CALLBACK("commandCompletion");
+        }
+        next = command->next;
+        free(command);
+        command = next;
+    }
+}
+
+
+/**
+ * pushes a command onto the stack of a command queue. May be called by any thread.
+ */
+static int mdi_submitCommand(SCTP_CommandQueue* queue, mdi_command* command)
+{
+    mdi_command* head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+
+    do {
+        command->next = head;
+    } while (!__atomic_compare_exchange_n(&queue->head, &head, command, TRUE,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    /* the event loop takes all commands at once, so it needs one wakeup for them */
+    if (head == NULL) adl_signalWakeup(queue->wakeup_fd);
+    return SCTP_SUCCESS;
+}
+
+
+/**
+ * picks the queue to submit a command to: the given one, or for NULL with sharded engines,
+ * the queue of the shard that owns the association
+ */
+static SCTP_CommandQueue* mdi_routeCommand(SCTP_CommandQueue* queue, unsigned int associationID)
+{
+    if ((queue == NULL) && (associationID != 0) && (adl_getShardCount() > 0))
+        queue = (SCTP_CommandQueue*)adl_getShardCommandQueue(associationID % adl_getShardCount());
+    return queue;
+}
+
+
+static mdi_command* mdi_newCommand(int type, unsigned int associationID, unsigned int length,
+                                   sctp_commandCallback completion, void* context)
+{
+    mdi_command* command = (mdi_command*)malloc(sizeof(mdi_command) + length);
+
+    if (command == NULL) return NULL;
+    command->command = type;
+    command->associationID = associationID;
+    command->completion = completion;
+    command->context = context;
+    command->path_id = SCTP_USE_PRIMARY;
+    command->length = length;
+    return command;
+}
+
+
+SCTP_CommandQueue* sctp_getCommandQueue(void)
+{
+    SCTP_CommandQueue* queue;
+
+    ENTER_LIBRARY("sctp_getCommandQueue");
+    ZERO_CHECK_LIBRARY;
+
+    if (commandQueue == NULL) {
+        queue = (SCTP_CommandQueue*)malloc(sizeof(SCTP_CommandQueue));
+        if (queue == NULL) {
+            error_log(ERROR_MAJOR, "sctp_getCommandQueue: out of memory");
+            LEAVE_LIBRARY("sctp_getCommandQueue");
+            return NULL;
+        }
+        queue->head = NULL;
+        if (adl_openWakeup(queue->wakeup_fd) < 0) {
+            free(queue);
+            LEAVE_LIBRARY("sctp_getCommandQueue");
+            return NULL;
+        }
+        if (adl_registerWakeupCallback(queue->wakeup_fd, &mdi_executeCommands, queue) < 0) {
+            error_log(ERROR_MAJOR, "sctp_getCommandQueue: could not register wakeup fd");
+            adl_closeWakeup(queue->wakeup_fd);
+            free(queue);
+            LEAVE_LIBRARY("sctp_getCommandQueue");
+            return NULL;
+        }
+        commandQueue = queue;
+        adl_setShardCommandQueue(queue);
+    }
+    LEAVE_LIBRARY("sctp_getCommandQueue");
+    return commandQueue;
+}
+
+
+int sctp_submitSend(SCTP_CommandQueue* queue,
+                    unsigned int associationID, unsigned short streamID,
+                    unsigned char *buffer, unsigned int length, unsigned int protocolId,
+                    short path_id, void * context, unsigned int lifetime,
+                    int unorderedDelivery, int dontBundle,
+                    sctp_commandCallback completion)
+{
+    mdi_command* command;
+
+    queue = mdi_routeCommand(queue, associationID);
+    if ((queue == NULL) || ((buffer == NULL) && (length > 0))) return SCTP_PARAMETER_PROBLEM;
+    command = mdi_newCommand(SCTP_COMMAND_SEND, associationID, length, completion, context);
+    if (command == NULL) return SCTP_OUT_OF_RESOURCES;
+
+    command->streamID = streamID;
+    command->protocolId = protocolId;
+    command->path_id = path_id;
+    command->lifetime = lifetime;
+    command->unorderedDelivery = unorderedDelivery;
+    command->dontBundle = dontBundle;
+    if (length > 0) memcpy(command->data, buffer, length);
+    return mdi_submitCommand(queue, command);
+}
+
+
+int sctp_submitShutdown(SCTP_CommandQueue* queue, unsigned int associationID,
+                        sctp_commandCallback completion, void* context)
+{
+    mdi_command* command;
+
+    queue = mdi_routeCommand(queue, associationID);
+    if (queue == NULL) return SCTP_PARAMETER_PROBLEM;
+    command = mdi_newCommand(SCTP_COMMAND_SHUTDOWN, associationID, 0, completion, context);
+    if (command == NULL) return SCTP_OUT_OF_RESOURCES;
+    return mdi_submitCommand(queue, command);
+}
+
+
+int sctp_submitAbort(SCTP_CommandQueue* queue, unsigned int associationID,
+                     sctp_commandCallback completion, void* context)
+{
+    mdi_command* command;
+
+    queue = mdi_routeCommand(queue, associationID);
+    if (queue == NULL) return SCTP_PARAMETER_PROBLEM;
+    command = mdi_newCommand(SCTP_COMMAND_ABORT, associationID, 0, completion, context);
+    if (command == NULL) return SCTP_OUT_OF_RESOURCES;
+    return mdi_submitCommand(queue, command);
+}
+
+
+int sctp_submitSetPrimary(SCTP_CommandQueue* queue, unsigned int associationID, short path_id,
+                          sctp_commandCallback completion, void* context)
+{
+    mdi_command* command;
+
+    queue = mdi_routeCommand(queue, associationID);
+    if (queue == NULL) return SCTP_PARAMETER_PROBLEM;
+    command = mdi_newCommand(SCTP_COMMAND_SET_PRIMARY, associationID, 0, completion, context);
+    if (command == NULL) return SCTP_OUT_OF_RESOURCES;
+    command->path_id = path_id;
+    return mdi_submitCommand(queue, command);
+}
+#endif
+
+
 #ifdef BAKEOFF
 int sctp_sendRawData(unsigned int associationID, short path_id,
                      unsigned char *buffer, unsigned int length)
@@ -3467,27 +4124,55 @@ path_id,length);
  * \item retrieve destination port ???
  * \end{itemize}
  *
- *  @param SCTP_message     SCTP message as a struct (i.e. common header and chunks)
- *  @param length           length of complete SCTP message.
+ *  @param iov              the SCTP message, gathered from these buffers: the first one
+ *                          starts with the common header
+ *  @param iovcnt           number of buffers, at most ADL_MAX_IOVECS
  *  @param destAddresIndex  Index of address in the destination address list.
+ *  @param crcKnown         TRUE if the CRC32C of the chunks is given in chunksCrc
+ *  @param chunksCrc        aux_crc32c(0, ...) of the message without the common header
  *  @return                 Errorcode (0 for good case: length bytes sent; 1 or -1 for error)
 */
-int mdi_send_message(SCTP_message * message, unsigned int length, short destAddressIndex)
+static int mdi_send(SCTP_iovec * iov, unsigned int iovcnt, short destAddressIndex,
+                    gboolean crcKnown, unsigned int chunksCrc, int flags)
 {
+    static ENGINE_LOCAL SCTP_message gathered;
+    SCTP_iovec gathered_iov;
+    SCTP_message *message;
     union sockunion dest_su, *dest_ptr;
     SCTP_simple_chunk *chunk;
     unsigned char tos = 0;
     unsigned short dIdx;
+    unsigned int length, i;
     int txmit_len = 0;
     guchar hoststring[SCTP_MAX_IP_LEN];
 
 
-    if (message == NULL) {
+    if (iov == NULL || iovcnt == 0 || iov[0].iov_base == NULL) {
         error_log(ERROR_MINOR, "mdi_send_message: no message to send !!!");
         return 1;
     }
+    for (length = 0, i = 0; i < iovcnt; i++) length += iov[i].iov_len;
 
-    chunk = (SCTP_simple_chunk *) & message->sctp_pdu[0];
+    if ((iovcnt > 1) && !(crcKnown && aux_crc32c_in_use())) {
+        /* the checksum must be computed over the whole message, so gather it first */
+        if (length > sizeof(SCTP_message)) {
+            error_logi(ERROR_MAJOR, "mdi_send_message: message of %u bytes too large", length);
+            return 1;
+        }
+        gathered_iov.iov_base = &gathered;
+        gathered_iov.iov_len  = 0;
+        for (i = 0; i < iovcnt; i++) {
+            memcpy((guchar*)&gathered + gathered_iov.iov_len, iov[i].iov_base, iov[i].iov_len);
+            gathered_iov.iov_len += iov[i].iov_len;
+        }
+        iov = &gathered_iov;
+        iovcnt = 1;
+    }
+    message = (SCTP_message *) iov[0].iov_base;
+
+    /* the first buffer may hold nothing but the common header */
+    if (iov[0].iov_len > sizeof(SCTP_common_header)) chunk = (SCTP_simple_chunk *) & message->sctp_pdu[0];
+    else chunk = (SCTP_simple_chunk *) iov[1].iov_base;
 
     if (currentAssociation == NULL) {
         /* possible cases : initAck, no association exists yet, and OOTB packets
@@ -3570,15 +4255,19 @@ int mdi_send_message(SCTP_message * message, unsigned int length, short destAddr
     }
 
     /* calculate and insert checksum */
-    aux_insert_checksum((unsigned char *) message, length);
+    if (crcKnown) {
+        aux_insert_checksum_combined((unsigned char *) message, length, chunksCrc);
+    } else {
+        aux_insert_checksum((unsigned char *) message, length);
+    }
 
     switch (sockunion_family(dest_ptr)) {
     case AF_INET:
-        txmit_len = adl_send_message(sctp_socket, message, length, dest_ptr, tos);
+        txmit_len = adl_send_vector(sctp_socket, iov, iovcnt, dest_ptr, tos, flags);
         break;
 #ifdef HAVE_IPV6
     case AF_INET6:
-        txmit_len = adl_send_message(ipv6_sctp_socket, message, length, dest_ptr, tos);
+        txmit_len = adl_send_vector(ipv6_sctp_socket, iov, iovcnt, dest_ptr, tos, flags);
         break;
 #endif
     default:
@@ -3586,13 +4275,32 @@ int mdi_send_message(SCTP_message * message, unsigned int length, short destAddr
         break;
     }
 
-    adl_sockunion2str(dest_ptr, hoststring, SCTP_MAX_IP_LEN);
-    event_logiii(INTERNAL_EVENT_0, "sent SCTP message of %d bytes to %s, result was %d",
-                    length, hoststring, txmit_len);
+    if (Current_event_log_ >= INTERNAL_EVENT_0) {
+        adl_sockunion2str(dest_ptr, hoststring, SCTP_MAX_IP_LEN);
+        event_logiii(INTERNAL_EVENT_0, "sent SCTP message of %d bytes to %s, result was %d",
+                        length, hoststring, txmit_len);
+    }
 
     return (txmit_len == (int)length) ? 0 : -1;
 
-}                               /* end: mdi_send_message */
+}                               /* end: mdi_send */
+
+
+int mdi_send_message(SCTP_message * message, unsigned int length, short destAddressIndex)
+{
+    SCTP_iovec iov;
+
+    iov.iov_base = message;
+    iov.iov_len  = length;
+    return mdi_send(&iov, 1, destAddressIndex, FALSE, 0, 0);
+}
+
+
+int mdi_send_message_vector(SCTP_iovec * iov, unsigned int iovcnt, short destAddressIndex,
+                            unsigned int chunksCrc, int flags)
+{
+    return mdi_send(iov, iovcnt, destAddressIndex, TRUE, chunksCrc, flags);
+}
 
 
 
@@ -4091,13 +4799,17 @@ unsigned int mdi_getUnusedAssocId(void)
 {
     Association * tmp = NULL;
     unsigned int newId;
+    int shard = adl_getShard();
 
     do {
-        if(nextAssocId == 0) {
+        /* a shard only hands out ids that leave its index as remainder, see sctp_getShardOfAssociation() */
+        while ((nextAssocId == 0) ||
+               ((shard >= 0) && (nextAssocId % adl_getShardCount() != (unsigned int)shard))) {
            nextAssocId++;
         }
         newId = nextAssocId;
-        tmp   = retrieveAssociation(newId);
+        /* ids of associations marked "deleted" are still in use */
+        tmp   = retrieveAssociationForced(newId);
         nextAssocId++;
     } while (tmp != NULL);
 
@@ -4126,16 +4838,26 @@ unsigned short mdi_getUnusedInstanceName(void)
 }
 
 /**
- * generates a random tag value for a new association, but not 0
+ * generates a random tag value for a new association, but not 0. The tags of a shard
+ * leave its index as remainder, so the dispatcher can steer the packets of the
+ * association to it.
  * @return   generates a random tag value for a new association, but not 0
  */
 unsigned int mdi_generateTag(void)
 {
-    unsigned int tag;
-
-    while ((tag = adl_random()) == 0);
+    unsigned int tag, shards = adl_getShardCount();
+    int shard = adl_getShard();
 
-    return tag;
+    for (;;) {
+        tag = adl_random();
+        if (shard >= 0) {
+            tag -= tag % shards;
+            /* the tag would wrap around */
+            if (tag > 0xFFFFFFFFU - (unsigned int)shard) continue;
+            tag += (unsigned int)shard;
+        }
+        if (tag != 0) return tag;
+    }
 }
 
 
@@ -4193,6 +4915,42 @@ short mdi_readLastFromPath(void)
     return lastFromPath;
 }
 
+/**
+ * read the length of the headers in front of the chunks of a packet to a path of the
+ * current association, i.e. of the IP (and UDP) header and the SCTP common header
+ * @param pathID  index of the path
+ * @return length of the headers in bytes
+ */
+unsigned int mdi_readHeaderLength(short pathID)
+{
+    unsigned int length = IP_HEADERLENGTH + sizeof(SCTP_common_header);
+
+#ifdef HAVE_IPV6
+    if (currentAssociation != NULL && pathID >= 0 && pathID < currentAssociation->noOfNetworks &&
+        sockunion_family(&(currentAssociation->destinationAddresses[pathID])) == AF_INET6) {
+        length = IPV6_HEADERLENGTH + sizeof(SCTP_common_header);
+    }
+#endif
+#ifdef SCTP_OVER_UDP
+    length += sizeof(udp_header);
+#endif
+    return length;
+}
+
+/**
+ * tells, whether the packets to a path of the current association have the DF bit set.
+ * Otherwise path MTU probes that are too large would reach the peer in fragments.
+ * @param pathID  index of the path
+ * @return TRUE, if the path MTU of the path can be discovered
+ */
+gboolean mdi_readDontFragment(short pathID)
+{
+    if (currentAssociation == NULL || pathID < 0 || pathID >= currentAssociation->noOfNetworks) {
+        return FALSE;
+    }
+    return adl_dontFragment(sockunion_family(&(currentAssociation->destinationAddresses[pathID])));
+}
+
 /**
  * read the port of the sender of the last received DG (host byte order)
  * @return the port of the sender of the last received DG (host byte order)
@@ -4251,7 +5009,9 @@ void mdi_rewriteLocalTag(unsigned int newTag)
     if (currentAssociation == NULL) {
         error_log(ERROR_MINOR, "mdi_rewriteLocalTag: association not set");
     } else {
+        unindexAssociation(currentAssociation);
         currentAssociation->tagLocal = newTag;
+        indexAssociation(currentAssociation);
     }
 }
 
@@ -4294,6 +5054,7 @@ void mdi_writeDestinationAddresses(union sockunion addresses[MAX_NUM_ADDRESSES],
         return;
     } else {
         if (currentAssociation->destinationAddresses != NULL) {
+            unindexAssociation(currentAssociation);
             free(currentAssociation->destinationAddresses);
         }
 
@@ -4307,6 +5068,7 @@ void mdi_writeDestinationAddresses(union sockunion addresses[MAX_NUM_ADDRESSES],
                noOfAddresses * sizeof(union sockunion));
 
         currentAssociation->noOfNetworks = noOfAddresses;
+        indexAssociation(currentAssociation);
 
         return;
     }
@@ -4873,7 +5635,10 @@ mdi_newAssociation(void*  sInstance,
     /* Enter association into list */
     event_logi(INTERNAL_EVENT_0, "entering association %08x into list", currentAssociation->assocId);
 
-    AssociationList = g_list_insert_sorted(AssociationList,currentAssociation, &compareAssociationIDs);
+    AssociationList = g_list_prepend(AssociationList, currentAssociation);
+    currentAssociation->assocListEntry = AssociationList;
+    g_hash_table_insert(AssociationTable, GUINT_TO_POINTER(currentAssociation->assocId), currentAssociation);
+    indexAssociation(currentAssociation);
 
     return 0;
 }                               /* end: mdi_newAssociation */
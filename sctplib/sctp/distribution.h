@@ -113,6 +113,18 @@ void mdi_receiveMessage(gint socket_fd, unsigned char *buffer,
 
 int mdi_send_message(SCTP_message * message, unsigned int length, short destAddressIndex);
 
+/**
+   Like mdi_send_message(), for bundling: the message is gathered from a number of buffers,
+   so that DATA chunks are sent from where they are kept, and the CRC32C of the chunks is
+   already known, so that only the common header needs to be checksummed.
+   @param iov              the buffers, the first one starts with the common header
+   @param iovcnt           number of buffers, at most ADL_MAX_IOVECS
+   @param chunksCrc        aux_crc32c(0, ...) of the SCTP message without the common header
+   @param flags            0, or ADL_SEND_PROBE or ADL_SEND_FRAGMENT, see adl_send_vector()
+*/
+int mdi_send_message_vector(SCTP_iovec * iov, unsigned int iovcnt, short destAddressIndex,
+                            unsigned int chunksCrc, int flags);
+
 
 
 /*------------------- Functions called by the SCTP to forward primitives to ULP ------------------*/
@@ -309,6 +321,16 @@ int mdi_readLastFromAddress(union sockunion* fromAddress);
 */
 short mdi_readLastFromPath(void);
 
+/* reads the length of the IP (and UDP) header and the SCTP common header of a packet
+   to a path of the current association.
+*/
+unsigned int mdi_readHeaderLength(short pathID);
+
+/* tells, whether the packets to a path of the current association have the DF bit set,
+   which the path MTU discovery needs.
+*/
+gboolean mdi_readDontFragment(short pathID);
+
 
 /* returns the port of the sender of the last received DG.
 */
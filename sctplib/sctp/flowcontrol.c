@@ -45,6 +45,7 @@
 #include "bundling.h"
 #include "adaptation.h"
 #include "recvctrl.h"
+#include "chunkpool.h"
 
 #include <stdio.h>
 #include <glib.h>
@@ -68,9 +69,9 @@ typedef struct __congestion_parameters
     /** */
     unsigned int mtu;
     /** */
-    struct timeval time_of_cwnd_adjustment;
+    adl_time time_of_cwnd_adjustment;
     /** */
-    struct timeval last_send_time;
+    adl_time last_send_time;
     /*@} */
 } cparm;
 
@@ -87,10 +88,16 @@ typedef struct flowcontrol_struct
     cparm *cparams;
     /** */
     unsigned int current_tsn;
+    /** send queue, linked through the chunks: retransmissions sorted by TSN, then new chunks */
+    chunk_data *queue_head;
     /** */
-    GList *chunk_list;
-    /** */
+    chunk_data *queue_tail;
+    /** number of chunks in the send queue */
     unsigned int list_length;
+    /** number of chunks in the send queue that have not been transmitted yet */
+    unsigned int unsent_chunks;
+    /** number of bytes in the send queue */
+    unsigned int queued_bytes;
     /** one timer may be running per destination address */
     TimerID *T3_timer;
     /** for passing as parameter in callback functions */
@@ -118,6 +125,118 @@ int fc_check_for_txmit(void *fc_instance, unsigned int oldListLen, gboolean doIn
 /* ---------------  Function Prototypes -----------------------------*/
 
 
+/**
+ * appends a new chunk at the tail of the send queue
+ * @param fc    flowcontrol instance
+ * @param dat   chunk that is not in the send queue
+ */
+static void fc_queue_append(fc_data* fc, chunk_data* dat)
+{
+    dat->next_queued = NULL;
+    dat->prev_queued = fc->queue_tail;
+    if (fc->queue_tail != NULL) fc->queue_tail->next_queued = dat;
+    else fc->queue_head = dat;
+    fc->queue_tail = dat;
+    dat->isQueued = TRUE;
+    fc->list_length++;
+    fc->queued_bytes += dat->chunk_len;
+    if (dat->num_of_transmissions == 0) fc->unsent_chunks++;
+}
+
+/**
+ * inserts a chunk that is to be retransmitted into the send queue, sorted by TSN.
+ * Chunks come back in descending TSN order from the retransmission paths, so the
+ * search ends at the head of the queue in the common case.
+ * @param fc    flowcontrol instance
+ * @param dat   chunk that is not in the send queue
+ */
+static void fc_queue_insert(fc_data* fc, chunk_data* dat)
+{
+    chunk_data* next = fc->queue_head;
+
+    while (next != NULL && before(next->chunk_tsn, dat->chunk_tsn)) next = next->next_queued;
+    if (next == NULL) {
+        fc_queue_append(fc, dat);
+        return;
+    }
+    dat->next_queued = next;
+    dat->prev_queued = next->prev_queued;
+    if (next->prev_queued != NULL) next->prev_queued->next_queued = dat;
+    else fc->queue_head = dat;
+    next->prev_queued = dat;
+    dat->isQueued = TRUE;
+    fc->list_length++;
+    fc->queued_bytes += dat->chunk_len;
+    if (dat->num_of_transmissions == 0) fc->unsent_chunks++;
+}
+
+/**
+ * unlinks a chunk from the send queue. The chunk itself is not freed.
+ * @param fc    flowcontrol instance
+ * @param dat   chunk in the send queue
+ */
+static void fc_queue_remove(fc_data* fc, chunk_data* dat)
+{
+    if (dat->prev_queued != NULL) dat->prev_queued->next_queued = dat->next_queued;
+    else fc->queue_head = dat->next_queued;
+    if (dat->next_queued != NULL) dat->next_queued->prev_queued = dat->prev_queued;
+    else fc->queue_tail = dat->prev_queued;
+    dat->next_queued = dat->prev_queued = NULL;
+    dat->isQueued = FALSE;
+    fc->list_length--;
+    fc->queued_bytes -= dat->chunk_len;
+    if (dat->num_of_transmissions == 0) fc->unsent_chunks--;
+}
+
+/**
+ * empties the send queue, freeing the chunks that have never been transmitted
+ * (the others are still owned by reltransfer)
+ * @param fc    flowcontrol instance
+ */
+static void fc_queue_clear(fc_data* fc)
+{
+    chunk_data* dat;
+
+    while ((dat = fc->queue_head) != NULL) {
+        fc_queue_remove(fc, dat);
+        free_list_element(dat, GINT_TO_POINTER(1));
+    }
+}
+
+/**
+ * output debug messages for the send queue
+ * @param   event_log_level  INTERNAL_EVENT_0 INTERNAL_EVENT_1 EXTERNAL_EVENT_X EXTERNAL_EVENT
+ * @param   fc  flowcontrol instance
+ */
+static void fc_queue_debug(short event_log_level, fc_data* fc)
+{
+    chunk_data *dat;
+    unsigned int counter;
+    unsigned int last_tsn;
+
+    if (event_log_level <= Current_event_log_) {
+        event_log(event_log_level, "------------- Chunk List Debug ------------------------");
+        if (fc->list_length == 0) {
+            event_log(event_log_level, " Size of List == 0 ! ");
+            return;
+        }
+        event_logii(event_log_level, " Size of List == %u (%u bytes) ! Printing first 10 chunks....",
+                    fc->list_length, fc->queued_bytes);
+        last_tsn = fc->queue_head->chunk_tsn - 1;
+        for (dat = fc->queue_head, counter = 0; dat != NULL; dat = dat->next_queued, counter++) {
+            if (counter < 10) {
+                event_logiii(event_log_level, "Chunk Size %u  -- TSN : %u  -- Transmissions = %u",
+                             dat->chunk_len, dat->chunk_tsn, dat->num_of_transmissions);
+            }
+            if (! after(dat->chunk_tsn, last_tsn))
+                error_log(ERROR_FATAL, "TSN not in sequence ! Bye");
+            last_tsn = dat->chunk_tsn;
+        }
+        event_log(event_log_level, "------------- Chunk List Debug : DONE  ------------------------");
+    }
+}
+
+
 /**
  * Creates new instance of flowcontrol module and returns pointer to it
  * TODO : should parameter be unsigned short ?
@@ -159,13 +278,14 @@ void *fc_new_flowcontrol(unsigned int peer_rwnd,
     for (count = 0; count < number_of_destination_addresses; count++) {
         tmp->T3_timer[count] = 0; /* i.e. timer not running */
         tmp->addresses[count] = count;
-        (tmp->cparams[count]).cwnd = 2 * MAX_MTU_SIZE;
+        /* until pathmanagement has discovered the path MTU */
+        (tmp->cparams[count]).mtu = DEFAULT_SCTP_PDU;
+        (tmp->cparams[count]).cwnd = 2 * (tmp->cparams[count]).mtu;
         (tmp->cparams[count]).cwnd2 = 0L;
         (tmp->cparams[count]).partial_bytes_acked = 0L;
         (tmp->cparams[count]).ssthresh = peer_rwnd;
-        (tmp->cparams[count]).mtu = MAX_SCTP_PDU;
-        adl_gettime( &(tmp->cparams[count].time_of_cwnd_adjustment));
-        timerclear(&(tmp->cparams[count].last_send_time));
+        tmp->cparams[count].time_of_cwnd_adjustment = adl_now();
+        tmp->cparams[count].last_send_time = 0;
     }
     tmp->outstanding_bytes = 0;
     tmp->announced_rwnd = peer_rwnd;
@@ -175,9 +295,12 @@ void *fc_new_flowcontrol(unsigned int peer_rwnd,
     tmp->t3_retransmission_sent = FALSE;
     tmp->one_packet_inflight = FALSE;
     tmp->doing_retransmission = FALSE;
-    tmp->chunk_list = NULL;
+    tmp->queue_head = NULL;
+    tmp->queue_tail = NULL;
     tmp->maxQueueLen = maxQueueLen;
     tmp->list_length = 0;
+    tmp->unsent_chunks = 0;
+    tmp->queued_bytes = 0;
 
     rtx_set_remote_receiver_window(peer_rwnd);
 
@@ -206,13 +329,14 @@ void fc_restart(guint32 new_rwnd, unsigned int iTSN, unsigned int maxQueueLen)
     }
     fc_stop_timers();
     for (count = 0; count < tmp->number_of_addresses; count++) {
-        (tmp->cparams[count]).cwnd = 2 * MAX_MTU_SIZE;
+        /* until pathmanagement has discovered the path MTU */
+        (tmp->cparams[count]).mtu = DEFAULT_SCTP_PDU;
+        (tmp->cparams[count]).cwnd = 2 * (tmp->cparams[count]).mtu;
         (tmp->cparams[count]).cwnd2 = 0L;
         (tmp->cparams[count]).partial_bytes_acked = 0L;
         (tmp->cparams[count]).ssthresh = new_rwnd;
-        (tmp->cparams[count]).mtu = MAX_SCTP_PDU;
-        adl_gettime( &(tmp->cparams[count].time_of_cwnd_adjustment) );
-        timerclear(&(tmp->cparams[count].last_send_time));
+        tmp->cparams[count].time_of_cwnd_adjustment = adl_now();
+        tmp->cparams[count].last_send_time = 0;
     }
     tmp->outstanding_bytes = 0;
     tmp->announced_rwnd = new_rwnd;
@@ -224,14 +348,11 @@ void fc_restart(guint32 new_rwnd, unsigned int iTSN, unsigned int maxQueueLen)
     tmp->current_tsn = iTSN;
     tmp->maxQueueLen = maxQueueLen;
     rtx_set_remote_receiver_window(new_rwnd);
-    if ((tmp->chunk_list) != NULL) {
+    if (tmp->queue_head != NULL) {
         /* TODO : pass chunks in this list back up to the ULP ! */
-        g_list_foreach(tmp->chunk_list, &free_list_element, GINT_TO_POINTER(1));
+        fc_queue_clear(tmp);
         error_log(ERROR_MINOR, "FLOWCONTROL RESTART : List is deleted...");
     }
-    g_list_free(tmp->chunk_list);
-    tmp->chunk_list = NULL;
-    tmp->list_length = 0;
 }
 
 /**
@@ -248,12 +369,10 @@ void fc_delete_flowcontrol(void *fc_instance)
     free(tmp->cparams);
     free(tmp->T3_timer);
     free(tmp->addresses);
-    if ((tmp->chunk_list) != NULL) {
+    if (tmp->queue_head != NULL) {
         error_log(ERROR_MINOR, "FLOWCONTROL : List is deleted with chunks still queued...");
-        g_list_foreach(tmp->chunk_list, &free_list_element, GINT_TO_POINTER(1));
+        fc_queue_clear(tmp);
     }
-    g_list_free(tmp->chunk_list);
-    tmp->chunk_list = NULL;
     free(fc_instance);
 }
 
@@ -277,7 +396,8 @@ void fc_debug_cparams(short event_log_level)
         event_log(event_log_level, "Debug-output for Congestion Control Parameters ! ");
         event_logii(event_log_level, "outstanding_bytes == %u; current_tsn == %u; ",
                                 fc->outstanding_bytes, fc->current_tsn);
-        event_logi(event_log_level, "chunks queued in flowcontrol== %lu; ", fc->list_length);
+        event_logii(event_log_level, "chunks queued in flowcontrol== %u (%u bytes); ",
+                    fc->list_length, fc->queued_bytes);
         event_logii(event_log_level,
                     "shutdown_received == %s; waiting_for_sack == %s",
                     ((fc->shutdown_received == TRUE) ? "TRUE" : "FALSE"),
@@ -360,7 +480,7 @@ int fc_reset_cwnd(unsigned int pathId)
     fc_data *fc = NULL;
     unsigned int rto;
     short pId;
-    struct timeval now, resetTime;
+    adl_time now;
 
 
     fc = (fc_data *) mdi_readFlowControl();
@@ -377,15 +497,13 @@ int fc_reset_cwnd(unsigned int pathId)
         return SCTP_PARAMETER_PROBLEM;
     }
     pId = (short)pathId;
-    adl_gettime(&now);
+    now = adl_now();
     rto = pm_readRTO(pId);
-    resetTime = fc->cparams[pathId].last_send_time;
-    adl_add_msecs_totime(&resetTime, rto);
-    if (timercmp(&now, &resetTime, > )) {
+    if (now > fc->cparams[pathId].last_send_time + (adl_time)rto * ADL_NSECS_PER_MSEC) {
         event_logi(INTERNAL_EVENT_0, "----- fc_reset_cwnd(): resetting CWND for idle path %u ------", pathId);
         /* path has been idle for at least on RTO */
-        fc->cparams[pathId].cwnd = 2 * MAX_MTU_SIZE;
-        adl_gettime(&(fc->cparams[pathId].last_send_time));
+        fc->cparams[pathId].cwnd = 2 * fc->cparams[pathId].mtu;
+        fc->cparams[pathId].last_send_time = now;
         event_logii(INTERNAL_EVENT_0, "resetting cwnd[%d], setting it to : %d\n", pathId, fc->cparams[pathId].cwnd);
     }
     return SCTP_SUCCESS;
@@ -535,12 +653,11 @@ void fc_timer_cb_t3_timeout(TimerID tid, void *assoc, void *data2)
     /* insert chunks to be retransmitted at the beginning of the list */
     /* make sure, that they are unique in this list ! */
     for (count = num_of_chunks - 1; count >= 0; count--) {
-        if (g_list_find(fc->chunk_list, chunks[count]) == NULL){
+        if (chunks[count]->isQueued == FALSE){
             if (chunks[count]->hasBeenAcked == FALSE) {
-                fc->chunk_list = g_list_insert_sorted(fc->chunk_list, chunks[count], (GCompareFunc) sort_tsn);
+                fc_queue_insert(fc, chunks[count]);
                 /* these chunks will not be counted, until they are actually sent again */
                 chunks[count]->hasBeenRequeued = TRUE;
-                fc->list_length++;
             }
         } else {
             event_logi(VERBOSE, "Chunk number %u already in list, skipped adding it", chunks[count]->chunk_tsn);
@@ -548,7 +665,7 @@ void fc_timer_cb_t3_timeout(TimerID tid, void *assoc, void *data2)
 
     }
     event_log(VVERBOSE, "\n-----FlowControl (T3 timeout): Chunklist after reinserting chunks -------");
-    chunk_list_debug(VVERBOSE, fc->chunk_list);
+    fc_queue_debug(VVERBOSE, fc);
     fc_debug_cparams(VVERBOSE);
     event_log(VVERBOSE, "-----FlowControl (T3 timeout): Debug Output End -------\n");
     free(chunks);
@@ -672,11 +789,8 @@ int fc_check_for_txmit(void *fc_instance, unsigned int oldListLen, gboolean doIn
 
     fc = (fc_data *) fc_instance;
 
-    if (fc->chunk_list != NULL) {
-        dat = (chunk_data*)g_list_nth_data(fc->chunk_list, 0);
-    } else {
-        return -1;
-    }
+    dat = fc->queue_head;
+    if (dat == NULL) return -1;
 
     if (dat->num_of_transmissions >= 1)  data_is_retransmitted = TRUE;
 
@@ -737,9 +851,10 @@ int fc_check_for_txmit(void *fc_instance, unsigned int oldListLen, gboolean doIn
                     dat->ack_time, dat->num_of_transmissions);
         /* -------------------- DEBUGGING --------------------------------------- */
 
-        bu_put_Data_Chunk((SCTP_simple_chunk *) dat->data, &destination);
+        bu_put_Data_Chunk(dat, &destination);
+        fc_queue_remove(fc, dat);
         data_is_submitted = TRUE;
-        adl_gettime(&(fc->cparams[destination].last_send_time));
+        fc->cparams[destination].last_send_time = adl_now();
 
         /* -------------------- DEBUGGING --------------------------------------- */
         event_logi(VERBOSE, "sent chunk (tsn=%u) to bundling", dat->chunk_tsn);
@@ -748,7 +863,7 @@ int fc_check_for_txmit(void *fc_instance, unsigned int oldListLen, gboolean doIn
 
         fc_update_chunk_data(fc, dat, destination);
         if (dat->num_of_transmissions == 1) {
-            adl_gettime(&(dat->transmission_time));
+            dat->transmission_time = adl_now();
             event_log(INTERNAL_EVENT_0, "Storing chunk in retransmission list -> calling rtx_save_retrans");
             rtx_save_retrans_chunks(dat);
         } else {
@@ -757,10 +872,8 @@ int fc_check_for_txmit(void *fc_instance, unsigned int oldListLen, gboolean doIn
                 lowest_tsn_is_retransmitted = rtx_is_lowest_tsn(dat->chunk_tsn);
         }
         fc->one_packet_inflight = TRUE;
-        fc->chunk_list = g_list_remove(fc->chunk_list, (gpointer) dat);
-        fc->list_length--;
 
-        dat = (chunk_data*)g_list_nth_data(fc->chunk_list, 0);
+        dat = fc->queue_head;
         if (dat != NULL) {
             if (dat->num_of_transmissions >= 1)    data_is_retransmitted = TRUE;
             else if (dat->num_of_transmissions == 0) data_is_retransmitted = FALSE;
@@ -795,7 +908,7 @@ int fc_check_for_txmit(void *fc_instance, unsigned int oldListLen, gboolean doIn
 
     /* ------------------ DEBUGGING ----------------------------- */
     event_log(VVERBOSE, "Printing Chunk List / Congestion Params in fc_check_for_txmit");
-    chunk_list_debug(VVERBOSE, fc->chunk_list);
+    fc_queue_debug(VVERBOSE, fc);
     /* fc_debug_cparams(VVERBOSE);*/
     /* ------------------ DEBUGGING ----------------------------- */
 
@@ -958,13 +1071,13 @@ int fc_send_data_chunk(chunk_data * chunkd,
     if (fc->shutdown_received == TRUE) {
         error_log(ERROR_MAJOR,
                   "fc_send_data_chunk() called, but shutdown_received==TRUE - send not allowed !");
-        free(chunkd);
+        cp_freeChunk(chunkd);
         /* FIXME: see that error treatment gives direct feedback of  this to the ULP ! */
         return SCTP_SPECIFIC_FUNCTION_ERROR;
     }
 
     /* event_log(VVERBOSE, "Printing Chunk List / Congestion Params in fc_send_data_chunk - before");
-    chunk_list_debug(VVERBOSE, fc->chunk_list); */
+    fc_queue_debug(VVERBOSE, fc); */
 
     event_log(VERBOSE, "FlowControl got a Data Chunk to send ");
 
@@ -981,30 +1094,27 @@ int fc_send_data_chunk(chunk_data * chunkd,
     chunkd->hasBeenDropped = FALSE;
     chunkd->hasBeenFastRetransmitted = FALSE;
     chunkd->hasBeenRequeued = FALSE;
+    chunkd->isQueued = FALSE;
     chunkd->last_destination = 0;
 
     if (destAddressIndex >= 0) chunkd->initial_destination = destAddressIndex;
     else chunkd->initial_destination = -1;
 
     if (lifetime == 0xFFFFFFFF) {
-        timerclear(&(chunkd->expiry_time));
-    } else if (lifetime == 0) {
-        adl_gettime(&(chunkd->expiry_time));
+        chunkd->expiry_time = 0;
     } else {
-        adl_gettime(&(chunkd->expiry_time));
-        adl_add_msecs_totime(&(chunkd->expiry_time), lifetime);
+        chunkd->expiry_time = adl_now() + (adl_time)lifetime * ADL_NSECS_PER_MSEC;
     }
 
-    timerclear(&(chunkd->transmission_time));
+    chunkd->transmission_time = 0;
 
     chunkd->dontBundle           = dontBundle;
     chunkd->num_of_transmissions = 0;
 
     /* insert chunk at the list's tail */
-    fc->chunk_list = g_list_append(fc->chunk_list, chunkd);
-    fc->list_length++;
+    fc_queue_append(fc, chunkd);
     event_log(VVERBOSE, "Printing Chunk List / Congestion Params in  fc_send_data_chunk - after");
-    chunk_list_debug(VVERBOSE, fc->chunk_list);
+    fc_queue_debug(VVERBOSE, fc);
 
     fc_check_for_txmit(fc, fc->list_length, FALSE);
 
@@ -1015,7 +1125,6 @@ int fc_send_data_chunk(chunk_data * chunkd,
 int fc_dequeue_acked_chunks(unsigned int ctsna)
 {
     chunk_data *dat = NULL;
-    GList* tmp = NULL;
     fc_data *fc = NULL;
 
     fc = (fc_data *) mdi_readFlowControl();
@@ -1024,14 +1133,9 @@ int fc_dequeue_acked_chunks(unsigned int ctsna)
         return (-1);
     }
 
-    tmp = g_list_first(fc->chunk_list);
-
-    while (tmp != NULL) {
-        dat = (chunk_data*)tmp->data;
+    while ((dat = fc->queue_head) != NULL) {
          if (before(dat->chunk_tsn, ctsna) || (dat->chunk_tsn == ctsna)) {
-            tmp = g_list_next(tmp);
-            fc->chunk_list = g_list_remove(fc->chunk_list, (gpointer) dat);
-            fc->list_length--;
+            fc_queue_remove(fc, dat);
             event_logii(INTERNAL_EVENT_0, "Removed chunk %u from Flowcontrol-List, Listlength now %u",
                 dat->chunk_tsn, fc->list_length);
         } else
@@ -1049,8 +1153,7 @@ int fc_adjustCounters(fc_data *fc, unsigned int addressIndex,
 
 {
     unsigned int count;
-    int diff;
-    struct timeval last_update, now;
+    adl_time last_update, now;
     unsigned int rtt_time;
 
     fc->outstanding_bytes = (fc->outstanding_bytes <= num_acked) ? 0 : (fc->outstanding_bytes - num_acked);
@@ -1061,8 +1164,8 @@ int fc_adjustCounters(fc_data *fc, unsigned int addressIndex,
         }
 
        if (new_data_acked == TRUE) {
-           fc->cparams[addressIndex].cwnd += min(MAX_MTU_SIZE, num_acked);
-           adl_gettime(&(fc->cparams[addressIndex].time_of_cwnd_adjustment));
+           fc->cparams[addressIndex].cwnd += min(fc->cparams[addressIndex].mtu, num_acked);
+           fc->cparams[addressIndex].time_of_cwnd_adjustment = adl_now();
        }
 
     } else {                    /* CONGESTION AVOIDANCE, as per section 6.2.2 */
@@ -1080,21 +1183,21 @@ int fc_adjustCounters(fc_data *fc, unsigned int addressIndex,
          * reset partial_bytes_acked to (partial_bytes_acked - cwnd)."
          */
         rtt_time = pm_readSRTT((short)addressIndex);
-        last_update = fc->cparams[addressIndex].time_of_cwnd_adjustment;
-        adl_add_msecs_totime(&last_update, rtt_time);
-        adl_gettime(&now);
-        diff = adl_timediff_to_msecs(&now, &last_update); /* a-b */
-        event_logii(VVERBOSE, "CONG. AVOIDANCE : rtt_time=%u diff=%d", rtt_time, diff);
+        last_update = fc->cparams[addressIndex].time_of_cwnd_adjustment +
+                      (adl_time)rtt_time * ADL_NSECS_PER_MSEC;
+        now = adl_now();
+        event_logii(VVERBOSE, "CONG. AVOIDANCE : rtt_time=%u, last update passed: %s",
+                    rtt_time, (now >= last_update) ? "yes" : "no");
 
-        if (diff >= 0) {
+        if (now >= last_update) {
             if ((fc->cparams[addressIndex].partial_bytes_acked >= fc->cparams[addressIndex].cwnd)
                 && (fc->outstanding_bytes >= fc->cparams[addressIndex].cwnd)) {
-                fc->cparams[addressIndex].cwnd += MAX_MTU_SIZE;
+                fc->cparams[addressIndex].cwnd += fc->cparams[addressIndex].mtu;
                 fc->cparams[addressIndex].partial_bytes_acked -= fc->cparams[addressIndex].cwnd;
                 /* update time of window adjustment (i.e. now) */
                 event_log(VVERBOSE,
                           "CONG. AVOIDANCE : updating time of adjustment !!!!!!!!!! NOW ! ");
-                adl_gettime(&(fc->cparams[addressIndex].time_of_cwnd_adjustment));
+                fc->cparams[addressIndex].time_of_cwnd_adjustment = now;
             }
             event_logii(VERBOSE, "CONG. AVOIDANCE : updated counters: %u bytes outstanding, cwnd=%u",
                         fc->outstanding_bytes, fc->cparams[addressIndex].cwnd);
@@ -1174,7 +1277,7 @@ int fc_fast_retransmission(unsigned int address_index, unsigned int arwnd, unsig
     /* This is to be an ordered list containing no duplicate entries ! */
     for (count = number_of_rtx_chunks - 1; count >= 0; count--) {
 
-        if (g_list_find(fc->chunk_list, chunks[count]) != NULL){
+        if (chunks[count]->isQueued == TRUE){
             event_logii(VERBOSE, "chunk_tsn==%u, count==%u already in the list -- continue with next\n",
                         chunks[count]->chunk_tsn, count);
             continue;
@@ -1182,13 +1285,12 @@ int fc_fast_retransmission(unsigned int address_index, unsigned int arwnd, unsig
         event_logii(INTERNAL_EVENT_0, "inserting chunk_tsn==%u, count==%u in the list\n",
                     chunks[count]->chunk_tsn, count);
 
-        fc->chunk_list = g_list_insert_sorted(fc->chunk_list, chunks[count], (GCompareFunc) sort_tsn);
-        fc->list_length++;
+        fc_queue_insert(fc, chunks[count]);
     }
 
     /* ------------------ DEBUGGING ----------------------------- */
     event_log(VVERBOSE, "============== fc_fast_retransmission: FlowControl Chunklist after Re-Insertion ======================");
-    chunk_list_debug(VVERBOSE, fc->chunk_list);
+    fc_queue_debug(VVERBOSE, fc);
     /* ------------------ DEBUGGING ----------------------------- */
 
     fc_check_t3(address_index, all_data_acked, new_data_acked);
@@ -1209,13 +1311,13 @@ int fc_fast_retransmission(unsigned int address_index, unsigned int arwnd, unsig
     }
 
     /* send as many to bundling as allowed, requesting new destination address */
-    if (fc->chunk_list != NULL){
+    if (fc->queue_head != NULL){
        result = fc_check_for_txmit(fc, oldListLen, TRUE);
     }
     /* make sure that SACK chunk is actually sent ! */
     if (result != 0) bu_sendAllChunks(NULL);
 
-    adl_gettime(&(fc->cparams[address_index].time_of_cwnd_adjustment));
+    fc->cparams[address_index].time_of_cwnd_adjustment = adl_now();
 
     return 1;
 }     /* end: fc_fast_retransmission */
@@ -1273,7 +1375,7 @@ void fc_sack_info(unsigned int address_index, unsigned int arwnd,unsigned int ct
     else
         rtx_set_remote_receiver_window(0);
 
-    if (fc->chunk_list != NULL) {
+    if (fc->queue_head != NULL) {
         fc_check_for_txmit(fc, oldListLen, FALSE);
     }
 
@@ -1296,34 +1398,19 @@ int fc_dequeueUnackedChunk(unsigned int tsn)
 {
     fc_data *fc = NULL;
     chunk_data *dat = NULL;
-    GList *tmp = NULL;
-    gboolean found = FALSE;
     fc = (fc_data *) mdi_readFlowControl();
     if (!fc) {
         error_log(ERROR_MAJOR, "flow control instance not set !");
         return SCTP_MODULE_NOT_FOUND;
     }
-    dat = (chunk_data*)g_list_nth_data(fc->chunk_list, 0);
-    tmp = fc->chunk_list;
-    while (dat != NULL && tmp != NULL) {
-        event_logii(VVERBOSE, "fc_dequeueOldestUnsentChunks(): checking chunk tsn=%u, num_rtx=%u ", dat->chunk_tsn, dat->num_of_transmissions);
-        if (dat->chunk_tsn == tsn) {
-            found = TRUE;
-            break;
-        } else {
-            tmp = g_list_next(tmp);
-            if (tmp != NULL) {
-                dat = (chunk_data*)tmp->data;
-            } else {
-                dat = NULL;
-            }
-        }
+    /* retransmissions are sorted by TSN at the head of the queue */
+    for (dat = fc->queue_head; dat != NULL && before(dat->chunk_tsn, tsn); dat = dat->next_queued) {
+        event_logii(VVERBOSE, "fc_dequeueUnackedChunk(): checking chunk tsn=%u, num_rtx=%u ", dat->chunk_tsn, dat->num_of_transmissions);
     }
-    if (found) { /* delete */
-        fc->chunk_list = g_list_remove(fc->chunk_list, (gpointer) dat);
-        fc->list_length--;
+    if (dat != NULL && dat->chunk_tsn == tsn) { /* delete */
+        fc_queue_remove(fc, dat);
         event_log(VVERBOSE, "fc_dequeueUnackedChunk(): checking list");
-        chunk_list_debug(VVERBOSE, fc->chunk_list);
+        fc_queue_debug(VVERBOSE, fc);
         return 1;
     }
     /* else */
@@ -1336,7 +1423,6 @@ int fc_dequeueOldestUnsentChunk(unsigned char *buf, unsigned int *len, unsigned
 {
     fc_data *fc = NULL;
     chunk_data *dat = NULL;
-    GList *tmp = NULL;
     SCTP_data_chunk* dchunk;
     int listlen;
 
@@ -1349,16 +1435,11 @@ int fc_dequeueOldestUnsentChunk(unsigned char *buf, unsigned int *len, unsigned
     listlen =  fc_readNumberOfUnsentChunks();
 
     if (listlen <= 0)               return SCTP_UNSPECIFIED_ERROR;
-    if (fc->chunk_list == NULL) return  SCTP_UNSPECIFIED_ERROR;
-    dat = (chunk_data*)g_list_nth_data(fc->chunk_list, 0);
-    tmp = fc->chunk_list;
-    while (dat != NULL && tmp != NULL) {
+    /* new chunks follow the retransmissions in the queue */
+    dat = fc->queue_head;
+    while (dat->num_of_transmissions != 0) {
         event_logii(VVERBOSE, "fc_dequeueOldestUnsentChunks(): checking chunk tsn=%u, num_rtx=%u ", dat->chunk_tsn, dat->num_of_transmissions);
-        if (dat->num_of_transmissions != 0) {
-            tmp = g_list_next(tmp);
-            dat = (chunk_data*)tmp->data;
-        /* should be a sorted list, and not happen here */
-        } else break;
+        dat = dat->next_queued;
     }
     if ((*len) <  (dat->chunk_len - FIXED_DATA_CHUNK_SIZE)) return SCTP_BUFFER_TOO_SMALL;
 
@@ -1366,42 +1447,32 @@ int fc_dequeueOldestUnsentChunk(unsigned char *buf, unsigned int *len, unsigned
 
     dchunk = (SCTP_data_chunk*) dat->data;
     *len = dat->chunk_len - FIXED_DATA_CHUNK_SIZE;
-    memcpy(buf, dchunk->data, dat->chunk_len - FIXED_DATA_CHUNK_SIZE);
+    cp_copyPayload(dat, buf);
     *tsn = dat->chunk_tsn;
     *sID = ntohs(dchunk->stream_id);
     *sSN = ntohs(dchunk->stream_sn);
     *pID = dchunk->protocolId;
     *flags = dchunk->chunk_flags;
     *ctx = dat->context;
-    fc->chunk_list = g_list_remove(fc->chunk_list, (gpointer) dat);
-    fc->list_length--;
+    fc_queue_remove(fc, dat);
     /* be careful ! data may only be freed once: this module ONLY takes care of untransmitted chunks */
-    free(dat);
+    cp_freeChunk(dat);
     event_log(VVERBOSE, "fc_dequeueOldestUnsentChunks(): checking list");
-    chunk_list_debug(VVERBOSE, fc->chunk_list);
+    fc_queue_debug(VVERBOSE, fc);
     return (listlen-1);
 }
 
 int fc_readNumberOfUnsentChunks(void)
 {
-    int queue_len = 0;
+    int queue_len;
     fc_data *fc;
-    GList* tmp;
-    chunk_data *cdat = NULL;
 
     fc = (fc_data *) mdi_readFlowControl();
     if (!fc) {
         error_log(ERROR_MAJOR, "flow control instance not set !");
         return SCTP_MODULE_NOT_FOUND;
     }
-    if (fc->chunk_list == NULL) return 0;
-    tmp = g_list_first(fc->chunk_list);
-    while (tmp) {
-        cdat = (chunk_data*)tmp->data; /* deref list data */
-        event_logii(VERBOSE, "fc_readNumberOfUnsentChunks(): checking chunk tsn=%u, num_rtx=%u ", cdat->chunk_tsn, cdat->num_of_transmissions);
-        if (cdat->num_of_transmissions == 0) queue_len++;
-        tmp = g_list_next(tmp);
-    }
+    queue_len = (int)fc->unsent_chunks;
     event_logi(VERBOSE, "fc_readNumberOfUnsentChunks() returns %u", queue_len);
     return queue_len;
 }
@@ -1423,11 +1494,7 @@ unsigned int fc_readNumberOfQueuedChunks(void)
         error_log(ERROR_MAJOR, "flow control instance not set !");
         return 0;
     }
-    if (fc->chunk_list != NULL){
-        queue_len = fc->list_length;
-    }
-    else
-        queue_len=0;
+    queue_len = fc->list_length;
 
     event_logi(VERBOSE, "fc_readNumberOfQueuedChunks() returns %u", queue_len);
     return queue_len;
@@ -1523,6 +1590,53 @@ unsigned int fc_readMTU(short path_id)
     return fc->cparams[path_id].mtu;
 }
 
+/**
+ * Function sets the mtu value of a certain path, called by pathmanagement when it
+ * has discovered the path MTU.
+ * @param path_id    path index of which the mtu is set
+ * @param mtu        maximum length of the chunks in a packet to that path
+ * @return SCTP_SUCCESS, or an error code
+ */
+int fc_setMTU(short path_id, unsigned int mtu)
+{
+    fc_data *fc;
+    fc = (fc_data *) mdi_readFlowControl();
+
+    if (!fc) {
+        error_log(ERROR_MAJOR, "flow control instance not set !");
+        return SCTP_MODULE_NOT_FOUND;
+    }
+    if ((unsigned int)path_id >= fc->number_of_addresses || path_id < 0) {
+        error_logi(ERROR_MAJOR, "Association has only %u addresses !!! ", fc->number_of_addresses);
+        return SCTP_PARAMETER_PROBLEM;
+    }
+    event_logii(INTERNAL_EVENT_0, "fc_setMTU: mtu of path %d is %u", path_id, mtu);
+    fc->cparams[path_id].mtu = mtu;
+    return SCTP_SUCCESS;
+}
+
+/**
+ * Function returns the smallest mtu value of all paths, i.e. the association PMTU
+ * that user messages are fragmented for (see section 7.3).
+ * @return current association MTU value, else 0
+ */
+unsigned int fc_readAssociationMTU(void)
+{
+    fc_data *fc;
+    unsigned int count, mtu;
+    fc = (fc_data *) mdi_readFlowControl();
+
+    if (!fc) {
+        error_log(ERROR_MAJOR, "flow control instance not set !");
+        return 0;
+    }
+    mtu = fc->cparams[0].mtu;
+    for (count = 1; count < fc->number_of_addresses; count++) {
+        mtu = min(mtu, fc->cparams[count].mtu);
+    }
+    return mtu;
+}
+
 /**
  * Function returns the partial bytes acked value of a certain path.
  * @param path_id    path index of which we want to know the PBA
@@ -189,6 +189,20 @@ int fc_readSsthresh(short path_id);
  */
 unsigned int fc_readMTU(short path_id);
 
+/**
+ * Function sets the mtu value of a certain path.
+ * @param path_id    path index of which the mtu is set
+ * @param mtu        maximum length of the chunks in a packet to that path
+ * @return SCTP_SUCCESS, or an error code
+ */
+int fc_setMTU(short path_id, unsigned int mtu);
+
+/**
+ * Function returns the smallest mtu value of all paths.
+ * @return current association MTU value, else 0
+ */
+unsigned int fc_readAssociationMTU(void);
+
 
 /**
  * Function returns the partial bytes acked value of a certain path.
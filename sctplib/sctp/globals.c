@@ -43,6 +43,7 @@
 
 #include "globals.h"
 #include "adaptation.h"
+#include "chunkpool.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -222,10 +223,9 @@ void perr_exit(const char *infostring)
 
 void print_time(short level)
 {
-    struct timeval now;
+    adl_time now = adl_now();
 
-    adl_gettime(&now);
-    event_logii(level, "Time now: %ld sec, %ld usec \n", now.tv_sec, now.tv_usec);
+    event_logii(level, "Time now: %lu sec, %lu usec \n", ADL_TIME_SECS(now), ADL_TIME_USECS(now));
 }
 
 
@@ -387,11 +387,11 @@ void free_list_element(gpointer list_element, gpointer user_data)
         return;
     } else if (GPOINTER_TO_INT(user_data) == 1) {   /* call from flowcontrol */
         if (list_element != NULL) {
-           if (chunkd->num_of_transmissions == 0) free (list_element);
+           if (chunkd->num_of_transmissions == 0) cp_freeChunk(chunkd);
         }
     } else if (GPOINTER_TO_INT(user_data) == 2) {   /* call from reltransfer */
         if (list_element != NULL) {
-           if (chunkd->num_of_transmissions != 0) free (list_element);
+           if (chunkd->num_of_transmissions != 0) cp_freeChunk(chunkd);
         }
     }
 }
@@ -104,6 +104,22 @@
 #define IPPROTO_SCTP    132
 #endif
 
+/*
+ * marks the state of the protocol engine, i.e. its associations, instances, sockets
+ * and timers. With SCTP_ENGINE_PER_THREAD, this state is kept per thread: every thread
+ * that calls sctp_initLibrary() runs an engine of its own, and the other library
+ * functions act on the engine of the calling thread.
+ */
+#ifdef SCTP_ENGINE_PER_THREAD
+#if defined(_MSC_VER)
+#define ENGINE_LOCAL    __declspec(thread)
+#else
+#define ENGINE_LOCAL    __thread
+#endif
+#else
+#define ENGINE_LOCAL
+#endif
+
 /** this parameter specifies the maximum number of addresses that an endpoint may have */
 #define MAX_NUM_ADDRESSES      32
 
@@ -145,6 +161,19 @@
 typedef unsigned char boolean;
 typedef unsigned int TimerID;
 
+/**
+ * a point in time on the monotonic clock, in nanoseconds, see adl_now().
+ * The value 0 is used for "no time set".
+ */
+typedef guint64 adl_time;
+
+#define ADL_NSECS_PER_USEC  ((adl_time)1000)
+#define ADL_NSECS_PER_MSEC  ((adl_time)1000000)
+#define ADL_NSECS_PER_SEC   ((adl_time)1000000000)
+/* seconds and microseconds of an adl_time, for printing with %lu */
+#define ADL_TIME_SECS(t)    ((unsigned long)((t) / ADL_NSECS_PER_SEC))
+#define ADL_TIME_USECS(t)   ((unsigned long)(((t) / ADL_NSECS_PER_USEC) % 1000000))
+
 #define   TIMER_TYPE_INIT       0
 #define   TIMER_TYPE_SHUTDOWN   1
 #define   TIMER_TYPE_RTXM       3
@@ -152,19 +181,23 @@ typedef unsigned int TimerID;
 #define   TIMER_TYPE_CWND       4
 #define   TIMER_TYPE_HEARTBEAT  5
 #define   TIMER_TYPE_USER       6
+#define   TIMER_TYPE_PMTU       7
 
 typedef struct chunk_data_struct
 {
     unsigned int chunk_len;
     unsigned int chunk_tsn;     /* for efficiency */
-    unsigned char data[MAX_SCTP_PDU];
+    /* CRC32C of the payload (see aux_crc32c()), and the shift operator for its length,
+       or 0 if not computed */
+    unsigned int crc_partial;
+    unsigned int crc_shift;
     unsigned int gap_reports;
-    struct timeval transmission_time;
+    adl_time transmission_time;
     /* ack_time : in msecs after transmission time, initially 0, -1 if retransmitted */
     int ack_time;
     unsigned int num_of_transmissions;
     /* time after which chunk should not be retransmitted */
-    struct timeval expiry_time;
+    adl_time expiry_time;
     gboolean dontBundle;
     /* lst destination used to send chunk to */
     unsigned int last_destination;
@@ -175,7 +208,22 @@ typedef struct chunk_data_struct
     gboolean hasBeenDropped;
     gboolean hasBeenFastRetransmitted;
     gboolean hasBeenRequeued;
+    /* links of the send queue of flowcontrol, only valid while isQueued is TRUE */
+    gboolean isQueued;
+    struct chunk_data_struct* next_queued;
+    struct chunk_data_struct* prev_queued;
     gpointer context;
+    /* for a chunk sent from borrowed buffers (see chunkpool.h), the payload and where
+       the payload of this chunk starts in it, and data holds only the chunk header.
+       NULL for a chunk that carries its payload */
+    struct chunk_payload_struct* payload;
+    unsigned int payload_iov;
+    unsigned int payload_offset;
+    /* number of holders of the chunk, see cp_holdChunk() */
+    unsigned int references;
+    /* the DATA chunk, chunk_len bytes: chunks come from the size classes of
+       cp_allocChunk(), so the space behind the chunk must not be used */
+    unsigned char data[];
 } chunk_data;
 
 #ifndef max
@@ -219,7 +267,7 @@ void read_tracelevels(void);
 void debug_print(FILE * fd, const char *f, ...);
 
 /**
- * function to output the result of the adl_gettime-call, i.e. the time now
+ * function to output the result of the adl_now-call, i.e. the time now
  */
 void print_time(short level);
 
@@ -76,8 +76,12 @@ typedef struct UDP_HEADER {
 #endif
 
 
-#define MAX_MTU_SIZE              1500
+/* the largest packet handled, i.e. a jumbo frame, the path MTU is discovered per path */
+#define MAX_MTU_SIZE              9000
+/* the path MTU assumed before a larger one has been discovered */
+#define DEFAULT_MTU_SIZE          1500
 #define IP_HEADERLENGTH             20
+#define IPV6_HEADERLENGTH           40
 
 /**
  * the common header, maybe we need to check for sizes of types on 64 bit machines
@@ -98,6 +102,10 @@ SCTP_common_header;
  * max. SCTP-datagram length without common header
  */
 #define MAX_SCTP_PDU   (MAX_MTU_SIZE - IP_HEADERLENGTH - sizeof(SCTP_common_header))
+/*
+ * SCTP-datagram length without common header at the default path MTU
+ */
+#define DEFAULT_SCTP_PDU   (DEFAULT_MTU_SIZE - IP_HEADERLENGTH - sizeof(SCTP_common_header))
 
 
 /*
@@ -136,6 +144,7 @@ SCTP_message;
 #define CHUNK_FORWARD_TSN       0xC0
 #define CHUNK_ASCONF            0xC1
 #define CHUNK_ASCONF_ACK        0x80
+#define CHUNK_PAD               0x84
 
 #define STOP_PROCESSING(chunk_id)               (((guint8)chunk_id & 0xC0)==0x00))
 #define STOP_PROCESSING_WITH_ERROR(chunk_id)    (((guint8)chunk_id & 0xC0)==0x40))
@@ -361,6 +370,8 @@ typedef struct SCTP_HEARTBEAT
     SCTP_vlparam_header HB_Info;
     guint32 sendingTime;
     guint32 pathID;
+    /* size of the packet, if the heartbeat is a path MTU probe, else 0 */
+    guint32 probeSize;
 #ifdef MD5_HMAC
     guint8 hmac[16];
 #elif SHA_HMAC
@@ -46,12 +46,22 @@
 #include "SCTP-control.h"
 #include "adaptation.h"
 #include "bundling.h"
+#include "flowcontrol.h"
 #include "pathmanagement.h"
 
 /*------------------------ defines -----------------------------------------------------------*/
 #define RTO_ALPHA            0.125
 #define RTO_BETA              0.25
 
+/* path MTU discovery (RFC 8899): a probe that is not acknowledged after being sent
+   this many times is taken as lost */
+#define PM_MAX_PROBES           3
+/* the search stops, when the largest working and the smallest failed probe size
+   are no farther apart than this */
+#define PM_PMTU_GRANULARITY     32
+/* time in msecs after which a completed search is started again */
+#define PM_PMTU_RAISE_TIMER     600000
+
 
 /*----------------------- Typedefs ------------------------------------------------------------*/
 
@@ -93,9 +103,19 @@ typedef struct PATHDATA
     /** ID of the heartbeat timer */
     TimerID hearbeatTimer;
     /** time of last rto update */
-    struct timeval rto_update;
+    adl_time rto_update;
     /** ID of path */
     unsigned int pathID;
+    /** path MTU, i.e. the largest packet known to reach the peer on this path */
+    unsigned int pmtu;
+    /** the smallest probe that did not reach the peer, 0 if no probe failed */
+    unsigned int pmtuLimit;
+    /** size of the outstanding path MTU probe, 0 if there is none */
+    unsigned int probeSize;
+    /** number of times the outstanding probe has been sent */
+    unsigned int probeCount;
+    /** ID of the path MTU probe timer */
+    TimerID probeTimer;
     /*@} */
 } PathData;
 
@@ -135,31 +155,138 @@ typedef struct PATHMANDATA
  * this pointer is set to point to the current asssociation's path management struct
  * it becomes zero after we have treated an incoming/outgoing datagram
  */
-PathmanData *pmData;
+ENGINE_LOCAL PathmanData *pmData;
 
 /*-------------------------- Function Implementations -------------------------------------------*/
 
 /*------------------- Internal Functions --------------------------------------------------------*/
 
 /**
-  return the current system time converted to a value of  milliseconds.
-  MSB of tv_sec field are removed in order
-  to make representation in millisecs possible. This done by taking the remainder of
-  a division by 1728000 = 20x24x60x60, restarting millisecs count every 20 days.
-  @return unsigned 32 bit value representing system time in milliseconds. Hmmmh.
+  return the current monotonic time converted to a value of milliseconds.
+  The value wraps around every 49.7 days, users only take differences of two values
+  as unsigned 32 bit numbers, which stay correct across the wrap.
+  @return unsigned 32 bit value representing the time in milliseconds.
 */
 unsigned int pm_getTime(void)
 {
-    unsigned int curTimeMilli;
-    struct timeval curTime;
+    return (unsigned int)(adl_now() / ADL_NSECS_PER_MSEC);
+}                               /* end: pm_ sctp_getTime */
+
 
-    adl_gettime(&curTime);
+/**
+ * sets the path MTU of a path, and tells flowcontrol how long the chunks in a packet
+ * to that path may be
+ * @param  pathID  index of the path
+ * @param  pmtu    the path MTU
+ */
+static void pm_setPMTU(short pathID, unsigned int pmtu)
+{
+    pmData->pathData[pathID].pmtu = pmtu;
+    fc_setMTU(pathID, pmtu - mdi_readHeaderLength(pathID));
+    event_logii(INTERNAL_EVENT_0, "path MTU of path %d is %u", pathID, pmtu);
+}
 
-    /* modulo operation overlfows every 20 days */
-    curTimeMilli = (curTime.tv_sec % 1728000) * 1000 + curTime.tv_usec / 1000;
 
-    return curTimeMilli;
-}                               /* end: pm_ sctp_getTime */
+/**
+ * falls back to the default path MTU, and restarts the path MTU discovery of a path
+ * @param  pathID  index of the path
+ */
+static void pm_resetPMTU(short pathID)
+{
+    pmData->pathData[pathID].pmtuLimit = 0;
+    pmData->pathData[pathID].probeSize = 0;
+    pmData->pathData[pathID].probeCount = 0;
+    if (pmData->pathData[pathID].pmtu != DEFAULT_MTU_SIZE) pm_setPMTU(pathID, DEFAULT_MTU_SIZE);
+}
+
+
+/**
+ * @return the size of the next path MTU probe for a path, or 0 if the search is complete.
+ *         The largest packet is tried first, then the search halves the interval between
+ *         the path MTU and the smallest failed probe.
+ */
+static unsigned int pm_nextProbeSize(PathData* path)
+{
+    if (path->pmtu >= MAX_MTU_SIZE) return 0;
+    if (path->pmtuLimit == 0) return MAX_MTU_SIZE;
+    if (path->pmtuLimit <= path->pmtu + PM_PMTU_GRANULARITY) return 0;
+    return ((path->pmtu + path->pmtuLimit) / 2) & ~3U;
+}
+
+
+/**
+ * sends a path MTU probe, i.e. a heartbeat padded to the size of the probe
+ * @param  pathID  index of the path
+ * @return 0 if the probe was sent, else -1 (e.g. the probe exceeds the local MTU)
+ */
+static int pm_sendProbe(short pathID)
+{
+    ChunkID heartbeatCID;
+    unsigned int size;
+    int result;
+
+    size = pmData->pathData[pathID].probeSize;
+    heartbeatCID = ch_makeHeartbeat(pm_getTime(), pathID, size);
+    result = bu_sendPadded(ch_chunkString(heartbeatCID), size - mdi_readHeaderLength(pathID), pathID);
+    ch_deleteChunk(heartbeatCID);
+    pmData->pathData[pathID].probeCount++;
+    event_logiii(VERBOSE, "path MTU probe of %u bytes sent on path %d, result %d", size, pathID, result);
+    return (result == 0) ? 0 : -1;
+}
+
+
+/**
+ * does the next step of the path MTU discovery of a path: sends the next probe, or
+ * gives up the outstanding one, and starts the probe timer
+ * @param  pathID  index of the path
+ */
+static void pm_probePMTU(short pathID)
+{
+    PathData *path = &(pmData->pathData[pathID]);
+    unsigned int delay;
+
+    if (path->probeTimer != 0) {
+        adl_stopTimer(path->probeTimer);
+        path->probeTimer = 0;
+    }
+
+    if (path->state != PM_ACTIVE) {
+        /* probe only confirmed paths, that are not failing */
+        path->probeSize = 0;
+        delay = path->rto;
+    } else {
+        for (;;) {
+            if (path->probeSize != 0 && path->probeCount >= PM_MAX_PROBES) {
+                /* packets of this size do not reach the peer */
+                event_logii(INTERNAL_EVENT_0, "path MTU probe of %u bytes on path %d failed",
+                            path->probeSize, pathID);
+                path->pmtuLimit = path->probeSize;
+                path->probeSize = 0;
+            }
+            if (path->probeSize == 0) {
+                path->probeSize = pm_nextProbeSize(path);
+                path->probeCount = 0;
+            }
+            if (path->probeSize == 0) {
+                /* search complete, the path may change, so search again later */
+                event_logii(INTERNAL_EVENT_0, "path MTU discovery of path %d done: %u bytes",
+                            pathID, path->pmtu);
+                path->pmtuLimit = 0;
+                delay = PM_PMTU_RAISE_TIMER;
+                break;
+            }
+            if (pm_sendProbe(pathID) == 0) {
+                delay = path->rto;
+                break;
+            }
+            /* a probe that cannot be sent has failed at once */
+            path->probeCount = PM_MAX_PROBES;
+        }
+    }
+    path->probeTimer = adl_startTimer(delay, &pm_probeTimer, TIMER_TYPE_PMTU,
+                                      (void *) &pmData->associationID,
+                                      (void *) &path->pathID);
+}
 
 
 /**
@@ -212,6 +339,8 @@ static gboolean handleChunksRetransmitted(short pathID)
         /* Set state of this path to inactive and notify change of state to ULP */
         pmData->pathData[pathID].state = PM_INACTIVE;
         event_logi(INTERNAL_EVENT_0, "handleChunksRetransmitted: path %d to INACTIVE ", pathID);
+        /* the path may have become a black hole for packets of the discovered size */
+        pm_resetPMTU(pathID);
         /* check if an active path is left */
         allPathsInactive = TRUE;
         for (pID = 0; pID < pmData->numberOfPaths; pID++) {
@@ -385,7 +514,7 @@ void pm_heartbeatTimer(TimerID timerID, void *associationIDvoid, void *pathIDvoi
          */
         /* send heartbeat if no chunks have been acked in the last HB-intervall (path is idle). */
         event_log(VERBOSE, "--------------> Sending HB");
-        heartbeatCID = ch_makeHeartbeat(pm_getTime(), pathID);
+        heartbeatCID = ch_makeHeartbeat(pm_getTime(), pathID, 0);
         bu_put_Ctrl_Chunk(ch_chunkString(heartbeatCID), &pathID);
         bu_sendAllChunks(&pathID);
         ch_deleteChunk(heartbeatCID);
@@ -425,6 +554,41 @@ void pm_heartbeatTimer(TimerID timerID, void *associationIDvoid, void *pathIDvoi
 }                               /* end: pm_heartbeatTimer */
 
 
+/**
+  pm_probeTimer is called by the adaption-layer when the path MTU probe timer expires.
+  It sends the outstanding probe again, or the next one.
+  @param timerID  ID of the probe timer that expired.
+  @param associationIDvoid  pointer to the association-ID
+  @param pathIDvoid         pointer to the path-ID
+*/
+void pm_probeTimer(TimerID timerID, void *associationIDvoid, void *pathIDvoid)
+{
+    unsigned int associationID;
+    unsigned int pathID;
+
+    associationID = *((unsigned int *) associationIDvoid);
+    pathID = *((unsigned int *) pathIDvoid);
+    if (mdi_setAssociationData(associationID)) {
+        error_logi(ERROR_MAJOR, "probe timer expired association %08u does not exist", associationID);
+        return;
+    }
+    pmData = (PathmanData *) mdi_readPathMan();
+    if (pmData == NULL || pmData->pathData == NULL) {
+        error_log(ERROR_MAJOR, "pm_probeTimer: mdi_readPathMan failed");
+        mdi_clearAssociationData();
+        return;
+    }
+    if (pathID >= (unsigned int)pmData->numberOfPaths) {
+        error_logi(ERROR_MAJOR, "pm_probeTimer: invalid path ID %d", pathID);
+        mdi_clearAssociationData();
+        return;
+    }
+    pmData->pathData[pathID].probeTimer = 0;
+    pm_probePMTU((short)pathID);
+    mdi_clearAssociationData();
+}                               /* end: pm_probeTimer */
+
+
 /**
  * simple function that sends a heartbeat chunk to the indicated address
  * @param  pathID index to the address, where HB is to be sent to
@@ -450,7 +614,7 @@ int pm_doHB(gshort pathID)
         return SCTP_PARAMETER_PROBLEM;
     }
     pid = (guint32)pathID;
-    heartbeatCID = ch_makeHeartbeat(pm_getTime(), pathID);
+    heartbeatCID = ch_makeHeartbeat(pm_getTime(), pathID, 0);
     bu_put_Ctrl_Chunk(ch_chunkString(heartbeatCID),&pid);
     bu_sendAllChunks(&pid);
     ch_deleteChunk(heartbeatCID);
@@ -469,6 +633,7 @@ void pm_heartbeatAck(SCTP_heartbeat * heartbeatChunk)
 {
     unsigned int roundtripTime;
     unsigned int sendingTime;
+    unsigned int probeSize;
     short pathID;
     ChunkID heartbeatCID;
     PathmanData *old_pmData = NULL;
@@ -488,6 +653,7 @@ void pm_heartbeatAck(SCTP_heartbeat * heartbeatChunk)
     heartbeatCID = ch_makeChunk((SCTP_simple_chunk *) heartbeatChunk);
     pathID = ch_HBpathID(heartbeatCID);
     sendingTime = ch_HBsendingTime(heartbeatCID);
+    probeSize = ch_HBprobeSize(heartbeatCID);
     roundtripTime = pm_getTime() - sendingTime;
     event_logii(INTERNAL_EVENT_0, "HBAck for path %u, RTT = %u msecs", pathID, roundtripTime);
 
@@ -530,6 +696,12 @@ void pm_heartbeatAck(SCTP_heartbeat * heartbeatChunk)
     pmData->pathData[pathID].heartbeatAcked = TRUE;
     pmData->pathData[pathID].timerBackoff = FALSE;
 
+    if (probeSize != 0 && probeSize == pmData->pathData[pathID].probeSize) {
+        /* the probe reached the peer, go on with the next one */
+        pmData->pathData[pathID].probeSize = 0;
+        if (probeSize > pmData->pathData[pathID].pmtu) pm_setPMTU(pathID, probeSize);
+        pm_probePMTU(pathID);
+    }
 }                               /* end: pm_heartbeatAck */
 
 
@@ -543,7 +715,7 @@ void pm_heartbeatAck(SCTP_heartbeat * heartbeatChunk)
  */
 void pm_chunksAcked(short pathID, unsigned int newRTT)
 {
-    struct timeval now;
+    adl_time now;
 
     pmData = (PathmanData *) mdi_readPathMan();
 
@@ -569,18 +741,18 @@ void pm_chunksAcked(short pathID, unsigned int newRTT)
 
     if (pmData->pathData[pathID].state == PM_ACTIVE) {
         /* Update RTO only if is the first data chunk acknowldged in this RTT intervall. */
-        adl_gettime(&now);
-        if (timercmp(&now, &(pmData->pathData[pathID].rto_update), < )) {
+        now = adl_now();
+        if (now < pmData->pathData[pathID].rto_update) {
             event_logiiii(VERBOSE, "pm_chunksAcked: now %lu sec, %lu usec - no update before %lu sec, %lu usec",
-                        now.tv_sec, now.tv_usec,
-                        pmData->pathData[pathID].rto_update.tv_sec,
-                        pmData->pathData[pathID].rto_update.tv_usec);
+                        ADL_TIME_SECS(now), ADL_TIME_USECS(now),
+                        ADL_TIME_SECS(pmData->pathData[pathID].rto_update),
+                        ADL_TIME_USECS(pmData->pathData[pathID].rto_update));
             newRTT = 0;
         } else {
             if (newRTT != 0) {
                 /* only if actually new valid RTT measurement is taking place, do update the time */
-                pmData->pathData[pathID].rto_update = now;
-                adl_add_msecs_totime(&(pmData->pathData[pathID].rto_update), pmData->pathData[pathID].srtt);
+                pmData->pathData[pathID].rto_update = now +
+                    (adl_time)pmData->pathData[pathID].srtt * ADL_NSECS_PER_MSEC;
             }
         }
         handleChunksAcked(pathID, newRTT);
@@ -797,6 +969,11 @@ void pm_disableAllHB(void)
             pmData->pathData[pathID].heartbeatEnabled = FALSE;
             event_logi(INTERNAL_EVENT_0, "pm_disableAllHB: path %d disabled", (unsigned int) pathID);
         }
+        /* path MTU probes are heartbeats, too */
+        if (pmData->pathData[pathID].probeTimer != 0) {
+            adl_stopTimer(pmData->pathData[pathID].probeTimer);
+            pmData->pathData[pathID].probeTimer = 0;
+        }
     }
 }                               /* end: pm_disableAllHB */
 
@@ -928,6 +1105,34 @@ unsigned int pm_readRttVar(short pathID)
 }                               /* end: pm_readRttVar */
 
 
+
+/**
+  pm_readMTU returns the path MTU of a path, as far as it has been discovered.
+  @param pathID  index of the address of the path
+  @return  path MTU in bytes, 0 if the path does not exist
+*/
+unsigned int pm_readMTU(short pathID)
+{
+    pmData = (PathmanData *) mdi_readPathMan();
+
+    if (pmData == NULL) {
+        error_log(ERROR_MAJOR, "pm_readMTU: mdi_readPathMan failed");
+        return 0;
+    }
+    if (pmData->pathData == NULL) {
+        error_logi(ERROR_MAJOR, "pm_readMTU(%d): Path Data Structures not initialized yet, returning !", pathID);
+        return 0;
+    }
+
+    if (pathID >= 0 && pathID < pmData->numberOfPaths) {
+        return pmData->pathData[pathID].pmtu;
+    } else {
+        error_logi(ERROR_MAJOR, "pm_readMTU: invalid path ID %d", pathID);
+        return 0;
+    }
+}                               /* end: pm_readMTU */
+
+
 /**
   pm_readSRTT returns the currently set SRTT value for a certain path.
   @param pathID    index of the address/path
@@ -1216,6 +1421,22 @@ short pm_setPaths(short noOfPaths, short primaryPathID)
             pmData->pathData[i].hearbeatTimer = 0;
             pmData->pathData[i].pathID = i;
 
+            /* path MTU discovery starts, when the path has been confirmed */
+            pmData->pathData[i].pmtu = DEFAULT_MTU_SIZE;
+            pmData->pathData[i].pmtuLimit = 0;
+            pmData->pathData[i].probeSize = 0;
+            pmData->pathData[i].probeCount = 0;
+            fc_setMTU((short)i, DEFAULT_MTU_SIZE - mdi_readHeaderLength((short)i));
+            if (mdi_readDontFragment((short)i)) {
+                pmData->pathData[i].probeTimer =
+                    adl_startTimer(pmData->pathData[i].rto, &pm_probeTimer, TIMER_TYPE_PMTU,
+                                   (void *) &pmData->associationID,
+                                   (void *) &pmData->pathData[i].pathID);
+            } else {
+                /* probes would be fragmented, and pass for any size */
+                pmData->pathData[i].probeTimer = 0;
+            }
+
             b = mdi_getDefaultMaxBurst();
 
             if (i != primaryPathID) {
@@ -1244,7 +1465,7 @@ short pm_setPaths(short noOfPaths, short primaryPathID)
                                     (void *) &pmData->pathData[i].pathID);
             }
             /* after RTO we can do next RTO update */
-            adl_gettime(&(pmData->pathData[i].rto_update));
+            pmData->pathData[i].rto_update = adl_now();
 
         }
 
@@ -1308,6 +1529,10 @@ void pm_deletePathman(void *pathmanPtr)
                 adl_stopTimer(pmData->pathData[i].hearbeatTimer);
                 pmData->pathData[i].hearbeatTimer = 0;
             }
+            if (pmData->pathData[i].probeTimer != 0) {
+                adl_stopTimer(pmData->pathData[i].probeTimer);
+                pmData->pathData[i].probeTimer = 0;
+            }
         }
     }
 
@@ -86,6 +86,14 @@ void pm_heartbeat(SCTP_heartbeat * heartbeatChunk, unsigned int source_address);
 void pm_heartbeatTimer(TimerID timerID, void *associationIDvoid, void *pathIDvoid);
 
 
+/* pm_probeTimer is called by the adaption-layer when the path MTU probe timer expires.
+   params: timerID:            ID of timer
+           associationIDvoid:  pointer to the association-ID
+           pathIDvoid:         pointer to the path-ID
+*/
+void pm_probeTimer(TimerID timerID, void *associationIDvoid, void *pathIDvoid);
+
+
 
 /* pm_heartbeatAck is called when a heartbeat acknowledgement was received from the peer.
    params: heartbeatChunk: the heartbeat chunk
@@ -199,6 +207,14 @@ unsigned int pm_readSRTT(short pathID);
 unsigned int pm_readRttVar(short pathID);
 
 
+/**
+ * pm_readMTU returns the path MTU of a path, as discovered by path MTU probes.
+ * @param pathID  index of the address of the path
+ * @return  path MTU in bytes, 0 if the path does not exist
+ */
+unsigned int pm_readMTU(short pathID);
+
+
 /**
  * pm_readState returns the current state of the path.
  * @params pathID      index of the path that is checked for its state
@@ -453,6 +453,10 @@ gint rbu_rcvDatagram(guint address_index, guchar * datagram, guint len)
             event_log(INTERNAL_EVENT_0, "*******************  Bundling received COOKIE ACK chunk");
             sctlr_cookieAck((SCTP_simple_chunk *) chunk);
             break;
+        case CHUNK_PAD:
+            /* fills up path MTU probes (RFC 4820), nothing to do */
+            event_logi(VVERBOSE, "Bundling received PAD chunk of %u bytes", chunk_len);
+            break;
      /* case CHUNK_ECNE:
         case CHUNK_CWR:
             event_logi(INTERNAL_EVENT_0,
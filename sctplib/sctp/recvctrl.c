@@ -45,12 +45,20 @@
 #include "adaptation.h"
 #include "bundling.h"
 #include "distribution.h"
+#include "flowcontrol.h"
 #include "streamengine.h"
 #include "SCTP-control.h"
 
 #include <glib.h>
 #include <string.h>
 
+/* initial size of the TSN map in bits, a power of 2 */
+#define RXC_MIN_MAP_BITS        256
+/* gap block offsets are 16 bit, TSNs that lie further ahead of ctsna are dropped */
+#define RXC_MAX_MAP_BITS        65536
+/* the most duplicates that fit into a SACK */
+#define RXC_MAX_DUPLICATES      (MAX_VARIABLE_SACK_SIZE / sizeof(duplicate))
+
 /**
  * this struct contains all necessary data for creating SACKs from received data chunks
  */
@@ -59,16 +67,20 @@ typedef struct rxc_buffer_struct
     /*@{ */
     /** */
     void *sack_chunk;
+    /** bit map of the TSNs after ctsna up to highest, a bit is set when its TSN was
+        received. The bit of a TSN is at position (TSN mod map_bits), so the map slides
+        along with ctsna, and bits outside of that range are always clear */
+    guint32 *tsn_map;
+    /** size of the map in bits, a power of 2 */
+    unsigned int map_bits;
+    /** duplicates received since the last SACK was sent */
+    guint32 dups[RXC_MAX_DUPLICATES];
     /** */
-    GList *frag_list;
-    /** */
-    GList *dup_list;
+    unsigned int num_of_dups;
     /** cumulative TSN acked */
     unsigned int ctsna;
-    /** store lowest tsn value for dups (!) */
-    unsigned int lowest;
-    /** stores highest tsn received so far, taking care of wraps
-        i.e. highest < lowest indicates a wrap */
+    /** stores highest tsn received so far, taking care of wraps,
+        it is never before ctsna */
     unsigned int highest;
     /** */
     boolean contains_valid_sack;
@@ -110,12 +122,13 @@ void *rxc_new_recvctrl(unsigned int remote_initial_TSN, unsigned int number_of_d
     tmp = (rxc_buffer*)malloc(sizeof(rxc_buffer));
     if (!tmp) error_log(ERROR_FATAL, "Malloc failed");
 
-    tmp->frag_list = NULL;
-    tmp->dup_list = NULL;
+    tmp->map_bits = RXC_MIN_MAP_BITS;
+    tmp->tsn_map = (guint32*)calloc(RXC_MIN_MAP_BITS / 32, sizeof(guint32));
+    if (!tmp->tsn_map) error_log(ERROR_FATAL, "Malloc failed");
+    tmp->num_of_dups = 0;
     tmp->num_of_addresses = number_of_destination_addresses;
     tmp->sack_chunk = malloc(sizeof(SCTP_sack_chunk));
     tmp->ctsna = remote_initial_TSN - 1; /* as per section 4.1 */
-    tmp->lowest = remote_initial_TSN - 1;
     tmp->highest = remote_initial_TSN - 1;
     tmp->contains_valid_sack = FALSE;
     tmp->timer_running = FALSE;
@@ -147,292 +160,158 @@ void rxc_delete_recvctrl(void *rxc_instance)
         tmp->timer_running = FALSE;
     }
 
-    g_list_foreach(tmp->frag_list, &free_list_element, NULL);
-    g_list_free(tmp->frag_list);
-    g_list_foreach(tmp->dup_list, &free_list_element, NULL);
-    g_list_free(tmp->dup_list);
+    free(tmp->tsn_map);
     free(tmp);
 }
 
 
 /**
- * function to find out, whether a chunk is duplicate or not
- * @param rbuf	instance of rxc_buffer
- * @param chunk_tsn	tsn we just received
- * @return the boolean response
+ * @return the index of the lowest bit that is set in a word, which must not be 0
  */
-boolean rxc_chunk_is_duplicate(rxc_buffer * rbuf, unsigned int chunk_tsn)
+static unsigned int rxc_lowest_bit(guint32 word)
 {
-    unsigned int low = rbuf->lowest;
-    unsigned int hi = rbuf->highest;
-    unsigned int ctsna = rbuf->ctsna;
-    fragment32 *frag;
-    GList *temp = NULL;
-
-    /* Assume, lowest and highest have already been updated */
-    if (between(low, chunk_tsn, ctsna))
-        return TRUE;
-    if (!between(ctsna, chunk_tsn, hi))
-        return FALSE;
-
-    /* Now check, whether chunk_tsn is in the (sorted !) list of fragments */
-    if (rbuf->frag_list == NULL) /* no fragments ! */
-        return FALSE;
-
-    /* if we are still here, we need to check, whether chunk_tsn is between any fragment bounds */
-    temp = g_list_first(rbuf->frag_list);
-    while (temp != NULL) {
-        if (temp->data == NULL) {
-            error_log(ERROR_FATAL, "LIST ERROR rxc_chunk_is_duplicate(2)");
-            temp = g_list_next(temp);
-            continue;
-        }
-        frag = (fragment32*) temp->data;
-        if (between(frag->start_tsn, chunk_tsn, frag->stop_tsn))
-            return TRUE;
-        /* assuming an ordered list of fragments */
-        if (after(frag->stop_tsn, chunk_tsn))
-           return FALSE;
-        temp = g_list_next(temp);
-    }
-    /* never reached */
-    error_log(ERROR_MAJOR, "while loop went past end of list....should not have happened !");
-    return FALSE;
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_ctz(word);
+#else
+    unsigned int n = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        n++;
+    }
+    return n;
+#endif
 }
 
+
 /**
- * Helper function to do the correct update of rxc->lowest
- * Function is only called, if that is necessary !
+ * function to find out, whether a TSN after ctsna (and not after highest) was received
  * @param rbuf	instance of rxc_buffer
- * @param chunk_tsn	tsn we just received
- * @return boolean indicating whether lowest was updated or not
+ * @param tsn	the TSN
+ * @return TRUE if the TSN was received before
  */
-boolean rxc_update_lowest(rxc_buffer * rbuf, unsigned int chunk_tsn)
+static boolean rxc_tsn_received(rxc_buffer * rbuf, unsigned int tsn)
 {
-    unsigned int low = rbuf->lowest;
-    if (before(chunk_tsn, low)) {
-        rbuf->lowest = chunk_tsn;
-        /* and it must be a duplicate ! */
-        return TRUE;
-    } else
-        return FALSE /* no update of lowest */ ;
+    unsigned int bit = tsn & (rbuf->map_bits - 1);
+    return ((rbuf->tsn_map[bit >> 5] >> (bit & 31)) & 1) ? TRUE : FALSE;
 }
 
+
 /**
- * Helper function to do the correct update of rxc->highest
- * Function is only called, if that is necessary !
+ * sets or clears the bits of a range of TSNs, one word at a time
  * @param rbuf	instance of rxc_buffer
- * @param chunk_tsn	tsn we just received
- * @return boolean indicating whether highest was updated or not
+ * @param tsn	first TSN of the range
+ * @param count	number of TSNs in the range
+ * @param received	TRUE to set the bits, FALSE to clear them
  */
-boolean rxc_update_highest(rxc_buffer * rbuf, unsigned int chunk_tsn)
+static void rxc_mark_tsns(rxc_buffer * rbuf, unsigned int tsn, unsigned int count, boolean received)
 {
-    unsigned int hi = rbuf->highest;
-    if (after(chunk_tsn, hi)) {
-        rbuf->highest = chunk_tsn;
-        return TRUE;
-    } else
-        return FALSE /* no update of highest */ ;
+    unsigned int n, bit;
+    guint32 mask;
+
+    while (count > 0) {
+        bit = tsn & (rbuf->map_bits - 1);
+        n = 32 - (bit & 31);
+        if (n > count) n = count;
+        mask = (n == 32) ? 0xFFFFFFFF : ((((guint32)1 << n) - 1) << (bit & 31));
+        if (received == TRUE)
+            rbuf->tsn_map[bit >> 5] |= mask;
+        else
+            rbuf->tsn_map[bit >> 5] &= ~mask;
+        tsn   += n;
+        count -= n;
+    }
 }
 
-int rxc_sort_duplicates(duplicate * one, duplicate * two)
-{
-    if (before(one->duplicate_tsn, two->duplicate_tsn)) {
-        return -1;
-    } else if (after(one->duplicate_tsn, two->duplicate_tsn)) {
-         return 1;
-    } else                      /* one==two */
-        return 0;
-}
 
-int rxc_sort_fragments(fragment32 * one, fragment32 * two)
+/**
+ * counts the TSNs from tsn on, that all were received (or all were not received),
+ * scanning the map a word at a time
+ * @param rbuf	instance of rxc_buffer
+ * @param tsn	first TSN to look at
+ * @param count	maximum number of TSNs to look at
+ * @param received	TRUE to count received TSNs, FALSE to count missing ones
+ * @return length of the run, at most count
+ */
+static unsigned int rxc_run_length(rxc_buffer * rbuf, unsigned int tsn, unsigned int count, boolean received)
 {
-    if (before(one->start_tsn, two->start_tsn) && before(one->stop_tsn, two->stop_tsn)) {
-        return -1;
-    } else if (after(one->start_tsn, two->start_tsn) && after(one->stop_tsn, two->stop_tsn)) {
-         return 1;
-    } else                      /* one==two */
-        return 0;
+    unsigned int run = 0, bit;
+    guint32 word;
+
+    while (run < count) {
+        bit = tsn & (rbuf->map_bits - 1);
+        word = rbuf->tsn_map[bit >> 5];
+        /* the bits of the TSNs that end the run */
+        if (received == TRUE) word = ~word;
+        word >>= (bit & 31);
+        if (word != 0) {
+            run += rxc_lowest_bit(word);
+            break;
+        }
+        run += 32 - (bit & 31);
+        tsn += 32 - (bit & 31);
+    }
+    return (run < count) ? run : count;
 }
 
 
 /**
- * Helper function for inserting chunk_tsn in the list of duplicates
+ * enlarges the TSN map, so that it covers a TSN, that lies offset TSNs after ctsna
  * @param rbuf	instance of rxc_buffer
- * @param chunk_tsn	tsn we just received
+ * @param offset	distance of the TSN from ctsna, less than RXC_MAX_MAP_BITS
+ * @return TRUE for success, FALSE if no memory was available
  */
-void rxc_update_duplicates(rxc_buffer * rbuf, unsigned int ch_tsn)
+static boolean rxc_grow_map(rxc_buffer * rbuf, unsigned int offset)
 {
-    duplicate* match;
-    GList* current = NULL;
-
-    current = g_list_first(rbuf->dup_list);
-    while (current != NULL) {
-        match = (duplicate*)current->data;
-        if (ch_tsn == match->duplicate_tsn) return;
-        current = g_list_next(current);
+    guint32 *new_map;
+    unsigned int new_bits = rbuf->map_bits, tsn, bit;
+
+    while (new_bits <= offset) new_bits *= 2;
+    new_map = (guint32*)calloc(new_bits / 32, sizeof(guint32));
+    if (new_map == NULL) {
+        error_log(ERROR_MAJOR, "rxc_grow_map: out of memory");
+        return FALSE;
     }
-    /* its new - add it to the list */
-    match = (duplicate*)malloc(sizeof(duplicate));
-    match->duplicate_tsn = ch_tsn;
-    rbuf->dup_list =  g_list_insert_sorted(rbuf->dup_list, match, (GCompareFunc) rxc_sort_duplicates);
+    event_logii(VERBOSE, "rxc_grow_map: TSN map now has %u instead of %u bits", new_bits, rbuf->map_bits);
 
+    /* the received TSNs move to their positions in the larger map */
+    for (tsn = rbuf->ctsna + 1; !after(tsn, rbuf->highest); tsn++) {
+        if (rxc_tsn_received(rbuf, tsn) == TRUE) {
+            bit = tsn & (new_bits - 1);
+            new_map[bit >> 5] |= (guint32)1 << (bit & 31);
+        }
+    }
+    free(rbuf->tsn_map);
+    rbuf->tsn_map = new_map;
+    rbuf->map_bits = new_bits;
+    return TRUE;
 }
 
 
-
 /**
- * Helper function to do the correct update of rxc->ctsna
+ * moves ctsna up to the last of the TSNs received without a gap after it,
+ * and clears the bits of the TSNs it passes
  * @param rbuf	instance of rxc_buffer
- * @param chunk_tsn	tsn we just received
  */
-void rxc_bubbleup_ctsna(rxc_buffer * rbuf)
+static void rxc_bubbleup_ctsna(rxc_buffer * rbuf)
 {
-    fragment32 *frag;
-    GList *temp = NULL, *old = NULL;
-
-    event_log(INTERNAL_EVENT_0, "Entering rxc_bubbleup_ctsna... ");
-
-    if (rbuf->frag_list == NULL) return;
-
-    temp = g_list_first(rbuf->frag_list);
-
-    while (temp != NULL) {
-        frag = (fragment32*)temp->data;
-        if (frag != NULL){
-            if (rbuf->ctsna + 1 == frag->start_tsn) {
-                rbuf->ctsna = frag->stop_tsn;
-                old = temp;
-                temp = g_list_next(temp);
-                rbuf->frag_list = g_list_remove_link(rbuf->frag_list, old);
-                g_list_free_1(old); free(frag);
-            }
-            else
-                return;
-        } else {
-            error_log(ERROR_FATAL, "rxc_bubbleup_ctsna: fragment data was NULL !!!!!!! ");
-            return;
-        }
-    }  /* end while */
-}
+    unsigned int run;
 
-boolean rxc_update_fragments(rxc_buffer * rbuf, unsigned int ch_tsn)
-{
-    unsigned int lo, hi, gapsize;
-    fragment32 *frag=NULL, *new_frag, * lo_frag;
-    GList *current = NULL, *tmp = NULL;
-
-    event_logi(INTERNAL_EVENT_0, "Entering rxc_update_fragments.tsn==%u.. ", ch_tsn);
-
-    lo = rbuf->ctsna + 1;
-
-    current = g_list_first(rbuf->frag_list);
-
-    while (current != NULL) {
-        frag = (fragment32*)current->data;
-
-        hi = frag->start_tsn - 1;
-        event_logiii(VVERBOSE, "while-loop: lo=%u, tsn=%u, hi=%u, \n", lo, ch_tsn, hi);
-
-        if (between(lo, ch_tsn, hi)) {
-            gapsize = hi - lo + 1;
-            if (gapsize > 1) {
-                event_logi(INTERNAL_EVENT_0, "Value of Gapsize (should be > 1 :) ", gapsize);
-                if (ch_tsn == hi) {
-                    event_log(VVERBOSE, "ch_tsn==hi....");
-                    frag->start_tsn = ch_tsn;
-                    rbuf->new_chunk_received = TRUE;
-                    return TRUE;
-                } else if (ch_tsn == lo) {
-                    event_logii(VVERBOSE, "ch_tsn==lo==%u....rbuf->ctsna==%u....", lo, rbuf->ctsna);
-                    if (ch_tsn == (rbuf->ctsna + 1)) {
-                        rbuf->ctsna++;
-                        rbuf->new_chunk_received = TRUE;
-                        return TRUE;
-                    }
-                    current = g_list_previous(current);
-                    if (current==NULL) {
-                        error_log(ERROR_MAJOR, "Error in Fragment List HANDLING - check program");
-                        return FALSE;
-                    }
-                    frag = (fragment32*)current->data;
-                    frag->stop_tsn = ch_tsn;
-                    rbuf->new_chunk_received = TRUE;
-                    return TRUE;
-                } else {    /* a fragment in between */
-                    new_frag = (fragment32*)malloc(sizeof(fragment32));
-                    new_frag->start_tsn = new_frag->stop_tsn = ch_tsn;
-                    event_log(VVERBOSE, "Inserting new fragment....");
-                    rbuf->frag_list = g_list_insert_sorted(rbuf->frag_list, new_frag, (GCompareFunc) rxc_sort_fragments);
-                    rbuf->new_chunk_received = TRUE;
-                    return FALSE;
-                }
-            } else {        /*gapsize == 1 */
-                event_logi(INTERNAL_EVENT_0, "Value of Gapsize (should be 1 :) %u", gapsize);
-                /* delete fragment, return TRUE */
-                if (lo == rbuf->ctsna + 1) {
-                    rbuf->ctsna = frag->stop_tsn;
-                    rbuf->frag_list = g_list_remove_link(rbuf->frag_list, current);
-                    g_list_free_1(current); free(frag);
-                    rbuf->new_chunk_received = TRUE;
-                    return TRUE;
-                } else {
-                    tmp = current;
-                    current = g_list_previous(current);
-                    if (current == NULL) {
-                        error_log(ERROR_MAJOR, "Error 2 in Fragment List HANDLING - check program");
-                        return FALSE;
-                    }
-                    lo_frag = (fragment32*)current->data;
-                    frag->start_tsn = lo_frag->start_tsn;
-                    rbuf->frag_list = g_list_remove_link(rbuf->frag_list, current);
-                    g_list_free_1(current); free(lo_frag);
-                    current = tmp;
-                    rbuf->new_chunk_received = TRUE;
-                    return TRUE;
-                }
-            }
-        } else {            /* ch_tsn is not in the gap between these two fragments */
-            lo = frag->stop_tsn + 1;
-            event_logi(VVERBOSE, "rxc_update_fragments: Setting lo to %u ", lo);
-        }
-        current = g_list_next(current);
-    }
+    if (!after(rbuf->highest, rbuf->ctsna)) return;
+    run = rxc_run_length(rbuf, rbuf->ctsna + 1, rbuf->highest - rbuf->ctsna, TRUE);
+    rxc_mark_tsns(rbuf, rbuf->ctsna + 1, run, FALSE);
+    rbuf->ctsna += run;
+    event_logi(VVERBOSE, "rxc_bubbleup_ctsna: ctsna is now %u", rbuf->ctsna);
+}
 
-    /* (NULL LISTE)  OR  (End of Fragment List was passed) */
-    if (ch_tsn == lo) {
-        /* just increase ctsna, handle rest in separate update_ctsna() */
-        if (ch_tsn == rbuf->ctsna + 1) {
-            event_logi(VVERBOSE, "Updating rbuf->ctsna==%u", ch_tsn);
-            rbuf->ctsna = ch_tsn;
-            rbuf->new_chunk_received = TRUE;
-            return TRUE;
-        }
-        /* Update last fragment....increase stop_tsn by one */
-        current = g_list_last(rbuf->frag_list);
-        if (current == NULL) {
-            error_log(ERROR_MAJOR, "rxc_update_fragments: Went past end of List....");
-            return FALSE;
-        }
-        frag = (fragment32*)current->data;
-        frag->stop_tsn = frag->stop_tsn + 1;
-        rbuf->new_chunk_received = TRUE;
 
-        event_logiii(VVERBOSE, "Updating last fragment frag.start==%u, frag.stop==%u, tsn=%u",
-                     frag->start_tsn, frag->stop_tsn, ch_tsn);
-        return FALSE;
-    } else {                    /* a new fragment altogether */
-        current = g_list_last(rbuf->frag_list);
-        new_frag = (fragment32*)malloc(sizeof(fragment32));
-        new_frag->start_tsn = ch_tsn;
-        new_frag->stop_tsn = ch_tsn;
-        rbuf->frag_list = g_list_append(rbuf->frag_list, new_frag);
-        event_logiii(VVERBOSE,
-                     "Inserting new  fragment at end...frag.start==%u,frag.stop==%u, tsn=%u",
-                     new_frag->start_tsn, new_frag->stop_tsn, ch_tsn);
-        rbuf->new_chunk_received = TRUE;
-        return FALSE;           /* no ctsna update necessary whatsoever */
-    }
+/**
+ * Helper function for remembering a duplicate TSN for the next SACK
+ * @param rbuf	instance of rxc_buffer
+ * @param ch_tsn	tsn we just received
+ */
+static void rxc_update_duplicates(rxc_buffer * rbuf, unsigned int ch_tsn)
+{
+    if (rbuf->num_of_dups < RXC_MAX_DUPLICATES) rbuf->dups[rbuf->num_of_dups++] = ch_tsn;
 }
 
 
@@ -446,7 +325,6 @@ int rxc_data_chunk_rx(SCTP_data_chunk * se_chk, unsigned int ad_idx)
     unsigned int chunk_tsn;
     unsigned int chunk_len;
     unsigned int assoc_state;
-    boolean result = FALSE;
     int bytesQueued = 0;
     unsigned current_rwnd = 0;
 
@@ -471,7 +349,7 @@ int rxc_data_chunk_rx(SCTP_data_chunk * se_chk, unsigned int ad_idx)
     }
 
     /* do SWS prevention */
-    if (current_rwnd > 0 && current_rwnd <= 2 * MAX_SCTP_PDU) current_rwnd = 1;
+    if (current_rwnd > 0 && current_rwnd <= 2 * DEFAULT_SCTP_PDU) current_rwnd = 1;
 
     /*
      * if any received data chunks have not been acked, sender
@@ -499,18 +377,23 @@ int rxc_data_chunk_rx(SCTP_data_chunk * se_chk, unsigned int ad_idx)
         reported in the SACK as duplicate.
      */
     event_logii(VERBOSE, "rxc_data_chunk_rx : chunk_tsn==%u, chunk_len=%u", chunk_tsn, chunk_len);
-    if (rxc_update_lowest(rxc, chunk_tsn) == TRUE) {
-        /* tsn is even lower than the lowest one received so far */
+    if (!after(chunk_tsn, rxc->ctsna)) {
+        /* tsn has been acked already */
         rxc_update_duplicates(rxc, chunk_tsn);
-    } else if (rxc_update_highest(rxc, chunk_tsn) == TRUE) {
-        rxc->new_chunk_received = TRUE;
-        result = rxc_update_fragments(rxc, chunk_tsn);
-    } else if (rxc_chunk_is_duplicate(rxc, chunk_tsn) == TRUE)
+    } else if (chunk_tsn - rxc->ctsna >= RXC_MAX_MAP_BITS) {
+        /* could not be reported in a gap block, the peer will send it again */
+        event_logii(VERBOSE, "rxc_data_chunk_rx: dropping tsn %u, too far ahead of ctsna %u",
+                    chunk_tsn, rxc->ctsna);
+        return 1;
+    } else if (!after(chunk_tsn, rxc->highest) && rxc_tsn_received(rxc, chunk_tsn) == TRUE) {
         rxc_update_duplicates(rxc, chunk_tsn);
-    else
-        result = rxc_update_fragments(rxc, chunk_tsn);
-
-    if (result == TRUE) rxc_bubbleup_ctsna(rxc);
+    } else if ((chunk_tsn - rxc->ctsna < rxc->map_bits) ||
+               (rxc_grow_map(rxc, chunk_tsn - rxc->ctsna) == TRUE)) {
+        if (after(chunk_tsn, rxc->highest)) rxc->highest = chunk_tsn;
+        rxc_mark_tsns(rxc, chunk_tsn, 1, TRUE);
+        rxc->new_chunk_received = TRUE;
+        if (chunk_tsn == rxc->ctsna + 1) rxc_bubbleup_ctsna(rxc);
+    }
 
     event_logi(VVERBOSE, "rxc_data_chunk_rx: after rxc_bubbleup_ctsna, rxc->ctsna=%u", rxc->ctsna);
 
@@ -532,7 +415,6 @@ int rxc_data_chunk_rx(SCTP_data_chunk * se_chk, unsigned int ad_idx)
 boolean rxc_create_sack(unsigned int *destination_address, boolean force_sack)
 {
     rxc_buffer *rxc;
-    unsigned int num_of_frags;
 
     event_logii(VVERBOSE,
                 "Entering rxc_create_sack(address==%u, force_sack==%s",
@@ -550,9 +432,8 @@ boolean rxc_create_sack(unsigned int *destination_address, boolean force_sack)
         rxc_all_chunks_processed(FALSE);
     }
 
-    num_of_frags = g_list_length(rxc->frag_list);
-
-    if (num_of_frags > 0)
+    /* there is a gap, as long as a TSN after ctsna was received */
+    if (after(rxc->highest, rxc->ctsna))
         rxc_send_sack_everytime();
     else
         rxc_send_sack_every_second_time();
@@ -561,7 +442,6 @@ boolean rxc_create_sack(unsigned int *destination_address, boolean force_sack)
     /* some timers may want to have a SACK anyway */
     /* first sack is sent at once, since datagrams_received==-1 */
     if (force_sack == TRUE) {
-        rxc->lowest = rxc->ctsna;
         bu_put_SACK_Chunk((SCTP_sack_chunk*)rxc->sack_chunk, destination_address);
         return TRUE;
     } else {
@@ -574,7 +454,6 @@ boolean rxc_create_sack(unsigned int *destination_address, boolean force_sack)
                 event_log(VVERBOSE, "Did not send SACK here - returning");
                 return FALSE;
         }
-        rxc->lowest = rxc->ctsna;
         bu_put_SACK_Chunk((SCTP_sack_chunk*)rxc->sack_chunk,destination_address);
         return TRUE;
     }
@@ -635,9 +514,7 @@ void rxc_stop_sack_timer(void)
         return;
     }
     /* also make sure you forget all the duplicates we received ! */
-    g_list_foreach(rxc->dup_list, &free_list_element, NULL);
-    g_list_free(rxc->dup_list);
-    rxc->dup_list = NULL;
+    rxc->num_of_dups = 0;
 
     if (rxc->timer_running == TRUE) {
         result = sctp_stopTimer(rxc->sack_timer);
@@ -669,14 +546,12 @@ void rxc_all_chunks_processed(boolean new_data_received)
     rxc_buffer *rxc=NULL;
     SCTP_sack_chunk *sack=NULL;
     unsigned short num_of_frags, num_of_dups;
-    unsigned short len16, count, frag_start16, frag_stop16;
-    unsigned int pos;
-    duplicate *dptr=NULL, d;
-    fragment32 *f32=NULL;
+    unsigned int pos, tsn, run;
+    duplicate d;
     fragment chunk_frag;
-    GList *temp=NULL;
     int bytesQueued = 0;
     unsigned current_rwnd = 0;
+    unsigned int max_size;
 
     event_log(INTERNAL_EVENT_0, "Entering funtion rxc_all_chunks_processed ()");
 
@@ -688,16 +563,6 @@ void rxc_all_chunks_processed(boolean new_data_received)
 
     if (new_data_received == TRUE) rxc->datagrams_received++;
 
-    num_of_frags = g_list_length(rxc->frag_list);
-    num_of_dups  = g_list_length(rxc->dup_list);
-
-    /* limit size of SACK to 80 bytes plus fixed size chunk and chunk header */
-    /* FIXME : Limit number of Fragments/Duplicates according to ->PATH MTU<-  */
-    if (num_of_frags > 10) num_of_frags = 10;
-    if (num_of_dups > 10)  num_of_dups = 10;
-
-    event_logii(VVERBOSE, "len of frag_list==%u, len of dup_list==%u", num_of_frags, num_of_dups);
-
     bytesQueued = se_getQueuedBytes();
     if (bytesQueued < 0) bytesQueued = 0;
     if ((unsigned int)bytesQueued > rxc->my_rwnd) {
@@ -706,56 +571,53 @@ void rxc_all_chunks_processed(boolean new_data_received)
         current_rwnd = rxc->my_rwnd - bytesQueued;
     }
     /* do SWS prevention */
-    if (current_rwnd > 0 && current_rwnd <= 2 * MAX_SCTP_PDU) current_rwnd = 1;
+    if (current_rwnd > 0 && current_rwnd <= 2 * DEFAULT_SCTP_PDU) current_rwnd = 1;
 
 
     sack = (SCTP_sack_chunk*)rxc->sack_chunk;
-    sack->chunk_header.chunk_id = CHUNK_SACK;
-    sack->chunk_header.chunk_flags = 0;
-    len16 = sizeof(SCTP_chunk_header) + (2 + num_of_dups) * sizeof(unsigned int) +
-            (2 * num_of_frags + 2) * sizeof(unsigned short);
-
-    sack->chunk_header.chunk_length = htons(len16);
-    sack->cumulative_tsn_ack = htonl(rxc->ctsna);
-    /* FIXME : deduct size of data still in queue, that is waiting to be picked up by an ULP */
-    sack->a_rwnd = htonl(current_rwnd);
-    sack->num_of_fragments  = htons(num_of_frags);
-    sack->num_of_duplicates = htons(num_of_dups);
     pos = 0L;
 
-    temp = g_list_first(rxc->frag_list); count = 0;
-    while ((temp != NULL) && (count < num_of_frags)) {
-
-        f32 = (fragment32*)temp->data;
-
-        event_logiii(VVERBOSE,"ctsna==%u, fragment.start==%u, fragment.stop==%u",
-                     rxc->ctsna, f32->start_tsn, f32->stop_tsn);
-
-        if (((f32->start_tsn - rxc->ctsna) > 0xFFFF) || ((f32->stop_tsn - rxc->ctsna) > 0xFFFF)) {
-            error_log(ERROR_MINOR, "Fragment offset becomes too big");
-            break;
-        }
-        frag_start16 = (unsigned short) (f32->start_tsn - rxc->ctsna);
-        frag_stop16 = (unsigned short) (f32->stop_tsn - rxc->ctsna);
-        event_logii(VVERBOSE, "frag_start16==%u, frag_stop16==%u", frag_start16, frag_stop16);
-
-        chunk_frag.start = htons((unsigned short)(f32->start_tsn - rxc->ctsna));
-        chunk_frag.stop = htons((unsigned short)(f32->stop_tsn - rxc->ctsna));
-        event_logii(VVERBOSE, "chunk_frag.start=%u,chunk_frag.stop ==%u",
-                                ntohs(chunk_frag.start), ntohs(chunk_frag.stop));
+    /* as many gap blocks as fit into a packet to the path of the SACK, the duplicates
+       take the rest of it */
+    max_size = fc_readMTU((short)rxc->last_address);
+    if (max_size == 0) max_size = DEFAULT_SCTP_PDU;
+    max_size = min(max_size - (MAX_SCTP_PDU - MAX_VARIABLE_SACK_SIZE), MAX_VARIABLE_SACK_SIZE);
+    num_of_frags = 0;
+    tsn = rxc->ctsna + 1;
+    while (!after(tsn, rxc->highest) && (pos + sizeof(fragment) <= max_size)) {
+        tsn += rxc_run_length(rxc, tsn, rxc->highest - tsn + 1, FALSE);
+        if (after(tsn, rxc->highest)) break;
+        run = rxc_run_length(rxc, tsn, rxc->highest - tsn + 1, TRUE);
+        chunk_frag.start = htons((unsigned short)(tsn - rxc->ctsna));
+        chunk_frag.stop = htons((unsigned short)(tsn + run - 1 - rxc->ctsna));
+        event_logiii(VVERBOSE, "ctsna==%u, fragment.start==%u, fragment.stop==%u",
+                     rxc->ctsna, tsn, tsn + run - 1);
         memcpy(&sack->fragments_and_dups[pos], &chunk_frag, sizeof(fragment));
         pos += sizeof(fragment);
-        temp = g_list_next(temp); count++;
+        num_of_frags++;
+        tsn += run;
     }
-
-    temp = g_list_first(rxc->dup_list); count = 0;
-    while ((temp != NULL) && (count < num_of_dups)) {
-        dptr = (duplicate*)temp->data;
-        if (dptr) d.duplicate_tsn = htonl(dptr->duplicate_tsn);
+    num_of_dups = 0;
+    while ((num_of_dups < rxc->num_of_dups) && (pos + sizeof(duplicate) <= max_size)) {
+        d.duplicate_tsn = htonl(rxc->dups[num_of_dups]);
         memcpy(&sack->fragments_and_dups[pos], &d, sizeof(duplicate));
         pos += sizeof(duplicate);
-        temp = g_list_next(temp); count++;
+        num_of_dups++;
     }
+
+    event_logii(VVERBOSE, "SACK has %u gap blocks, %u duplicates", num_of_frags, num_of_dups);
+
+    sack->chunk_header.chunk_id = CHUNK_SACK;
+    sack->chunk_header.chunk_flags = 0;
+    sack->chunk_header.chunk_length = htons((unsigned short)(sizeof(SCTP_chunk_header) +
+                                                             2 * sizeof(unsigned int) +
+                                                             2 * sizeof(unsigned short) + pos));
+    sack->cumulative_tsn_ack = htonl(rxc->ctsna);
+    /* FIXME : deduct size of data still in queue, that is waiting to be picked up by an ULP */
+    sack->a_rwnd = htonl(current_rwnd);
+    sack->num_of_fragments  = htons(num_of_frags);
+    sack->num_of_duplicates = htons(num_of_dups);
+
     /* start sack_timer set to 200 msecs */
     if (rxc->timer_running != TRUE && new_data_received == TRUE) {
         rxc->sack_timer = adl_startTimer(rxc->delay, &rxc_sack_timer_cb, TIMER_TYPE_SACK, &(rxc->my_association), NULL);
@@ -786,8 +648,8 @@ int rxc_start_sack_timer(unsigned int oldQueueLen)
     if (bytesQueued < 0) bytesQueued = 0;
     /* no new data received, but we want updated SACK to be sent */
     rxc_all_chunks_processed(FALSE);
-    if ((rxc->my_rwnd - oldQueueLen < 2 * MAX_SCTP_PDU) &&
-        (rxc->my_rwnd - bytesQueued >= 2 * MAX_SCTP_PDU)) {
+    if ((rxc->my_rwnd - oldQueueLen < 2 * DEFAULT_SCTP_PDU) &&
+        (rxc->my_rwnd - bytesQueued >= 2 * DEFAULT_SCTP_PDU)) {
         /* send SACK at once */
         rxc_create_sack(&rxc->last_address, TRUE);
         bu_sendAllChunks(&rxc->last_address);
@@ -935,15 +797,9 @@ void rxc_restart_receivecontrol(unsigned int my_rwnd, unsigned int new_remote_TS
         return;
     }
     rxc_stop_sack_timer();
-    g_list_foreach(rxc->frag_list, &free_list_element, NULL);
-    g_list_free(rxc->frag_list);
+    memset(rxc->tsn_map, 0, rxc->map_bits / 8);
     rxc->ctsna = new_remote_TSN - 1;
-    rxc->lowest = new_remote_TSN - 1;
     rxc->highest = new_remote_TSN - 1;
-    /* initialize and set up lists */
-
-    rxc->frag_list = NULL;
-    rxc->dup_list = NULL;
     rxc->contains_valid_sack = FALSE;
     rxc->timer_running = FALSE;
     rxc->datagrams_received = -1;
@@ -960,9 +816,6 @@ int rxc_process_forward_tsn(void* chunk)
     rxc_buffer *rxc=NULL;
     unsigned int fw_tsn;
     unsigned int chunk_len;
-    unsigned int lo, hi;
-    fragment32 *frag=NULL;
-    GList *current = NULL;
 
     SCTP_forward_tsn_chunk* chk = (SCTP_forward_tsn_chunk*)chunk;
 
@@ -981,49 +834,16 @@ int rxc_process_forward_tsn(void* chunk)
         return 0;
     }
 
-    current = g_list_first(rxc->frag_list);
-
-    /* -get first fragment
-       -case1: fw_tsn after hi: delete fragment, continue with next fragment;
-       -case2: fw_tsn between hi and lo-1:
-                delete fragment, set ctsna=hi, break;
-       -case3: fw_tsn before lo-1, set ctsna => fw_tsn, break;
-     */
-    while (current != NULL) {
-        frag = (fragment32*)current->data;
-        if (current != NULL && frag != NULL){
-            lo = frag->start_tsn;
-            hi = frag->stop_tsn;
-            if (before(fw_tsn, lo-1)) {
-                /* case3: fw_tsn before lo-1, set ctsna => fw_tsn, break; */
-                event_logi(VERBOSE, "process- case3: update ctsna to %u !",fw_tsn);
-                rxc->ctsna  = fw_tsn;
-                break;
-            } else if (between(lo-1, fw_tsn, hi)) {
-                /* case2: fw_tsn between hi and lo-1: delete fragment, set ctsna=hi, break; */
-                rxc->frag_list = g_list_remove_link(rxc->frag_list, current);
-                g_list_free_1(current); free(frag);
-                event_logi(VERBOSE, "process- case2: remove fragment and update ctsna to %u !",hi);
-                rxc->ctsna = hi;
-                break;
-            } else if (after(fw_tsn, hi)) {
-                /* case1: fw_tsn after hi: delete fragment, continue with next fragment; */
-                rxc->frag_list = g_list_remove_link(rxc->frag_list, current);
-                g_list_free_1(current); free(frag);
-                event_logi(VERBOSE, "process- case1: remove fragment, and set ctsna => %u !",hi);
-                rxc->ctsna = fw_tsn;
-            } else {
-                error_log(ERROR_FATAL, "rxc_process_forward_tsn: impossible conditon");
-                abort();
-            }
-        }
-        /* we are still here, take next fragment == first fragment */
-        current = g_list_first(rxc->frag_list);
-    }
-    if (after(fw_tsn, rxc->ctsna)) {
-        rxc->ctsna = fw_tsn;
-        event_logi(VERBOSE, "rxc_process_forward_tsn: case4: set ctsna => %u !",fw_tsn);
+    /* forget the TSNs up to fw_tsn, and those received without a gap after it */
+    if (after(fw_tsn, rxc->highest)) {
+        rxc_mark_tsns(rxc, rxc->ctsna + 1, rxc->highest - rxc->ctsna, FALSE);
+        rxc->highest = fw_tsn;
+    } else {
+        rxc_mark_tsns(rxc, rxc->ctsna + 1, fw_tsn - rxc->ctsna, FALSE);
     }
+    rxc->ctsna = fw_tsn;
+    rxc_bubbleup_ctsna(rxc);
+    event_logi(VERBOSE, "rxc_process_forward_tsn: ctsna is now %u", rxc->ctsna);
     se_deliver_unreliably(rxc->ctsna, chk);
 
     rxc_all_chunks_processed(TRUE);
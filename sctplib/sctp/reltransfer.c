@@ -49,13 +49,18 @@
 #include "distribution.h"
 #include "SCTP-control.h"
 #include "bundling.h"
+#include "chunkpool.h"
 
 #include <string.h>
 #include <stdio.h>
 
 #define MAX_NUM_OF_CHUNKS   500
+/* initial number of slots of the retransmission ring, a power of 2 */
+#define RTX_MIN_RING_SIZE   64
+/* number of acknowledged chunks handed back to the chunk pool at once */
+#define RTX_FREE_BATCH      64
 
-static chunk_data *rtx_chunks[MAX_NUM_OF_CHUNKS];
+static ENGINE_LOCAL chunk_data *rtx_chunks[MAX_NUM_OF_CHUNKS];
 
 /* #define Current_event_log_ 6 */
 
@@ -70,16 +75,24 @@ typedef struct rtx_buffer_struct
     unsigned int lowest_tsn;
     /** */
     unsigned int highest_tsn;
-    /** */
+    /** number of chunks in the ring */
     unsigned int num_of_chunks;
     /** */
     unsigned int highest_acked;
-    /** a list that is ordered by ascending tsn values */
-    GList *chunk_list;
+    /** the chunks sent, but not yet acked cumulatively, indexed by TSN: the chunk with
+        TSN t is in slot (t mod ring_size). Only the ring_span slots from the one of
+        ring_tsn on may hold chunks, all other slots are NULL */
+    chunk_data **ring;
+    /** number of slots, a power of 2 */
+    unsigned int ring_size;
+    /** TSN of the oldest chunk in the ring, if there is one */
+    unsigned int ring_tsn;
+    /** */
+    unsigned int ring_span;
     /** */
-    struct timeval sack_arrival_time;
+    adl_time sack_arrival_time;
     /** */
-    struct timeval saved_send_time;
+    adl_time saved_send_time;
     /** this val stores 0 if retransmitted chunks have been acked, else 1 */
     unsigned int save_num_of_txm;
     /** */
@@ -138,7 +151,12 @@ void *rtx_new_reltransfer(unsigned int number_of_destination_addresses, unsigned
                "================== Reltransfer: number_of_destination_addresses = %d",
                number_of_destination_addresses);
 
-    tmp->chunk_list = NULL;
+    tmp->ring = (chunk_data**)calloc(RTX_MIN_RING_SIZE, sizeof(chunk_data*));
+    if (!tmp->ring)
+        error_log(ERROR_FATAL, "Malloc failed");
+    tmp->ring_size = RTX_MIN_RING_SIZE;
+    tmp->ring_tsn = iTSN;
+    tmp->ring_span = 0;
 
     tmp->lowest_tsn = iTSN-1;
     tmp->highest_tsn = iTSN-1;
@@ -172,13 +190,16 @@ void *rtx_new_reltransfer(unsigned int number_of_destination_addresses, unsigned
 void rtx_delete_reltransfer(void *rtx_instance)
 {
     rtx_buffer *rtx;
+    unsigned int n;
     rtx = (rtx_buffer *) rtx_instance;
     event_log(INTERNAL_EVENT_0, "deleting reliable transfer");
-    if (rtx->chunk_list != NULL)
+    if (rtx->num_of_chunks != 0)
         error_log(ERROR_MINOR, "List is being deleted, but chunks are still queued...");
 
-    g_list_foreach(rtx->chunk_list, &free_list_element, GINT_TO_POINTER(2));
-    g_list_free(rtx->chunk_list);
+    for (n = 0; n < rtx->ring_span; n++) {
+        free_list_element(rtx->ring[(rtx->ring_tsn + n) & (rtx->ring_size - 1)], GINT_TO_POINTER(2));
+    }
+    free(rtx->ring);
     g_array_free(rtx->prChunks, TRUE);
 
     free(rtx_instance);
@@ -199,8 +220,8 @@ void rtx_rtt_update(unsigned int adr_idx, rtx_buffer * rtx)
     event_logi(INTERNAL_EVENT_0, "rtx_update_rtt(address=%u... ", adr_idx);
     if (rtx->save_num_of_txm == 1) {
         rtx->save_num_of_txm = 0;
-        rtt = adl_timediff_to_msecs(&(rtx->sack_arrival_time), &(rtx->saved_send_time));
-        if (rtt != -1) {
+        if (rtx->sack_arrival_time >= rtx->saved_send_time) {
+            rtt = (int)((rtx->sack_arrival_time - rtx->saved_send_time) / ADL_NSECS_PER_MSEC);
             event_logii(ERROR_MINOR, "Calling pm_chunksAcked(%u, %d)...", adr_idx, rtt);
             pm_chunksAcked((short)adr_idx, (unsigned int)rtt);
         }
@@ -266,6 +287,60 @@ gboolean rtx_is_in_fast_recovery(void)
 }
 
 
+/**
+ * @return the chunk with a TSN from the retransmission ring, or NULL if there is none
+ */
+static chunk_data* rtx_chunk_at(rtx_buffer* rtx, unsigned int tsn)
+{
+    if (tsn - rtx->ring_tsn >= rtx->ring_span) return NULL;
+    return rtx->ring[tsn & (rtx->ring_size - 1)];
+}
+
+
+/**
+ * enlarges the retransmission ring, so that it has at least span slots
+ * @return 0 on success, -1 if no memory was available
+ */
+static int rtx_grow_ring(rtx_buffer* rtx, unsigned int span)
+{
+    chunk_data **ring;
+    unsigned int size = rtx->ring_size, n, tsn;
+
+    while (size < span) size *= 2;
+    ring = (chunk_data**)calloc(size, sizeof(chunk_data*));
+    if (ring == NULL) return -1;
+    for (n = 0; n < rtx->ring_span; n++) {
+        tsn = rtx->ring_tsn + n;
+        ring[tsn & (size - 1)] = rtx->ring[tsn & (rtx->ring_size - 1)];
+    }
+    event_logii(VERBOSE, "rtx_grow_ring: %u instead of %u slots", size, rtx->ring_size);
+    free(rtx->ring);
+    rtx->ring = ring;
+    rtx->ring_size = size;
+    return 0;
+}
+
+
+/**
+ * takes the chunk with the lowest TSN out of the retransmission ring, which must not be empty
+ * @return the chunk
+ */
+static chunk_data* rtx_remove_first(rtx_buffer* rtx)
+{
+    unsigned int mask = rtx->ring_size - 1;
+    chunk_data* dat = rtx->ring[rtx->ring_tsn & mask];
+
+    rtx->ring[rtx->ring_tsn & mask] = NULL;
+    rtx->num_of_chunks--;
+    /* move on to the next chunk */
+    do {
+        rtx->ring_tsn++;
+        rtx->ring_span--;
+    } while ((rtx->ring_span > 0) && (rtx->ring[rtx->ring_tsn & mask] == NULL));
+    return dat;
+}
+
+
 /**
  * Function takes out chunks up to ctsna, updates newly acked bytes
  * @param   ctsna   the ctsna value, that has just been received in a sack
@@ -274,13 +349,9 @@ gboolean rtx_is_in_fast_recovery(void)
 int rtx_dequeue_up_to(unsigned int ctsna, unsigned int addr_index)
 {
     rtx_buffer *rtx;
-    chunk_data *dat, *old_dat;
-/*
-    boolean deleted_chunk = FALSE;
-    guint i=0, list_length = 0;
-*/
-    unsigned int chunk_tsn;
-    GList* tmp;
+    chunk_data *dat;
+    chunk_data *acked[RTX_FREE_BATCH];
+    unsigned int num_acked = 0;
 
     event_logi(INTERNAL_EVENT_0, "rtx_dequeue_up_to...%u ", ctsna);
 
@@ -289,7 +360,7 @@ int rtx_dequeue_up_to(unsigned int ctsna, unsigned int addr_index)
         error_log(ERROR_MAJOR, "rtx_buffer instance not set !");
         return (-1);
     }
-    if (rtx->chunk_list == NULL) {
+    if (rtx->num_of_chunks == 0) {
         event_log(INTERNAL_EVENT_0, "List is NULL in rtx_dequeue_up_to()");
         return -1;
     }
@@ -298,48 +369,37 @@ int rtx_dequeue_up_to(unsigned int ctsna, unsigned int addr_index)
     /* so that these are not referenced after they are freed here    */
     fc_dequeue_acked_chunks(ctsna);
 
-    tmp = g_list_first(rtx->chunk_list);
-
-    while (tmp) {
-        dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, 0);
-        if (!dat) return -1;
-
-        chunk_tsn = dat->chunk_tsn;
+    while ((rtx->ring_span > 0) && !after(rtx->ring_tsn, ctsna)) {
+        dat = rtx_remove_first(rtx);
 
         event_logiiii(VVERBOSE,
                       " dat->num_of_transmissions==%u, chunk_tsn==%u, chunk_len=%u, ctsna==%u ",
-                      dat->num_of_transmissions, chunk_tsn, dat->chunk_len, ctsna);
-
-        tmp = g_list_next(tmp);
-
-        if (before(dat->chunk_tsn, ctsna) || (dat->chunk_tsn == ctsna)) {
-
-            if (dat->num_of_transmissions < 1)
-                error_log(ERROR_FATAL, "Somehow dat->num_of_transmissions is less than 1 !");
-
-            if (dat->hasBeenAcked == FALSE && dat->hasBeenDropped == FALSE) {
-                rtx->newly_acked_bytes += dat->chunk_len;
-                dat->hasBeenAcked = TRUE;
-                if (dat->num_of_transmissions == 1 && addr_index == dat->last_destination) {
-                    rtx->save_num_of_txm = 1;
-                    rtx->saved_send_time = dat->transmission_time;
-                    event_logiii(VERBOSE,
-                                 "Saving Time (after dequeue) : %lu secs, %06lu usecs for tsn=%u",
-                                 dat->transmission_time.tv_sec,
-                                 dat->transmission_time.tv_usec, dat->chunk_tsn);
-                }
+                      dat->num_of_transmissions, dat->chunk_tsn, dat->chunk_len, ctsna);
+
+        if (dat->num_of_transmissions < 1)
+            error_log(ERROR_FATAL, "Somehow dat->num_of_transmissions is less than 1 !");
+
+        if (dat->hasBeenAcked == FALSE && dat->hasBeenDropped == FALSE) {
+            rtx->newly_acked_bytes += dat->chunk_len;
+            dat->hasBeenAcked = TRUE;
+            if (dat->num_of_transmissions == 1 && addr_index == dat->last_destination) {
+                rtx->save_num_of_txm = 1;
+                rtx->saved_send_time = dat->transmission_time;
+                event_logiii(VERBOSE,
+                             "Saving Time (after dequeue) : %lu secs, %06lu usecs for tsn=%u",
+                             ADL_TIME_SECS(dat->transmission_time),
+                             ADL_TIME_USECS(dat->transmission_time), dat->chunk_tsn);
             }
-
-            event_logi(INTERNAL_EVENT_0, "Now delete chunk with tsn...%u", chunk_tsn);
-            old_dat = dat;
-            rtx->chunk_list = g_list_remove(rtx->chunk_list, (gpointer)dat);
-            free(old_dat);
         }
-        /* it is a sorted list, so it is safe to get out in this case */
-        if (after(chunk_tsn, ctsna))
-            break;
 
+        event_logi(INTERNAL_EVENT_0, "Now delete chunk with tsn...%u", dat->chunk_tsn);
+        acked[num_acked++] = dat;
+        if (num_acked == RTX_FREE_BATCH) {
+            cp_freeChunks(acked, num_acked);
+            num_acked = 0;
+        }
     }
+    cp_freeChunks(acked, num_acked);
     return 0;
 }
 
@@ -393,22 +453,20 @@ static int rtx_update_fwtsn_list(rtx_buffer *rtx, chunk_data* dat)
 static int rtx_advancePeerAckPoint(rtx_buffer *rtx)
 {
     chunk_data *dat = NULL;
-    GList* tmp = NULL;
+    unsigned int n;
 
     /* restart with a fresh array */
     g_array_free(rtx->prChunks, TRUE);
     rtx->prChunks = g_array_new(FALSE, TRUE, sizeof(pr_stream_data));
 
-    tmp = g_list_first(rtx->chunk_list);
-
-    while (tmp) {
-        dat = (chunk_data*)g_list_nth_data(tmp, 0);
-        if (!dat) return -1;
+    /* the dropped chunks at the start of the ring */
+    for (n = 0; n < rtx->ring_span; n++) {
+        dat = rtx->ring[(rtx->ring_tsn + n) & (rtx->ring_size - 1)];
+        if (!dat) continue;
         if (!dat->hasBeenDropped) return 0;
         event_logi(VVERBOSE, "rtx_advancePeerAckPoint: Set advancedPeerAckPoint to %u", dat->chunk_tsn);
         rtx->advancedPeerAckPoint = dat->chunk_tsn;
         rtx_update_fwtsn_list(rtx, dat);
-        tmp = g_list_next(tmp);
     }
     return 0;
 }
@@ -451,21 +509,17 @@ int rtx_get_obpa(unsigned int adIndex, unsigned int *totalInFlight)
 {
     rtx_buffer *rtx=NULL;
     chunk_data *dat=NULL;
-    int count, len, numBytesPerAddress = 0, numTotalBytes = 0;
+    unsigned int n;
+    int numBytesPerAddress = 0, numTotalBytes = 0;
 
     rtx = (rtx_buffer *) mdi_readReliableTransfer();
     if (!rtx) {
         error_log(ERROR_FATAL, "rtx_buffer instance not set !");
         return SCTP_MODULE_NOT_FOUND;
     }
-    len = g_list_length(rtx->chunk_list);
-    if (len == 0) {
-        *totalInFlight = 0;
-        return 0;
-    }
-    for (count = 0; count < len; count++) {
-        dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, count);
-        if (dat == NULL) break;
+    for (n = 0; n < rtx->ring_span; n++) {
+        dat = rtx->ring[(rtx->ring_tsn + n) & (rtx->ring_size - 1)];
+        if (dat == NULL) continue;
         /* do not count chunks that were retransmitted by T3 timer              */
         /* dat->hasBeenRequeued will be set to FALSE when these are sent again  */
         if (!dat->hasBeenDropped && !dat->hasBeenAcked && !dat->hasBeenRequeued) {
@@ -494,16 +548,13 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
     SCTP_sack_chunk *sack=NULL;
     fragment *frag=NULL;
     chunk_data *dat=NULL;
-    GList* tmp_list = NULL;
     int result;
     unsigned int advertised_rwnd, old_own_ctsna;
-    unsigned int low, hi, ctsna, pos;
+    unsigned int low, hi, ctsna, pos, tsn, end_tsn;
     unsigned int chunk_len, var_len, gap_len, dup_len;
     unsigned int num_of_dups, num_of_gaps;
-    unsigned int max_rtx_arraysize;
     unsigned int retransmitted_bytes = 0L;
     int chunks_to_rtx = 0;
-    guint i=0;
     boolean rtx_necessary = FALSE, all_acked = FALSE, new_acked = FALSE;
 
     event_logi(INTERNAL_EVENT_0, "rtx_process_sack(address==%u)", adr_index);
@@ -514,8 +565,6 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
         return (-1);
     }
 
-    /*      chunk_list_debug(rtx->chunk_list); */
-
     sack = (SCTP_sack_chunk *) sack_chunk;
     ctsna = ntohl(sack->cumulative_tsn_ack);
 
@@ -528,10 +577,10 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
     old_own_ctsna = rtx->lowest_tsn;
     event_logii(VERBOSE, "Received ctsna==%u, old_own_ctsna==%u", ctsna, old_own_ctsna);
 
-    adl_gettime(&(rtx->sack_arrival_time));
+    rtx->sack_arrival_time = adl_now();
 
     event_logii(VERBOSE, "SACK Arrival Time : %lu secs, %06lu usecs",
-                rtx->sack_arrival_time.tv_sec, rtx->sack_arrival_time.tv_usec);
+                ADL_TIME_SECS(rtx->sack_arrival_time), ADL_TIME_USECS(rtx->sack_arrival_time));
 
     /* a false value here may do evil things !!!!! */
     chunk_len = ntohs(sack->chunk_header.chunk_length);
@@ -570,111 +619,87 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
         event_logi(VVERBOSE, "Updated rtx->lowest_tsn==ctsna==%u", ctsna);
     }
 
-    chunk_list_debug(VVERBOSE, rtx->chunk_list);
-
-    if (ntohs(sack->num_of_fragments) != 0) {
-        event_logi(VERBOSE, "Processing %u fragment reports", ntohs(sack->num_of_fragments));
-        max_rtx_arraysize = g_list_length(rtx->chunk_list);
-        if (max_rtx_arraysize == 0) {
+    if (num_of_gaps != 0) {
+        event_logi(VERBOSE, "Processing %u fragment reports", num_of_gaps);
+        if (rtx->num_of_chunks == 0) {
             /*rxc_send_sack_everytime(); */
             event_log(VERBOSE,
                       "Size of retransmission list was zero, we received fragment report -> ignore");
         } else {
-            /* this may become expensive !!!!!!!!!!!!!!!! */
-            pos = 0;
-            dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, i);
-            if (rtx->chunk_list != NULL && dat != NULL) {
-                do {
+            /* only the chunks up to the last gap block are looked at */
+            tsn = rtx->ring_tsn;
+            end_tsn = rtx->ring_tsn + rtx->ring_span;
+            for (pos = 0; (pos < gap_len) && (chunks_to_rtx < MAX_NUM_OF_CHUNKS); pos += sizeof(fragment)) {
                 frag = (fragment *) & (sack->fragments_and_dups[pos]);
-                    low = ctsna + ntohs(frag->start);
-                    hi = ctsna + ntohs(frag->stop);
-                    event_logiii(VVERBOSE, "chunk_tsn==%u, lo==%u, hi==%u", dat->chunk_tsn, low, hi);
-                    if (after(dat->chunk_tsn, hi)) {
-                        event_logii(VVERBOSE, "after(%u,%u)==true", dat->chunk_tsn, hi);
-                        pos += sizeof(fragment);
-                        if (pos >= gap_len)
-                            break;
-                        continue;
-                    }
-                    if (before(dat->chunk_tsn, low)) {
-                        /* this chunk is in a gap... */
-                        dat->gap_reports++;
-                        event_logiii(VVERBOSE,
-                                     "Chunk in a gap: before(%u,%u)==true -- Marking it up (%u Gap Reports)!",
-                                     dat->chunk_tsn, low, dat->gap_reports);
-                        if (dat->gap_reports >= 4) {
-                            /* FIXME : Get MTU of address, where RTX is to take place, instead of MAX_SCTP_PDU */
-                            event_logi(VVERBOSE, "Got four gap_reports, ==checking== chunk %u for rtx OR drop", dat->chunk_tsn);
-                            /* check sum of chunk sizes (whether it exceeds MTU for current address */
-                            if(dat->hasBeenDropped == FALSE) {
-                                if (timerisset(&dat->expiry_time) && timercmp(&(rtx->sack_arrival_time), &(dat->expiry_time), >)) {
-                                    event_logi(VVERBOSE, "Got four gap_reports, dropping chunk %u !!!", dat->chunk_tsn);
-                                    dat->hasBeenDropped = TRUE;
-                                    /* this is a trick... */
-                                    dat->hasBeenFastRetransmitted = TRUE;
-                                } else if (dat->hasBeenFastRetransmitted == FALSE) {
-                                    event_logi(VVERBOSE, "Got four gap_reports, scheduling %u for RTX", dat->chunk_tsn);
-                                    /* retransmit it, chunk is not yet expired */
-                                    rtx_necessary = TRUE;
-                                    rtx_chunks[chunks_to_rtx] = dat;
-                                    dat->gap_reports = 0;
-                                    dat->hasBeenFastRetransmitted = TRUE;
-                                    chunks_to_rtx++;
-                                    /* preparation for what is in section 6.2.1.C */
-                                    retransmitted_bytes += dat->chunk_len;
-                                }
-                            } /*  if(dat->hasBeenDropped == FALSE)  */
-                        }     /*  if (dat->gap_reports == 4) */
-                        /* read next chunk */
-                        i++;
-                        dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, i);
-                        if (dat == NULL)
-                            break; /* was the last chunk in the list */
-                        if (chunks_to_rtx == MAX_NUM_OF_CHUNKS)
-                            break;
-                        else continue;
-
-                    } else if (between(low, dat->chunk_tsn, hi)) {
-                        event_logiii(VVERBOSE, "between(%u,%u,%u)==true", low, dat->chunk_tsn, hi);
-                        if (dat->hasBeenAcked == FALSE && dat->hasBeenDropped == FALSE) {
-                            rtx->newly_acked_bytes += dat->chunk_len;
-                            dat->hasBeenAcked = TRUE;
-                            rtx->all_chunks_are_unacked = FALSE;
-                            dat->gap_reports = 0;
-                            if (dat->num_of_transmissions == 1 && adr_index == dat->last_destination) {
-                                rtx->saved_send_time = dat->transmission_time;
-                                rtx->save_num_of_txm = 1;
-                                event_logiii(VERBOSE, "Saving Time (chunk in gap) : %lu secs, %06lu usecs for tsn=%u",
-                                                     dat->transmission_time.tv_sec,
-                                                     dat->transmission_time.tv_usec, dat->chunk_tsn);
+                low = ctsna + ntohs(frag->start);
+                hi = ctsna + ntohs(frag->stop);
+                event_logiii(VVERBOSE, "next tsn==%u, lo==%u, hi==%u", tsn, low, hi);
+                if (after(low, hi)) {
+                    error_log(ERROR_MINOR, "Problem with fragment boundaries (low > hi)");
+                    continue;
+                }
 
+                /* the chunks before the gap block are in a gap... */
+                for (; before(tsn, low) && before(tsn, end_tsn); tsn++) {
+                    dat = rtx_chunk_at(rtx, tsn);
+                    if (dat == NULL) continue;
+                    dat->gap_reports++;
+                    event_logiii(VVERBOSE,
+                                 "Chunk in a gap: before(%u,%u)==true -- Marking it up (%u Gap Reports)!",
+                                 dat->chunk_tsn, low, dat->gap_reports);
+                    if (dat->gap_reports >= 4) {
+                        /* FIXME : Get MTU of address, where RTX is to take place, instead of MAX_SCTP_PDU */
+                        event_logi(VVERBOSE, "Got four gap_reports, ==checking== chunk %u for rtx OR drop", dat->chunk_tsn);
+                        /* check sum of chunk sizes (whether it exceeds MTU for current address */
+                        if(dat->hasBeenDropped == FALSE) {
+                            if ((dat->expiry_time != 0) && (rtx->sack_arrival_time > dat->expiry_time)) {
+                                event_logi(VVERBOSE, "Got four gap_reports, dropping chunk %u !!!", dat->chunk_tsn);
+                                dat->hasBeenDropped = TRUE;
+                                /* this is a trick... */
+                                dat->hasBeenFastRetransmitted = TRUE;
+                            } else if (dat->hasBeenFastRetransmitted == FALSE) {
+                                event_logi(VVERBOSE, "Got four gap_reports, scheduling %u for RTX", dat->chunk_tsn);
+                                /* retransmit it, chunk is not yet expired */
+                                rtx_necessary = TRUE;
+                                rtx_chunks[chunks_to_rtx] = dat;
+                                dat->gap_reports = 0;
+                                dat->hasBeenFastRetransmitted = TRUE;
+                                chunks_to_rtx++;
+                                /* preparation for what is in section 6.2.1.C */
+                                retransmitted_bytes += dat->chunk_len;
+                                if (chunks_to_rtx == MAX_NUM_OF_CHUNKS) break;
                             }
-                        }
+                        } /*  if(dat->hasBeenDropped == FALSE)  */
+                    }     /*  if (dat->gap_reports == 4) */
+                }
+                if (chunks_to_rtx == MAX_NUM_OF_CHUNKS) break;
+
+                /* ...and those in the gap block were received */
+                for (; !after(tsn, hi) && before(tsn, end_tsn); tsn++) {
+                    dat = rtx_chunk_at(rtx, tsn);
+                    if (dat == NULL) continue;
+                    event_logiii(VVERBOSE, "between(%u,%u,%u)==true", low, dat->chunk_tsn, hi);
+                    if (dat->hasBeenAcked == FALSE && dat->hasBeenDropped == FALSE) {
+                        rtx->newly_acked_bytes += dat->chunk_len;
+                        dat->hasBeenAcked = TRUE;
+                        rtx->all_chunks_are_unacked = FALSE;
+                        if (dat->num_of_transmissions == 1 && adr_index == dat->last_destination) {
+                            rtx->saved_send_time = dat->transmission_time;
+                            rtx->save_num_of_txm = 1;
+                            event_logiii(VERBOSE, "Saving Time (chunk in gap) : %lu secs, %06lu usecs for tsn=%u",
+                                                 ADL_TIME_SECS(dat->transmission_time),
+                                                 ADL_TIME_USECS(dat->transmission_time), dat->chunk_tsn);
 
-                        if (dat->num_of_transmissions < 1) {
-                            error_log(ERROR_FATAL, "Somehow dat->num_of_transmissions is less than 1 !");
-                            break;
                         }
-                        /* reset number of gap reports so it does not get fast retransmitted */
-                        dat->gap_reports = 0;
-
-                        i++;
-                        dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, i);
-                        if (dat == NULL)
-                            break; /* was the last chunk in the list or chunk is empty*/
-                        else continue;
-                    } else if (after(dat->chunk_tsn, hi)) {
-                        error_log(ERROR_MINOR, "Problem with fragment boundaries (low_2 <= hi_1)");
+                    }
+                    if (dat->num_of_transmissions < 1) {
+                        error_log(ERROR_FATAL, "Somehow dat->num_of_transmissions is less than 1 !");
                         break;
                     }
-
+                    /* reset number of gap reports so it does not get fast retransmitted */
+                    dat->gap_reports = 0;
                 }
-                while ((pos < gap_len));
-
-            }  /* end: if(rtx->chunk_list != NULL && dat != NULL) */
-            else {
-                event_log(EXTERNAL_EVENT,
-                          "Received duplicated SACK for Chunks that are not in the queue anymore");
+                if (!before(tsn, end_tsn)) break;
             }
         }
 
@@ -685,10 +710,9 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
             /* and reneged: reset their status to unacked, since that is what peer reported   */
             /* fast retransmit reneged chunks, as per section   6.2.1.D.iii) of RFC 4960      */
             event_log(VVERBOSE, "rtx_process_sack: resetting all *hasBeenAcked* attributes");
-            tmp_list = g_list_first(rtx->chunk_list);
-            while (tmp_list) {
-                dat = (chunk_data*)g_list_nth_data(tmp_list, 0);
-                if (!dat) break;
+            for (tsn = rtx->ring_tsn; tsn != rtx->ring_tsn + rtx->ring_span; tsn++) {
+                dat = rtx_chunk_at(rtx, tsn);
+                if (!dat) continue;
                 if (dat->hasBeenAcked == TRUE && dat->hasBeenDropped == FALSE) {
                     dat->hasBeenAcked = FALSE;
                     rtx_necessary = TRUE;
@@ -699,15 +723,14 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
                     chunks_to_rtx++;
                     /* preparation for what is in section 6.2.1.C */
                     retransmitted_bytes += dat->chunk_len;
+                    if (chunks_to_rtx == MAX_NUM_OF_CHUNKS) break;
                 }
-                tmp_list = g_list_next(tmp_list);
             }
             rtx->all_chunks_are_unacked = TRUE;
         }
     }
 
     event_log(INTERNAL_EVENT_0, "Marking of Chunks done in rtx_process_sack()");
-    chunk_list_debug(VVERBOSE, rtx->chunk_list);
 
     /* also tell pathmanagement, that we got a SACK, possibly updating RTT/RTO. */
     rtx_rtt_update(adr_index, rtx);
@@ -716,7 +739,7 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
      * new_acked==TRUE means our own ctsna has advanced :
      * also see section 6.2.1 (Note)
      */
-    if (rtx->chunk_list == NULL) {
+    if (rtx->num_of_chunks == 0) {
         if ((rtx->highest_tsn == rtx->highest_acked)) {
             all_acked = TRUE;
         }
@@ -733,13 +756,7 @@ int rtx_process_sack(unsigned int adr_index, void *sack_chunk, unsigned int tota
         }
     } else {
         /* there are still chunks in that queue */
-        if (rtx->chunk_list != NULL)
-            dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, 0);
-        if (dat == NULL) {
-            error_log(ERROR_FATAL, "Problem with RTX-chunklist, CHECK Program and List Handling");
-            return -1;
-        }
-        rtx->lowest_tsn = dat->chunk_tsn;
+        rtx->lowest_tsn = rtx->ring_tsn;
         /* new_acked is true, when own  ctsna advances... */
         if (after(rtx->lowest_tsn, old_own_ctsna)) new_acked = TRUE;
     }
@@ -805,63 +822,46 @@ int rtx_t3_timeout(void *assoc_id, unsigned int address, unsigned int mtu, chunk
     /* it's size == 20+5*4+5*4 == 60        */
     unsigned int size = 60;
     int chunks_to_rtx = 0, result=0;
-    struct timeval now;
-    GList *tmp;
+    adl_time now;
+    unsigned int n;
     chunk_data *dat=NULL;
     event_logi(INTERNAL_EVENT_0, "========================= rtx_t3_timeout (address==%u) =====================", address);
 
     rtx = (rtx_buffer *) mdi_readReliableTransfer();
 
-    if (rtx->chunk_list == NULL) return 0;
-
-    adl_gettime(&now);
+    if (rtx->num_of_chunks == 0) return 0;
 
-    tmp = g_list_first(rtx->chunk_list);
+    now = adl_now();
 
-    while (tmp) {
-        if (((chunk_data *)(tmp->data))->num_of_transmissions < 1) {
+    for (n = 0; n < rtx->ring_span; n++) {
+        dat = rtx->ring[(rtx->ring_tsn + n) & (rtx->ring_size - 1)];
+        if (dat == NULL) continue;
+        if (dat->num_of_transmissions < 1) {
             error_log(ERROR_FATAL, "Somehow chunk->num_of_transmissions is less than 1 !");
             break;
         }
         /* only take chunks that were transmitted to *address* */
-        if (((chunk_data *)(tmp->data))->last_destination == address) {
-            if (((chunk_data *)(tmp->data))->hasBeenDropped == FALSE) {
-                if (timerisset( &((chunk_data *)(tmp->data))->expiry_time)) {
-                    if (timercmp(&now, &((chunk_data *)(tmp->data))->expiry_time, > )) {
-                        /* chunk has expired, maybe send FORWARD_TSN */
-                        ((chunk_data *)(tmp->data))->hasBeenDropped = TRUE;
-                    } else { /* chunk has not yet expired */
-                        chunks[chunks_to_rtx] = (chunk_data*)tmp->data;
-                        size += chunks[chunks_to_rtx]->chunk_len;
-                        event_logii(VVERBOSE, "Scheduling chunk (tsn==%u), len==%u for rtx",
-                                    chunks[chunks_to_rtx]->chunk_tsn, chunks[chunks_to_rtx]->chunk_len);
-                        /* change SCI2002 */
-                        chunks[chunks_to_rtx]->gap_reports = 0;
-                        chunks_to_rtx++;
-                    }
+        if (dat->last_destination == address) {
+            if (dat->hasBeenDropped == FALSE) {
+                if ((dat->expiry_time != 0) && (now > dat->expiry_time)) {
+                    /* chunk has expired, maybe send FORWARD_TSN */
+                    dat->hasBeenDropped = TRUE;
                 } else {
-                    chunks[chunks_to_rtx] = (chunk_data*)tmp->data;
-                    size += chunks[chunks_to_rtx]->chunk_len;
+                    chunks[chunks_to_rtx] = dat;
+                    size += dat->chunk_len;
                     event_logii(VVERBOSE, "Scheduling chunk (tsn==%u), len==%u for rtx",
-                            chunks[chunks_to_rtx]->chunk_tsn, chunks[chunks_to_rtx]->chunk_len);
+                                dat->chunk_tsn, dat->chunk_len);
                     /* change SCI2002 */
-                    chunks[chunks_to_rtx]->gap_reports = 0;
-
+                    dat->gap_reports = 0;
                     chunks_to_rtx++;
                 }
             }       /* hasBeenDropped == FALSE     */
         }           /* last_destination == address */
-        tmp = g_list_next(tmp);
     }
     event_logi(VVERBOSE, "Scheduled %d chunks for rtx", chunks_to_rtx);
 
-    if (rtx->chunk_list != NULL) {
-        dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, 0);
-        if (dat == NULL) {
-           error_log(ERROR_FATAL, "Problem with RTX-chunklist, CHECK Program and List Handling");
-           return chunks_to_rtx;
-        }
-        rtx->lowest_tsn = dat->chunk_tsn;
+    if (rtx->num_of_chunks != 0) {
+        rtx->lowest_tsn = rtx->ring_tsn;
     } else {
         rtx->lowest_tsn = rtx->highest_tsn;
     }
@@ -889,6 +889,7 @@ int rtx_save_retrans_chunks(void *data_chunk)
 {
     chunk_data *dat;
     rtx_buffer *rtx;
+    unsigned int first, span;
 
     event_log(INTERNAL_EVENT_0, "rtx_save_retrans_chunks");
 
@@ -898,86 +899,46 @@ int rtx_save_retrans_chunks(void *data_chunk)
         return (-1);
     }
 
-    /*      chunk_list_debug(rtx->chunk_list); */
-
     dat = (chunk_data *) data_chunk;
 
     /* TODO : check, if all values are set correctly */
     dat->gap_reports = 0L;
-    rtx->chunk_list = g_list_insert_sorted(rtx->chunk_list, dat, (GCompareFunc)sort_tsn);
+
+    if (rtx->num_of_chunks == 0) {
+        rtx->ring_tsn = dat->chunk_tsn;
+        rtx->ring_span = 0;
+    }
+    if (before(dat->chunk_tsn, rtx->ring_tsn)) {
+        first = dat->chunk_tsn;
+        span = rtx->ring_tsn - dat->chunk_tsn + rtx->ring_span;
+    } else {
+        first = rtx->ring_tsn;
+        span = dat->chunk_tsn - rtx->ring_tsn + 1;
+        if (span < rtx->ring_span) span = rtx->ring_span;
+    }
+    if (rtx_chunk_at(rtx, dat->chunk_tsn) != NULL) {
+        error_log(ERROR_MAJOR, "rtx_save_retrans_chunks: chunk with this TSN is already saved");
+        return -1;
+    }
+    if ((span > rtx->ring_size) && (rtx_grow_ring(rtx, span) < 0)) {
+        error_log(ERROR_FATAL, "Malloc failed");
+        return -1;
+    }
+    rtx->ring_tsn = first;
+    rtx->ring_span = span;
+    rtx->ring[dat->chunk_tsn & (rtx->ring_size - 1)] = dat;
+    rtx->num_of_chunks++;
 
     if (after(dat->chunk_tsn, rtx->highest_tsn))
         rtx->highest_tsn = dat->chunk_tsn;
     else
         error_log(ERROR_MINOR, "Data Chunk has TSN that was already assigned (i.e. is too small)");
 
-    chunk_list_debug(VVERBOSE, rtx->chunk_list);
-
-    rtx->num_of_chunks = g_list_length(rtx->chunk_list);
+    event_logiii(VVERBOSE, "rtx_save_retrans_chunks: %u chunks from tsn %u on, in %u slots",
+                 rtx->num_of_chunks, rtx->ring_tsn, rtx->ring_span);
     return 0;
 }
 
-/**
- * output debug messages for the list of saved chunks
- * @param   event_log_level  INTERNAL_EVENT_0 INTERNAL_EVENT_1 EXTERNAL_EVENT_X EXTERNAL_EVENT
- * @param   chunk_list  the list about which we print information
- */
-void chunk_list_debug(short event_log_level, GList * chunk_list)
-{
-    chunk_data *dat;
-    unsigned int size, counter;
-    unsigned int last_tsn;
-    guint i=0;
-
-    last_tsn = 0;
-    if (event_log_level <= Current_event_log_) {
-/*    if (1) { */
-        event_log(event_log_level, "------------- Chunk List Debug ------------------------");
-        if ((size = g_list_length(chunk_list)) == 0) {
-            event_log(event_log_level, " Size of List == 0 ! ");
-        } else if (size <= 200) {
-            event_logi(event_log_level, " Size of List == %u ! Printing first 10 chunks....", size);
-            dat = (chunk_data*)g_list_nth_data(chunk_list, 0);
-            last_tsn = dat->chunk_tsn - 1;
-            if (size > 10) counter = 10;
-            else counter = size;
-            for (i=0; i<counter; i++) {
-                dat = (chunk_data*)g_list_nth_data(chunk_list, i);
-                event_logii(event_log_level,
-                            "________________ Chunk _________________\nChunk Size %u  -- TSN : %u  ",
-                            dat->chunk_len, dat->chunk_tsn);
-                event_logiii(event_log_level, "Gap repts=%u -- initial dest=%d  Transmissions = %u",
-                              dat->gap_reports, dat->initial_destination, dat->num_of_transmissions);
-                event_logii(event_log_level,  "Transmission Time : %lu secs, %06lu usecs",
-                            dat->transmission_time.tv_sec, dat->transmission_time.tv_usec);
-                event_logii(event_log_level, "Destination[%u] == %u", dat->num_of_transmissions,
-                            dat->last_destination);
-
-                if (dat->chunk_len > 10000)
-                    error_log(ERROR_FATAL, "Corrput TSN length in queue 1 ! Terminate");
-
-                if (! after(dat->chunk_tsn, last_tsn)) error_log(ERROR_FATAL, "TSN not in sequence ! Bye");
-                last_tsn = dat->chunk_tsn;
-            }
-            for (i=counter; i<size; i++) {
-                dat = (chunk_data*)g_list_nth_data(chunk_list, i);
-                if (! after(dat->chunk_tsn, last_tsn))
-                    error_log(ERROR_FATAL, "Higher TSNs not in sequence ! Terminate");
-                if (dat->chunk_tsn - last_tsn > 10000)
-                    error_log(ERROR_FATAL, "Corrput TSN in queue ! Terminate");
-                if (dat->chunk_len > 10000)
-                    error_log(ERROR_FATAL, "Corrput TSN length in queue 2 ! Terminate");
-
-                last_tsn = dat->chunk_tsn;
-            }
-            event_log(event_log_level, "------------- Chunk List Debug : DONE  ------------------------");
-        } else {
-            event_logi(event_log_level, " Size of List == %u ! ", size);
-        }
-    }
-}
-
-
 /**
  * function that returns the consecutive tsn number that has been acked by the peer.
  * @return the ctsna value
@@ -1033,7 +994,6 @@ void* rtx_restart_reliable_transfer(void* rtx_instance, unsigned int numOfPaths,
 
     rtx_delete_reltransfer(rtx_instance);
     /* For ease of implementation we will delete all old data ! */
-    /* chunk_list_debug(VVERBOSE, rtx->chunk_list); */
     new_rtx = rtx_new_reltransfer(numOfPaths, iTSN);
 
     return new_rtx;
@@ -1048,21 +1008,21 @@ int rtx_dequeueOldestUnackedChunk(unsigned char *buf, unsigned int *len, unsigne
     chunk_data *dat = NULL;
     SCTP_data_chunk* dchunk;
 
+
     rtx = (rtx_buffer *) mdi_readReliableTransfer();
     if (!rtx) {
         error_log(ERROR_MAJOR, "rtx_buffer instance not set !");
         return SCTP_MODULE_NOT_FOUND;
     }
-    if (rtx->chunk_list == NULL) return  SCTP_UNSPECIFIED_ERROR;
-    listlen = g_list_length(rtx->chunk_list);
+    listlen = (int)rtx->num_of_chunks;
     if (listlen <= 0) return SCTP_UNSPECIFIED_ERROR;
-    dat = (chunk_data*)g_list_nth_data(rtx->chunk_list, 0);
+    dat = rtx->ring[rtx->ring_tsn & (rtx->ring_size - 1)];
     if (dat->num_of_transmissions == 0) return SCTP_UNSPECIFIED_ERROR;
     if ((*len) <  (dat->chunk_len - FIXED_DATA_CHUNK_SIZE)) return SCTP_BUFFER_TOO_SMALL;
 
     dchunk = (SCTP_data_chunk*) dat->data;
     *len = dat->chunk_len - FIXED_DATA_CHUNK_SIZE;
-    memcpy(buf, dchunk->data, dat->chunk_len - FIXED_DATA_CHUNK_SIZE);
+    cp_copyPayload(dat, buf);
     *tsn = dat->chunk_tsn;
     *sID = ntohs(dchunk->stream_id);
     *sSN = ntohs(dchunk->stream_sn);
@@ -1074,11 +1034,10 @@ int rtx_dequeueOldestUnackedChunk(unsigned char *buf, unsigned int *len, unsigne
 
     result = fc_dequeueUnackedChunk(dat->chunk_tsn);
     event_logi(VERBOSE, "fc_dequeueUnackedChunk() returns  %u", result);
-    rtx->chunk_list = g_list_remove(rtx->chunk_list, (gpointer) dat);
+    rtx_remove_first(rtx);
     /* be careful ! data may only be freed once: this module ONLY takes care of unacked chunks */
-    chunk_list_debug(VVERBOSE, rtx->chunk_list);
 
-    free(dat);
+    cp_freeChunk(dat);
     return (listlen-1);
 }
 
@@ -1097,7 +1056,7 @@ unsigned int rtx_readNumberOfUnackedChunks()
         error_log(ERROR_MAJOR, "rtx_buffer instance not set !");
         return 0;
     }
-    queue_len = g_list_length(rtx->chunk_list);
+    queue_len = rtx->num_of_chunks;
     event_logi(VERBOSE, "rtx_readNumberOfUnackedChunks() returns %u", queue_len);
     return queue_len;
 }
@@ -1199,7 +1158,7 @@ unsigned int rtx_rcv_shutdown_ctsna(unsigned int ctsna)
         }
         rtx->lowest_tsn = ctsna;
         event_logi(VVERBOSE, "Updated rtx->lowest_tsn==ctsna==%u", ctsna);
-        rtx_queue_len =  g_list_length(rtx->chunk_list);
+        rtx_queue_len = (int)rtx->num_of_chunks;
 
         if (rtx->newly_acked_bytes != 0) new_acked = TRUE;
         if (rtx_queue_len == 0) all_acked = TRUE;
@@ -1207,7 +1166,7 @@ unsigned int rtx_rcv_shutdown_ctsna(unsigned int ctsna)
                      rtx->newly_acked_bytes, rtx->num_of_addresses);
         rtx_reset_bytecounters(rtx);
     } else {
-        rtx_queue_len =  g_list_length(rtx->chunk_list);
+        rtx_queue_len = (int)rtx->num_of_chunks;
     }
 
 
@@ -93,9 +93,6 @@ int rtx_t3_timeout(void *rtx_instance, unsigned int address,
                    unsigned int mtu, chunk_data ** rtx_chunks);
 
 
-
-void chunk_list_debug(short event_log_level, GList * chunk_list);
-
 /**
  * function to return the last a_rwnd value we got from our peer
  */
@@ -49,9 +49,19 @@
 #include "recvctrl.h"
 #include "reltransfer.h"
 #include "errorhandler.h"
+#include "auxiliary.h"
+#include "chunkpool.h"
+#include "flowcontrol.h"
+#include "adaptation.h"
 
 #define TOTAL_SIZE(buf)		((buf)->ctrl_position+(buf)->sack_position+(buf)->data_position- 2*sizeof(SCTP_common_header))
 #define SACK_SIZE(buf)		((buf)->ctrl_position+(buf)->data_position- sizeof(SCTP_common_header))
+
+/* the common header, the SACK and the control chunks take one buffer each */
+#define MAX_DATA_IOVECS         (ADL_MAX_IOVECS - 2)
+/* the payload of a DATA chunk spread over more borrowed buffers is copied */
+#define MAX_PAYLOAD_IOVECS      8
+
 /**
  * this struct contains all data belonging to a bundling module
  */
@@ -60,17 +70,29 @@ typedef struct bundling_instance_struct
     /*@{ */
     /** buffer for control chunks */
     guchar ctrl_buf[MAX_MTU_SIZE];
-    /** buffer for sack chunks */
+    /** buffer for sack chunks, the packet starts with its common header */
     guchar sack_buf[MAX_MTU_SIZE];
-    /** buffer for data chunks */
-    guchar data_buf[MAX_MTU_SIZE];
+    /** buffer for the few DATA chunks that are not sent from where they are kept */
+    guchar copy_buf[MAX_MTU_SIZE];
+    /** the DATA chunks are sent from these buffers, i.e. from their chunk_data */
+    SCTP_iovec data_iov[MAX_DATA_IOVECS];
+    /** number of buffers in data_iov */
+    guint data_iovcnt;
+    /** the DATA chunks in the packet, held with cp_holdChunk() until it has been sent */
+    chunk_data* data_chunks[MAX_DATA_IOVECS];
+    /** number of chunks in data_chunks */
+    guint data_chunk_count;
     /* Leave some space for the SCTP common header */
     /**  current position in the buffer for control chunks */
     guint ctrl_position;
     /**  current position in the buffer for sack chunks */
     guint sack_position;
-    /**  current position in the buffer for data chunks */
+    /**  length of the DATA chunks plus the length of the common header */
     guint data_position;
+    /**  current position in the buffer for copied DATA chunks */
+    guint copy_position;
+    /** CRC32C (see aux_crc32c()) of the data chunks */
+    guint data_crc;
     /** is there data to be sent in the buffer ? */
     gboolean data_in_buffer;
     /**  is there a control chunk  to be sent in the buffer ? */
@@ -92,11 +114,14 @@ typedef struct bundling_instance_struct
 }
 bundling_instance;
 
+/** padding of DATA chunks, whose length is not a multiple of 4 */
+static const guchar padding[4] = { 0, 0, 0, 0 };
+
 /**
  *  one static variable for a buffer that is used, if no bundling instance has been
  *  allocated and initialized yet
  */
-static bundling_instance *global_buffer;
+static ENGINE_LOCAL bundling_instance *global_buffer;
 
 
 void bu_init_bundling(void)
@@ -122,6 +147,10 @@ gpointer bu_new(void)
     ptr->data_position = sizeof(SCTP_common_header); /* start adding data after that header ! */
     ptr->sack_position = sizeof(SCTP_common_header); /* start adding data after that header ! */
 
+    ptr->copy_position = 0;
+    ptr->data_iovcnt = 0;
+    ptr->data_chunk_count = 0;
+    ptr->data_crc = 0;
     ptr->data_in_buffer = FALSE;
     ptr->ctrl_chunk_in_buffer = FALSE;
     ptr->sack_in_buffer = FALSE;
@@ -138,11 +167,89 @@ gpointer bu_new(void)
  */
 void bu_delete(gpointer buPtr)
 {
+    bundling_instance *bu_ptr = (bundling_instance *) buPtr;
+
     event_log(INTERNAL_EVENT_0, "deleting bundling");
+    cp_freeChunks(bu_ptr->data_chunks, bu_ptr->data_chunk_count);
     free(buPtr);
 }
 
 
+/**
+ * Returns the maximum length of the chunks in a packet to a path, i.e. the MTU of
+ * the path without the IP and SCTP common headers
+ * @param bu_ptr    the bundling instance
+ * @param idx       index of the path, or -1 for the primary path
+ */
+static guint bu_maxPDU(bundling_instance *bu_ptr, gint idx)
+{
+    guint mtu = 0;
+
+    /* the global buffer is used without an association */
+    if (bu_ptr == global_buffer) return DEFAULT_SCTP_PDU;
+    if (idx < 0) idx = pm_readPrimaryPath();
+    if (idx != 0xFFFF) mtu = fc_readMTU((short)idx);
+    return (mtu > 0) ? mtu : DEFAULT_SCTP_PDU;
+}
+
+/**
+ * @return the path a chunk is put into the packet for, or -1 for the default path
+ */
+static gint bu_destination(bundling_instance *bu_ptr, unsigned int * dest_index)
+{
+    if (dest_index != NULL) return (gint)*dest_index;
+    if (bu_ptr->got_send_address) return (gint)bu_ptr->requested_destination;
+    return -1;
+}
+
+
+
+/**
+ * Sends a control chunk in a packet of its own, that is filled up with a PAD chunk
+ * (RFC 4820), e.g. a heartbeat that probes the path MTU. The chunks in the bundling
+ * buffers are not touched.
+ * @param chunk     the control chunk, its length a multiple of 4
+ * @param length    length of the chunks in the packet, without the common header
+ * @param ad_idx    index of the path the packet is sent to
+ * @return 0 if the packet has been sent, -1 else (e.g. too large for the local interface)
+ */
+gint bu_sendPadded(SCTP_simple_chunk * chunk, guint length, guint ad_idx)
+{
+    static const guchar zeros[MAX_SCTP_PDU];
+    SCTP_common_header header;
+    SCTP_chunk_header pad;
+    SCTP_iovec iov[4];
+    guint chunk_len, crc;
+
+    chunk_len = CHUNKP_LENGTH((SCTP_chunk_header *) chunk);
+    length &= ~3U;
+    if ((chunk_len % 4) != 0 || length > MAX_SCTP_PDU ||
+        length < chunk_len + sizeof(SCTP_chunk_header)) {
+        error_logii(ERROR_MAJOR, "bu_sendPadded: cannot pad chunk of %u bytes to %u bytes",
+                    chunk_len, length);
+        return -1;
+    }
+    pad.chunk_id = CHUNK_PAD;
+    pad.chunk_flags = 0;
+    pad.chunk_length = htons((gushort)(length - chunk_len));
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len  = sizeof(SCTP_common_header);
+    iov[1].iov_base = chunk;
+    iov[1].iov_len  = chunk_len;
+    iov[2].iov_base = &pad;
+    iov[2].iov_len  = sizeof(SCTP_chunk_header);
+    iov[3].iov_base = (guchar*)zeros;
+    iov[3].iov_len  = length - chunk_len - sizeof(SCTP_chunk_header);
+
+    crc = aux_crc32c(0, (guchar*)chunk, chunk_len);
+    crc = aux_crc32c(crc, (guchar*)&pad, sizeof(SCTP_chunk_header));
+    crc = aux_crc32c(crc, zeros, iov[3].iov_len);
+
+    event_logii(VERBOSE, "bu_sendPadded: sending packet with %u bytes of chunks to path %u", length, ad_idx);
+    return mdi_send_message_vector(iov, 4, (short)ad_idx, crc, ADL_SEND_PROBE);
+}
+
 
 /**
  * Keep sender from sending data right away - wait after received chunks have
@@ -204,10 +311,11 @@ gint bu_put_SACK_Chunk(SCTP_sack_chunk * chunk, unsigned int * dest_index)
         bu_ptr = global_buffer;
     }
 
-    if (SACK_SIZE(bu_ptr) + CHUNKP_LENGTH((SCTP_chunk_header *) chunk) >= MAX_SCTP_PDU) {
+    if (SACK_SIZE(bu_ptr) + CHUNKP_LENGTH((SCTP_chunk_header *) chunk) >=
+        bu_maxPDU(bu_ptr, bu_destination(bu_ptr, dest_index))) {
         lock = bu_ptr->locked;
          event_logi(VERBOSE,
-                  "Chunk Length exceeded MAX_SCTP_PDU : sending chunk to address %u !",
+                  "Chunk Length exceeded path MTU : sending chunk to address %u !",
                     (dest_index==NULL)?0:*dest_index);
         if (lock) bu_ptr->locked = FALSE;
         bu_sendAllChunks(dest_index);
@@ -257,10 +365,11 @@ gint bu_put_Ctrl_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index)
         bu_ptr = global_buffer;
     }
 
-    if (TOTAL_SIZE(bu_ptr) + CHUNKP_LENGTH((SCTP_chunk_header *) chunk) >= MAX_SCTP_PDU) {
+    if (TOTAL_SIZE(bu_ptr) + CHUNKP_LENGTH((SCTP_chunk_header *) chunk) >=
+        bu_maxPDU(bu_ptr, bu_destination(bu_ptr, dest_index))) {
         lock = bu_ptr->locked;
         event_logi(VERBOSE,
-                  "Chunk Length exceeded MAX_SCTP_PDU : sending chunk to address %u !",
+                  "Chunk Length exceeded path MTU : sending chunk to address %u !",
                     (dest_index==NULL)?0:*dest_index);
         if (lock) bu_ptr->locked = FALSE;
         bu_sendAllChunks(dest_index);
@@ -300,18 +409,58 @@ gboolean bu_userDataOutbound(void)
     return bu_ptr->data_in_buffer;
 }
 
+/**
+ * puts a buffer into the list of buffers the DATA chunks are sent from
+ */
+static void bu_addDataIovec(bundling_instance *bu_ptr, const guchar* buffer, guint length, gboolean checksum)
+{
+    if (length == 0) return;
+    bu_ptr->data_iov[bu_ptr->data_iovcnt].iov_base = (void*)buffer;
+    bu_ptr->data_iov[bu_ptr->data_iovcnt].iov_len  = length;
+    bu_ptr->data_iovcnt++;
+    if (checksum) bu_ptr->data_crc = aux_crc32c(bu_ptr->data_crc, buffer, length);
+}
+
+/**
+ * walks over the borrowed buffers of the payload of a DATA chunk, and either counts
+ * them, or puts them into the list of buffers the DATA chunks are sent from
+ * @return the number of buffers
+ */
+static guint bu_addPayloadIovecs(bundling_instance *bu_ptr, chunk_data * cdata, gboolean add, gboolean checksum)
+{
+    guint length = cdata->chunk_len - FIXED_DATA_CHUNK_SIZE;
+    guint i, offset, count, number = 0;
+    const SCTP_iovec* iov;
+
+    offset = cdata->payload_offset;
+    for (i = cdata->payload_iov; length > 0; i++) {
+        iov = &cdata->payload->iov[i];
+        count = iov->iov_len - offset;
+        if (count > length) count = length;
+        if (count > 0) {
+            if (add) bu_addDataIovec(bu_ptr, (const guchar*)iov->iov_base + offset, count, checksum);
+            number++;
+        }
+        length -= count;
+        offset = 0;
+    }
+    return number;
+}
+
 /**
  * this function used for putting data chunks into the buffer
- * Used only in the flow control module
+ * Used only in the flow control module. The chunk is not copied, but held until the
+ * packet has been sent, and sent from its chunk_data (or from its borrowed buffers).
  *
- * @param chunk pointer to chunk, that is to be put in the bundling buffer
+ * @param cdata pointer to chunk, that is to be put in the bundling buffer
  * @return TODO : error value, 0 on success
  */
-gint bu_put_Data_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index)
+gint bu_put_Data_Chunk(chunk_data * cdata,unsigned int * dest_index)
 {
     bundling_instance *bu_ptr;
-    gint count;
-    gboolean lock;
+    SCTP_simple_chunk *chunk = (SCTP_simple_chunk *) cdata->data;
+    guint pad, iovecs, length;
+    gboolean lock, copy = FALSE, combine;
 
     event_log(INTERNAL_EVENT_0, "bu_put_Data_Chunk() was called ");
 
@@ -322,10 +471,24 @@ gint bu_put_Data_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index)
         bu_ptr = global_buffer;
     }
 
-    if (TOTAL_SIZE(bu_ptr) + CHUNKP_LENGTH((SCTP_chunk_header *) chunk) >= MAX_SCTP_PDU) {
+    length = CHUNKP_LENGTH((SCTP_chunk_header *) chunk);
+    pad = (4 - (length % 4)) % 4;
+    /* the chunk header, the payload and the padding */
+    if (cdata->payload == NULL) {
+        iovecs = 1;
+    } else {
+        iovecs = 1 + bu_addPayloadIovecs(bu_ptr, cdata, FALSE, FALSE);
+        if (iovecs > 1 + MAX_PAYLOAD_IOVECS) copy = TRUE;
+    }
+    if (copy) iovecs = 1;
+    else if (pad > 0) iovecs++;
+
+    if ((TOTAL_SIZE(bu_ptr) + length >= bu_maxPDU(bu_ptr, bu_destination(bu_ptr, dest_index))) ||
+        (bu_ptr->data_iovcnt + iovecs > MAX_DATA_IOVECS) ||
+        (bu_ptr->copy_position + length + pad > sizeof(bu_ptr->copy_buf))) {
         lock = bu_ptr->locked;
         event_logi(VERBOSE,
-                  "Chunk Length exceeded MAX_SCTP_PDU : sending chunk to address %u !",
+                  "Chunk Length exceeded path MTU : sending chunk to address %u !",
                     (dest_index==NULL)?0:*dest_index);
         if (lock) bu_ptr->locked = FALSE;
         bu_sendAllChunks(dest_index);
@@ -334,20 +497,37 @@ gint bu_put_Data_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index)
         bu_ptr->got_send_address = TRUE;
         bu_ptr->requested_destination = *dest_index;
     }
-    memcpy(&(bu_ptr->data_buf[bu_ptr->data_position]), chunk,
-           CHUNKP_LENGTH((SCTP_chunk_header *) chunk));
-    bu_ptr->data_position += CHUNKP_LENGTH((SCTP_chunk_header *) chunk);
 
-
-    /* insert padding, if necessary */
-    if ((CHUNKP_LENGTH((SCTP_chunk_header *) chunk) % 4) != 0) {
-        for (count = 0; count < (4 - (CHUNKP_LENGTH((SCTP_chunk_header *) chunk) % 4)); count++) {
-            bu_ptr->data_buf[bu_ptr->data_position] = 0;
-            bu_ptr->data_position++;
+    /* checksum the chunk header (with the TSN) and the padding, and reuse the CRC32C of the payload */
+    combine = (!copy) && (cdata->crc_shift != 0);
+
+    if (copy) {
+        memcpy(&(bu_ptr->copy_buf[bu_ptr->copy_position]), chunk, FIXED_DATA_CHUNK_SIZE);
+        cp_copyPayload(cdata, &(bu_ptr->copy_buf[bu_ptr->copy_position + FIXED_DATA_CHUNK_SIZE]));
+        memset(&(bu_ptr->copy_buf[bu_ptr->copy_position + length]), 0, pad);
+        bu_addDataIovec(bu_ptr, &(bu_ptr->copy_buf[bu_ptr->copy_position]), length + pad, TRUE);
+        bu_ptr->copy_position += length + pad;
+    } else if (cdata->payload == NULL) {
+        if (combine) {
+            bu_addDataIovec(bu_ptr, cdata->data, length, FALSE);
+            bu_ptr->data_crc = aux_crc32c(bu_ptr->data_crc, cdata->data, FIXED_DATA_CHUNK_SIZE);
+            bu_ptr->data_crc = aux_crc32c_combine(bu_ptr->data_crc, cdata->crc_partial, cdata->crc_shift);
+        } else {
+            bu_addDataIovec(bu_ptr, cdata->data, length, TRUE);
         }
+    } else {
+        bu_addDataIovec(bu_ptr, cdata->data, FIXED_DATA_CHUNK_SIZE, TRUE);
+        bu_addPayloadIovecs(bu_ptr, cdata, TRUE, !combine);
+        if (combine) bu_ptr->data_crc = aux_crc32c_combine(bu_ptr->data_crc, cdata->crc_partial, cdata->crc_shift);
     }
+    if (!copy) bu_addDataIovec(bu_ptr, padding, pad, TRUE);
+    bu_ptr->data_position += length + pad;
+
+    cp_holdChunk(cdata);
+    bu_ptr->data_chunks[bu_ptr->data_chunk_count++] = cdata;
+
     event_logii(VERBOSE, "Put Data Chunk Length : %u , Total buffer size (incl. padding): %u\n",
-                CHUNKP_LENGTH((SCTP_chunk_header *) chunk), TOTAL_SIZE(bu_ptr));
+                length, TOTAL_SIZE(bu_ptr));
 
     bu_ptr->data_in_buffer = TRUE;
 
@@ -370,8 +550,9 @@ gint bu_put_Data_Chunk(SCTP_simple_chunk * chunk,unsigned int * dest_index)
  */
 gint bu_sendAllChunks(guint * ad_idx)
 {
-    gint result, send_len = 0;
-    guchar *send_buffer = NULL;
+    gint result, send_len = 0, sendFlags = 0;
+    guint i, iovcnt, crc;
+    SCTP_iovec iov[ADL_MAX_IOVECS];
     bundling_instance *bu_ptr;
     gshort idx = 0;
 
@@ -411,61 +592,56 @@ gint bu_sendAllChunks(guint * ad_idx)
 
     event_logi(VVERBOSE, "bu_sendAllChunks : send to path %d ", idx);
 
-    if (bu_ptr->sack_in_buffer)             send_buffer = bu_ptr->sack_buf;
-    else if (bu_ptr->ctrl_chunk_in_buffer)  send_buffer = bu_ptr->ctrl_buf;
-    else if (bu_ptr->data_in_buffer)        send_buffer = bu_ptr->data_buf;
-    else {
+    if (!bu_ptr->sack_in_buffer && !bu_ptr->ctrl_chunk_in_buffer && !bu_ptr->data_in_buffer) {
         error_log(ERROR_MINOR, "Nothing to send, but bu_sendAllChunks was called !");
         return 1;
     }
 
+    /* the packet is gathered from the SACK buffer with the common header in front,
+       the control chunks and the DATA chunks, and the CRC32C of the chunks is combined */
+    iov[0].iov_base = bu_ptr->sack_buf;
+    iov[0].iov_len  = bu_ptr->sack_position; /* at least sizeof(SCTP_common_header) */
+    iovcnt = 1;
+    send_len = bu_ptr->sack_position;
+    crc = aux_crc32c(0, &(bu_ptr->sack_buf[sizeof(SCTP_common_header)]),
+                     bu_ptr->sack_position - sizeof(SCTP_common_header));
     if (bu_ptr->sack_in_buffer) {
         rxc_stop_sack_timer();
         /* SACKs by default go to the last active address, from which data arrived */
-        send_len = bu_ptr->sack_position; /* at least sizeof(SCTP_common_header) */
-        /* at most pointing to the end of SACK chunk */
         event_logi(VVERBOSE, "bu_sendAllChunks(sack) : send_len == %d ", send_len);
-        if (bu_ptr->ctrl_chunk_in_buffer) {
-            memcpy(&send_buffer[send_len],
-                   &(bu_ptr->ctrl_buf[sizeof(SCTP_common_header)]),
-                   (bu_ptr->ctrl_position - sizeof(SCTP_common_header)));
-            send_len += bu_ptr->ctrl_position - sizeof(SCTP_common_header);
-            event_logi(VVERBOSE, "bu_sendAllChunks(sack+ctrl) : send_len == %d ", send_len);
-        }
-        if (bu_ptr->data_in_buffer) {
-            memcpy(&send_buffer[send_len],
-                   &(bu_ptr->data_buf[sizeof(SCTP_common_header)]),
-                   (bu_ptr->data_position - sizeof(SCTP_common_header)));
-            send_len += bu_ptr->data_position - sizeof(SCTP_common_header);
-            event_logi(VVERBOSE, "bu_sendAllChunks(sack+data) : send_len == %d ", send_len);
-        }
-    } else if (bu_ptr->ctrl_chunk_in_buffer) {
-        send_len = bu_ptr->ctrl_position;
+    }
+    if (bu_ptr->ctrl_chunk_in_buffer) {
+        iov[iovcnt].iov_base = &(bu_ptr->ctrl_buf[sizeof(SCTP_common_header)]);
+        iov[iovcnt].iov_len  = bu_ptr->ctrl_position - sizeof(SCTP_common_header);
+        crc = aux_crc32c(crc, (guchar*)iov[iovcnt].iov_base, iov[iovcnt].iov_len);
+        send_len += iov[iovcnt].iov_len;
+        iovcnt++;
         event_logi(VVERBOSE, "bu_sendAllChunks(ctrl) : send_len == %d ", send_len);
-        if (bu_ptr->data_in_buffer) {
-            memcpy(&send_buffer[send_len],
-                   &(bu_ptr->data_buf[sizeof(SCTP_common_header)]),
-                   (bu_ptr->data_position - sizeof(SCTP_common_header)));
-            send_len += bu_ptr->data_position - sizeof(SCTP_common_header);
-            event_logi(VVERBOSE, "bu_sendAllChunks(ctrl+data) : send_len == %d ", send_len);
-        }
-
-    } else if (bu_ptr->data_in_buffer) send_len = bu_ptr->data_position;
+    }
+    if (bu_ptr->data_in_buffer) {
+        for (i = 0; i < bu_ptr->data_iovcnt; i++) iov[iovcnt++] = bu_ptr->data_iov[i];
+        crc = aux_crc32c_combine(crc, bu_ptr->data_crc,
+                                 aux_crc32c_shift(bu_ptr->data_position - sizeof(SCTP_common_header)));
+        send_len += bu_ptr->data_position - sizeof(SCTP_common_header);
+        event_logi(VVERBOSE, "bu_sendAllChunks(data) : send_len == %d ", send_len);
+    }
 
     event_logi(VVERBOSE, "bu_sendAllChunks(finally) : send_len == %d ", send_len);
 
-    if (send_len > 1480) {
-        fprintf(stderr, "MTU definitely exceeded (%u) - aborting\n",send_len);
-        fprintf(stderr, "sack_position: %u, ctrl_position: %u, data_position: %u\n",
-            bu_ptr->sack_position,bu_ptr->ctrl_position,bu_ptr->data_position);
-        abort();
+    if ((guint)send_len > bu_maxPDU(bu_ptr, idx) + sizeof(SCTP_common_header)) {
+        /* a chunk that was cut before the path MTU decreased, e.g. a retransmission */
+        event_logii(VERBOSE, "bu_sendAllChunks: packet of %d bytes exceeds the MTU of path %d",
+                    send_len, idx);
+        event_logiii(VERBOSE, "sack_position: %u, ctrl_position: %u, data_position: %u",
+                     bu_ptr->sack_position, bu_ptr->ctrl_position, bu_ptr->data_position);
+        sendFlags = ADL_SEND_FRAGMENT;
     }
 
     if ((bu_ptr->data_in_buffer) && (idx != -1)) pm_chunksSentOn(idx);
 
     event_logii(VERBOSE, "bu_sendAllChunks() : sending message len==%u to adress idx=%d", send_len, idx);
 
-    result = mdi_send_message((SCTP_message *) send_buffer, send_len, idx);
+    result = mdi_send_message_vector(iov, iovcnt, idx, crc, sendFlags);
 
     event_logi(VVERBOSE, "bu_sendAllChunks(): result == %s ", (result==0)?"OKAY":"ERROR");
 
@@ -473,12 +649,19 @@ gint bu_sendAllChunks(guint * ad_idx)
     bu_ptr->sack_in_buffer = FALSE;
     bu_ptr->ctrl_chunk_in_buffer = FALSE;
     bu_ptr->data_in_buffer = FALSE;
+    bu_ptr->data_crc = 0;
     bu_ptr->got_send_request = FALSE;
     bu_ptr->got_send_address = FALSE;
 
     bu_ptr->data_position = sizeof(SCTP_common_header);
     bu_ptr->ctrl_position = sizeof(SCTP_common_header);
     bu_ptr->sack_position = sizeof(SCTP_common_header);
+    bu_ptr->copy_position = 0;
+    bu_ptr->data_iovcnt = 0;
+
+    /* the DATA chunks have been sent, give them back */
+    cp_freeChunks(bu_ptr->data_chunks, bu_ptr->data_chunk_count);
+    bu_ptr->data_chunk_count = 0;
 
     return result;
 }
@@ -116,6 +116,9 @@ extern "C" {
 #define SCTP_SEND_RELIABLE                  SCTP_INFINITE_LIFETIME
 #define SCTP_NO_CONTEXT                     NULL
 #define SCTP_GENERIC_PAYLOAD_PROTOCOL_ID    0
+/* for sctp_sendv(): boolean, 0==data is copied, 1==buffers are borrowed until sendCompleteNotif */
+#define SCTP_COPY_BUFFERS                   0
+#define SCTP_BORROW_BUFFERS                 1
 /* these are for sctp_receive() */
 #define SCTP_MSG_DEFAULT                    0x00
 #define SCTP_MSG_PEEK                       0x02
@@ -276,6 +279,17 @@ struct SCTP_ulp_Callbacks
      *  @param 4 pointer to ULP data
      */
     void (*asconfStatusNotif) (unsigned int, unsigned int, int, void*, void*);
+    /**
+     * indicates that a message sent with sctp_sendv() from borrowed buffers has been
+     * acked or abandoned, so that its buffers are no longer used by the library.
+     * Only read by sctp_sendv() with SCTP_BORROW_BUFFERS. It is called at the end of an
+     * event loop pass, or before sctp_abort(), sctp_receiveUnsent(), sctp_receiveUnacked()
+     * and sctp_deleteAssociation() return when these are not called from a callback.
+     *  @param 1 associationID
+     *  @param 2 context from sctp_sendv()
+     *  @param 3 pointer to ULP data
+     */
+    void (*sendCompleteNotif) (unsigned int, void*, void*);
     /* @} */
 }SCTP_ulpCallbacks;
 
@@ -311,7 +325,36 @@ struct SCTP_Library_Parameters {
      * Allowed values are 0 (==FALSE) or 1 (== TRUE)
      */
     int supportADDIP;
-
+    /**
+     * maximum number of datagrams that are queued while incoming packets or timers
+     * are processed, and then sent with one sendmmsg() call per socket.
+     * 0 (default) sends each datagram at once. Allowed values are 0 to 64, if the
+     * system supports sendmmsg(), else only 0.
+     */
+    unsigned int sendBatchSize;
+    /**
+     * maximum time (in usecs) a datagram may wait in the transmit queue,
+     * 0 (default) means it waits until the processing of events has finished
+     */
+    unsigned int sendBatchMaxDelay;
+    /* this is read-only (get): number of sendmmsg() calls made so far */
+    unsigned int sendBatchCalls;
+    /* this is read-only (get): number of datagrams sent by these calls */
+    unsigned int sendBatchDatagrams;
+    /* this is read-only (get): largest number of datagrams sent by one call */
+    unsigned int sendBatchLargest;
+    /**
+     * maximum number of expired timers that are handled in one pass of the
+     * event loop, default is 64. 0 keeps the current budget.
+     */
+    unsigned int timerBudget;
+    /* this is read-only (get): number of DATA chunks received so far */
+    unsigned int receivedChunks;
+    /**
+     * this is read-only (get): number of these chunks that held a whole message, which
+     * could be delivered at once (unordered, or the next message of its stream)
+     */
+    unsigned int expressChunks;
 
 }SCTP_LibraryParameters;
 
@@ -475,7 +518,7 @@ struct SCTP_Path_Status
     unsigned int ssthresh;
     /**  from flow control */
     unsigned int outstandingBytesPerAddress;
-    /**  Current MTU (flowcontrol) */
+    /**  path MTU, as far as it has been discovered by path MTU probes */
     unsigned int mtu;
     /** per path ? per instance ? for the IP type of service field. */
     unsigned char ipTos;
@@ -483,11 +526,61 @@ struct SCTP_Path_Status
 }SCTP_PathStatus;
 
 
+typedef
+/**
+ * one buffer of a message passed to sctp_sendv()
+ */
+struct SCTP_Iovec
+{
+    /* @{ */
+    /** start of the buffer */
+    void* iov_base;
+    /** length of the buffer in bytes */
+    unsigned int iov_len;
+    /* @} */
+}SCTP_iovec;
+
+
+typedef
+/**
+ * one message returned by sctp_receive_batch()
+ */
+struct SCTP_Received_Message
+{
+    /* @{ */
+    /** the stream the message was received on */
+    unsigned short streamID;
+    /** stream sequence number of the message */
+    unsigned short streamSN;
+    /** TSN of the first fragment that is read */
+    unsigned int tsn;
+    /** payload protocol identifier */
+    unsigned int protocolId;
+    /** index of the path the first fragment that is read was received from */
+    unsigned int addressIndex;
+    /** number of bytes returned in data */
+    unsigned int length;
+    /** bytes of the message that are left for the next call, if it did not fit */
+    unsigned int remaining;
+    /** the message, within the arena passed to sctp_receive_batch() */
+    unsigned char* data;
+    /* @} */
+}SCTP_ReceivedMessage;
+
+
 /******************** Function Definitions ********************************************************/
 
 /**
  * Function that needs to be called in advance to all library calls.
- * It initializes all file descriptors etc. and sets up some variables
+ * It initializes all file descriptors etc. and sets up some variables.
+ * If the library has been configured with --enable-engine-per-thread, every thread
+ * that calls it gets a protocol engine of its own, with its own sockets, timers,
+ * instances and associations, and all other library functions act on the engine of
+ * the calling thread. Each engine is then run by its thread with sctp_eventLoop(),
+ * without locking. As every raw SCTP socket receives all SCTP packets, each engine
+ * sees the packets of the others, so sendOotbAborts must be turned off. For the same
+ * reason the engines use disjoint local ports: sctp_registerInstance() fails for a port
+ * that an instance of another engine uses, except among shards (see sctp_initShards()).
  * @return 0 for success, 1 for adaptation level error, -1 if already called
  * (i.e. the function has already been called before), -2 for insufficient rights
  * (you need root-rights to open RAW sockets !).
@@ -495,6 +588,56 @@ struct SCTP_Path_Status
 int sctp_initLibrary(void);
 
 
+/**
+ * Sets up sharded engines (requires --enable-engine-per-thread): the engine of the
+ * calling thread becomes the receive dispatcher, that reads the SCTP sockets in batches
+ * and steers every packet to the shard that owns its association, through a lock-free
+ * ring. It is called instead of sctp_initLibrary(), and before the shards are started;
+ * the thread then runs sctp_eventLoop() like any other engine.
+ * Each of the shards is an engine run by a thread of its own, that calls sctp_initShard()
+ * instead of sctp_initLibrary(), registers the same instances, and runs sctp_eventLoop().
+ * Shards may register instances on the same local ports, ports chosen by the library
+ * are still used by one shard only.
+ * A shard owns the associations whose verification tags it has chosen, and their timers.
+ * As INIT chunks carry no tag yet, associations started by a peer are set up by the
+ * shard of the peer's address and port (see sctp_getShardOfPeer()), and so
+ * sctp_associate() must be called on that shard, too. With sctp_associatex(), that is
+ * the shard of the first destination address. A multihomed peer may send INITs from its
+ * other addresses as well, on a restart or an INIT collision: these reach the shards of
+ * those addresses, which do not know the association, and so are handled as the start
+ * of a new association. All other calls for an association
+ * must be made on the shard returned by sctp_getShardOfAssociation(). As only the
+ * dispatcher reads the sockets, sendOotbAborts need not be turned off.
+ * @param  numberOfShards   number of shards, at least 1
+ * @return SCTP_SUCCESS, SCTP_PARAMETER_PROBLEM, SCTP_NOT_SUPPORTED, or the errors of
+ *         sctp_initLibrary()
+ */
+int sctp_initShards(unsigned int numberOfShards);
+
+/**
+ * Makes the engine of the calling thread one of the shards set up by sctp_initShards(),
+ * instead of sctp_initLibrary().
+ * @param  shard    index of the shard, less than the number of shards
+ * @return SCTP_SUCCESS, SCTP_PARAMETER_PROBLEM if there is no such shard or it is already
+ *         run by another thread, SCTP_LIBRARY_NOT_INITIALIZED if there are no shards,
+ *         SCTP_NOT_SUPPORTED, or the errors of sctp_initLibrary()
+ */
+int sctp_initShard(unsigned int shard);
+
+/**
+ * @return index of the shard that owns an association, SCTP_LIBRARY_NOT_INITIALIZED if
+ *         there are no shards, or SCTP_PARAMETER_PROBLEM
+ */
+int sctp_getShardOfAssociation(unsigned int associationID);
+
+/**
+ * @return index of the shard that sets up the associations with a peer, i.e. on which
+ *         sctp_associate() must be called, SCTP_LIBRARY_NOT_INITIALIZED if there are no
+ *         shards, or SCTP_PARAMETER_PROBLEM if the address is not valid
+ */
+int sctp_getShardOfPeer(unsigned char address[SCTP_MAX_IP_LEN], unsigned short port);
+
+
 /**
  * Function returns coded library version as result. This unsigned integer
  * contains the major version in the upper 16 bits, and the minor version in
@@ -550,6 +693,18 @@ int sctp_send_private(unsigned int associationID,
                       int unorderedDelivery, /* use constants SCTP_ORDERED_DELIVERY, SCTP_UNORDERED_DELIVERY */
                       int dontBundle);  /* use constants SCTP_BUNDLING_ENABLED, SCTP_BUNDLING_DISABLED */
 
+int sctp_sendv(unsigned int associationID,
+               unsigned short streamID,
+               const SCTP_iovec *iov,
+               unsigned int iovcnt,
+               unsigned int protocolId,
+               short path_id,         /* -1 for primary path, else address index to be taken */
+               void * context,        /* SCTP_NO_CONTEXT */
+               unsigned int lifetime, /* 0xFFFFFFFF-> infinite, 0->no retransmit, else msecs */
+               int unorderedDelivery, /* use constants SCTP_ORDERED_DELIVERY, SCTP_UNORDERED_DELIVERY */
+               int dontBundle,        /* use constants SCTP_BUNDLING_ENABLED, SCTP_BUNDLING_DISABLED */
+               int borrowBuffers);    /* use constants SCTP_COPY_BUFFERS, SCTP_BORROW_BUFFERS */
+
 
 /*
  *  sctp_receive() now returns SCTP_SUCCESS if data was received okay,
@@ -565,6 +720,15 @@ int sctp_receivefrom(unsigned int associationID, unsigned short streamID, unsign
                      unsigned int *length, unsigned short *streamSN, unsigned int * tsn,
                      unsigned int *addressIndex, unsigned int flags);
 
+/*
+ *  sctp_receive_batch() reads up to maxMessages messages from all streams at once, and
+ *  copies them one after the other into the arena. It returns SCTP_SUCCESS and the number
+ *  of messages in numMessages, or the same errors as sctp_receive().
+ */
+int sctp_receive_batch(unsigned int associationID, SCTP_ReceivedMessage *messages,
+                       unsigned int maxMessages, unsigned char *arena, unsigned int arenaLength,
+                       unsigned int *numMessages);
+
 
 
 /*----------------------------------------------------------------------------------------------*/
@@ -737,6 +901,76 @@ int sctp_eventLoop(void);
 
 int sctp_extendedEventLoop(void (*lock)(void* data), void (*unlock)(void* data), void* data);
 
+#ifndef WIN32
+/* commands that other threads submit to the command queue of an engine */
+#define SCTP_COMMAND_SEND                   1
+#define SCTP_COMMAND_SHUTDOWN               2
+#define SCTP_COMMAND_ABORT                  3
+#define SCTP_COMMAND_SET_PRIMARY            4
+
+typedef struct SCTP_COMMAND_QUEUE SCTP_CommandQueue;
+
+/* Defines the callback function that is called by the event loop when a submitted
+   command has been executed
+   Params: 1. ID of the association
+           2. the command, e.g. SCTP_COMMAND_SEND
+           3. the result of the command, as returned by sctp_send(), sctp_shutdown(),
+              sctp_abort() or sctp_setPrimary()
+           4. context given with the command
+*/
+typedef void (*sctp_commandCallback) (unsigned int, int, int, void*);
+
+/**
+ * Returns the command queue of the engine, which is created on the first call. Other
+ * threads submit sends, shutdowns, aborts and changes of the primary path to it without
+ * taking a lock, instead of calling the library while it runs the event loop (as with
+ * sctp_extendedEventLoop()). The queue wakes up the event loop through a file descriptor
+ * in its poll set, and the commands are executed there in the order of submission. Their
+ * results are reported to a completion callback, which is called by the event loop thread.
+ * The queue lives as long as the engine, and its commands must be submitted to it.
+ * With sharded engines, they go to the queue of the shard that owns the association:
+ * the submit functions pick it when they are given NULL as queue, once each shard has
+ * called this function.
+ * To be called by the thread that runs the event loop.
+ * @return the command queue, or NULL for error
+ */
+SCTP_CommandQueue* sctp_getCommandQueue(void);
+
+/**
+ * Submits the sending of a message, like sctp_send(). May be called by any thread.
+ * The message is copied, so the buffer can be reused at once.
+ * @param  queue        the command queue, or NULL for that of the shard owning the association
+ * @param  context      passed to sctp_send(), and to the completion callback
+ * @param  completion   the completion callback, or NULL
+ * @return SCTP_SUCCESS, SCTP_PARAMETER_PROBLEM or SCTP_OUT_OF_RESOURCES
+ */
+int sctp_submitSend(SCTP_CommandQueue* queue,
+                    unsigned int associationID,
+                    unsigned short streamID,
+                    unsigned char *buffer,
+                    unsigned int length,
+                    unsigned int protocolId,
+                    short path_id,
+                    void * context,
+                    unsigned int lifetime,
+                    int unorderedDelivery,
+                    int dontBundle,
+                    sctp_commandCallback completion);
+
+/**
+ * Submit sctp_shutdown(), sctp_abort() and sctp_setPrimary(). May be called by any thread.
+ * @return SCTP_SUCCESS, SCTP_PARAMETER_PROBLEM or SCTP_OUT_OF_RESOURCES
+ */
+int sctp_submitShutdown(SCTP_CommandQueue* queue, unsigned int associationID,
+                        sctp_commandCallback completion, void* context);
+
+int sctp_submitAbort(SCTP_CommandQueue* queue, unsigned int associationID,
+                     sctp_commandCallback completion, void* context);
+
+int sctp_submitSetPrimary(SCTP_CommandQueue* queue, unsigned int associationID, short path_id,
+                          sctp_commandCallback completion, void* context);
+#endif
+
 /**
  *  these next funtions are unused. They should either be implemented, or removed :-)
  *  Maybe we should ask Thomas...
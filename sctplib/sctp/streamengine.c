@@ -46,6 +46,9 @@
 #include <errno.h>
 #include "flowcontrol.h"
 #include "streamengine.h"
+#include "auxiliary.h"
+#include "chunkpool.h"
+#include "adaptation.h"
 #include "distribution.h"
 #include "errorhandler.h"
 #include "SCTP-control.h"
@@ -64,8 +67,14 @@ typedef struct
     GList   *pduList;         /* list of PDUs waiting for pickup (after notification has been called) */
     GList   *prePduList;      /* list of PDUs waiting for transfer to pduList and doing mdi arrive notification */
     guint16  nextSSN;
-    guint16  highestSSN;      /* used to detect Protocol violations in se_searchReadyPdu */
-    gboolean highestSSNused;
+    GHashTable *messages;     /* ordered messages being reassembled or waiting for nextSSN, by SSN */
+    GHashTable *fragments;    /* fragments of unordered messages, by TSN */
+    GHashTable *orderedFragments; /* fragments of the ordered messages, by TSN, see se_mixedFragments() */
+    guint32  lastTSN;         /* used to detect Protocol violations in se_deliverInSequence */
+    gboolean lastTSNused;
+    int nextActive;           /* next stream in the list of streams with a prePduList, or -1 */
+    int nextReady;            /* next stream in the list of streams with a pduList, or -1 */
+    gboolean ready;           /* stream is in that list, its pduList may have been emptied since */
     int index;
 }ReceiveStream;
 
@@ -83,10 +92,21 @@ typedef struct
     gboolean*       recvStreamActivated;
     unsigned int    queuedBytes;
     gboolean        unreliable;
-
-    GList           *List;	 /* list for all packets */
+    /* streams with PDUs in their prePduList, linked by nextActive, or -1 */
+    int             firstActive;
+    int             lastActive;
+    /* streams with PDUs for pickup by the ULP, linked by nextReady, or -1 */
+    int             firstReady;
+    int             lastReady;
 }StreamEngine;
 
+/* payloads shorter than this share of their receive buffer are copied out of it */
+#define SE_REFERENCED_SHARE         6
+
+/* DATA chunks received, and those queued on the express path, by all associations */
+static ENGINE_LOCAL unsigned int se_receivedChunks = 0;
+static ENGINE_LOCAL unsigned int se_expressChunks  = 0;
+
 /*
  * this stores all the data need to be delivered to the user
  */
@@ -99,7 +119,10 @@ typedef struct _delivery_data
     guint16 stream_sn;
     guint32 protocolId;
     guint32 fromAddressIndex;
-    guchar  data[MAX_DATACHUNK_PDU_LENGTH];
+    /* the payload, in the receive buffer of the datagram, or behind this struct */
+    guchar* data;
+    /* the receive buffer referenced, see adl_holdReceiveBuffer(), or NULL */
+    void*   rbuf;
 }
 delivery_data;
 
@@ -121,8 +144,21 @@ typedef struct _delivery_pdu
 
 
 
+/*
+ * this struct collects the fragments of an ordered message
+ */
+typedef struct _reassembly_data
+{
+    guint16  stream_sn;
+    guint32  number_of_chunks;
+    guint32  size;
+    /* the fragments received so far, sorted by TSN */
+    delivery_data** ddata;
+}reassembly_data;
+
+
+
 /******************** Declarations *************************************************/
-int se_searchReadyPdu(StreamEngine* se);
 int se_deliverWaiting(StreamEngine* se, unsigned short sid);
 
 void print_element(gpointer list_element, gpointer user_data)
@@ -135,16 +171,6 @@ void print_element(gpointer list_element, gpointer user_data)
     }
 }
 
-int sort_tsn_se(delivery_data * one, delivery_data * two)
-{
-    if (before(one->tsn, two->tsn)) {
-        return -1;
-    } else if (after(one->tsn, two->tsn)) {
-        return 1;
-    } else                      /* one==two */
-        return 0;
-}
-
 /******************** Function Definitions *****************************************/
 
 /* This function is called to instanciate one Stream Engine for an association.
@@ -203,6 +229,14 @@ void* se_new_stream_engine (unsigned int numberReceiveStreams,        /* max of
       (se->RecvStreams)[i].nextSSN = 0;
       (se->RecvStreams)[i].pduList = NULL;
       (se->RecvStreams)[i].prePduList = NULL;
+      (se->RecvStreams)[i].messages = NULL;
+      (se->RecvStreams)[i].fragments = NULL;
+      (se->RecvStreams)[i].orderedFragments = NULL;
+      (se->RecvStreams)[i].lastTSN = 0;
+      (se->RecvStreams)[i].lastTSNused = FALSE;
+      (se->RecvStreams)[i].nextActive = -1;
+      (se->RecvStreams)[i].nextReady = -1;
+      (se->RecvStreams)[i].ready = FALSE;
       (se->RecvStreams)[i].index = 0; /* for ordered chunks, next ssn */
     }
     for (i = 0; i < numberSendStreams; i++)
@@ -211,25 +245,65 @@ void* se_new_stream_engine (unsigned int numberReceiveStreams,        /* max of
     }
 
     se->queuedBytes = 0;
-    se->List          = NULL;
+    se->firstActive = -1;
+    se->lastActive  = -1;
+    se->firstReady  = -1;
+    se->lastReady   = -1;
     return (se);
 }
 
 
-/* Free all chunks in list */
-static void free_delivery_pdu(gpointer list_element, gpointer user_data)
+/* Free a chunk, and release the receive buffer holding its payload */
+static void free_delivery_data(delivery_data* d_chunk)
 {
-   delivery_pdu* d_pdu = (delivery_pdu*)list_element;
-   int           i;
+   adl_releaseReceiveBuffer(d_chunk->rbuf);
+   free(d_chunk);
+}
+
 
-   if(d_pdu->ddata != NULL) {
-      for (i = 0; i < (int)d_pdu->number_of_chunks; i++) {
-         free(d_pdu->ddata[i]);
-         d_pdu->ddata[i] = NULL;
-      }
+/* Free an ordered message that has not been delivered, with its chunks */
+static void free_reassembly_data(reassembly_data* msg)
+{
+   unsigned int i;
+
+   for (i = 0; i < msg->number_of_chunks; i++) free_delivery_data(msg->ddata[i]);
+   free(msg->ddata);
+   free(msg);
+}
+
+
+static void free_message(gpointer key, gpointer value, gpointer user_data)
+{
+   free_reassembly_data((reassembly_data*)value);
+}
+
+
+static void free_fragment(gpointer key, gpointer value, gpointer user_data)
+{
+   free_delivery_data((delivery_data*)value);
+}
+
+
+/* Free a PDU with its chunks. An express PDU (see se_recvDataChunk()) is a single
+   block, that holds its only chunk. */
+static void free_pdu(delivery_pdu* d_pdu)
+{
+   unsigned int i;
+
+   if (d_pdu->ddata == (delivery_data**)(d_pdu + 1)) {
+      adl_releaseReceiveBuffer(d_pdu->ddata[0]->rbuf);
+   } else {
+      for (i = 0; i < d_pdu->number_of_chunks; i++) free_delivery_data(d_pdu->ddata[i]);
       free(d_pdu->ddata);
-      free(d_pdu);
    }
+   free(d_pdu);
+}
+
+
+/* Free all chunks in list */
+static void free_delivery_pdu(gpointer list_element, gpointer user_data)
+{
+   free_pdu((delivery_pdu*)list_element);
 }
 
 
@@ -252,6 +326,18 @@ se_delete_stream_engine (void *septr)
      g_list_foreach(se->RecvStreams[i].prePduList, &free_delivery_pdu, NULL);
      g_list_free(se->RecvStreams[i].pduList);
      g_list_free(se->RecvStreams[i].prePduList);
+     if (se->RecvStreams[i].messages != NULL) {
+        g_hash_table_foreach(se->RecvStreams[i].messages, &free_message, NULL);
+        g_hash_table_destroy(se->RecvStreams[i].messages);
+     }
+     if (se->RecvStreams[i].fragments != NULL) {
+        g_hash_table_foreach(se->RecvStreams[i].fragments, &free_fragment, NULL);
+        g_hash_table_destroy(se->RecvStreams[i].fragments);
+     }
+     /* only refers to the chunks of the messages */
+     if (se->RecvStreams[i].orderedFragments != NULL) {
+        g_hash_table_destroy(se->RecvStreams[i].orderedFragments);
+     }
   }
 
   event_log (INTERNAL_EVENT_0, "delete streamengine: freeing receive streams");
@@ -282,6 +368,59 @@ se_readNumberOfStreams (unsigned short *inStreams, unsigned short *outStreams)
 
 /******************** Functions for Sending *****************************************/
 
+/**
+ * Computes the CRC32C of the payload of a new DATA chunk once, so that the bundling
+ * does not need to checksum it again for the first and for each further transmission.
+ * @param cdata    the chunk, with the payload already copied
+ * @param length   the length of the payload
+ */
+static void se_checksumPayload(chunk_data* cdata, unsigned int length)
+{
+    if (aux_crc32c_combining()) {
+        cdata->crc_partial = aux_crc32c(0, &cdata->data[FIXED_DATA_CHUNK_SIZE], length);
+        cdata->crc_shift   = aux_crc32c_shift(length);
+    } else {
+        cdata->crc_partial = 0;
+        cdata->crc_shift   = 0;
+    }
+}
+
+
+/**
+ * Walks over length bytes of the buffers of a message, starting at buffer *index and
+ * offset *offset in it, and advances both behind these bytes.
+ * @param iov       the buffers of the message
+ * @param dest      where the bytes are copied to, or NULL
+ * @param checksum  TRUE if the CRC32C of the bytes is to be computed
+ * @return the CRC32C of the bytes (see aux_crc32c()), or 0
+ */
+static unsigned int se_slicePayload(const SCTP_iovec* iov, unsigned int* index, unsigned int* offset,
+                                    unsigned int length, unsigned char* dest, gboolean checksum)
+{
+    const unsigned char* src;
+    unsigned int count, crc = 0;
+
+    while (length > 0) {
+        count = iov[*index].iov_len - *offset;
+        if (count == 0) {
+            (*index)++;
+            *offset = 0;
+            continue;
+        }
+        if (count > length) count = length;
+        src = (const unsigned char*)iov[*index].iov_base + *offset;
+        if (dest != NULL) {
+            memcpy(dest, src, count);
+            dest += count;
+        }
+        if (checksum) crc = aux_crc32c(crc, src, count);
+        *offset += count;
+        length -= count;
+    }
+    return crc;
+}
+
+
 /**
  * This function is called to send a chunk.
  *  called from MessageDistribution
@@ -292,14 +431,36 @@ se_ulpsend (unsigned short streamId, unsigned char *buffer,
             unsigned int byteCount,  unsigned int protocolId,
             short destAddressIndex, void *context, unsigned int lifetime,
             gboolean unorderedDelivery, gboolean dontBundle)
+{
+    SCTP_iovec iov;
+
+    iov.iov_base = buffer;
+    iov.iov_len  = byteCount;
+    return se_ulpsendv (streamId, &iov, 1, byteCount, protocolId, destAddressIndex,
+                        context, lifetime, unorderedDelivery, dontBundle, NULL);
+}
+
+
+/**
+ * This function is called to send a message, that is given as a vector of buffers.
+ * Each fragment of the message takes its slice of the buffers: it is copied into the
+ * chunk, or, for a borrowed-buffer message, only referenced until bundling.
+ *  called from MessageDistribution
+ * @return 0 for success, -1 for error (e.g. data sent in shutdown state etc.)
+*/
+int
+se_ulpsendv (unsigned short streamId, const SCTP_iovec* iov, unsigned int iovcnt,
+             unsigned int byteCount, unsigned int protocolId,
+             short destAddressIndex, void *context, unsigned int lifetime,
+             gboolean unorderedDelivery, gboolean dontBundle, ChunkPayload* payload)
 {
     StreamEngine* se=NULL;
     guint32 state;
     chunk_data*  cdata=NULL;
     SCTP_data_chunk* dchunk=NULL;
-    unsigned char* bufPosition = buffer;
+    unsigned int iovIndex = 0, iovOffset = 0;
 
-    unsigned int bCount = 0, maxQueueLen = 0;
+    unsigned int bCount = 0, maxQueueLen = 0, maxDataLength;
     int numberOfSegments, residual;
 
     int i = 0;
@@ -327,7 +488,12 @@ se_ulpsend (unsigned short streamId, unsigned char *buffer,
     {
         error_logii (ERROR_MAJOR, "STREAM ID OVERFLOW in se_ulpsend: wanted %u, got only %u",
             streamId, se->numSendStreams);
-        mdi_sendFailureNotif (buffer, byteCount, (unsigned int*)context);
+        /* a message in several buffers has no contiguous data to report */
+        if (iovcnt == 1) {
+            mdi_sendFailureNotif ((unsigned char*)iov[0].iov_base, byteCount, (unsigned int*)context);
+        } else {
+            mdi_sendFailureNotif (NULL, 0, (unsigned int*)context);
+        }
         return SCTP_PARAMETER_PROBLEM;
     }
 
@@ -337,100 +503,54 @@ se_ulpsend (unsigned short streamId, unsigned char *buffer,
 
     retVal = SCTP_SUCCESS;
 
-    /* if (byteCount <= fc_getMTU())          */
-    if (byteCount <= SCTP_MAXIMUM_DATA_LENGTH)
-    {
-       if (maxQueueLen > 0) {
-         if ((1 + fc_readNumberOfQueuedChunks()) > maxQueueLen) return SCTP_QUEUE_EXCEEDED;
-       }
+    /* calculate nr. of necessary chunks, which fit into the smallest path MTU */
+    maxDataLength = fc_readAssociationMTU();
+    if (maxDataLength > FIXED_DATA_CHUNK_SIZE) {
+        maxDataLength = (maxDataLength - FIXED_DATA_CHUNK_SIZE) & ~3U;
+    } else {
+        maxDataLength = SCTP_MAXIMUM_DATA_LENGTH;
+    }
+    numberOfSegments = byteCount / maxDataLength;
+    residual = byteCount % maxDataLength;
+    if (residual != 0 || numberOfSegments == 0) {
+        numberOfSegments++;
+    } else {
+        residual = maxDataLength;
+    }
 
-        cdata = (chunk_data*)malloc(sizeof(chunk_data));
+    if (maxQueueLen > 0) {
+        if ((numberOfSegments + fc_readNumberOfQueuedChunks()) > maxQueueLen) return SCTP_QUEUE_EXCEEDED;
+    }
+
+    for (i = 1; i <= numberOfSegments; i++)
+    {
+        bCount = (i == numberOfSegments) ? residual : maxDataLength;
+        if (payload != NULL) {
+            cdata = cp_allocChunk(FIXED_DATA_CHUNK_SIZE);
+        } else {
+            cdata = cp_allocChunk(bCount + FIXED_DATA_CHUNK_SIZE);
+        }
         if (cdata == NULL) {
+            /* FIXME: this is unclean, as we have already assigned some TSNs etc, and
+             * maybe queued parts of this message in the queue, this should be cleaned
+             * up... */
             return SCTP_OUT_OF_RESOURCES;
         }
 
         dchunk = (SCTP_data_chunk*)cdata->data;
 
-        dchunk->chunk_id      = CHUNK_DATA;
-        dchunk->chunk_flags   = (guint8)SCTP_DATA_BEGIN_SEGMENT + SCTP_DATA_END_SEGMENT;
-        dchunk->chunk_length  = htons ((unsigned short)(byteCount + FIXED_DATA_CHUNK_SIZE));
-        dchunk->tsn = 0;        /* gets assigned in the flowcontrol module */
-        dchunk->stream_id     = htons (streamId);
-        dchunk->protocolId    = protocolId;
-
-        if (unorderedDelivery)
-        {
-            dchunk->stream_sn = htons (0);
-            dchunk->chunk_flags += SCTP_DATA_UNORDERED;
+        dchunk->chunk_flags = 0;
+        if (i == 1) {
+            dchunk->chunk_flags += SCTP_DATA_BEGIN_SEGMENT;
         }
-        else
-        {       /* unordered flag not put */
-            dchunk->stream_sn = htons ((unsigned short)(se->SendStreams[streamId].nextSSN));
-            se->SendStreams[streamId].nextSSN++;
-            se->SendStreams[streamId].nextSSN = se->SendStreams[streamId].nextSSN % 0x10000;
+        if (i == numberOfSegments) {
+            dchunk->chunk_flags += SCTP_DATA_END_SEGMENT;
         }
-        /* copy the data, but only once ! */
-        memcpy (dchunk->data, buffer, byteCount);
-
-        event_logii (EXTERNAL_EVENT, "=========> ulp sent a chunk (SSN=%u, SID=%u) to StreamEngine <=======",
-                      ntohs (dchunk->stream_sn),ntohs (dchunk->stream_id));
-        if (!se->unreliable) lifetime = 0xFFFFFFFF;
-        result = fc_send_data_chunk (cdata, destAddressIndex, lifetime, dontBundle, context);
-
-        if (result != SCTP_SUCCESS)	{
-            error_logi (ERROR_MINOR, "se_ulpsend() failed with result %d", result);
-            return result;
-        }
-    }
-    else
-    {
-        /* calculate nr. of necessary chunks -> use fc_getMTU() later !!! */
-      numberOfSegments = byteCount / SCTP_MAXIMUM_DATA_LENGTH;
-      residual = byteCount % SCTP_MAXIMUM_DATA_LENGTH;
-      if (residual != 0) {
-            numberOfSegments++;
-      } else {
-            residual = SCTP_MAXIMUM_DATA_LENGTH;
-      }
-
-      if (maxQueueLen > 0) {
-        if ((numberOfSegments + fc_readNumberOfQueuedChunks()) > maxQueueLen) return SCTP_QUEUE_EXCEEDED;
-      }
-
-      for (i = 1; i <= numberOfSegments; i++)
-      {
-            cdata = (chunk_data*)malloc(sizeof(chunk_data));
-            if (cdata == NULL) {
-                /* FIXME: this is unclean, as we have already assigned some TSNs etc, and
-                 * maybe queued parts of this message in the queue, this should be cleaned
-                 * up... */
-                return SCTP_OUT_OF_RESOURCES;
-            }
-
-            dchunk = (SCTP_data_chunk*)cdata->data;
-
-            if ((i != 1) && (i != numberOfSegments))
-            {
-                dchunk->chunk_flags = 0;
-                bCount = SCTP_MAXIMUM_DATA_LENGTH;
-                event_log (VERBOSE, "NEXT FRAGMENTED CHUNK -> MIDDLE");
-            }
-            else if (i == 1)
-            {
-                dchunk->chunk_flags = SCTP_DATA_BEGIN_SEGMENT;
-                event_log (VERBOSE, "NEXT FRAGMENTED CHUNK -> BEGIN");
-                bCount = SCTP_MAXIMUM_DATA_LENGTH;
-            }
-            else if (i == numberOfSegments)
-            {
-                dchunk->chunk_flags = SCTP_DATA_END_SEGMENT;
-                event_log (EXTERNAL_EVENT, "NEXT FRAGMENTED CHUNK -> END");
-                bCount = residual;
-            }
+        event_logiii (VERBOSE, "NEXT CHUNK %d of %d (flags=%u)", i, numberOfSegments, dchunk->chunk_flags);
 
         dchunk->chunk_id = CHUNK_DATA;
         dchunk->chunk_length = htons ((unsigned short)(bCount + FIXED_DATA_CHUNK_SIZE));
-        dchunk->tsn = htonl (0);
+        dchunk->tsn = htonl (0);        /* gets assigned in the flowcontrol module */
         dchunk->stream_id = htons (streamId);
         dchunk->protocolId = protocolId;
 
@@ -449,21 +569,34 @@ se_ulpsend (unsigned short streamId, unsigned char *buffer,
             }
         }
 
-        memcpy (dchunk->data, bufPosition, bCount);
-        bufPosition += bCount * sizeof(unsigned char);
+        if (payload != NULL) {
+            /* the payload stays in the buffers of the ULP until bundling */
+            cp_attachPayload (cdata, payload, iovIndex, iovOffset);
+            if (aux_crc32c_combining()) {
+                cdata->crc_partial = se_slicePayload (iov, &iovIndex, &iovOffset, bCount, NULL, TRUE);
+                cdata->crc_shift   = aux_crc32c_shift(bCount);
+            } else {
+                se_slicePayload (iov, &iovIndex, &iovOffset, bCount, NULL, FALSE);
+                cdata->crc_partial = 0;
+                cdata->crc_shift   = 0;
+            }
+        } else {
+            /* copy the data, but only once ! */
+            se_slicePayload (iov, &iovIndex, &iovOffset, bCount, dchunk->data, FALSE);
+            se_checksumPayload (cdata, bCount);
+        }
 
         event_logiii (EXTERNAL_EVENT, "======> SE sends fragment %d of chunk (SSN=%u, SID=%u) to FlowControl <======",
                         i, ntohs (dchunk->stream_sn),ntohs (dchunk->stream_id));
 
-            if (!se->unreliable) lifetime = 0xFFFFFFFF;
+        if (!se->unreliable) lifetime = 0xFFFFFFFF;
 
-            result = fc_send_data_chunk (cdata, destAddressIndex, lifetime, dontBundle, context);
+        result = fc_send_data_chunk (cdata, destAddressIndex, lifetime, dontBundle, context);
 
-            if (result != SCTP_SUCCESS) {
-                error_logi (ERROR_MINOR, "se_ulpsend() failed with result %d", result);
-                /* FIXME : Howto Propagate an Error here - Result gets overwritten on next Call */
-                retVal = result;
-            }
+        if (result != SCTP_SUCCESS) {
+            error_logi (ERROR_MINOR, "se_ulpsend() failed with result %d", result);
+            /* FIXME : Howto Propagate an Error here - Result gets overwritten on next Call */
+            retVal = result;
         }
     }
   return retVal;
@@ -472,6 +605,82 @@ se_ulpsend (unsigned short streamId, unsigned char *buffer,
 
 /******************** Functions for Receiving **************************************/
 
+/**
+ * Copies up to *byteCount bytes of the first PDU waiting on a stream into buffer, and
+ * sets *byteCount to the number of bytes copied. Unless peek is set, the read position
+ * advances, and a PDU that has been read completely is removed and freed.
+ * @return the number of bytes of the PDU left unread
+ */
+static unsigned int se_readPdu(StreamEngine* se, unsigned short streamId,
+                               unsigned char *buffer, unsigned int *byteCount, gboolean peek)
+{
+    delivery_pdu  *d_pdu;
+    unsigned int copiedBytes, residual;
+    guint32 r_pos, r_chunk, chunk_pos;
+
+    d_pdu = (delivery_pdu*)se->RecvStreams[streamId].pduList->data;
+
+    r_pos       = d_pdu->read_position;
+    r_chunk     = d_pdu->read_chunk;
+    chunk_pos   = d_pdu->chunk_position;
+
+    event_logiiii (VVERBOSE, "SE_ULPRECEIVE (read_position: %u, read_chunk: %u, chunk_position: %u, total_length: %u)",
+            r_pos,  r_chunk, chunk_pos, d_pdu->total_length);
+
+    if (d_pdu->total_length - d_pdu->read_position < *byteCount)
+        *byteCount = d_pdu->total_length-d_pdu->read_position;
+
+    copiedBytes = 0;
+    residual = *byteCount;
+
+    while (copiedBytes < *byteCount) {
+
+        if (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position > residual) {
+            event_logiii (VVERBOSE, "Copy in SE_ULPRECEIVE (residual: %u, copied bytes: %u, byteCount: %u)",
+                residual, copiedBytes,*byteCount);
+
+            memcpy (&buffer[copiedBytes],
+                    &(d_pdu->ddata[d_pdu->read_chunk]->data)[d_pdu->chunk_position],
+                    residual);
+
+            d_pdu->chunk_position += residual;
+            d_pdu->read_position  += residual;
+            copiedBytes           += residual;
+            residual = 0;
+        } else {
+            event_logi (VVERBOSE, "Copy in SE_ULPRECEIVE (num: %u)",d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
+
+            memcpy (&buffer[copiedBytes],
+                    &(d_pdu->ddata[d_pdu->read_chunk]->data)[d_pdu->chunk_position],
+                    d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
+
+            d_pdu->read_position += (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
+            copiedBytes          += (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
+            residual             -= (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
+            d_pdu->chunk_position = 0;
+            d_pdu->read_chunk++;
+        }
+    }
+
+    if (peek) {
+        d_pdu->chunk_position   = chunk_pos;
+        d_pdu->read_position    = r_pos;
+        d_pdu->read_chunk       = r_chunk;
+        return d_pdu->total_length - r_pos - copiedBytes;
+    }
+    if (d_pdu->read_position < d_pdu->total_length) {
+        return d_pdu->total_length - d_pdu->read_position;
+    }
+
+    se->queuedBytes -= d_pdu->total_length;
+    se->RecvStreams[streamId].pduList =
+        g_list_delete_link (se->RecvStreams[streamId].pduList, se->RecvStreams[streamId].pduList);
+    event_log (VERBOSE, "Remove PDU element from the SE list, and free associated memory");
+    free_pdu(d_pdu);
+    return 0;
+}
+
+
 /**
  * This function is called from distribution layer to receive a chunk.
  */
@@ -481,8 +690,7 @@ short se_ulpreceivefrom(unsigned char *buffer, unsigned int *byteCount,
 {
 
   delivery_pdu  *d_pdu = NULL;
-  unsigned int copiedBytes, residual, i;
-  guint32 r_pos, r_chunk, chunk_pos, oldQueueLen = 0;
+  guint32 oldQueueLen = 0;
 
 
   StreamEngine* se = (StreamEngine *) mdi_readStreamEngine ();
@@ -516,81 +724,96 @@ short se_ulpreceivefrom(unsigned char *buffer, unsigned int *byteCount,
       else
         {
             oldQueueLen = se->queuedBytes;
-            copiedBytes = 0;
 
-            d_pdu = (delivery_pdu*)g_list_nth_data (se->RecvStreams[streamId].pduList, 0);
-
-            r_pos       = d_pdu->read_position;
-            r_chunk     = d_pdu->read_chunk;
-            chunk_pos   = d_pdu->chunk_position;
+            d_pdu = (delivery_pdu*)se->RecvStreams[streamId].pduList->data;
 
             *streamSN   = d_pdu->ddata[d_pdu->read_chunk]->stream_sn;
             *tsn        = d_pdu->ddata[d_pdu->read_chunk]->tsn;
             *addressIndex = d_pdu->ddata[d_pdu->read_chunk]->fromAddressIndex;
 
-            event_logiiii (VVERBOSE, "SE_ULPRECEIVE (read_position: %u, read_chunk: %u, chunk_position: %u, total_length: %u)",
-                    r_pos,  r_chunk, chunk_pos, d_pdu->total_length);
-
-            if (d_pdu->total_length - d_pdu->read_position < *byteCount)
-                *byteCount = d_pdu->total_length-d_pdu->read_position;
-
-            residual = *byteCount;
-
-            while (copiedBytes < *byteCount) {
-
-                if (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position > residual) {
-                    event_logiii (VVERBOSE, "Copy in SE_ULPRECEIVE (residual: %u, copied bytes: %u, byteCount: %u)",
-                        residual, copiedBytes,*byteCount);
-
-                    memcpy (&buffer[copiedBytes],
-                            &(d_pdu->ddata[d_pdu->read_chunk]->data)[d_pdu->chunk_position],
-                            residual);
-
-                    d_pdu->chunk_position += residual;
-                    d_pdu->read_position  += residual;
-                    copiedBytes           += residual;
-                    residual = 0;
-                } else {
-                    event_logi (VVERBOSE, "Copy in SE_ULPRECEIVE (num: %u)",d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
-
-                    memcpy (&buffer[copiedBytes],
-                            &(d_pdu->ddata[d_pdu->read_chunk]->data)[d_pdu->chunk_position],
-                            d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
-
-                    d_pdu->read_position += (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
-                    copiedBytes          += (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
-                    residual             -= (d_pdu->ddata[d_pdu->read_chunk]->data_length - d_pdu->chunk_position);
-                    d_pdu->chunk_position = 0;
-                    d_pdu->read_chunk++;
-                }
+            if (se_readPdu(se, streamId, buffer, byteCount, flags == SCTP_MSG_PEEK) == 0 &&
+                flags != SCTP_MSG_PEEK) {
+                rxc_start_sack_timer(oldQueueLen);
             }
+        }
+
+    }
+    event_logi (EXTERNAL_EVENT, "ulp receives %u bytes from se", *byteCount);
+    return (RECEIVE_DATA);
+}
 
-            if (flags == SCTP_MSG_PEEK) {
-                d_pdu->chunk_position   = chunk_pos;
-                d_pdu->read_position    = r_pos;
-                d_pdu->read_chunk       = r_chunk;
-            } else {
 
-               if (d_pdu->read_position >= d_pdu->total_length) {
+/**
+ * This function is called from distribution layer to receive the messages waiting on
+ * all streams, one stream after the other, until maxMessages messages have been read,
+ * or the arena is full. A message that does not fit into what is left of the arena is
+ * only read (partially) if it is the first one. Streams are read in the order they got
+ * data, a stream that was not emptied goes behind the others, unless a message of it
+ * was read partially.
+ * The receiver window is updated once, after all messages have been read.
+ * @return the number of messages read
+ */
+unsigned int se_ulpreceivebatch(SCTP_ReceivedMessage* messages, unsigned int maxMessages,
+                                unsigned char* arena, unsigned int arenaLength)
+{
+    delivery_pdu  *d_pdu;
+    delivery_data *d_chunk;
+    ReceiveStream* rs;
+    unsigned int count = 0, used = 0, length;
+    guint32 oldQueueLen;
+    int sid;
 
-                    se->queuedBytes -= d_pdu->total_length;
+    StreamEngine* se = (StreamEngine *) mdi_readStreamEngine ();
 
-                    se->RecvStreams[streamId].pduList =
-                        g_list_remove (se->RecvStreams[streamId].pduList,
-                                       g_list_nth_data (se->RecvStreams[streamId].pduList, 0));
-                    event_log (VERBOSE, "Remove PDU element from the SE list, and free associated memory");
-                    for (i=0; i < d_pdu->number_of_chunks; i++) free(d_pdu->ddata[i]);
-                    free(d_pdu->ddata);
-                    free(d_pdu);
-                    rxc_start_sack_timer(oldQueueLen);
-                }
+    if (se == NULL) {
+        error_log (ERROR_MAJOR, "Could not retrieve SE instance ");
+        return 0;
+    }
+    oldQueueLen = se->queuedBytes;
+
+    while (se->firstReady >= 0 && count < maxMessages) {
+        sid = se->firstReady;
+        rs  = &se->RecvStreams[sid];
+
+        while (rs->pduList != NULL && count < maxMessages) {
+            d_pdu   = (delivery_pdu*)rs->pduList->data;
+            d_chunk = d_pdu->ddata[d_pdu->read_chunk];
+            length  = d_pdu->total_length - d_pdu->read_position;
+            if (length > arenaLength - used) {
+                if (count > 0) break;
+                length = arenaLength - used;
             }
-
+            messages[count].streamID     = (unsigned short)sid;
+            messages[count].streamSN     = d_chunk->stream_sn;
+            messages[count].tsn          = d_chunk->tsn;
+            messages[count].protocolId   = d_chunk->protocolId;
+            messages[count].addressIndex = d_chunk->fromAddressIndex;
+            messages[count].data         = &arena[used];
+            messages[count].remaining    = se_readPdu(se, (unsigned short)sid, &arena[used], &length, FALSE);
+            messages[count].length       = length;
+            used += length;
+            count++;
+            if (messages[count-1].remaining > 0) break;
+        }
+        if (rs->pduList != NULL && ((delivery_pdu*)rs->pduList->data)->read_position > 0) break;
+
+        se->firstReady = rs->nextReady;
+        if (se->firstReady < 0) se->lastReady = -1;
+        rs->nextReady = -1;
+        rs->ready = FALSE;
+        if (rs->pduList != NULL) {
+            /* the budget is used up, the stream goes behind the others */
+            if (se->lastReady >= 0) se->RecvStreams[se->lastReady].nextReady = sid;
+            else se->firstReady = sid;
+            se->lastReady = sid;
+            rs->ready = TRUE;
+            break;
         }
-
     }
-    event_logi (EXTERNAL_EVENT, "ulp receives %u bytes from se", *byteCount);
-    return (RECEIVE_DATA);
+    event_logii (EXTERNAL_EVENT, "ulp receives %u messages with %u bytes from se", count, used);
+
+    if (se->queuedBytes != oldQueueLen) rxc_start_sack_timer(oldQueueLen);
+    return count;
 }
 
 
@@ -601,7 +824,7 @@ short se_ulpreceivefrom(unsigned char *buffer, unsigned int *byteCount,
 int se_doNotifications(void)
 {
     int retVal;
-    unsigned short i;
+    int i;
 
     StreamEngine* se = (StreamEngine *) mdi_readStreamEngine ();
 
@@ -613,20 +836,323 @@ int se_doNotifications(void)
     event_log (INTERNAL_EVENT_0, " ================> se_doNotifications <=============== ");
 
     retVal = SCTP_SUCCESS;
-    retVal = se_searchReadyPdu(se);
 
-    for (i = 0; i < se->numReceiveStreams; i++)
+    /* only the streams that got a PDU since the last call */
+    while (se->firstActive >= 0)
     {
-        if(se->RecvStreams[i].prePduList != NULL)
-        {
-            retVal = se_deliverWaiting(se, i);
-        }
+        i = se->firstActive;
+        se->firstActive = se->RecvStreams[i].nextActive;
+        if (se->firstActive < 0) se->lastActive = -1;
+        se->RecvStreams[i].nextActive = -1;
+        retVal = se_deliverWaiting(se, (unsigned short)i);
     }
     event_log (INTERNAL_EVENT_0, " ================> se_doNotifications: DONE <=============== ");
     return retVal;
 }
 
 
+/*
+ * queues a PDU for the DataArrive-Notification
+ */
+static void se_appendPdu(StreamEngine* se, delivery_pdu* d_pdu)
+{
+    guint16 sid = d_pdu->ddata[0]->stream_id;
+    ReceiveStream* rs = &se->RecvStreams[sid];
+
+    event_logiii(VVERBOSE, "Queueing PDU with TSN: %u, SID: %u, %u chunks",
+                 d_pdu->ddata[0]->tsn, sid, d_pdu->number_of_chunks);
+    if (rs->prePduList == NULL) {
+        /* put the stream on the list for se_doNotifications() */
+        if (se->lastActive >= 0) se->RecvStreams[se->lastActive].nextActive = sid;
+        else se->firstActive = sid;
+        se->lastActive = sid;
+    }
+    rs->prePduList = g_list_append(rs->prePduList, d_pdu);
+}
+
+
+/*
+ * makes a PDU of the chunks of a complete message, and queues it for the
+ * DataArrive-Notification. If successful, the PDU takes over the array of chunks.
+ */
+static int se_queuePdu(StreamEngine* se, delivery_data** ddata, guint32 nrOfChunks)
+{
+    delivery_pdu* d_pdu;
+    guint32 i;
+
+    d_pdu = (delivery_pdu*)malloc(sizeof(delivery_pdu));
+    if (d_pdu == NULL) {
+        return SCTP_OUT_OF_RESOURCES;
+    }
+    d_pdu->number_of_chunks = nrOfChunks;
+    d_pdu->read_position = 0;
+    d_pdu->read_chunk = 0;
+    d_pdu->chunk_position = 0;
+    d_pdu->total_length = 0;
+    d_pdu->ddata = ddata;
+    for (i = 0; i < nrOfChunks; i++) {
+        d_pdu->total_length += ddata[i]->data_length;
+    }
+    se_appendPdu(se, d_pdu);
+    return SCTP_SUCCESS;
+}
+
+
+/*
+ * an ordered message is complete, when it runs from a begin to an end segment
+ * without a gap in the TSNs
+ */
+static gboolean se_messageComplete(reassembly_data* msg)
+{
+    return ((msg->number_of_chunks > 0) &&
+            (msg->ddata[0]->chunk_flags & SCTP_DATA_BEGIN_SEGMENT) &&
+            (msg->ddata[msg->number_of_chunks - 1]->chunk_flags & SCTP_DATA_END_SEGMENT) &&
+            (msg->ddata[msg->number_of_chunks - 1]->tsn - msg->ddata[0]->tsn == msg->number_of_chunks - 1));
+}
+
+
+/*
+ * queues a complete ordered message, and removes it from the stream
+ */
+static int se_queueMessage(StreamEngine* se, ReceiveStream* rs, reassembly_data* msg)
+{
+    int result;
+    guint32 i;
+
+    result = se_queuePdu(se, msg->ddata, msg->number_of_chunks);
+    if (result != SCTP_SUCCESS) return result;
+    if ((msg->number_of_chunks > 1) && (rs->orderedFragments != NULL)) {
+        for (i = 0; i < msg->number_of_chunks; i++) {
+            g_hash_table_remove(rs->orderedFragments, GUINT_TO_POINTER(msg->ddata[i]->tsn));
+        }
+    }
+    g_hash_table_remove(rs->messages, GUINT_TO_POINTER((guint32)msg->stream_sn));
+    free(msg);
+    return SCTP_SUCCESS;
+}
+
+
+/*
+ * checks the U bit of a new fragment against its neighbours by TSN in the other table
+ * of the stream: ordered fragments are collected by SSN and unordered ones by TSN, so
+ * a run of TSNs that mixes both would never be completed, and hold its rwnd forever.
+ * @param  d_chunk      the new fragment
+ * @param  neighbours   the table of fragments with the other U bit
+ * @return TRUE, if the fragment continues or is continued by one with the other U bit
+ */
+static gboolean se_mixedFragments(delivery_data* d_chunk, GHashTable* neighbours)
+{
+    delivery_data* d;
+
+    if (neighbours == NULL) return FALSE;
+    if (!(d_chunk->chunk_flags & SCTP_DATA_BEGIN_SEGMENT)) {
+        d = (delivery_data*)g_hash_table_lookup(neighbours, GUINT_TO_POINTER(d_chunk->tsn - 1));
+        if ((d != NULL) && !(d->chunk_flags & SCTP_DATA_END_SEGMENT)) return TRUE;
+    }
+    if (!(d_chunk->chunk_flags & SCTP_DATA_END_SEGMENT)) {
+        d = (delivery_data*)g_hash_table_lookup(neighbours, GUINT_TO_POINTER(d_chunk->tsn + 1));
+        if ((d != NULL) && !(d->chunk_flags & SCTP_DATA_BEGIN_SEGMENT)) return TRUE;
+    }
+    return FALSE;
+}
+
+
+/*
+ * queues the complete ordered messages of a stream from nextSSN on, as long as
+ * there is no gap in the SSNs
+ */
+static int se_deliverInSequence(StreamEngine* se, ReceiveStream* rs)
+{
+    reassembly_data* msg;
+    guint32 tsn;
+    int result;
+
+    if (rs->messages == NULL) return SCTP_SUCCESS;
+
+    while ((msg = (reassembly_data*)g_hash_table_lookup(rs->messages,
+                                                        GUINT_TO_POINTER((guint32)rs->nextSSN))) != NULL) {
+        if (!se_messageComplete(msg)) break;
+        if ((rs->lastTSNused) && (before(msg->ddata[0]->tsn, rs->lastTSN))) {
+            error_logi(VERBOSE, "Wrong ssn and tsn order", msg->stream_sn);
+            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
+            return SCTP_UNSPECIFIED_ERROR;
+        }
+        tsn = msg->ddata[msg->number_of_chunks - 1]->tsn;
+        result = se_queueMessage(se, rs, msg);
+        if (result != SCTP_SUCCESS) return result;
+        rs->lastTSN = tsn;
+        rs->lastTSNused = TRUE;
+        rs->nextSSN++;
+    }
+    return SCTP_SUCCESS;
+}
+
+
+/*
+ * adds a chunk of an ordered message to the message with its SSN, and queues the
+ * messages of the stream that can be delivered now
+ */
+static int se_recvOrdered(StreamEngine* se, delivery_data* d_chunk)
+{
+    ReceiveStream* rs = &se->RecvStreams[d_chunk->stream_id];
+    reassembly_data* msg;
+    delivery_data** ddata;
+    guint32 pos;
+    gboolean begin, end;
+
+    begin = (d_chunk->chunk_flags & SCTP_DATA_BEGIN_SEGMENT) ? TRUE : FALSE;
+    end   = (d_chunk->chunk_flags & SCTP_DATA_END_SEGMENT) ? TRUE : FALSE;
+
+    if (rs->messages == NULL) {
+        rs->messages = g_hash_table_new(g_direct_hash, g_direct_equal);
+        if (rs->messages == NULL) return SCTP_OUT_OF_RESOURCES;
+    }
+    msg = (reassembly_data*)g_hash_table_lookup(rs->messages, GUINT_TO_POINTER((guint32)d_chunk->stream_sn));
+
+    if (msg == NULL) {
+        msg = (reassembly_data*)malloc(sizeof(reassembly_data));
+        if (msg == NULL) {
+            free_delivery_data(d_chunk);
+            return SCTP_OUT_OF_RESOURCES;
+        }
+        msg->stream_sn = d_chunk->stream_sn;
+        msg->number_of_chunks = 0;
+        msg->size = 4;
+        msg->ddata = (delivery_data**)malloc(msg->size * sizeof(delivery_data*));
+        if (msg->ddata == NULL) {
+            free(msg);
+            free_delivery_data(d_chunk);
+            return SCTP_OUT_OF_RESOURCES;
+        }
+        g_hash_table_insert(rs->messages, GUINT_TO_POINTER((guint32)msg->stream_sn), msg);
+    } else if (msg->number_of_chunks == msg->size) {
+        ddata = (delivery_data**)realloc(msg->ddata, 2 * msg->size * sizeof(delivery_data*));
+        if (ddata == NULL) {
+            free_delivery_data(d_chunk);
+            return SCTP_OUT_OF_RESOURCES;
+        }
+        msg->ddata = ddata;
+        msg->size *= 2;
+    }
+
+    /* fragments mostly arrive in TSN order, so search the place from the end */
+    for (pos = msg->number_of_chunks; pos > 0; pos--) {
+        if (!after(msg->ddata[pos - 1]->tsn, d_chunk->tsn)) break;
+    }
+    if ((pos > 0) && (msg->ddata[pos - 1]->tsn == d_chunk->tsn)) {
+        event_logi(VERBOSE, "Dropping duplicate chunk with TSN %u", d_chunk->tsn);
+        free_delivery_data(d_chunk);
+        return SCTP_SUCCESS;
+    }
+    memmove(&msg->ddata[pos + 1], &msg->ddata[pos], (msg->number_of_chunks - pos) * sizeof(delivery_data*));
+    msg->ddata[pos] = d_chunk;
+    msg->number_of_chunks++;
+    se->queuedBytes += d_chunk->data_length;
+
+    if ((begin && (pos > 0)) ||
+        ((pos == 0) && (msg->number_of_chunks > 1) && (msg->ddata[1]->chunk_flags & SCTP_DATA_BEGIN_SEGMENT))) {
+        error_logi(VERBOSE, "Multiple Begins found with SSN: %u", d_chunk->stream_sn);
+        scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
+        return SCTP_UNSPECIFIED_ERROR;
+    }
+    if ((end && (pos < msg->number_of_chunks - 1)) ||
+        ((pos == msg->number_of_chunks - 1) && (pos > 0) && (msg->ddata[pos - 1]->chunk_flags & SCTP_DATA_END_SEGMENT))) {
+        error_logi(VERBOSE, "Data without end segment found", d_chunk->stream_sn);
+        scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
+        return SCTP_UNSPECIFIED_ERROR;
+    }
+    if (!(begin && end)) {
+        if (se_mixedFragments(d_chunk, rs->fragments)) {
+            error_logi(VERBOSE, "Mix Ordered and unordered Segments found with SSN: %u", d_chunk->stream_sn);
+            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
+            return SCTP_UNSPECIFIED_ERROR;
+        }
+        if (rs->orderedFragments == NULL) {
+            rs->orderedFragments = g_hash_table_new(g_direct_hash, g_direct_equal);
+            if (rs->orderedFragments == NULL) return SCTP_OUT_OF_RESOURCES;
+        }
+        g_hash_table_insert(rs->orderedFragments, GUINT_TO_POINTER(d_chunk->tsn), d_chunk);
+    }
+
+    if (!se_messageComplete(msg)) return SCTP_SUCCESS;
+
+    if (msg->stream_sn == rs->nextSSN) {
+        return se_deliverInSequence(se, rs);
+    }
+    if (sBefore(msg->stream_sn, rs->nextSSN)) {
+        /* the stream has moved on (FORWARD-TSN), deliver it as it is */
+        return se_queueMessage(se, rs, msg);
+    }
+    event_logii(VVERBOSE, "Complete message with SSN %u waits for SSN %u", msg->stream_sn, rs->nextSSN);
+    return SCTP_SUCCESS;
+}
+
+
+/*
+ * adds a chunk of an unordered message to the fragments of the stream, and queues
+ * the message, if the chunk completes a run of TSNs from a begin to an end segment
+ */
+static int se_recvUnordered(StreamEngine* se, delivery_data* d_chunk)
+{
+    ReceiveStream* rs = &se->RecvStreams[d_chunk->stream_id];
+    delivery_data* d;
+    delivery_data** ddata;
+    guint32 firstTSN, lastTSN, nrOfChunks, i;
+
+    if (rs->fragments == NULL) {
+        rs->fragments = g_hash_table_new(g_direct_hash, g_direct_equal);
+        if (rs->fragments == NULL) return SCTP_OUT_OF_RESOURCES;
+    }
+    if (g_hash_table_lookup(rs->fragments, GUINT_TO_POINTER(d_chunk->tsn)) != NULL) {
+        event_logi(VERBOSE, "Dropping duplicate chunk with TSN %u", d_chunk->tsn);
+        free_delivery_data(d_chunk);
+        return SCTP_SUCCESS;
+    }
+    g_hash_table_insert(rs->fragments, GUINT_TO_POINTER(d_chunk->tsn), d_chunk);
+    se->queuedBytes += d_chunk->data_length;
+
+    if (se_mixedFragments(d_chunk, rs->orderedFragments)) {
+        error_logi(VERBOSE, "Mix Ordered and unordered Segments found with TSN: %u", d_chunk->tsn);
+        scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
+        return SCTP_UNSPECIFIED_ERROR;
+    }
+
+    /* look for the begin and the end of the message around the new chunk */
+    firstTSN = d_chunk->tsn;
+    for (d = d_chunk; !(d->chunk_flags & SCTP_DATA_BEGIN_SEGMENT); firstTSN--) {
+        d = (delivery_data*)g_hash_table_lookup(rs->fragments, GUINT_TO_POINTER(firstTSN - 1));
+        if ((d == NULL) || (d->chunk_flags & SCTP_DATA_END_SEGMENT)) return SCTP_SUCCESS;
+    }
+    lastTSN = d_chunk->tsn;
+    for (d = d_chunk; !(d->chunk_flags & SCTP_DATA_END_SEGMENT); lastTSN++) {
+        d = (delivery_data*)g_hash_table_lookup(rs->fragments, GUINT_TO_POINTER(lastTSN + 1));
+        if (d == NULL) return SCTP_SUCCESS;
+        if (d->chunk_flags & SCTP_DATA_BEGIN_SEGMENT) {
+            error_logi(VERBOSE, "Multiple Begins found with TSN: %u", d->tsn);
+            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
+            return SCTP_UNSPECIFIED_ERROR;
+        }
+    }
+
+    nrOfChunks = lastTSN - firstTSN + 1;
+    ddata = (delivery_data**)malloc(nrOfChunks * sizeof(delivery_data*));
+    if (ddata == NULL) {
+        return SCTP_OUT_OF_RESOURCES;
+    }
+    for (i = 0; i < nrOfChunks; i++) {
+        ddata[i] = (delivery_data*)g_hash_table_lookup(rs->fragments, GUINT_TO_POINTER(firstTSN + i));
+    }
+    if (se_queuePdu(se, ddata, nrOfChunks) != SCTP_SUCCESS) {
+        free(ddata);
+        return SCTP_OUT_OF_RESOURCES;
+    }
+    for (i = 0; i < nrOfChunks; i++) {
+        g_hash_table_remove(rs->fragments, GUINT_TO_POINTER(firstTSN + i));
+    }
+    return SCTP_SUCCESS;
+}
+
+
  /*
  * This function is called from Receive Control to forward received chunks to Stream Engine.
  * returns an error chunk to the peer, when the maximum stream id is exceeded !
@@ -634,240 +1160,118 @@ int se_doNotifications(void)
 int se_recvDataChunk (SCTP_data_chunk * dataChunk, unsigned int byteCount, unsigned int address_index)
 {
     guint16 datalength;
+    guint16 stream_id;
     SCTP_InvalidStreamIdError error_info;
+    ReceiveStream* rs;
     delivery_data* d_chunk;
+    delivery_pdu* d_pdu;
+    guint32 tsn;
+    guint16 stream_sn;
+    gboolean express;
+    size_t headroom;
+    guchar* block;
+    void* rbuf;
     StreamEngine* se = (StreamEngine *) mdi_readStreamEngine ();
     assert(se);
 
     event_log (INTERNAL_EVENT_0, "SE_RECVDATACHUNK CALLED");
 
-    d_chunk = (delivery_data*)malloc (sizeof (delivery_data));
-    if (d_chunk == NULL) return SCTP_OUT_OF_RESOURCES;
-
     datalength =  byteCount - FIXED_DATA_CHUNK_SIZE;
-    d_chunk->stream_id =    ntohs (dataChunk->stream_id);
+    stream_id =    ntohs (dataChunk->stream_id);
 
-    if (d_chunk->stream_id >= se->numReceiveStreams) {
+    if (stream_id >= se->numReceiveStreams) {
         /* return error, when numReceiveStreams is exceeded */
-        error_info.stream_id = htons(d_chunk->stream_id);
+        error_info.stream_id = htons(stream_id);
         error_info.reserved = htons(0);
 
         scu_abort(ECC_INVALID_STREAM_ID, sizeof(error_info), (unsigned char*)&error_info);
-        free(d_chunk);
         return SCTP_UNSPECIFIED_ERROR;
     }
 
-    d_chunk->tsn = ntohl (dataChunk->tsn);     /* for efficiency */
-
     if (datalength <= 0) {
         scu_abort(ECC_NO_USER_DATA, sizeof(unsigned int), (unsigned char*)&(dataChunk->tsn));
-
-        free(d_chunk);
         return SCTP_UNSPECIFIED_ERROR;
     }
 
-    memcpy (d_chunk->data, dataChunk->data, datalength);
+    se_receivedChunks++;
+    rs = &se->RecvStreams[stream_id];
+    tsn = ntohl (dataChunk->tsn);
+    stream_sn = ntohs (dataChunk->stream_sn);
+
+    /* a message in a single chunk, that is unordered or the next one of its stream, is
+       queued at once, as a PDU in the same block as the chunk */
+    express = ((dataChunk->chunk_flags & SCTP_DATA_BEGIN_SEGMENT) &&
+               (dataChunk->chunk_flags & SCTP_DATA_END_SEGMENT) &&
+               ((dataChunk->chunk_flags & SCTP_DATA_UNORDERED) ||
+                ((stream_sn == rs->nextSSN) &&
+                 ((!rs->lastTSNused) || (!before(tsn, rs->lastTSN))) &&
+                 ((rs->messages == NULL) ||
+                  (g_hash_table_lookup(rs->messages, GUINT_TO_POINTER((guint32)stream_sn)) == NULL)))));
+    headroom = express ? sizeof(delivery_pdu) + sizeof(delivery_data*) : 0;
+
+    /* keep the payload in the receive buffer of the datagram, if there is one. Small
+       payloads are copied, so a whole buffer is not held for a few bytes of the rwnd */
+    rbuf = (datalength * SE_REFERENCED_SHARE >= adl_getReceiveBufferSize()) ? adl_holdReceiveBuffer() : NULL;
+    block = (guchar*)malloc (headroom + sizeof (delivery_data) + ((rbuf != NULL) ? 0 : datalength));
+    if (block == NULL) {
+        adl_releaseReceiveBuffer(rbuf);
+        return SCTP_OUT_OF_RESOURCES;
+    }
+    d_chunk = (delivery_data*)(block + headroom);
+    if (rbuf != NULL) {
+        d_chunk->data = dataChunk->data;
+    } else {
+        d_chunk->data = (guchar*)(d_chunk + 1);
+        memcpy (d_chunk->data, dataChunk->data, datalength);
+    }
+    d_chunk->rbuf = rbuf;
+
+    d_chunk->stream_id = stream_id;
+    d_chunk->tsn = tsn;     /* for efficiency */
     d_chunk->data_length = datalength;
     d_chunk->chunk_flags = dataChunk->chunk_flags;
-    d_chunk->stream_sn =    ntohs (dataChunk->stream_sn);
+    d_chunk->stream_sn =    stream_sn;
     d_chunk->protocolId =   dataChunk->protocolId;
     d_chunk->fromAddressIndex =  address_index;
 
 
 
-    se->List = g_list_insert_sorted(se->List, d_chunk, (GCompareFunc) sort_tsn_se);
-    se->queuedBytes += datalength;
-
     se->recvStreamActivated[d_chunk->stream_id] = TRUE;
-    return SCTP_SUCCESS;
-}
 
-  int se_searchReadyPdu(StreamEngine* se)
-{
-    GList* tmp = g_list_first(se->List);
-    GList* firstItem = NULL;
-    delivery_data* d_chunk;
-    delivery_pdu* d_pdu;
-    guint32 firstTSN = 0;
-    guint16 currentSID = 0;
-    guint16 currentSSN = 0;
-    guint16 nrOfChunks = 0;
-    gboolean complete = FALSE;
-    gboolean unordered = FALSE;
-    int i = 0;
-    guint32 itemPosition = 0;
-    event_log (INTERNAL_EVENT_0, " ================> se_searchReadyPdu <=============== ");
-    event_logi (VVERBOSE, "List has %u elements", g_list_length(se->List));
-    for (i = 0; i < (int)se->numReceiveStreams; i++) {
-        se->RecvStreams[i].highestSSN = 0;
-        se->RecvStreams[i].highestSSNused = FALSE;
+    if (express) {
+        se_expressChunks++;
+        d_pdu = (delivery_pdu*)block;
+        d_pdu->number_of_chunks = 1;
+        d_pdu->read_position = 0;
+        d_pdu->read_chunk = 0;
+        d_pdu->chunk_position = 0;
+        d_pdu->total_length = datalength;
+        d_pdu->ddata = (delivery_data**)(d_pdu + 1);
+        d_pdu->ddata[0] = d_chunk;
+        se_appendPdu(se, d_pdu);
+        se->queuedBytes += datalength;
+        if (d_chunk->chunk_flags & SCTP_DATA_UNORDERED) return SCTP_SUCCESS;
+        rs->lastTSN = tsn;
+        rs->lastTSNused = TRUE;
+        rs->nextSSN++;
+        /* messages that waited for this one */
+        return se_deliverInSequence(se, rs);
     }
-
-    while(tmp != NULL)
-    {
-        d_chunk = (delivery_data*)(tmp->data);
-        event_logiii(VVERBOSE, "Handling Packet with TSN: %u, SSN: %u, SID: %u", d_chunk->tsn, d_chunk->stream_sn, d_chunk->stream_id);
-
-        currentSID = d_chunk->stream_id;
-        currentSSN = d_chunk->stream_sn;
-        unordered = (d_chunk->chunk_flags & SCTP_DATA_UNORDERED);
-
-        if((se->RecvStreams[currentSID].highestSSNused) && (sAfter(se->RecvStreams[currentSID].highestSSN, currentSSN)))
-        {
-            error_logi(VERBOSE, "Wrong ssn and tsn order", d_chunk->stream_sn);
-            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
-            return SCTP_UNSPECIFIED_ERROR;
-        }
-        if(!unordered)
-        {
-            se->RecvStreams[currentSID].highestSSN = currentSSN;
-            se->RecvStreams[currentSID].highestSSNused = TRUE;
-        }
-
-
-        if(d_chunk->chunk_flags & SCTP_DATA_BEGIN_SEGMENT)
-        {
-            event_log (VVERBOSE, "Found Begin Segment");
-
-            nrOfChunks = 1;
-            firstItem = tmp;
-            firstTSN = d_chunk->tsn;
-
-            if((sBefore(currentSSN, se->RecvStreams[currentSID].nextSSN)) || (currentSSN == se->RecvStreams[currentSID].nextSSN) || (d_chunk->chunk_flags & SCTP_DATA_UNORDERED))
-            {
-
-                if(d_chunk->chunk_flags & SCTP_DATA_END_SEGMENT)
-                {
-                    event_log (VVERBOSE, "Complete PDU found");
-                    complete = TRUE;
-                }
-
-
-                while((tmp != NULL) && (!complete))
-                {
-                    nrOfChunks++;
-                    event_logi (VVERBOSE, "Handling chunk nr: %u", nrOfChunks);
-
-                    tmp = g_list_next(tmp);
-                    if(tmp == NULL) break;
-                    d_chunk = (delivery_data*)(tmp->data);
-                    event_logiii(VVERBOSE, "Handling Packet with TSN: %u, SSN: %u, SID: %u", d_chunk->tsn, d_chunk->stream_sn, d_chunk->stream_id);
-
-
-                    if((d_chunk->stream_id == currentSID)
-                        && ((d_chunk->stream_sn == currentSSN) || unordered)
-                        && (firstTSN + nrOfChunks - 1 == d_chunk->tsn))
-                    {
-                        if(d_chunk->chunk_flags & SCTP_DATA_BEGIN_SEGMENT)
-                        {
-                            error_logi(VERBOSE, "Multiple Begins found with SSN: %u", d_chunk->stream_sn);
-                            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
-                            return SCTP_UNSPECIFIED_ERROR;
-                        }
-                        else if((d_chunk->chunk_flags & SCTP_DATA_UNORDERED) != unordered)
-                        {
-                            error_logi(VERBOSE, "Mix Ordered and unordered Segments found with SSN: %u", d_chunk->stream_sn);
-                            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
-                            return SCTP_UNSPECIFIED_ERROR;
-                        }
-                        else if(d_chunk->chunk_flags & SCTP_DATA_END_SEGMENT)
-                        {
-                            event_log (VVERBOSE, "Complete PDU found");
-                            complete = TRUE;
-                        }
-                    }
-                    else
-                    {
-                        if(firstTSN + nrOfChunks - 1 == d_chunk->tsn)
-                        {
-                            error_logi(VERBOSE, "Data without end segment found", d_chunk->stream_sn);
-                            scu_abort(ECC_PROTOCOL_VIOLATION, 0, NULL);
-                            return SCTP_UNSPECIFIED_ERROR;
-                        }
-                        event_log (VVERBOSE, "Abort current ssn search - Incomplete!");
-                        break;
-                    }
-
-
-                }
-                if(complete)
-                {
-                      event_log (VVERBOSE, "handling complete PDU");
-
-                      d_pdu = (delivery_pdu*)malloc(sizeof(delivery_pdu));
-                      if (d_pdu == NULL) {
-                          return SCTP_OUT_OF_RESOURCES;
-                      }
-                      d_pdu->number_of_chunks = nrOfChunks;
-                      d_pdu->read_position = 0;
-
-                      d_pdu->read_chunk = 0;
-                      d_pdu->chunk_position = 0;
-                      d_pdu->total_length = 0;
-
-                      d_pdu->ddata = (delivery_data**)malloc(nrOfChunks*sizeof(delivery_data*));
-                      if (d_pdu->ddata == NULL) {
-                          free(d_pdu);
-                          return SCTP_OUT_OF_RESOURCES;
-                      }
-
-                      tmp = firstItem;
-                      itemPosition = g_list_position(se->List, tmp);
-
-                      /* get pointers to the first chunks and put them into the pduList */
-                      for (i = 0; i < nrOfChunks; ++i) {
-                          d_pdu->ddata[i] = (delivery_data*)(tmp->data);
-                          d_pdu->total_length += d_pdu->ddata[i]->data_length;
-                          tmp = g_list_next(tmp);
-                      }
-                      if(!unordered && (se->RecvStreams[d_pdu[0].ddata[0]->stream_id].nextSSN == currentSSN))
-                           se->RecvStreams[d_pdu[0].ddata[0]->stream_id].nextSSN++;
-
-                      se->RecvStreams[d_pdu[0].ddata[0]->stream_id].prePduList = g_list_append(se->RecvStreams[d_pdu[0].ddata[0]->stream_id].prePduList, d_pdu);
-                      /* remove chunks from the list and return */
-                      for (i = 1; i <= nrOfChunks; i++)
-                      {
-                           se->List = g_list_remove(se->List, g_list_nth_data(se->List, itemPosition ));
-                           event_logiii(VERBOSE, "Removing chunk nr: %u(%u) list size after remove: %u", i,itemPosition, g_list_length(se->List));
-
-                      }
-                      tmp = g_list_nth(se->List, itemPosition);
-                      nrOfChunks = 0;
-                      firstItem = NULL;
-                      firstTSN = 0;
-                      currentSID = 0;
-                      currentSSN = 0;
-                      complete = FALSE;
-                      continue;
-                }
-                else
-                {
-                    nrOfChunks = 0;
-                    firstItem = NULL;
-                    firstTSN = 0;
-                    currentSID = 0;
-                    currentSSN = 0;
-                    continue;
-                }
-            }
-            else
-            {
-                event_log (VVERBOSE, "No begin chunk!");
-
-                nrOfChunks = 0;
-                firstItem = NULL;
-                firstTSN = 0;
-                currentSID = 0;
-                currentSSN = 0;
-            }
-
-        }
-        if(tmp != NULL)
-            tmp = g_list_next(tmp);
+    if (d_chunk->chunk_flags & SCTP_DATA_UNORDERED) {
+        return se_recvUnordered(se, d_chunk);
     }
-    event_log (INTERNAL_EVENT_0, " ================> se_searchReadyPdu Finished <=============== ");
+    return se_recvOrdered(se, d_chunk);
+}
 
-    return SCTP_SUCCESS;
+
+/**
+ * reads the numbers of DATA chunks received by all associations, and of those that
+ * were queued on the express path
+ */
+void se_getDeliveryCounters(unsigned int* chunks, unsigned int* expressChunks)
+{
+    *chunks        = se_receivedChunks;
+    *expressChunks = se_expressChunks;
 }
 
 
@@ -880,6 +1284,13 @@ int se_deliverWaiting(StreamEngine* se, unsigned short sid)
     {
         d_pdu = (delivery_pdu*)waitingListItem->data;
         se->RecvStreams[sid].pduList = g_list_append(se->RecvStreams[sid].pduList, d_pdu);
+        if (!se->RecvStreams[sid].ready) {
+            /* put the stream on the list for se_ulpreceivebatch() */
+            if (se->lastReady >= 0) se->RecvStreams[se->lastReady].nextReady = sid;
+            else se->firstReady = sid;
+            se->lastReady = sid;
+            se->RecvStreams[sid].ready = TRUE;
+        }
         mdi_dataArriveNotif(sid, d_pdu->total_length, d_pdu->ddata[0]->stream_sn, d_pdu->ddata[0]->tsn,
                                 d_pdu->ddata[0]->protocolId, (d_pdu->ddata[0]->chunk_flags & SCTP_DATA_UNORDERED) ? 1 : 0);
         if(waitingListItem != NULL)
@@ -953,14 +1364,91 @@ se_numOfRecvStreams ()
 }
 
 
+/*
+ * state for the removal of abandoned chunks after a FORWARD-TSN
+ */
+typedef struct
+{
+    StreamEngine* se;
+    guint32       up_to_tsn;
+    GList*        stale;
+}
+se_forward_data;
+
+
+static gint se_sortStaleMessages(gconstpointer one, gconstpointer two)
+{
+    guint32 tsn1 = ((const reassembly_data*)one)->ddata[0]->tsn;
+    guint32 tsn2 = ((const reassembly_data*)two)->ddata[0]->tsn;
+
+    if (before(tsn1, tsn2)) return -1;
+    if (after(tsn1, tsn2)) return 1;
+    return 0;
+}
+
+
+/* collects the complete messages of a stream, that the FORWARD-TSN has moved nextSSN past */
+static void se_findStaleMessage(gpointer key, gpointer value, gpointer user_data)
+{
+    reassembly_data* msg = (reassembly_data*)value;
+    se_forward_data* fwd = (se_forward_data*)user_data;
+    ReceiveStream* rs = &fwd->se->RecvStreams[msg->ddata[0]->stream_id];
+
+    if (sBefore(msg->stream_sn, rs->nextSSN) && se_messageComplete(msg)) {
+        fwd->stale = g_list_insert_sorted(fwd->stale, msg, se_sortStaleMessages);
+    }
+}
+
+
+/* removes the abandoned chunks from an ordered message, and the message, if none is left */
+static gboolean se_forwardMessage(gpointer key, gpointer value, gpointer user_data)
+{
+    reassembly_data* msg = (reassembly_data*)value;
+    se_forward_data* fwd = (se_forward_data*)user_data;
+    ReceiveStream* rs = &fwd->se->RecvStreams[msg->ddata[0]->stream_id];
+    guint32 i, kept = 0;
+
+    for (i = 0; i < msg->number_of_chunks; i++) {
+        if (after(msg->ddata[i]->tsn, fwd->up_to_tsn)) {
+            msg->ddata[kept++] = msg->ddata[i];
+        } else {
+            if (rs->orderedFragments != NULL) {
+                g_hash_table_remove(rs->orderedFragments, GUINT_TO_POINTER(msg->ddata[i]->tsn));
+            }
+            fwd->se->queuedBytes -= msg->ddata[i]->data_length;
+            free_delivery_data(msg->ddata[i]);
+        }
+    }
+    msg->number_of_chunks = kept;
+    if (kept > 0) return FALSE;
+    free_reassembly_data(msg);
+    return TRUE;
+}
+
+
+/* removes an abandoned chunk of an unordered message */
+static gboolean se_forwardFragment(gpointer key, gpointer value, gpointer user_data)
+{
+    delivery_data* d_chunk = (delivery_data*)value;
+    se_forward_data* fwd = (se_forward_data*)user_data;
+
+    if (after(d_chunk->tsn, fwd->up_to_tsn)) return FALSE;
+    fwd->se->queuedBytes -= d_chunk->data_length;
+    free_delivery_data(d_chunk);
+    return TRUE;
+}
+
+
 int se_deliver_unreliably(unsigned int up_to_tsn, SCTP_forward_tsn_chunk* chk)
 {
     int i;
     int numOfSkippedStreams;
     unsigned short skippedStream, skippedSSN;
     pr_stream_data* psd;
+    ReceiveStream* rs;
+    se_forward_data fwd;
     GList* tmp;
-    delivery_data  *d_chunk = NULL;
+    int result;
 
     StreamEngine* se = (StreamEngine *) mdi_readStreamEngine();
     if (se == NULL) {
@@ -972,7 +1460,8 @@ int se_deliver_unreliably(unsigned int up_to_tsn, SCTP_forward_tsn_chunk* chk)
                           sizeof(unsigned int) - sizeof(SCTP_chunk_header)) / sizeof(pr_stream_data);
 
     if (se->unreliable == TRUE) {
-        /* TODO: optimization !!!! loop through all streams */
+        fwd.se        = se;
+        fwd.up_to_tsn = up_to_tsn;
         for (i = 0; i < numOfSkippedStreams; i++)
         {
             psd = (pr_stream_data*) &chk->variableParams[sizeof(pr_stream_data)*i];
@@ -980,20 +1469,30 @@ int se_deliver_unreliably(unsigned int up_to_tsn, SCTP_forward_tsn_chunk* chk)
             skippedSSN = ntohs(psd->stream_sn);
             event_logiii (VERBOSE, "delivering dangling messages in stream %d for forward_tsn=%u, SSN=%u",
                         skippedStream, up_to_tsn, skippedSSN);
+            if (skippedStream >= se->numReceiveStreams) continue;
             /* if unreliable, check if messages can be  delivered */
-            se->RecvStreams[skippedStream].nextSSN = skippedSSN + 1;
+            rs = &se->RecvStreams[skippedStream];
+            rs->nextSSN = skippedSSN + 1;
+            if (rs->messages == NULL) continue;
+
+            fwd.stale = NULL;
+            g_hash_table_foreach(rs->messages, &se_findStaleMessage, &fwd);
+            for (tmp = fwd.stale; tmp != NULL; tmp = g_list_next(tmp)) {
+                se_queueMessage(se, rs, (reassembly_data*)tmp->data);
+            }
+            g_list_free(fwd.stale);
+            result = se_deliverInSequence(se, rs);
+            if (result != SCTP_SUCCESS) return result;
         }
         se_doNotifications();
 
-        tmp = g_list_first(se->List);
-        while((tmp != NULL) && (((delivery_data*)(tmp->data))->tsn <= up_to_tsn))
-        {
-             d_chunk = (delivery_data*)(tmp->data);
-
-             se->List = g_list_remove (se->List, d_chunk);
-             se->queuedBytes -= d_chunk->data_length;
-             free(d_chunk);
-             tmp = g_list_first(se->List);
+        for (i = 0; i < (int)se->numReceiveStreams; i++) {
+            if (se->RecvStreams[i].messages != NULL) {
+                g_hash_table_foreach_remove(se->RecvStreams[i].messages, &se_forwardMessage, &fwd);
+            }
+            if (se->RecvStreams[i].fragments != NULL) {
+                g_hash_table_foreach_remove(se->RecvStreams[i].fragments, &se_forwardFragment, &fwd);
+            }
         }
     }
     return SCTP_SUCCESS;
@@ -47,6 +47,7 @@
 
 #include  "globals.h"           /* boolean, etc */
 #include  "messages.h"
+#include  "chunkpool.h"
 
 
 
@@ -98,6 +99,21 @@ int se_ulpsend(unsigned short streamId,
                gboolean unorderedDelivery,  /* optional (=FALSE if none) */
                gboolean dontBundle);         /* optional (=null if none)  */
 
+/**
+ * This function is called to send a message, that is given as a vector of buffers.
+ *  called from MessageDistribution
+ * @param payload  the payload of a message sent from borrowed buffers (see cp_newPayload()),
+ *                 or NULL if the buffers are to be copied
+ * @return 0 for success, -1 for error (e.g. data sent in shutdown state etc.)
+*/
+int se_ulpsendv(unsigned short streamId,
+                const SCTP_iovec* iov, unsigned int iovcnt,
+                unsigned int byteCount, unsigned int protocolId,
+                short destAddressIndex, void* context, unsigned int lifetime,
+                gboolean unorderedDelivery,
+                gboolean dontBundle,
+                ChunkPayload* payload);
+
 
 
 
@@ -115,11 +131,23 @@ short se_ulpreceivefrom(unsigned char *buffer, unsigned int *byteCount,
                         unsigned int * tsn, unsigned int* addressIndex, unsigned int flags);
 
 
+/* This function is called from ULP to receive the messages waiting on all streams.
+*/
+unsigned int se_ulpreceivebatch(SCTP_ReceivedMessage* messages, unsigned int maxMessages,
+                                unsigned char* arena, unsigned int arenaLength);
+
+
 /*
  * This function is called from RX_Control to receive a chunk.
  */
 int se_recvDataChunk(SCTP_data_chunk * dataChunk, unsigned int byteCount, unsigned int address_index);
 
+/**
+ * reads the numbers of DATA chunks received by all associations, and of those that
+ * were queued on the express path
+ */
+void se_getDeliveryCounters(unsigned int* chunks, unsigned int* expressChunks);
+
 
 /**
  * function to return the number of chunks that can be retrieved
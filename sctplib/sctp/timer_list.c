@@ -47,8 +47,20 @@
 #include <stdio.h>
 #include <glib.h>
 
-static unsigned int tid = 1;
-static GList* timer_list = NULL;
+/* initial number of entries of the timer heap */
+#define TIMER_HEAP_SIZE     64
+
+static ENGINE_LOCAL unsigned int tid = 1;
+/*
+ * The timers are kept in a binary min-heap ordered by their action time, so the
+ * next timer to go off is always timer_heap[0]. Each timer knows its position in
+ * the heap, and timer_table maps timer ids to the timers, so starting, stopping and
+ * restarting a timer need no walk through all timers.
+ */
+static ENGINE_LOCAL AlarmTimer** timer_heap = NULL;
+static ENGINE_LOCAL unsigned int heap_length = 0;
+static ENGINE_LOCAL unsigned int heap_size = 0;
+static ENGINE_LOCAL GHashTable*  timer_table = NULL;
 
 
 /**
@@ -57,45 +69,85 @@ static GList* timer_list = NULL;
  */
 void init_timer_list()
 {
-    if (timer_list != NULL) error_log(ERROR_FATAL, "init_timer_list() should not have been called -> fix program");
-    timer_list = NULL;
+    if (timer_table != NULL) error_log(ERROR_FATAL, "init_timer_list() should not have been called -> fix program");
+    timer_heap = (AlarmTimer**)malloc(TIMER_HEAP_SIZE * sizeof(AlarmTimer*));
+    if (timer_heap == NULL) error_log(ERROR_FATAL, "init_timer_list: out of memory");
+    heap_size = TIMER_HEAP_SIZE;
+    heap_length = 0;
+    timer_table = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 
+/**
+ * compares the action times of two timers. Timers with equal action times go off
+ * in the order in which they were started.
+ * @return TRUE if timer one is to go off before timer two
+ */
+static gboolean timer_before(AlarmTimer* one, AlarmTimer* two)
+{
+    if (one->action_time < two->action_time) return TRUE;
+    if (one->action_time > two->action_time) return FALSE;
+    return (one->sequence < two->sequence);
+}
+
 
-gint timercompare(gconstpointer a, gconstpointer b)
+static void heap_set(unsigned int index, AlarmTimer* item)
 {
-    AlarmTimer *one, *two;
+    timer_heap[index] = item;
+    item->heap_index = index;
+}
 
-    one = (AlarmTimer *) a;
-    two = (AlarmTimer *) b;
-    if (timercmp(&(one->action_time), &(two->action_time), ==))
-        return 0;
-    else if timercmp
-        (&(one->action_time), &(two->action_time), <)return -1;
-    else if timercmp
-        (&(one->action_time), &(two->action_time), >)return 1;
-    /* never reached   */
-    return 0;
+
+/**
+ * moves the timer at position index towards the top of the heap, as far as needed
+ */
+static void heap_sift_up(unsigned int index)
+{
+    AlarmTimer* item = timer_heap[index];
+    unsigned int parent;
+
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (!timer_before(item, timer_heap[parent])) break;
+        heap_set(index, timer_heap[parent]);
+        index = parent;
+    }
+    heap_set(index, item);
 }
 
 
-int idcompare(gconstpointer a, gconstpointer b)
+/**
+ * moves the timer at position index towards the bottom of the heap, as far as needed
+ */
+static void heap_sift_down(unsigned int index)
 {
-    AlarmTimer *one;
-    unsigned int *two;
+    AlarmTimer* item = timer_heap[index];
+    unsigned int child;
+
+    while ((child = 2 * index + 1) < heap_length) {
+        if ((child + 1 < heap_length) && timer_before(timer_heap[child + 1], timer_heap[child])) child++;
+        if (!timer_before(timer_heap[child], item)) break;
+        heap_set(index, timer_heap[child]);
+        index = child;
+    }
+    heap_set(index, item);
+}
 
-    one = (AlarmTimer *) a;
-    two = (unsigned int *) b;
 
-    if (one->timer_id == *two)
-        return 0;
-    else if (one->timer_id < *two)
-        return -1;
-    else if (one->timer_id > *two)
-        return 1;
-    /* never reached */
-    return 0;
+/**
+ * takes a timer out of the heap, but does not free it
+ */
+static void heap_remove(AlarmTimer* item)
+{
+    unsigned int index = item->heap_index;
+
+    heap_length--;
+    if (index == heap_length) return;
+    heap_set(index, timer_heap[heap_length]);
+    if ((index > 0) && timer_before(timer_heap[index], timer_heap[(index - 1) / 2]))
+        heap_sift_up(index);
+    else
+        heap_sift_down(index);
 }
 
 
@@ -107,8 +159,14 @@ int idcompare(gconstpointer a, gconstpointer b)
  */
 void del_timer_list(void)
 {
-    g_list_foreach(timer_list, &free_list_element, NULL);
-    g_list_free(timer_list);
+    unsigned int i;
+
+    for (i = 0; i < heap_length; i++) free_list_element(timer_heap[i], NULL);
+    free(timer_heap);
+    timer_heap = NULL;
+    heap_length = heap_size = 0;
+    if (timer_table != NULL) g_hash_table_destroy(timer_table);
+    timer_table = NULL;
 }
 
 
@@ -124,16 +182,31 @@ void del_timer_list(void)
  */
 unsigned int insert_item(AlarmTimer * item)
 {
+    AlarmTimer** new_heap;
+    static ENGINE_LOCAL unsigned int sequence = 0;
+
+    if (heap_length == heap_size) {
+        new_heap = (AlarmTimer**)realloc(timer_heap, 2 * heap_size * sizeof(AlarmTimer*));
+        if (new_heap == NULL) {
+            error_log(ERROR_MAJOR, "insert_item: out of memory");
+            return 0;
+        }
+        timer_heap = new_heap;
+        heap_size *= 2;
+    }
 
-    item->timer_id = tid++;
+    /* skip 0, and ids that are still in use after the counter wrapped around */
+    do {
+        item->timer_id = tid++;
+    } while ((item->timer_id == 0) ||
+             (g_hash_table_lookup(timer_table, GUINT_TO_POINTER(item->timer_id)) != NULL));
 
     event_logi(VERBOSE, "Insert item : timer id %u ", item->timer_id);
 
-    if (item->timer_id == 0) {
-        tid++;
-        item->timer_id = 1;
-    }
-    timer_list = g_list_insert_sorted(timer_list, item, timercompare);
+    item->sequence = sequence++;
+    g_hash_table_insert(timer_table, GUINT_TO_POINTER(item->timer_id), item);
+    heap_set(heap_length++, item);
+    heap_sift_up(item->heap_index);
 
     /* print_debug_list(VERBOSE); */
 
@@ -151,28 +224,21 @@ unsigned int insert_item(AlarmTimer * item)
  */
 int remove_item(unsigned int id)
 {
-    GList* tmp=NULL;
-    gpointer dat;
+    AlarmTimer* item;
 
     event_logi(VERBOSE, "Remove item : timer id %u called", id);
 
-    tmp = g_list_find_custom(timer_list, &id, idcompare);
+    item = (AlarmTimer*)g_hash_table_lookup(timer_table, GUINT_TO_POINTER(id));
 
-    if (tmp != NULL) {
-        event_logi(VERBOSE, "Remove item : found timer id %u", ((AlarmTimer*)(tmp->data))->timer_id);
+    if (item != NULL) {
+        event_logi(VERBOSE, "Remove item : found timer id %u", item->timer_id);
     } else {
         event_logi(VERBOSE, "Remove item : did NOT find timer id %u", id);
     }
 
-    if (tmp == NULL) return -1;
-
-    dat = tmp->data;
-    free_list_element(dat, NULL);
-    timer_list=g_list_remove(timer_list, dat);
-
-    /* print_debug_list(VERBOSE); */
+    if (item == NULL) return -1;
 
-    return 0;
+    return remove_timer(item);
 }
 
 int remove_timer(AlarmTimer* item)
@@ -181,7 +247,8 @@ int remove_timer(AlarmTimer* item)
 
     event_logi(VERBOSE, "Remove item : timer id %u called", item->timer_id);
 
-    timer_list=g_list_remove(timer_list, item);
+    g_hash_table_remove(timer_table, GUINT_TO_POINTER(item->timer_id));
+    heap_remove(item);
     free_list_element(item, NULL);
     /* print_debug_list(VERBOSE); */
 
@@ -189,25 +256,17 @@ int remove_timer(AlarmTimer* item)
 }
 
 /**
- *	a function to get the pointer to a certain action item, traverses the list
- *    copies the item into the provided pointer (reserve enough space !!)
- *	@param	tlist		pointer to the timer_list instance
- *	@param	timer_id	id of the timer to be found
- *	@param	item	pointer to where found data is to be copied !
- *	@return	0 on success, -1 if a pointer was NULL or other error
+ * takes the timer out of the heap and the id table, sets its new action time
+ * and inserts it again, under a new id
+ * @return new timer_id
  */
-/*int get_item(unsigned int id, AlarmTimer * item)
+static unsigned int reinsert_item(AlarmTimer* item, adl_time action_time)
 {
-
-    GList* result=NULL;
-    result=g_list_find(timer_list,item);
-    if (result!=NULL)
-     	return 0;
-
-   	error_log(ERROR_FATAL, "No valid result in  get_item !\n");
-    return -1;
+    g_hash_table_remove(timer_table, GUINT_TO_POINTER(item->timer_id));
+    heap_remove(item);
+    item->action_time = action_time;
+    return (insert_item(item));
 }
-*/
 
 /**
  *      function to be called, when a timer is reset. Basically calls get_item(),
@@ -222,70 +281,54 @@ int remove_timer(AlarmTimer* item)
 unsigned int update_item(unsigned int id, unsigned int msecs)
 {
     AlarmTimer* tmp_item;
-    GList* tmp=NULL;
 
     event_logi(VERBOSE, "Update item : timer id %u called", id);
 
-    if (timer_list == NULL)  return 0;
+    if (heap_length == 0)  return 0;
 
-    tmp = g_list_find_custom(timer_list, &id, idcompare);
+    tmp_item = (AlarmTimer*)g_hash_table_lookup(timer_table, GUINT_TO_POINTER(id));
 
-    if (tmp != NULL){
-        event_logi(VERBOSE, "Update item : found timer id %u", ((AlarmTimer*)(tmp->data))->timer_id);
+    if (tmp_item != NULL){
+        event_logi(VERBOSE, "Update item : found timer id %u", tmp_item->timer_id);
     } else {
         event_logi(VERBOSE, "Update item : did NOT find timer id %u", id);
     }
 
-    if (tmp == NULL) return 0;
-
-    tmp_item = (AlarmTimer*)tmp->data;
-    timer_list = g_list_remove(timer_list, tmp->data);
+    if (tmp_item == NULL) return 0;
 
     /* update action time, and  write back to the list */
-    adl_gettime(&(tmp_item->action_time));
-    adl_add_msecs_totime(&(tmp_item->action_time), msecs);
-
     /* print_debug_list(VERBOSE); */
 
-    return (insert_item(tmp_item));
+    return (reinsert_item(tmp_item, adl_now() + (adl_time)msecs * ADL_NSECS_PER_MSEC));
 }
 
 unsigned int micro_update_item(unsigned int id, unsigned int seconds, unsigned int microseconds)
 {
     AlarmTimer* tmp_item;
-    GList* tmp=NULL;
-    struct timeval delta, now;
+    adl_time delta;
 
     event_logi(VERBOSE, "Micro-Update item : timer id %u called", id);
 
-    if (timer_list == NULL)  return 0;
+    if (heap_length == 0)  return 0;
 
-    tmp = g_list_find_custom(timer_list, &id, idcompare);
+    tmp_item = (AlarmTimer*)g_hash_table_lookup(timer_table, GUINT_TO_POINTER(id));
 
-    if (tmp != NULL){
-        event_logi(VERBOSE, "Micro-Update item : found timer id %u", ((AlarmTimer*)(tmp->data))->timer_id);
+    if (tmp_item != NULL){
+        event_logi(VERBOSE, "Micro-Update item : found timer id %u", tmp_item->timer_id);
     } else {
         event_logi(VERBOSE, "Micro-Update item : did NOT find timer id %u", id);
     }
 
-    if (tmp == NULL) return 0;
+    if (tmp_item == NULL) return 0;
 
-    tmp_item = (AlarmTimer*)tmp->data;
-    timer_list = g_list_remove(timer_list, tmp->data);
-    delta.tv_sec = seconds;
-    delta.tv_sec += (microseconds / 1000000); /* usually 0 */
-    delta.tv_usec = (microseconds % 1000000); /* usually == microseconds */
+    delta = (adl_time)seconds * ADL_NSECS_PER_SEC + (adl_time)microseconds * ADL_NSECS_PER_USEC;
 
     /* update action time, and  write back to the list */
-    adl_gettime(&now);
-    timeradd(&now, &delta, &(tmp_item->action_time));
-
     /* print_debug_list(VERBOSE); */
 
-    return (insert_item(tmp_item));
+    return (reinsert_item(tmp_item, adl_now() + delta));
 }
 
-
 void print_item_info(short event_log_level, AlarmTimer * item)
 {
     const char* ttype;
@@ -305,40 +348,38 @@ void print_item_info(short event_log_level, AlarmTimer * item)
             break;
         case TIMER_TYPE_USER: ttype = "User Timer";
             break;
+        case TIMER_TYPE_PMTU: ttype = "PMTU Timer";
+            break;
         default:  ttype = "Unknown Timer";
             break;
     }
     event_logii(event_log_level, "TimerID: %d, Type : %s", item->timer_id, ttype);
-    event_logii(event_log_level, "action_time: %ld sec, %ld usec\n",
-                item->action_time.tv_sec, item->action_time.tv_usec);
+    event_logii(event_log_level, "action_time: %lu sec, %lu usec\n",
+                ADL_TIME_SECS(item->action_time), ADL_TIME_USECS(item->action_time));
 }
 
 void print_debug_list(short event_log_level)
 {
-    GList* tmp=NULL;
-    unsigned int  j, i;
+    unsigned int  i;
 
     if (event_log_level <= Current_event_log_) {
         event_log(event_log_level,"-------------Entering print_debug_list() ------------------------");
-        if (timer_list == NULL) {
+        if (timer_heap == NULL) {
             event_log(event_log_level, "tlist pointer == NULL");
             return;
         }
 
-        tmp=g_list_first(timer_list);
-
-        if (tmp==NULL) {
+        if (heap_length == 0) {
             event_log(event_log_level, "Timer-List is empty !");
             return;
         }
         print_time(event_log_level);
-        j=g_list_length(timer_list);
-        event_logi(event_log_level, "List Length : %u ", j);
+        event_logi(event_log_level, "List Length : %u ", heap_length);
 
-        for (i=0; i < j; i++)
+        /* in heap order, i.e. only the first timer is sure to be the next one */
+        for (i=0; i < heap_length; i++)
         {
-            print_item_info(event_log_level, (AlarmTimer*)tmp->data);
-            tmp = g_list_next(tmp);
+            print_item_info(event_log_level, timer_heap[i]);
         }
         event_log(event_log_level,"-------------Leaving print_debug_list() ------------------------");
     }
@@ -353,44 +394,26 @@ void print_debug_list(short event_log_level)
 */
 int get_msecs_to_nexttimer()
 {
-    long secs, usecs;
-    GList* result=NULL;
-    int msecs;
     AlarmTimer* next;
-    struct timeval now;
-
-    result = g_list_first(timer_list);
-
-    if (result == NULL) return -1;
+    adl_time now;
 
-    adl_gettime(&now);
-    next = (AlarmTimer*)result->data;
+    if (heap_length == 0) return -1;
 
-    secs = next->action_time.tv_sec - now.tv_sec;
-    usecs = next->action_time.tv_usec - now.tv_usec;
-
-    if (secs < 0)  return 0;
-
-    if (usecs < 0) {
-        secs--;
-        usecs += 1000000;
-    }
+    now = adl_now();
+    next = timer_heap[0];
 
-    if (secs < 0) return 0;
+    if (next->action_time <= now) return 0;
 
     /* here we will be cutting of the rest..... */
-    msecs = (int) (1000 * secs + usecs / 1000);
-    return (msecs);
+    return ((int)((next->action_time - now) / ADL_NSECS_PER_MSEC));
 }
 
 int get_next_event(AlarmTimer ** dest)
 {
-    GList* result=NULL;
     *dest = NULL;
 
-    if (g_list_first(timer_list) == NULL) return -1;
-    result = g_list_first(timer_list);
-    *dest = (AlarmTimer*)result->data;
+    if (heap_length == 0) return -1;
+    *dest = timer_heap[0];
 
     return 0;
 }
@@ -398,7 +421,7 @@ int get_next_event(AlarmTimer ** dest)
 
 int timer_list_empty()
 {
-    if (g_list_first(timer_list) == NULL)
+    if (heap_length == 0)
         return 1;
     else
         return 0;
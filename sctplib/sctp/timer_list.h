@@ -92,7 +92,7 @@
 #include "globals.h"
 
 /**
-  *  A singly linked list for timer events
+  *  A timer event, kept in a heap ordered by action time
   */
 
 
@@ -101,14 +101,17 @@ typedef struct alarm_timer
 {
     unsigned int timer_id;
     int timer_type;
-/* the time when it is to go off */
-    struct timeval action_time;
+/* the time when it is to go off, see adl_now() */
+    adl_time action_time;
 /* pointer to possible arguments */
     void *arg1;
     void *arg2;
 /* the callback function 	*/
     void (*action) (TimerID, void *, void *);
-/* arranged in a sorted, linked list	*/
+/* position in the timer heap */
+    unsigned int heap_index;
+/* orders timers with equal action times */
+    unsigned int sequence;
 }
 AlarmTimer;
 /**
@@ -174,8 +177,6 @@ unsigned int micro_update_item(unsigned int id, unsigned int seconds, unsigned i
 int get_msecs_to_nexttimer(void);
 
 
-void adl_add_msecs_totime(struct timeval *t, unsigned int msecs);
-
 void print_debug_list(short event_log_level);
 
 /**